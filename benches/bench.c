@@ -0,0 +1,610 @@
+/* Core benchmarks, built by `make bench`.
+ *
+ * Links the real core objects against stub_backend.c and times the
+ * tree, query and rule code on generated window sets. Each run prints
+ * one tab separated line per scenario and parameter set:
+ *
+ *   scenario windows depth desktops monitors rules ops ns_per_op
+ *   allocs_per_op calls_per_op configures_per_op
+ *
+ * windows is per desktop, rules is the number of class rules (every
+ * window matches one of them), depth caps the depth new windows are
+ * inserted at before the insertion point moves to the shallowest leaf.
+ * Allocations are counted through the linker's --wrap of the malloc
+ * family; calls are the stub backend calls made per operation.
+ *
+ * With -b FILE, the ns_per_op of a previous run is read from FILE and
+ * appended with the ratio of the current run, see make bench_baseline.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bspwm.h"
+#include "desktop.h"
+#include "monitor.h"
+#include "tree.h"
+#include "query.h"
+#include "rule.h"
+#include "window.h"
+#include "settings.h"
+#include "messages.h"
+#include "restore.h"
+#include "stats.h"
+#include "stub_backend.h"
+
+#define BENCH_MIN_NS     20000000
+#define BENCH_MAX_LINES  1024
+#define BENCH_MAX_MONITORS 64
+
+typedef struct {
+	int windows;
+	int depth;
+	int desktops;
+	int monitors;
+	int rules;
+} bench_params_t;
+
+typedef struct {
+	char key[128];
+	double ns_per_op;
+} baseline_entry_t;
+
+static const bench_params_t default_matrix[] = {
+	{  10,   4,  1, 1,   0},
+	{ 100,   8,  1, 1,   0},
+	{ 100, 100,  1, 1,   0},
+	{1000,  12,  1, 1,   0},
+	{ 100,   8, 10, 2,   0},
+	{ 100,   8,  4, 4,  50},
+	{ 100,   8,  1, 1, 500},
+};
+
+static uint64_t alloc_count;
+static baseline_entry_t baseline[BENCH_MAX_LINES];
+static int baseline_len;
+static const char *only_scenario;
+static bspwm_wid_t first_window, last_window;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	alloc_count++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	alloc_count++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	alloc_count++;
+	return __real_realloc(ptr, size);
+}
+
+/* Measurement */
+
+typedef struct {
+	uint64_t ops;
+	uint64_t ns;
+	uint64_t allocs;
+	stub_calls_t calls;
+} sample_t;
+
+static uint64_t sample_start_ns, sample_start_allocs;
+
+static void sample_begin(void)
+{
+	stub_reset_calls();
+	sample_start_allocs = alloc_count;
+	sample_start_ns = latency_now();
+}
+
+static void sample_end(sample_t *s, uint64_t ops)
+{
+	s->ns += latency_now() - sample_start_ns;
+	s->allocs += alloc_count - sample_start_allocs;
+	s->calls.total += stub_calls.total;
+	s->calls.configure += stub_calls.configure;
+	s->ops += ops;
+}
+
+static void format_key(char *buf, size_t len, const char *scenario, const bench_params_t *p)
+{
+	snprintf(buf, len, "%s\t%d\t%d\t%d\t%d\t%d", scenario,
+	         p->windows, p->depth, p->desktops, p->monitors, p->rules);
+}
+
+static void report(const char *scenario, const bench_params_t *p, const sample_t *s)
+{
+	char key[128];
+	format_key(key, sizeof(key), scenario, p);
+	double ops = s->ops > 0 ? (double) s->ops : 1;
+	double ns_per_op = s->ns / ops;
+	printf("%s\t%" PRIu64 "\t%.1f\t%.2f\t%.2f\t%.2f", key, s->ops, ns_per_op,
+	       s->allocs / ops, s->calls.total / ops, s->calls.configure / ops);
+	if (baseline_len > 0) {
+		double base = 0;
+		for (int i = 0; i < baseline_len; i++) {
+			if (streq(baseline[i].key, key)) {
+				base = baseline[i].ns_per_op;
+				break;
+			}
+		}
+		if (base > 0) {
+			printf("\t%.1f\t%.2f", base, ns_per_op / base);
+		} else {
+			printf("\t-\t-");
+		}
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static bool wanted(const char *scenario)
+{
+	return only_scenario == NULL || streq(only_scenario, scenario);
+}
+
+/* Population */
+
+static int node_depth(node_t *n)
+{
+	int depth = 0;
+	while (n->parent != NULL) {
+		n = n->parent;
+		depth++;
+	}
+	return depth;
+}
+
+static node_t *insertion_point(desktop_t *d, int max_depth)
+{
+	if (d->focus == NULL || node_depth(d->focus) < max_depth) {
+		return d->focus;
+	}
+	node_t *best = NULL;
+	int best_depth = 0;
+	for (node_t *f = first_extrema(d->root); f != NULL; f = next_leaf(f, d->root)) {
+		int depth = node_depth(f);
+		if (best == NULL || depth < best_depth) {
+			best = f;
+			best_depth = depth;
+		}
+	}
+	return best;
+}
+
+static void populate(const bench_params_t *p, sample_t *manage)
+{
+	stub_monitors = p->monitors;
+	stub_classes = p->rules > 0 ? p->rules : 1;
+
+	load_settings();
+	setup();
+
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		int count = 0;
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			count++;
+		}
+		while (count++ < p->desktops) {
+			add_desktop(m, make_desktop(NULL, BSPWM_WID_NONE));
+		}
+	}
+
+	for (int i = 0; i < p->rules; i++) {
+		rule_t *r = make_rule();
+		snprintf(r->class_name, sizeof(r->class_name), "Bench%d", i);
+		snprintf(r->instance_name, sizeof(r->instance_name), "%s", MATCH_ANY);
+		snprintf(r->name, sizeof(r->name), "%s", MATCH_ANY);
+		snprintf(r->effect, sizeof(r->effect), "border=on");
+		add_rule(r);
+	}
+
+	first_window = last_window = BSPWM_WID_NONE;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			focus_node(m, d, d->focus);
+			for (int i = 0; i < p->windows; i++) {
+				node_t *f = insertion_point(d, p->depth);
+				if (f != d->focus) {
+					focus_node(m, d, f);
+				}
+				bspwm_wid_t win = stub_new_window();
+				if (first_window == BSPWM_WID_NONE) {
+					first_window = win;
+				}
+				last_window = win;
+				sample_begin();
+				schedule_window(win);
+				sample_end(manage, 1);
+			}
+		}
+	}
+
+	focus_node(mon_head, mon_head->desk_head, mon_head->desk_head->focus);
+}
+
+/* Scenarios */
+
+static void bench_locate(const bench_params_t *p)
+{
+	sample_t s = {0};
+	coordinates_t loc;
+	uint64_t found = 0;
+	do {
+		sample_begin();
+		for (bspwm_wid_t win = first_window; win <= last_window; win++) {
+			found += locate_window(win, &loc);
+		}
+		sample_end(&s, last_window - first_window + 1);
+	} while (s.ns < BENCH_MIN_NS);
+	(void) found;
+	report("locate", p, &s);
+}
+
+static void bench_traverse(const bench_params_t *p)
+{
+	desktop_t *d = mon->desk;
+	sample_t s = {0};
+	volatile unsigned int count = 0;
+	do {
+		sample_begin();
+		for (node_t *f = first_extrema(d->root); f != NULL; f = next_leaf(f, d->root)) {
+			count++;
+		}
+		sample_end(&s, 1);
+	} while (s.ns < BENCH_MIN_NS);
+	report("traverse", p, &s);
+}
+
+static void bench_collect_leaves(const bench_params_t *p)
+{
+	desktop_t *d = mon->desk;
+	sample_t s = {0};
+	do {
+		sample_begin();
+		node_list_t *list = collect_leaves(d->root);
+		free_node_list(list);
+		sample_end(&s, 1);
+	} while (s.ns < BENCH_MIN_NS);
+	report("collect_leaves", p, &s);
+}
+
+static void bench_arrange(const bench_params_t *p)
+{
+	monitor_t *m = mon;
+	desktop_t *d = m->desk;
+	sample_t s = {0};
+	do {
+		sample_begin();
+		invalidate_layout_in(d->root);
+		arrange(m, d);
+		sample_end(&s, 1);
+	} while (s.ns < BENCH_MIN_NS);
+	report("arrange", p, &s);
+}
+
+static void bench_neighbor(const bench_params_t *p)
+{
+	monitor_t *m = mon;
+	desktop_t *d = m->desk;
+	node_select_t sel = make_node_select();
+	sample_t s = {0};
+	coordinates_t dst;
+	do {
+		sample_begin();
+		uint64_t ops = 0;
+		for (node_t *f = first_extrema(d->root); f != NULL; f = next_leaf(f, d->root)) {
+			coordinates_t ref = {m, d, f};
+			for (direction_t dir = DIR_NORTH; dir <= DIR_EAST; dir++) {
+				find_nearest_neighbor(&ref, &dst, dir, &sel);
+				ops++;
+			}
+		}
+		sample_end(&s, ops);
+	} while (s.ns < BENCH_MIN_NS);
+	report("neighbor", p, &s);
+}
+
+static void bench_focus(const bench_params_t *p)
+{
+	monitor_t *m = mon;
+	desktop_t *d = m->desk;
+	sample_t s = {0};
+	do {
+		sample_begin();
+		uint64_t ops = 0;
+		for (node_t *f = first_extrema(d->root); f != NULL; f = next_leaf(f, d->root)) {
+			focus_node(m, d, f);
+			ops++;
+		}
+		sample_end(&s, ops);
+	} while (s.ns < BENCH_MIN_NS);
+	report("focus", p, &s);
+}
+
+static void bench_rules(const bench_params_t *p)
+{
+	sample_t s = {0};
+	do {
+		sample_begin();
+		for (bspwm_wid_t win = first_window; win <= last_window; win++) {
+			rule_consequence_t *csq = make_rule_consequence();
+			backend_fetch_window_attributes(win, &csq->attrs, csq->class_name, csq->instance_name,
+			                                csq->name, sizeof(csq->class_name));
+			apply_rules(win, csq);
+			free(csq->rect);
+			free(csq->layer);
+			free(csq->state);
+			free(csq->split_dir);
+			free(csq);
+		}
+		sample_end(&s, last_window - first_window + 1);
+	} while (s.ns < BENCH_MIN_NS);
+	report("rules", p, &s);
+}
+
+static void bench_message(const bench_params_t *p, const char *scenario, const char *const *words, int num)
+{
+	char buf[BUFSIZ];
+	char *args[8];
+	sample_t s = {0};
+	do {
+		char *pos = buf;
+		for (int i = 0; i < num; i++) {
+			size_t len = strlen(words[i]) + 1;
+			memcpy(pos, words[i], len);
+			args[i] = pos;
+			pos += len;
+		}
+		/* process_message closes the response stream like a client socket */
+		FILE *rsp = fopen("/dev/null", "w");
+		if (rsp == NULL) {
+			err("Can't open /dev/null.\n");
+		}
+		sample_begin();
+		process_message(args, num, rsp);
+		sample_end(&s, 1);
+	} while (s.ns < BENCH_MIN_NS);
+	report(scenario, p, &s);
+}
+
+/* Regaps the focused desktop in monocle, where only the focus is shown */
+static void bench_monocle(const bench_params_t *p)
+{
+	monitor_t *m = mon;
+	desktop_t *d = m->desk;
+	set_layout(m, d, LAYOUT_MONOCLE, true);
+	bench_message(p, "monocle", (const char *const[]) {"batch", "config window_gap 4",
+	              "config window_gap 6"}, 3);
+	set_layout(m, d, LAYOUT_TILED, true);
+}
+
+/* Resizes the last output back and forth, as a hotplug on another one would */
+static void bench_hotplug(const bench_params_t *p)
+{
+	sample_t s = {0};
+	do {
+		stub_shrink_last_output = !stub_shrink_last_output;
+		sample_begin();
+		update_monitors();
+		sample_end(&s, 1);
+	} while (s.ns < BENCH_MIN_NS);
+	stub_shrink_last_output = false;
+	update_monitors();
+	report("hotplug", p, &s);
+}
+
+/* Restores a dump of the populated state, which keeps every window */
+static void bench_restore(const bench_params_t *p)
+{
+	char path[] = "/tmp/bspwm_bench_XXXXXX";
+	int fd = mkstemp(path);
+	FILE *rsp = fd == -1 ? NULL : fdopen(fd, "w");
+	if (rsp == NULL) {
+		err("Can't create the state file.\n");
+	}
+	char wm[] = "wm", dump[] = "-d";
+	process_message((char *[]) {wm, dump}, 2, rsp);
+	sample_t s = {0};
+	do {
+		sample_begin();
+		restore_state(path);
+		sample_end(&s, 1);
+	} while (s.ns < BENCH_MIN_NS);
+	unlink(path);
+	report("restore", p, &s);
+}
+
+static void bench_unmanage(const bench_params_t *p)
+{
+	sample_t s = {0};
+	for (bspwm_wid_t win = first_window; win <= last_window; win++) {
+		sample_begin();
+		unmanage_window(win);
+		sample_end(&s, 1);
+	}
+	report("unmanage", p, &s);
+}
+
+static void run(const bench_params_t *p)
+{
+	sample_t manage = {0};
+	populate(p, &manage);
+	if (wanted("manage")) {
+		report("manage", p, &manage);
+	}
+	if (wanted("locate")) {
+		bench_locate(p);
+	}
+	if (wanted("traverse")) {
+		bench_traverse(p);
+	}
+	if (wanted("collect_leaves")) {
+		bench_collect_leaves(p);
+	}
+	if (wanted("arrange")) {
+		bench_arrange(p);
+	}
+	if (wanted("neighbor")) {
+		bench_neighbor(p);
+	}
+	if (wanted("rules")) {
+		bench_rules(p);
+	}
+	if (wanted("query_nodes")) {
+		bench_message(p, "query_nodes", (const char *const[]) {"query", "-N"}, 2);
+	}
+	if (wanted("query_tree")) {
+		bench_message(p, "query_tree", (const char *const[]) {"query", "-T", "-d"}, 3);
+	}
+	if (wanted("batch")) {
+		bench_message(p, "batch", (const char *const[]) {"batch", "node @/ -r 0.4", "node @/ -r 0.6",
+		              "config window_gap 4", "config window_gap 6", "node @/ -r 0.5"}, 6);
+	}
+	if (wanted("monocle")) {
+		bench_monocle(p);
+	}
+	if (wanted("focus")) {
+		bench_focus(p);
+	}
+	if (wanted("switch")) {
+		bench_message(p, "switch", (const char *const[]) {"desktop", "-f", "next.local"}, 3);
+	}
+	if (wanted("switch_composited")) {
+		set_composited_switching(true);
+		bench_message(p, "switch_composited", (const char *const[]) {"desktop", "-f", "next.local"}, 3);
+		set_composited_switching(false);
+	}
+	if (wanted("hotplug")) {
+		bench_hotplug(p);
+	}
+	if (wanted("restore")) {
+		bench_restore(p);
+	}
+	if (wanted("unmanage")) {
+		bench_unmanage(p);
+	}
+	cleanup();
+}
+
+static void load_baseline(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		warn("Can't open baseline '%s'.\n", path);
+		return;
+	}
+	char line[512];
+	while (baseline_len < BENCH_MAX_LINES && fgets(line, sizeof(line), f) != NULL) {
+		if (line[0] == '#' || strncmp(line, "scenario\t", 9) == 0) {
+			continue;
+		}
+		/* The key is the first six fields, ns_per_op the eighth. */
+		char *field = line;
+		for (int i = 0; i < 6 && field != NULL; i++) {
+			field = strchr(field, '\t');
+			if (field != NULL) {
+				field++;
+			}
+		}
+		if (field == NULL) {
+			continue;
+		}
+		baseline_entry_t *e = &baseline[baseline_len];
+		size_t len = field - line - 1;
+		if (len >= sizeof(e->key)) {
+			continue;
+		}
+		memcpy(e->key, line, len);
+		e->key[len] = '\0';
+		char *ns = strchr(field, '\t');
+		if (ns == NULL) {
+			continue;
+		}
+		e->ns_per_op = strtod(ns + 1, NULL);
+		baseline_len++;
+	}
+	fclose(f);
+}
+
+static void usage(void)
+{
+	printf("bench [-b BASELINE] [-s SCENARIO] [-w WINDOWS] [-t DEPTH] [-k DESKTOPS] [-m MONITORS] [-r RULES]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	bench_params_t custom = {100, 8, 1, 1, 0};
+	bool use_custom = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "hb:s:w:t:k:m:r:")) != -1) {
+		switch (opt) {
+			case 'b':
+				load_baseline(optarg);
+				break;
+			case 's':
+				only_scenario = optarg;
+				break;
+			case 'w':
+				custom.windows = atoi(optarg);
+				use_custom = true;
+				break;
+			case 't':
+				custom.depth = atoi(optarg);
+				use_custom = true;
+				break;
+			case 'k':
+				custom.desktops = atoi(optarg);
+				use_custom = true;
+				break;
+			case 'm':
+				custom.monitors = atoi(optarg);
+				use_custom = true;
+				break;
+			case 'r':
+				custom.rules = atoi(optarg);
+				use_custom = true;
+				break;
+			case 'h':
+				usage();
+				return EXIT_SUCCESS;
+			default:
+				usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (custom.windows < 1 || custom.depth < 1 || custom.desktops < 1 ||
+	    custom.monitors < 1 || custom.monitors > BENCH_MAX_MONITORS || custom.rules < 0) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	printf("scenario\twindows\tdepth\tdesktops\tmonitors\trules\tops\tns_per_op\tallocs_per_op\tcalls_per_op\tconfigures_per_op");
+	if (baseline_len > 0) {
+		printf("\tbaseline_ns_per_op\tratio");
+	}
+	printf("\n");
+
+	if (use_custom) {
+		run(&custom);
+	} else {
+		for (size_t i = 0; i < LENGTH(default_matrix); i++) {
+			run(&default_matrix[i]);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
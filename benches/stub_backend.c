@@ -0,0 +1,444 @@
+/* Stub backend for the core benchmarks, see stub_backend.h.
+ *
+ * Only the entry points the core and window_ops.c reference are
+ * provided; window_ops.c supplies the rest of the backend surface.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "backend.h"
+#include "stub_backend.h"
+
+#define STUB_ROOT          0x00000001
+#define STUB_FIRST_WINDOW  0x00400000
+#define STUB_FIRST_SPECIAL 0x00100000
+#define STUB_OUTPUT_WIDTH  1920
+#define STUB_OUTPUT_HEIGHT 1080
+
+stub_calls_t stub_calls;
+int stub_monitors = 1;
+bool stub_shrink_last_output = false;
+unsigned int stub_classes = 1;
+
+static uint32_t next_window = STUB_FIRST_WINDOW;
+static uint32_t next_special = STUB_FIRST_SPECIAL;
+static uint32_t serial;
+
+#define CALL(group) (stub_calls.total++, stub_calls.group++)
+#define OTHER() (stub_calls.total++)
+
+void stub_reset_calls(void)
+{
+	stub_calls = (stub_calls_t) {0};
+}
+
+uint32_t stub_new_window(void)
+{
+	return next_window++;
+}
+
+/* Lifecycle */
+
+int backend_init(int *default_screen)
+{
+	OTHER();
+	if (default_screen != NULL) {
+		*default_screen = 0;
+	}
+	return 0;
+}
+
+void backend_destroy(void)
+{
+	OTHER();
+}
+
+int backend_get_fd(void)
+{
+	OTHER();
+	return -1;
+}
+
+void backend_flush(void)
+{
+	OTHER();
+}
+
+uint32_t backend_request_count(void)
+{
+	return (uint32_t) stub_calls.total;
+}
+
+bool backend_dispatch_events(void)
+{
+	OTHER();
+	return true;
+}
+
+bool backend_check_connection(void)
+{
+	OTHER();
+	return true;
+}
+
+bool backend_parse_display(char **host, int *display_num, int *screen_num)
+{
+	OTHER();
+	(void) host;
+	(void) display_num;
+	(void) screen_num;
+	return false;
+}
+
+void backend_get_screen_size(int *width, int *height)
+{
+	OTHER();
+	*width = STUB_OUTPUT_WIDTH * stub_monitors;
+	*height = STUB_OUTPUT_HEIGHT;
+}
+
+bspwm_wid_t backend_get_root(void)
+{
+	OTHER();
+	return STUB_ROOT;
+}
+
+/* Windows */
+
+bspwm_wid_t backend_create_internal_window(const char *kind, bspwm_rect_t rect, bool input_only)
+{
+	OTHER();
+	(void) kind;
+	(void) rect;
+	(void) input_only;
+	return next_special++;
+}
+
+void backend_destroy_window(bspwm_wid_t win)
+{
+	OTHER();
+	(void) win;
+}
+
+void backend_window_show(bspwm_wid_t win)
+{
+	CALL(map);
+	(void) win;
+}
+
+void backend_window_hide(bspwm_wid_t win)
+{
+	CALL(map);
+	(void) win;
+}
+
+void backend_window_park(bspwm_wid_t win, bool parked)
+{
+	CALL(configure);
+	(void) win;
+	(void) parked;
+}
+
+void backend_window_move(bspwm_wid_t win, int16_t x, int16_t y)
+{
+	CALL(configure);
+	(void) win;
+	(void) x;
+	(void) y;
+}
+
+void backend_window_resize(bspwm_wid_t win, uint16_t w, uint16_t h)
+{
+	CALL(configure);
+	(void) win;
+	(void) w;
+	(void) h;
+}
+
+void backend_window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t w, uint16_t h)
+{
+	CALL(configure);
+	(void) win;
+	(void) x;
+	(void) y;
+	(void) w;
+	(void) h;
+}
+
+void backend_window_set_border_width(bspwm_wid_t win, uint32_t bw)
+{
+	CALL(border);
+	(void) win;
+	(void) bw;
+}
+
+void backend_window_set_border_color(bspwm_wid_t win, uint32_t color)
+{
+	CALL(border);
+	(void) win;
+	(void) color;
+}
+
+uint32_t backend_configure_serial(void)
+{
+	OTHER();
+	return serial++;
+}
+
+void backend_forget_window(bspwm_wid_t win)
+{
+	OTHER();
+	(void) win;
+}
+
+bool backend_window_exists(bspwm_wid_t win)
+{
+	OTHER();
+	return win >= STUB_FIRST_WINDOW && win < next_window;
+}
+
+void backend_window_listen_enter(bspwm_wid_t win, bool enable)
+{
+	OTHER();
+	(void) win;
+	(void) enable;
+}
+
+void backend_window_stack_above(bspwm_wid_t w1, bspwm_wid_t w2)
+{
+	CALL(stack);
+	(void) w1;
+	(void) w2;
+}
+
+void backend_window_stack_below(bspwm_wid_t w1, bspwm_wid_t w2)
+{
+	CALL(stack);
+	(void) w1;
+	(void) w2;
+}
+
+void backend_window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings,
+                            uint32_t count, bool above)
+{
+	CALL(stack);
+	(void) wins;
+	(void) siblings;
+	(void) count;
+	(void) above;
+}
+
+void backend_window_lower(bspwm_wid_t win)
+{
+	CALL(stack);
+	(void) win;
+}
+
+/* Focus */
+
+void backend_set_input_focus(bspwm_wid_t win)
+{
+	CALL(focus);
+	(void) win;
+}
+
+void backend_clear_input_focus(void)
+{
+	CALL(focus);
+}
+
+void backend_send_take_focus(bspwm_wid_t win, bspwm_icccm_props_t *props)
+{
+	CALL(focus);
+	(void) win;
+	(void) props;
+}
+
+void backend_ewmh_update_active_window(bspwm_wid_t win)
+{
+	CALL(focus);
+	(void) win;
+}
+
+/* Window properties */
+
+static void describe_window(bspwm_wid_t win, char *class_name, char *instance_name, char *name, size_t len)
+{
+	if (class_name != NULL) {
+		snprintf(class_name, len, "Bench%u", win % (stub_classes > 0 ? stub_classes : 1));
+	}
+	if (instance_name != NULL) {
+		snprintf(instance_name, len, "bench");
+	}
+	if (name != NULL) {
+		snprintf(name, len, "bench 0x%08X", win);
+	}
+}
+
+bool backend_get_window_class(bspwm_wid_t win, char *class_name, char *instance_name, size_t len)
+{
+	OTHER();
+	describe_window(win, class_name, instance_name, NULL, len);
+	return true;
+}
+
+bool backend_get_icccm_props(bspwm_wid_t win, bspwm_icccm_props_t *props)
+{
+	OTHER();
+	(void) win;
+	*props = (bspwm_icccm_props_t) {.input_hint = true, .delete_window = true};
+	return true;
+}
+
+bool backend_get_size_hints(bspwm_wid_t win, bspwm_size_hints_t *hints)
+{
+	OTHER();
+	(void) win;
+	*hints = (bspwm_size_hints_t) {0};
+	return false;
+}
+
+void backend_set_window_state(bspwm_wid_t win, bspwm_wm_state_t state)
+{
+	OTHER();
+	(void) win;
+	(void) state;
+}
+
+static void fill_attributes(bspwm_wid_t win, bspwm_window_attrs_t *attrs)
+{
+	*attrs = (bspwm_window_attrs_t) {0};
+	attrs->transient_for = BSPWM_WID_NONE;
+	attrs->icccm_props = (bspwm_icccm_props_t) {.input_hint = true, .delete_window = true};
+	attrs->has_geometry = true;
+	attrs->geometry = (bspwm_rect_t) {0, 0, 640, 480};
+	(void) win;
+}
+
+bspwm_attrs_cookie_t backend_request_window_attributes(bspwm_wid_t win, bool with_name)
+{
+	OTHER();
+	(void) with_name;
+	bspwm_attrs_cookie_t cookie = {0};
+	cookie.sequence[0] = win;
+	return cookie;
+}
+
+void backend_collect_window_attributes(bspwm_wid_t win, bspwm_attrs_cookie_t cookie, bspwm_window_attrs_t *attrs,
+                                       char *class_name, char *instance_name, char *name, size_t len)
+{
+	OTHER();
+	(void) cookie;
+	fill_attributes(win, attrs);
+	describe_window(win, class_name, instance_name, name, len);
+}
+
+void backend_fetch_window_attributes(bspwm_wid_t win, bspwm_window_attrs_t *attrs,
+                                     char *class_name, char *instance_name, char *name, size_t len)
+{
+	OTHER();
+	fill_attributes(win, attrs);
+	describe_window(win, class_name, instance_name, name, len);
+}
+
+/* Outputs */
+
+int backend_query_outputs(bspwm_output_info_t *outputs, int max)
+{
+	OTHER();
+	int len = stub_monitors < max ? stub_monitors : max;
+	for (int i = 0; i < len; i++) {
+		outputs[i] = (bspwm_output_info_t) {0};
+		snprintf(outputs[i].name, sizeof(outputs[i].name), "BENCH-%d", i + 1);
+		outputs[i].id = i + 1;
+		outputs[i].rect = (bspwm_rect_t) {i * STUB_OUTPUT_WIDTH, 0, STUB_OUTPUT_WIDTH, STUB_OUTPUT_HEIGHT};
+		if (stub_shrink_last_output && i == len - 1) {
+			outputs[i].rect.width--;
+		}
+		outputs[i].primary = (i == 0);
+		outputs[i].refresh = 60000;
+	}
+	return len;
+}
+
+bool backend_set_adaptive_sync(bspwm_output_id_t id, bool enable)
+{
+	OTHER();
+	(void) id;
+	(void) enable;
+	return true;
+}
+
+bool backend_output_direct_scanout(bspwm_output_id_t id)
+{
+	OTHER();
+	(void) id;
+	return false;
+}
+
+/* Pointer */
+
+void backend_query_pointer(bspwm_wid_t *win, bspwm_point_t *pos)
+{
+	OTHER();
+	if (win != NULL) {
+		*win = BSPWM_WID_NONE;
+	}
+	if (pos != NULL) {
+		*pos = (bspwm_point_t) {0, 0};
+	}
+}
+
+void backend_warp_pointer(bspwm_rect_t rect)
+{
+	OTHER();
+	(void) rect;
+}
+
+/* Presel feedback */
+
+bspwm_wid_t backend_create_presel_feedback(uint32_t color)
+{
+	OTHER();
+	(void) color;
+	return next_special++;
+}
+
+void backend_set_presel_feedback_color(bspwm_wid_t win, uint32_t color)
+{
+	OTHER();
+	(void) win;
+	(void) color;
+}
+
+/* Closing */
+
+void backend_close_window(bspwm_wid_t win)
+{
+	OTHER();
+	(void) win;
+}
+
+void backend_request_close(bspwm_wid_t win)
+{
+	OTHER();
+	(void) win;
+}
+
+/* Misc */
+
+uint32_t backend_get_color_pixel(const char *color)
+{
+	OTHER();
+	unsigned int red, green, blue;
+	if (sscanf(color + 1, "%02x%02x%02x", &red, &green, &blue) == 3) {
+		return (0xFF << 24) | (red << 16 | green << 8 | blue);
+	}
+	return 0xFF000000;
+}
+
+void backend_enumerate_windows(backend_window_visitor_t visitor)
+{
+	OTHER();
+	(void) visitor;
+}
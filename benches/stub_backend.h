@@ -0,0 +1,36 @@
+/* Stub backend for the core benchmarks.
+ *
+ * Implements backend.h without any display server: every call is
+ * counted and answered with plausible values, so the real tree, query
+ * and rule code can be driven from benches/bench.c.
+ */
+
+#ifndef BSPWM_STUB_BACKEND_H
+#define BSPWM_STUB_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+	uint64_t total;
+	uint64_t configure;  /* move, resize, move_resize */
+	uint64_t map;        /* show, hide */
+	uint64_t border;     /* border width and color */
+	uint64_t stack;      /* restack, stack_above/below, lower */
+	uint64_t focus;      /* input focus, take focus, active window */
+} stub_calls_t;
+
+extern stub_calls_t stub_calls;
+
+/* Number of outputs reported by backend_query_outputs. */
+extern int stub_monitors;
+/* The last output is reported one pixel narrower. */
+extern bool stub_shrink_last_output;
+/* Windows report the class "Bench<id % stub_classes>". */
+extern unsigned int stub_classes;
+
+void stub_reset_calls(void);
+/* Hand out a fresh client window id. */
+uint32_t stub_new_window(void);
+
+#endif
@@ -128,6 +128,7 @@ typedef struct {
 	bspwm_output_id_t id;
 	bspwm_rect_t      rect;
 	bool              primary;
+	uint32_t          refresh;  /* mHz, 0 when unknown */
 } bspwm_output_info_t;
 
 /* ------------------------------------------------------------------ */
@@ -148,6 +149,10 @@ int  backend_get_fd(void);
 /* Flush pending requests to the display server. */
 void backend_flush(void);
 
+/* Running count of requests sent to the X server, or of serials handed
+ * out to Wayland clients. Wraps around; only differences are meaningful. */
+uint32_t backend_request_count(void);
+
 /* Poll and dispatch all pending display server events.
  * Returns false if the connection is dead. */
 bool backend_dispatch_events(void);
@@ -183,6 +188,11 @@ void backend_window_show(bspwm_wid_t win);
 /* Hide (unmap) a window. */
 void backend_window_hide(bspwm_wid_t win);
 
+/* Park or unpark a window: a parked window stays mapped but out of
+ * sight, moved off every output (X11) or with its scene node disabled
+ * (wlroots). Moves sent while parked take effect on unparking. */
+void backend_window_park(bspwm_wid_t win, bool parked);
+
 /* Move a window. */
 void backend_window_move(bspwm_wid_t win, int16_t x, int16_t y);
 
@@ -195,6 +205,15 @@ void backend_window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t
 /* Set border width. */
 void backend_window_set_border_width(bspwm_wid_t win, uint32_t bw);
 
+/* Serial of the last configure request sent, to be compared with the
+ * serials given to client_geometry_observed(). Zero when the backend has
+ * no such ordering. */
+uint32_t backend_configure_serial(void);
+
+/* Drop what the backend remembers of a window's last sent geometry, for
+ * windows leaving management: they may reconfigure themselves meanwhile. */
+void backend_forget_window(bspwm_wid_t win);
+
 /* Set border color (0xAARRGGBB). */
 void backend_window_set_border_color(bspwm_wid_t win, uint32_t color);
 
@@ -217,6 +236,10 @@ void backend_window_stack_above(bspwm_wid_t w1, bspwm_wid_t w2);
 /* Stack w1 below w2. */
 void backend_window_stack_below(bspwm_wid_t w1, bspwm_wid_t w2);
 
+/* Stack each wins[i] directly above (or below) siblings[i], in order. */
+void backend_window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings,
+                            uint32_t count, bool above);
+
 /* Raise window to top. */
 void backend_window_raise(bspwm_wid_t win);
 
@@ -277,6 +300,52 @@ typedef enum {
 
 bool backend_get_window_type(bspwm_wid_t win, bspwm_window_type_t *type);
 
+/* ------------------------------------------------------------------ */
+/*  Batched attribute fetch for newly mapped windows                  */
+/* ------------------------------------------------------------------ */
+
+/* Initial _NET_WM_STATE of a window. */
+enum {
+	BSP_INITIAL_STATE_FULLSCREEN = (1 << 0),
+	BSP_INITIAL_STATE_ABOVE      = (1 << 1),
+	BSP_INITIAL_STATE_BELOW      = (1 << 2),
+	BSP_INITIAL_STATE_STICKY     = (1 << 3),
+};
+
+/* Everything manage_window and apply_rules read from a new window. */
+typedef struct {
+	bool override_redirect;
+	bool has_type;
+	bspwm_window_type_t type;
+	uint8_t initial_state;
+	bspwm_wid_t transient_for;
+	bspwm_size_hints_t size_hints;
+	bspwm_icccm_props_t icccm_props;
+	bool has_geometry;
+	bspwm_rect_t geometry;
+} bspwm_window_attrs_t;
+
+/* Outstanding replies of one backend_request_window_attributes call. */
+typedef struct {
+	unsigned int sequence[10];
+	bool has_name;
+} bspwm_attrs_cookie_t;
+
+/* Send the requests for the attributes, class, instance and, with
+ * with_name, name of a window without waiting on any reply. Requests for
+ * many windows can be sent before the first one is collected. */
+bspwm_attrs_cookie_t backend_request_window_attributes(bspwm_wid_t win, bool with_name);
+
+/* Wait for the replies of a backend_request_window_attributes call. The
+ * name is left empty when it wasn't requested, name can be NULL. */
+void backend_collect_window_attributes(bspwm_wid_t win, bspwm_attrs_cookie_t cookie, bspwm_window_attrs_t *attrs,
+                                       char *class_name, char *instance_name, char *name, size_t len);
+
+/* Request and collect in one go: a single round trip on X11. The name
+ * is only requested when name isn't NULL. */
+void backend_fetch_window_attributes(bspwm_wid_t win, bspwm_window_attrs_t *attrs,
+                                     char *class_name, char *instance_name, char *name, size_t len);
+
 /* ------------------------------------------------------------------ */
 /*  Compositor state (replaces EWMH set_ functions)                   */
 /* ------------------------------------------------------------------ */
@@ -305,6 +374,14 @@ int backend_query_outputs(bspwm_output_info_t *outputs, int max);
 /* Register for output change events (hotplug). */
 void backend_listen_output_changes(void);
 
+/* Enable or disable variable refresh rate on an output. Returns false if
+ * the output can't be put in the requested mode. */
+bool backend_set_adaptive_sync(bspwm_output_id_t id, bool enable);
+
+/* Whether the last frame of an output was a fullscreen client's buffer
+ * scanned out directly, without compositing. */
+bool backend_output_direct_scanout(bspwm_output_id_t id);
+
 /* ------------------------------------------------------------------ */
 /*  Input handling (replaces pointer grabs)                           */
 /* ------------------------------------------------------------------ */
@@ -349,6 +426,9 @@ uint16_t backend_get_lock_fields(void);
  * Sets input shape to pass-through. */
 bspwm_wid_t backend_create_presel_feedback(uint32_t color);
 
+/* Recolor an unmapped presel feedback window. */
+void backend_set_presel_feedback_color(bspwm_wid_t win, uint32_t color);
+
 /* ------------------------------------------------------------------ */
 /*  Client message / close                                            */
 /* ------------------------------------------------------------------ */
@@ -411,4 +491,9 @@ void backend_grab_keys(void);
 /* Ungrab all keys from the root window. */
 void backend_ungrab_keys(void);
 
+/* Grab / ungrab the whole keyboard while a key chord is in progress.
+ * On Wayland: no-op (every key goes through the compositor). */
+void backend_grab_keyboard(void);
+void backend_ungrab_keyboard(void);
+
 #endif
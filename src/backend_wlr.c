@@ -52,6 +52,7 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_subcompositor.h>
@@ -67,6 +68,7 @@
 #include <wlr/types/wlr_xdg_decoration_v1.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/xwayland.h>
+#include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include <xkbcommon/xkbcommon.h>
 
@@ -78,12 +80,23 @@
 #include "query.h"
 #include "keybind.h"
 #include "settings.h"
+#include "stats.h"
+#include "lookup.h"
 
 /* ------------------------------------------------------------------ */
 /*  Compositor state                                                  */
 /* ------------------------------------------------------------------ */
 
+/* Kinds of the objects in the id registry. Their structs start with the
+ * kind, so that a scene node whose data points at one tells what it is. */
+enum bspwm_wlr_kind {
+	WLR_KIND_TOPLEVEL = 1,
+	WLR_KIND_XWAYLAND,
+	WLR_KIND_PRESEL,
+};
+
 struct bspwm_wlr_toplevel {
+	enum bspwm_wlr_kind kind;
 	bspwm_wid_t id;
 	struct wlr_xdg_toplevel *xdg_toplevel;
 	struct wlr_scene_tree *scene_tree;   /* container tree (holds borders + surface) */
@@ -95,6 +108,23 @@ struct bspwm_wlr_toplevel {
 	uint32_t border_width;
 	float border_color[4];
 
+	/* Last geometry sent, to drop configures that repeat it */
+	bspwm_rect_t geometry;
+	bool position_sent;
+	bool size_sent;
+
+	/* The scene tree is enabled unless hidden or parked by the core or
+	 * covered by the fullscreen window of an output */
+	bool hidden;
+	bool parked;
+	struct bspwm_wlr_output *occluder;
+
+	/* Member of the open layout transaction, waiting for the client to
+	 * commit the configure of serial txn_serial unless it is zero */
+	bool txn_pending;
+	uint32_t txn_serial;
+	struct wl_list txn_link; /* wlr_server.txn_toplevels */
+
 	struct wl_listener map;
 	struct wl_listener unmap;
 	struct wl_listener commit;
@@ -110,7 +140,11 @@ struct bspwm_wlr_toplevel {
 struct bspwm_wlr_output {
 	bspwm_output_id_t id;
 	struct wlr_output *wlr_output;
+	/* Fullscreen toplevel shown alone, see update_fullscreen_bypass */
+	struct bspwm_wlr_toplevel *bypass;
+	bool scanout; /* the last frame was its buffer */
 	struct wl_listener frame;
+	struct wl_listener commit;
 	struct wl_listener request_state;
 	struct wl_listener destroy;
 	struct wl_list link; /* wlr_server.outputs */
@@ -125,6 +159,7 @@ struct bspwm_wlr_keyboard {
 };
 
 struct bspwm_wlr_xwayland_surface {
+	enum bspwm_wlr_kind kind;
 	bspwm_wid_t id;
 	struct wlr_xwayland_surface *xsurface;
 	struct wlr_scene_tree *scene_tree;
@@ -135,8 +170,6 @@ struct bspwm_wlr_xwayland_surface {
 	struct wl_listener dissociate;
 	struct wl_listener destroy;
 	struct wl_listener request_configure;
-
-	struct wl_list link; /* xwayland_surfaces list */
 };
 
 struct bspwm_wlr_layer_surface {
@@ -183,6 +216,7 @@ static struct {
 	struct wl_listener cursor_frame;
 
 	struct wlr_seat *seat;
+	struct wlr_relative_pointer_manager_v1 *relative_pointer_mgr;
 	struct wl_listener new_input;
 	struct wl_listener request_cursor;
 	struct wl_listener request_set_selection;
@@ -232,6 +266,16 @@ static struct {
 	double grab_sx, grab_sy;
 	int grab_width, grab_height;
 
+	/* Pointer motion waiting for the next output frame */
+	bool motion_pending;
+	uint32_t motion_time;
+
+	/* Layout transaction, see transaction_commit */
+	struct wl_list txn_toplevels;
+	struct wl_event_source *txn_timer;
+	unsigned int txn_waiting;
+	bool txn_committed;
+
 	/* ID generation */
 	uint32_t next_toplevel_id;
 	uint32_t next_output_id;
@@ -240,6 +284,70 @@ static struct {
 	const char *socket;
 } server;
 
+/* ------------------------------------------------------------------ */
+/*  Listener timing                                                   */
+/* ------------------------------------------------------------------ */
+
+/* Every listener is registered through a wrapper feeding its histogram
+ * in the listeners group of wm --stats. */
+#define TIMED_LISTENER(fn) \
+	static void fn(struct wl_listener *listener, void *data); \
+	static void timed_##fn(struct wl_listener *listener, void *data) \
+	{ \
+		static latency_histogram_t *h; \
+		if (h == NULL) { \
+			h = make_latency_histogram(LATENCY_LISTENERS, #fn); \
+		} \
+		uint64_t start = latency_now(); \
+		fn(listener, data); \
+		latency_record(h, start); \
+	}
+
+TIMED_LISTENER(output_frame)
+TIMED_LISTENER(output_commit)
+TIMED_LISTENER(output_request_state)
+TIMED_LISTENER(output_destroy)
+TIMED_LISTENER(xdg_toplevel_map)
+TIMED_LISTENER(xdg_toplevel_unmap)
+TIMED_LISTENER(xdg_toplevel_commit)
+TIMED_LISTENER(xdg_toplevel_destroy)
+TIMED_LISTENER(xdg_toplevel_request_move)
+TIMED_LISTENER(xdg_toplevel_request_resize)
+TIMED_LISTENER(xdg_toplevel_request_maximize)
+TIMED_LISTENER(xdg_toplevel_request_fullscreen)
+TIMED_LISTENER(keyboard_modifiers)
+TIMED_LISTENER(keyboard_key)
+TIMED_LISTENER(keyboard_destroy)
+TIMED_LISTENER(layer_surface_map)
+TIMED_LISTENER(layer_surface_unmap)
+TIMED_LISTENER(layer_surface_destroy)
+TIMED_LISTENER(layer_surface_commit)
+TIMED_LISTENER(xwayland_surface_map)
+TIMED_LISTENER(xwayland_surface_unmap)
+TIMED_LISTENER(xwayland_surface_associate)
+TIMED_LISTENER(xwayland_surface_dissociate)
+TIMED_LISTENER(xwayland_surface_destroy)
+TIMED_LISTENER(xwayland_surface_request_configure)
+TIMED_LISTENER(session_lock_destroy)
+TIMED_LISTENER(server_new_output)
+TIMED_LISTENER(server_new_xdg_toplevel)
+TIMED_LISTENER(server_new_xdg_popup)
+TIMED_LISTENER(xdg_activation_request)
+TIMED_LISTENER(session_new_lock)
+TIMED_LISTENER(server_new_layer_surface)
+TIMED_LISTENER(server_new_xwayland_surface)
+TIMED_LISTENER(cursor_motion)
+TIMED_LISTENER(cursor_motion_absolute)
+TIMED_LISTENER(cursor_button)
+TIMED_LISTENER(cursor_axis)
+TIMED_LISTENER(cursor_frame)
+TIMED_LISTENER(server_new_input)
+TIMED_LISTENER(seat_request_cursor)
+TIMED_LISTENER(seat_request_set_selection)
+TIMED_LISTENER(new_decoration)
+
+#undef TIMED_LISTENER
+
 /* ------------------------------------------------------------------ */
 /*  Border helpers                                                    */
 /* ------------------------------------------------------------------ */
@@ -312,6 +420,9 @@ static void toplevel_set_border_color(struct bspwm_wlr_toplevel *tl, uint32_t pi
 {
 	float color[4];
 	color_u32_to_float(pixel, color);
+	if (memcmp(tl->border_color, color, sizeof(color)) == 0) {
+		return;
+	}
 	memcpy(tl->border_color, color, sizeof(color));
 	for (int i = 0; i < 4; i++) {
 		wlr_scene_rect_set_color(tl->border[i], color);
@@ -323,33 +434,35 @@ static void toplevel_set_border_color(struct bspwm_wlr_toplevel *tl, uint32_t pi
 /* ------------------------------------------------------------------ */
 
 struct bspwm_wlr_presel {
+	enum bspwm_wlr_kind kind;
 	bspwm_wid_t id;
 	struct wlr_scene_rect *rect;
-	struct wl_list link;
 };
-static struct wl_list presel_list = {0};
-static bool presel_list_initialized = false;
+
+/* ------------------------------------------------------------------ */
+/*  Lookup by ID                                                      */
+/* ------------------------------------------------------------------ */
 
 static struct bspwm_wlr_presel *presel_from_id(bspwm_wid_t id)
 {
-	if (!presel_list_initialized) return NULL;
-	struct bspwm_wlr_presel *p;
-	wl_list_for_each(p, &presel_list, link) {
-		if (p->id == id) return p;
-	}
-	return NULL;
+	return object_registry_get(id, WLR_KIND_PRESEL);
 }
 
-/* ------------------------------------------------------------------ */
-/*  Toplevel lookup by ID                                             */
-/* ------------------------------------------------------------------ */
-
 static struct bspwm_wlr_toplevel *toplevel_from_id(bspwm_wid_t id)
 {
-	struct bspwm_wlr_toplevel *tl;
-	wl_list_for_each(tl, &server.toplevels, link) {
-		if (tl->id == id)
-			return tl;
+	return object_registry_get(id, WLR_KIND_TOPLEVEL);
+}
+
+/* The toplevel owning a scene node. Only our own trees carry data, the
+ * registry confirms that the tagged object is still alive. */
+static struct bspwm_wlr_toplevel *toplevel_at_node(struct wlr_scene_node *node)
+{
+	while (node) {
+		if (node->data && *(enum bspwm_wlr_kind *) node->data == WLR_KIND_TOPLEVEL) {
+			struct bspwm_wlr_toplevel *tl = node->data;
+			return toplevel_from_id(tl->id) == tl ? tl : NULL;
+		}
+		node = node->parent ? &node->parent->node : NULL;
 	}
 	return NULL;
 }
@@ -361,14 +474,33 @@ static struct bspwm_wlr_toplevel *toplevel_from_id(bspwm_wid_t id)
 /* Forward decl: output state/mode changes need to re-arrange layers so
  * that exclusive-zone padding tracks the new resolution. */
 static void arrange_layers(struct bspwm_wlr_output *output);
-
+static void output_set_bypass(struct bspwm_wlr_output *output, struct bspwm_wlr_toplevel *bypass, bool force);
+static void flush_cursor_motion(void);
+static void transaction_commit(void);
+static bool transaction_covers(struct wlr_output *wlr_output);
+static void transaction_ack(struct bspwm_wlr_toplevel *tl);
+static void transaction_remove(struct bspwm_wlr_toplevel *tl);
+
+/* Set when the scene may have gained nodes that a bypass must cover */
+static bool bypass_dirty = false;
+
+/* Frames are requested on demand: the scene schedules one on the outputs
+ * it damages, when the layout moves a node or a client commits a buffer
+ * or asks for a frame callback. An output without damage goes idle until
+ * then, instead of being committed at every refresh. */
 static void output_frame(struct wl_listener *listener, void *data)
 {
 	(void)data;
 	struct bspwm_wlr_output *output = wl_container_of(listener, output, frame);
+	/* Interactive moves are shown in the frame that processes them */
+	flush_cursor_motion();
+	transaction_commit();
 	struct wlr_scene_output *scene_output =
 		wlr_scene_get_scene_output(server.scene, output->wlr_output);
-	if (scene_output) {
+	if (!scene_output) {
+		return;
+	}
+	if (wlr_scene_output_needs_frame(scene_output) && !transaction_covers(output->wlr_output)) {
 		wlr_scene_output_commit(scene_output, NULL);
 	}
 	struct timespec now;
@@ -376,6 +508,21 @@ static void output_frame(struct wl_listener *listener, void *data)
 	wlr_scene_output_send_frame_done(scene_output, &now);
 }
 
+/* Direct scanout happened when the committed buffer is the client's */
+static void output_commit(struct wl_listener *listener, void *data)
+{
+	struct bspwm_wlr_output *output = wl_container_of(listener, output, commit);
+	const struct wlr_output_event_commit *event = data;
+	if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+	struct wlr_client_buffer *buffer = NULL;
+	if (output->bypass) {
+		buffer = output->bypass->xdg_toplevel->base->surface->buffer;
+	}
+	output->scanout = (buffer != NULL && event->state->buffer == &buffer->base);
+}
+
 static void output_request_state(struct wl_listener *listener, void *data)
 {
 	struct bspwm_wlr_output *output = wl_container_of(listener, output, request_state);
@@ -385,6 +532,7 @@ static void output_request_state(struct wl_listener *listener, void *data)
 	 * padding so tiled windows reflow into the new usable area. Without
 	 * this, hotplugging or rotating leaves stale m->padding values. */
 	arrange_layers(output);
+	wlr_output_schedule_frame(output->wlr_output);
 }
 
 static void output_destroy(struct wl_listener *listener, void *data)
@@ -392,7 +540,9 @@ static void output_destroy(struct wl_listener *listener, void *data)
 	struct bspwm_wlr_output *output = wl_container_of(listener, output, destroy);
 	(void)data;
 
+	output_set_bypass(output, NULL, false);
 	wl_list_remove(&output->frame.link);
+	wl_list_remove(&output->commit.link);
 	wl_list_remove(&output->request_state.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->link);
@@ -425,11 +575,13 @@ static void server_new_output(struct wl_listener *listener, void *data)
 	output->id = ++server.next_output_id;
 	output->wlr_output = wlr_output;
 
-	output->frame.notify = output_frame;
+	output->frame.notify = timed_output_frame;
 	wl_signal_add(&wlr_output->events.frame, &output->frame);
-	output->request_state.notify = output_request_state;
+	output->commit.notify = timed_output_commit;
+	wl_signal_add(&wlr_output->events.commit, &output->commit);
+	output->request_state.notify = timed_output_request_state;
 	wl_signal_add(&wlr_output->events.request_state, &output->request_state);
-	output->destroy.notify = output_destroy;
+	output->destroy.notify = timed_output_destroy;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 
 	wl_list_insert(&server.outputs, &output->link);
@@ -481,6 +633,7 @@ static void xdg_toplevel_unmap(struct wl_listener *listener, void *data)
 		tl->foreign_handle = NULL;
 	}
 
+	transaction_remove(tl);
 	unmanage_window(tl->id);
 }
 
@@ -491,12 +644,20 @@ static void xdg_toplevel_commit(struct wl_listener *listener, void *data)
 
 	if (tl->xdg_toplevel->base->initial_commit) {
 		wlr_xdg_toplevel_set_size(tl->xdg_toplevel, 0, 0);
+		tl->size_sent = false;
 	}
 
+	transaction_ack(tl);
+
 	/* Update borders when surface geometry changes */
 	if (tl->border_width > 0) {
 		toplevel_update_borders(tl);
 	}
+
+	bspwm_rect_t r;
+	if (backend_window_get_geometry(tl->id, &r)) {
+		client_geometry_observed(tl->id, r, 0);
+	}
 }
 
 static void xdg_toplevel_destroy(struct wl_listener *listener, void *data)
@@ -513,6 +674,14 @@ static void xdg_toplevel_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&tl->request_maximize.link);
 	wl_list_remove(&tl->request_fullscreen.link);
 	wl_list_remove(&tl->link);
+	transaction_remove(tl);
+	struct bspwm_wlr_output *out;
+	wl_list_for_each(out, &server.outputs, link) {
+		if (out->bypass == tl) {
+			output_set_bypass(out, NULL, false);
+		}
+	}
+	object_registry_remove(tl->id);
 	free(tl);
 }
 
@@ -556,7 +725,9 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data)
 	struct bspwm_wlr_toplevel *tl = calloc(1, sizeof(*tl));
 	if (!tl) return;
 
+	tl->kind = WLR_KIND_TOPLEVEL;
 	tl->id = ++server.next_toplevel_id;
+	object_registry_add(tl->id, tl->kind, tl);
 	tl->xdg_toplevel = xdg_toplevel;
 
 	/* Container tree holds borders + surface */
@@ -569,22 +740,22 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data)
 
 	toplevel_create_borders(tl);
 
-	tl->map.notify = xdg_toplevel_map;
+	tl->map.notify = timed_xdg_toplevel_map;
 	wl_signal_add(&xdg_toplevel->base->surface->events.map, &tl->map);
-	tl->unmap.notify = xdg_toplevel_unmap;
+	tl->unmap.notify = timed_xdg_toplevel_unmap;
 	wl_signal_add(&xdg_toplevel->base->surface->events.unmap, &tl->unmap);
-	tl->commit.notify = xdg_toplevel_commit;
+	tl->commit.notify = timed_xdg_toplevel_commit;
 	wl_signal_add(&xdg_toplevel->base->surface->events.commit, &tl->commit);
-	tl->destroy.notify = xdg_toplevel_destroy;
+	tl->destroy.notify = timed_xdg_toplevel_destroy;
 	wl_signal_add(&xdg_toplevel->events.destroy, &tl->destroy);
 
-	tl->request_move.notify = xdg_toplevel_request_move;
+	tl->request_move.notify = timed_xdg_toplevel_request_move;
 	wl_signal_add(&xdg_toplevel->events.request_move, &tl->request_move);
-	tl->request_resize.notify = xdg_toplevel_request_resize;
+	tl->request_resize.notify = timed_xdg_toplevel_request_resize;
 	wl_signal_add(&xdg_toplevel->events.request_resize, &tl->request_resize);
-	tl->request_maximize.notify = xdg_toplevel_request_maximize;
+	tl->request_maximize.notify = timed_xdg_toplevel_request_maximize;
 	wl_signal_add(&xdg_toplevel->events.request_maximize, &tl->request_maximize);
-	tl->request_fullscreen.notify = xdg_toplevel_request_fullscreen;
+	tl->request_fullscreen.notify = timed_xdg_toplevel_request_fullscreen;
 	wl_signal_add(&xdg_toplevel->events.request_fullscreen, &tl->request_fullscreen);
 
 	wl_list_insert(&server.toplevels, &tl->link);
@@ -642,11 +813,15 @@ static void keyboard_key(struct wl_listener *listener, void *data)
 		if (modifiers & WLR_MODIFIER_MOD5)  kbmod |= KBMOD_MOD5;
 
 		for (int i = 0; i < nsyms; i++) {
-			const char *cmd = keybind_match(kbmod, syms[i]);
-			if (cmd) {
-				keybind_exec(cmd);
+			bool chording = keybind_chord_pending();
+			const keybind_t *bind = keybind_match(kbmod, syms[i]);
+			if (bind) {
+				keybind_exec(bind);
 				return; /* consumed — don't forward to client */
 			}
+			/* Part of a chord, or the key that aborted one */
+			if (chording || keybind_chord_pending())
+				return;
 		}
 	}
 
@@ -692,11 +867,11 @@ static void server_new_keyboard(struct wlr_input_device *device)
 	xkb_context_unref(ctx);
 	wlr_keyboard_set_repeat_info(wlr_keyboard, 25, 600);
 
-	kb->modifiers.notify = keyboard_modifiers;
+	kb->modifiers.notify = timed_keyboard_modifiers;
 	wl_signal_add(&wlr_keyboard->events.modifiers, &kb->modifiers);
-	kb->key.notify = keyboard_key;
+	kb->key.notify = timed_keyboard_key;
 	wl_signal_add(&wlr_keyboard->events.key, &kb->key);
-	kb->destroy.notify = keyboard_destroy;
+	kb->destroy.notify = timed_keyboard_destroy;
 	wl_signal_add(&device->events.destroy, &kb->destroy);
 
 	wlr_seat_set_keyboard(server.seat, wlr_keyboard);
@@ -715,7 +890,7 @@ static void process_cursor_motion(uint32_t time)
 	if (server.cursor_mode == BSPWM_CURSOR_MOVE && server.grabbed_tl) {
 		int new_x = (int)(server.cursor->x - server.grab_x);
 		int new_y = (int)(server.cursor->y - server.grab_y);
-		wlr_scene_node_set_position(&server.grabbed_tl->scene_tree->node, new_x, new_y);
+		backend_window_move(server.grabbed_tl->id, new_x, new_y);
 
 		/* Update bspwm's floating rectangle */
 		coordinates_t loc;
@@ -734,7 +909,7 @@ static void process_cursor_motion(uint32_t time)
 		if (new_w < 32) new_w = 32;
 		if (new_h < 32) new_h = 32;
 
-		wlr_xdg_toplevel_set_size(server.grabbed_tl->xdg_toplevel, new_w, new_h);
+		backend_window_resize(server.grabbed_tl->id, new_w, new_h);
 
 		/* Update bspwm's floating rectangle */
 		coordinates_t loc;
@@ -789,12 +964,44 @@ static void process_cursor_motion(uint32_t time)
 	}
 }
 
+/* The cursor image follows every event, but hit-testing, focus and
+ * interactive move/resize run once per frame of the output under the
+ * cursor. Without an enabled output there, motion is processed at once. */
+static void queue_cursor_motion(uint32_t time)
+{
+	server.motion_time = time;
+	if (server.motion_pending) {
+		return;
+	}
+	struct wlr_output *output = wlr_output_layout_output_at(server.output_layout,
+		server.cursor->x, server.cursor->y);
+	if (!output || !output->enabled) {
+		process_cursor_motion(time);
+		return;
+	}
+	server.motion_pending = true;
+	wlr_output_schedule_frame(output);
+}
+
+static void flush_cursor_motion(void)
+{
+	if (!server.motion_pending) {
+		return;
+	}
+	server.motion_pending = false;
+	process_cursor_motion(server.motion_time);
+	wlr_seat_pointer_notify_frame(server.seat);
+}
+
 static void cursor_motion(struct wl_listener *listener, void *data)
 {
 	(void)listener;
 	struct wlr_pointer_motion_event *event = data;
+	wlr_relative_pointer_manager_v1_send_relative_motion(server.relative_pointer_mgr,
+		server.seat, (uint64_t)event->time_msec * 1000,
+		event->delta_x, event->delta_y, event->unaccel_dx, event->unaccel_dy);
 	wlr_cursor_move(server.cursor, &event->pointer->base, event->delta_x, event->delta_y);
-	process_cursor_motion(event->time_msec);
+	queue_cursor_motion(event->time_msec);
 }
 
 static void cursor_motion_absolute(struct wl_listener *listener, void *data)
@@ -802,7 +1009,7 @@ static void cursor_motion_absolute(struct wl_listener *listener, void *data)
 	(void)listener;
 	struct wlr_pointer_motion_absolute_event *event = data;
 	wlr_cursor_warp_absolute(server.cursor, &event->pointer->base, event->x, event->y);
-	process_cursor_motion(event->time_msec);
+	queue_cursor_motion(event->time_msec);
 }
 
 /* Find the toplevel at cursor position */
@@ -811,20 +1018,7 @@ static struct bspwm_wlr_toplevel *toplevel_at_cursor(double *sx, double *sy)
 	double lx = server.cursor->x, ly = server.cursor->y;
 	struct wlr_scene_node *node = wlr_scene_node_at(
 		&server.scene->tree.node, lx, ly, sx, sy);
-
-	while (node) {
-		if (node->data) {
-			/* Check if it's a toplevel (not a presel or layer surface) */
-			struct bspwm_wlr_toplevel *tl = node->data;
-			/* Verify it's actually in our toplevel list */
-			struct bspwm_wlr_toplevel *check;
-			wl_list_for_each(check, &server.toplevels, link) {
-				if (check == tl) return tl;
-			}
-		}
-		node = node->parent ? &node->parent->node : NULL;
-	}
-	return NULL;
+	return toplevel_at_node(node);
 }
 
 static void begin_interactive_move(struct bspwm_wlr_toplevel *tl)
@@ -852,6 +1046,9 @@ static void cursor_button(struct wl_listener *listener, void *data)
 	(void)listener;
 	struct wlr_pointer_button_event *event = data;
 
+	/* Clicks must land where the cursor is now */
+	flush_cursor_motion();
+
 	if (event->state == WL_POINTER_BUTTON_STATE_RELEASED) {
 		if (server.cursor_mode != BSPWM_CURSOR_PASSTHROUGH) {
 			server.cursor_mode = BSPWM_CURSOR_PASSTHROUGH;
@@ -914,6 +1111,7 @@ static void cursor_axis(struct wl_listener *listener, void *data)
 {
 	(void)listener;
 	struct wlr_pointer_axis_event *event = data;
+	flush_cursor_motion();
 	wlr_seat_pointer_notify_axis(server.seat,
 		event->time_msec, event->orientation, event->delta,
 		event->delta_discrete, event->source, event->relative_direction);
@@ -922,7 +1120,10 @@ static void cursor_axis(struct wl_listener *listener, void *data)
 static void cursor_frame(struct wl_listener *listener, void *data)
 {
 	(void)listener; (void)data;
-	wlr_seat_pointer_notify_frame(server.seat);
+	/* Deferred motion sends its own frame when it is flushed */
+	if (!server.motion_pending) {
+		wlr_seat_pointer_notify_frame(server.seat);
+	}
 }
 
 static void server_new_pointer(struct wlr_input_device *device)
@@ -1075,6 +1276,7 @@ static void layer_surface_commit(struct wl_listener *listener, void *data)
 static void layer_surface_map(struct wl_listener *listener, void *data)
 {
 	(void)listener; (void)data;
+	bypass_dirty = true;
 }
 
 static void layer_surface_unmap(struct wl_listener *listener, void *data)
@@ -1163,13 +1365,13 @@ static void server_new_layer_surface(struct wl_listener *listener, void *data)
 	ls->scene = wlr_scene_layer_surface_v1_create(
 		server.layer_trees[layer_idx], layer_surface);
 
-	ls->map.notify = layer_surface_map;
+	ls->map.notify = timed_layer_surface_map;
 	wl_signal_add(&layer_surface->surface->events.map, &ls->map);
-	ls->unmap.notify = layer_surface_unmap;
+	ls->unmap.notify = timed_layer_surface_unmap;
 	wl_signal_add(&layer_surface->surface->events.unmap, &ls->unmap);
-	ls->destroy.notify = layer_surface_destroy;
+	ls->destroy.notify = timed_layer_surface_destroy;
 	wl_signal_add(&layer_surface->events.destroy, &ls->destroy);
-	ls->commit.notify = layer_surface_commit;
+	ls->commit.notify = timed_layer_surface_commit;
 	wl_signal_add(&layer_surface->surface->events.commit, &ls->commit);
 
 	wl_list_insert(&layer_surfaces, &ls->link);
@@ -1185,20 +1387,232 @@ static void server_new_layer_surface(struct wl_listener *listener, void *data)
 }
 
 /* ------------------------------------------------------------------ */
-/*  XWayland surface handling                                         */
+/*  Layout transactions                                               */
 /* ------------------------------------------------------------------ */
 
-static struct wl_list xwayland_surfaces_list;
-static bool xwayland_surfaces_initialized = false;
+/* Longest wait for the clients of a transaction, in milliseconds */
+#define TRANSACTION_TIMEOUT  200
 
-static struct bspwm_wlr_xwayland_surface *xsurface_from_id(bspwm_wid_t id)
+/* The configures of the windows moved by a layout pass are sent at once,
+ * but their scene nodes keep their old positions until every client of
+ * the pass committed a buffer for its new size, or until the timeout.
+ * The outputs they cover aren't committed meanwhile: the whole layout
+ * change shows up in a single frame. */
+static void transaction_add(struct bspwm_wlr_toplevel *tl)
 {
-	if (!xwayland_surfaces_initialized) return NULL;
-	struct bspwm_wlr_xwayland_surface *xs;
-	wl_list_for_each(xs, &xwayland_surfaces_list, link) {
-		if (xs->id == id) return xs;
+	if (!tl->txn_pending) {
+		tl->txn_pending = true;
+		wl_list_insert(server.txn_toplevels.prev, &tl->txn_link);
+	}
+}
+
+static void transaction_wait(struct bspwm_wlr_toplevel *tl, uint32_t serial)
+{
+	transaction_add(tl);
+	/* Unseen windows aren't worth a frame of delay */
+	if (!tl->xdg_toplevel->base->surface->mapped || tl->hidden || tl->parked || tl->occluder != NULL) {
+		return;
+	}
+	if (tl->txn_serial == 0) {
+		server.txn_waiting++;
+	}
+	tl->txn_serial = serial;
+}
+
+static void transaction_apply(void)
+{
+	struct bspwm_wlr_toplevel *tl, *tmp;
+	wl_list_for_each_safe(tl, tmp, &server.txn_toplevels, txn_link) {
+		if (tl->scene_tree) {
+			wlr_scene_node_set_position(&tl->scene_tree->node, tl->geometry.x, tl->geometry.y);
+		}
+		tl->txn_pending = false;
+		tl->txn_serial = 0;
+		wl_list_remove(&tl->txn_link);
+	}
+	server.txn_waiting = 0;
+	if (server.txn_committed) {
+		server.txn_committed = false;
+		wl_event_source_timer_update(server.txn_timer, 0);
+		struct bspwm_wlr_output *output;
+		wl_list_for_each(output, &server.outputs, link) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
+
+static int transaction_timeout(void *data)
+{
+	(void)data;
+	transaction_apply();
+	return 0;
+}
+
+/* Called once the core is done with the current layout pass. Windows
+ * placed while a transaction waits join it. */
+static void transaction_commit(void)
+{
+	if (wl_list_empty(&server.txn_toplevels) || server.txn_committed) {
+		return;
+	}
+	if (server.txn_waiting == 0) {
+		transaction_apply();
+		return;
+	}
+	server.txn_committed = true;
+	wl_event_source_timer_update(server.txn_timer, TRANSACTION_TIMEOUT);
+}
+
+static void transaction_ack(struct bspwm_wlr_toplevel *tl)
+{
+	if (tl->txn_serial == 0 ||
+	    (int32_t) (tl->xdg_toplevel->base->current.configure_serial - tl->txn_serial) < 0) {
+		return;
+	}
+	tl->txn_serial = 0;
+	server.txn_waiting--;
+	if (server.txn_waiting == 0 && server.txn_committed) {
+		transaction_apply();
+	}
+}
+
+/* For windows that won't commit anymore */
+static void transaction_remove(struct bspwm_wlr_toplevel *tl)
+{
+	if (!tl->txn_pending) {
+		return;
+	}
+	if (tl->txn_serial != 0) {
+		tl->txn_serial = 0;
+		server.txn_waiting--;
+	}
+	tl->txn_pending = false;
+	wl_list_remove(&tl->txn_link);
+	if (server.txn_waiting == 0 && server.txn_committed) {
+		transaction_apply();
+	}
+}
+
+static bool transaction_covers(struct wlr_output *wlr_output)
+{
+	if (!server.txn_committed) {
+		return false;
+	}
+	struct wlr_box box, inter;
+	wlr_output_layout_get_box(server.output_layout, wlr_output, &box);
+	struct bspwm_wlr_toplevel *tl;
+	wl_list_for_each(tl, &server.txn_toplevels, txn_link) {
+		if (!tl->scene_tree) {
+			continue;
+		}
+		struct wlr_box target = {tl->geometry.x, tl->geometry.y, tl->geometry.width, tl->geometry.height};
+		struct wlr_box actual = {tl->scene_tree->node.x, tl->scene_tree->node.y,
+		                         tl->xdg_toplevel->base->geometry.width, tl->xdg_toplevel->base->geometry.height};
+		if (wlr_box_intersection(&inter, &box, &target) || wlr_box_intersection(&inter, &box, &actual)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Fullscreen bypass                                                 */
+/* ------------------------------------------------------------------ */
+
+static void toplevel_update_visibility(struct bspwm_wlr_toplevel *tl)
+{
+	if (tl->scene_tree) {
+		wlr_scene_node_set_enabled(&tl->scene_tree->node, !tl->hidden && !tl->parked && tl->occluder == NULL);
+	}
+}
+
+/* The focused window of the shown desktop, when it is fullscreen */
+static struct bspwm_wlr_toplevel *fullscreen_candidate(struct bspwm_wlr_output *output)
+{
+	monitor_t *m = get_monitor_by_output_id(output->id);
+	if (!m || !m->desk || server.locked) return NULL;
+	node_t *n = m->desk->focus;
+	if (!n || !n->client || n->client->state != STATE_FULLSCREEN || n->hidden) return NULL;
+	struct bspwm_wlr_toplevel *tl = toplevel_from_id(n->id);
+	if (!tl || tl->hidden || tl->parked || !tl->xdg_toplevel->base->surface->mapped) return NULL;
+	return tl;
+}
+
+/* While a fullscreen window is shown on an output, the other windows of
+ * its monitor, its borders and the layer surfaces under the overlay layer
+ * are disabled. The scene then holds a single buffer for that output,
+ * which wlroots tries to scan out directly instead of compositing. */
+static void output_set_bypass(struct bspwm_wlr_output *output, struct bspwm_wlr_toplevel *bypass, bool force)
+{
+	if (output->bypass == bypass && (!force || !bypass)) {
+		return;
+	}
+
+	struct bspwm_wlr_toplevel *tl;
+	struct bspwm_wlr_layer_surface *ls;
+	if (output->bypass && output->bypass != bypass) {
+		toplevel_update_borders(output->bypass);
+	}
+	wl_list_for_each(tl, &server.toplevels, link) {
+		if (tl->occluder == output) {
+			tl->occluder = NULL;
+			toplevel_update_visibility(tl);
+		}
+	}
+	if (layer_surfaces_initialized) {
+		wl_list_for_each(ls, &layer_surfaces, link) {
+			if (ls->layer_surface->output == output->wlr_output && ls->current_layer < 3) {
+				wlr_scene_node_set_enabled(&ls->scene->tree->node, ls->layer_surface->surface->mapped);
+			}
+		}
+	}
+
+	output->bypass = bypass;
+	output->scanout = false;
+	wlr_output_schedule_frame(output->wlr_output);
+	if (!bypass) {
+		return;
+	}
+
+	monitor_t *m = get_monitor_by_output_id(output->id);
+	wl_list_for_each(tl, &server.toplevels, link) {
+		coordinates_t loc;
+		if (tl != bypass && tl->occluder == NULL &&
+		    locate_window(tl->id, &loc) && loc.monitor == m) {
+			tl->occluder = output;
+			toplevel_update_visibility(tl);
+		}
+	}
+	for (int i = 0; i < 4; i++) {
+		wlr_scene_node_set_enabled(&bypass->border[i]->node, false);
+	}
+	if (layer_surfaces_initialized) {
+		wl_list_for_each(ls, &layer_surfaces, link) {
+			if (ls->layer_surface->output == output->wlr_output && ls->current_layer < 3) {
+				wlr_scene_node_set_enabled(&ls->scene->tree->node, false);
+			}
+		}
 	}
-	return NULL;
+}
+
+/* Called before the main loop sleeps, once the core is done changing
+ * states and focus. */
+static void update_fullscreen_bypass(void)
+{
+	struct bspwm_wlr_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		output_set_bypass(output, fullscreen_candidate(output), bypass_dirty);
+	}
+	bypass_dirty = false;
+}
+
+/* ------------------------------------------------------------------ */
+/*  XWayland surface handling                                         */
+/* ------------------------------------------------------------------ */
+
+static struct bspwm_wlr_xwayland_surface *xsurface_from_id(bspwm_wid_t id)
+{
+	return object_registry_get(id, WLR_KIND_XWAYLAND);
 }
 
 static void xwayland_surface_map(struct wl_listener *listener, void *data)
@@ -1240,9 +1654,9 @@ static void xwayland_surface_associate(struct wl_listener *listener, void *data)
 		}
 	}
 
-	xs->map.notify = xwayland_surface_map;
+	xs->map.notify = timed_xwayland_surface_map;
 	wl_signal_add(&xs->xsurface->surface->events.map, &xs->map);
-	xs->unmap.notify = xwayland_surface_unmap;
+	xs->unmap.notify = timed_xwayland_surface_unmap;
 	wl_signal_add(&xs->xsurface->surface->events.unmap, &xs->unmap);
 }
 
@@ -1264,7 +1678,7 @@ static void xwayland_surface_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&xs->dissociate.link);
 	wl_list_remove(&xs->destroy.link);
 	wl_list_remove(&xs->request_configure.link);
-	wl_list_remove(&xs->link);
+	object_registry_remove(xs->id);
 	free(xs);
 }
 
@@ -1281,28 +1695,24 @@ static void server_new_xwayland_surface(struct wl_listener *listener, void *data
 	(void)listener;
 	struct wlr_xwayland_surface *xsurface = data;
 
-	if (!xwayland_surfaces_initialized) {
-		wl_list_init(&xwayland_surfaces_list);
-		xwayland_surfaces_initialized = true;
-	}
-
 	struct bspwm_wlr_xwayland_surface *xs = calloc(1, sizeof(*xs));
 	if (!xs) return;
 
+	xs->kind = WLR_KIND_XWAYLAND;
 	xs->id = ++server.next_toplevel_id;
 	xs->xsurface = xsurface;
 	xs->scene_tree = NULL; /* created in associate handler when surface is valid */
 
-	xs->associate.notify = xwayland_surface_associate;
+	xs->associate.notify = timed_xwayland_surface_associate;
 	wl_signal_add(&xsurface->events.associate, &xs->associate);
-	xs->dissociate.notify = xwayland_surface_dissociate;
+	xs->dissociate.notify = timed_xwayland_surface_dissociate;
 	wl_signal_add(&xsurface->events.dissociate, &xs->dissociate);
-	xs->destroy.notify = xwayland_surface_destroy;
+	xs->destroy.notify = timed_xwayland_surface_destroy;
 	wl_signal_add(&xsurface->events.destroy, &xs->destroy);
-	xs->request_configure.notify = xwayland_surface_request_configure;
+	xs->request_configure.notify = timed_xwayland_surface_request_configure;
 	wl_signal_add(&xsurface->events.request_configure, &xs->request_configure);
 
-	wl_list_insert(&xwayland_surfaces_list, &xs->link);
+	object_registry_add(xs->id, xs->kind, xs);
 }
 
 /* ------------------------------------------------------------------ */
@@ -1354,7 +1764,7 @@ static void session_new_lock(struct wl_listener *listener, void *data)
 	server.active_lock = lock;
 	server.locked = true;
 
-	server.lock_destroy.notify = session_lock_destroy;
+	server.lock_destroy.notify = timed_session_lock_destroy;
 	wl_signal_add(&lock->events.destroy, &server.lock_destroy);
 
 	wlr_session_lock_v1_send_locked(lock);
@@ -1403,7 +1813,7 @@ int backend_init(int *default_screen)
 	/* Output layout */
 	server.output_layout = wlr_output_layout_create(server.wl_display);
 	wl_list_init(&server.outputs);
-	server.new_output.notify = server_new_output;
+	server.new_output.notify = timed_server_new_output;
 	wl_signal_add(&server.backend->events.new_output, &server.new_output);
 
 	/* Scene graph */
@@ -1416,10 +1826,12 @@ int backend_init(int *default_screen)
 
 	/* XDG shell (toplevels render between bottom and top layers) */
 	wl_list_init(&server.toplevels);
+	wl_list_init(&server.txn_toplevels);
+	server.txn_timer = wl_event_loop_add_timer(server.wl_event_loop, transaction_timeout, NULL);
 	server.xdg_shell = wlr_xdg_shell_create(server.wl_display, 3);
-	server.new_xdg_toplevel.notify = server_new_xdg_toplevel;
+	server.new_xdg_toplevel.notify = timed_server_new_xdg_toplevel;
 	wl_signal_add(&server.xdg_shell->events.new_toplevel, &server.new_xdg_toplevel);
-	server.new_xdg_popup.notify = server_new_xdg_popup;
+	server.new_xdg_popup.notify = timed_server_new_xdg_popup;
 	wl_signal_add(&server.xdg_shell->events.new_popup, &server.new_xdg_popup);
 
 	/* Remaining layer shell trees (above toplevels) */
@@ -1435,13 +1847,13 @@ int backend_init(int *default_screen)
 
 	/* XDG activation (urgency / focus stealing) */
 	server.xdg_activation = wlr_xdg_activation_v1_create(server.wl_display);
-	server.xdg_activation_request.notify = xdg_activation_request;
+	server.xdg_activation_request.notify = timed_xdg_activation_request;
 	wl_signal_add(&server.xdg_activation->events.request_activate,
 		&server.xdg_activation_request);
 
 	/* Session lock */
 	server.session_lock_mgr = wlr_session_lock_manager_v1_create(server.wl_display);
-	server.new_lock.notify = session_new_lock;
+	server.new_lock.notify = timed_session_new_lock;
 	wl_signal_add(&server.session_lock_mgr->events.new_lock, &server.new_lock);
 	server.locked = false;
 
@@ -1454,15 +1866,24 @@ int backend_init(int *default_screen)
 
 	/* Layer shell protocol */
 	server.layer_shell = wlr_layer_shell_v1_create(server.wl_display, 4);
-	server.new_layer_surface.notify = server_new_layer_surface;
+	server.new_layer_surface.notify = timed_server_new_layer_surface;
 	wl_signal_add(&server.layer_shell->events.new_surface, &server.new_layer_surface);
 
-	/* XWayland — skip in headless mode (no GPU for Xwayland rendering) */
+	/* XWayland — skip in headless mode (no GPU for Xwayland rendering).
+	 * In lazy mode, wlroots only reserves the display socket and starts
+	 * the server when the first X11 client connects to it. */
 	const char *wlr_backends = getenv("WLR_BACKENDS");
+	const char *xwayland_mode = getenv(XWAYLAND_ENV_VAR);
 	bool headless = wlr_backends && strstr(wlr_backends, "headless");
-	server.xwayland = headless ? NULL : wlr_xwayland_create(server.wl_display, server.compositor, false);
+	bool disabled = xwayland_mode && streq(xwayland_mode, "off");
+	bool lazy = xwayland_mode && streq(xwayland_mode, "lazy");
+	if (xwayland_mode && !disabled && !lazy && !streq(xwayland_mode, "eager")) {
+		warn("Unknown %s value: '%s'.\n", XWAYLAND_ENV_VAR, xwayland_mode);
+	}
+	server.xwayland = (headless || disabled) ? NULL :
+		wlr_xwayland_create(server.wl_display, server.compositor, lazy);
 	if (server.xwayland) {
-		server.xwayland_new_surface.notify = server_new_xwayland_surface;
+		server.xwayland_new_surface.notify = timed_server_new_xwayland_surface;
 		wl_signal_add(&server.xwayland->events.new_surface, &server.xwayland_new_surface);
 		wl_list_init(&server.xwayland_surfaces);
 	}
@@ -1472,30 +1893,31 @@ int backend_init(int *default_screen)
 	wlr_cursor_attach_output_layout(server.cursor, server.output_layout);
 	server.cursor_mgr = wlr_xcursor_manager_create(NULL, 24);
 
-	server.cursor_motion.notify = cursor_motion;
+	server.cursor_motion.notify = timed_cursor_motion;
 	wl_signal_add(&server.cursor->events.motion, &server.cursor_motion);
-	server.cursor_motion_absolute.notify = cursor_motion_absolute;
+	server.cursor_motion_absolute.notify = timed_cursor_motion_absolute;
 	wl_signal_add(&server.cursor->events.motion_absolute, &server.cursor_motion_absolute);
-	server.cursor_button.notify = cursor_button;
+	server.cursor_button.notify = timed_cursor_button;
 	wl_signal_add(&server.cursor->events.button, &server.cursor_button);
-	server.cursor_axis.notify = cursor_axis;
+	server.cursor_axis.notify = timed_cursor_axis;
 	wl_signal_add(&server.cursor->events.axis, &server.cursor_axis);
-	server.cursor_frame.notify = cursor_frame;
+	server.cursor_frame.notify = timed_cursor_frame;
 	wl_signal_add(&server.cursor->events.frame, &server.cursor_frame);
 
 	/* Seat */
 	wl_list_init(&server.keyboards);
-	server.new_input.notify = server_new_input;
+	server.new_input.notify = timed_server_new_input;
 	wl_signal_add(&server.backend->events.new_input, &server.new_input);
 	server.seat = wlr_seat_create(server.wl_display, "seat0");
-	server.request_cursor.notify = seat_request_cursor;
+	server.relative_pointer_mgr = wlr_relative_pointer_manager_v1_create(server.wl_display);
+	server.request_cursor.notify = timed_seat_request_cursor;
 	wl_signal_add(&server.seat->events.request_set_cursor, &server.request_cursor);
-	server.request_set_selection.notify = seat_request_set_selection;
+	server.request_set_selection.notify = timed_seat_request_set_selection;
 	wl_signal_add(&server.seat->events.request_set_selection, &server.request_set_selection);
 
 	/* XDG decoration — force server-side borders */
 	server.decoration_mgr = wlr_xdg_decoration_manager_v1_create(server.wl_display);
-	server.new_decoration.notify = new_decoration;
+	server.new_decoration.notify = timed_new_decoration;
 	wl_signal_add(&server.decoration_mgr->events.new_toplevel_decoration, &server.new_decoration);
 
 	/* ID counters start above 0 (BSPWM_WID_NONE) */
@@ -1551,6 +1973,7 @@ void backend_destroy(void)
 			wl_list_remove(&server.xwayland_new_surface.link);
 		}
 
+		wl_event_source_remove(server.txn_timer);
 		wlr_scene_node_destroy(&server.scene->tree.node);
 		wlr_xcursor_manager_destroy(server.cursor_mgr);
 		wlr_cursor_destroy(server.cursor);
@@ -1559,6 +1982,7 @@ void backend_destroy(void)
 		wlr_backend_destroy(server.backend);
 		wl_display_destroy(server.wl_display);
 		server.wl_display = NULL;
+		object_registry_clear();
 	}
 }
 
@@ -1569,9 +1993,16 @@ int backend_get_fd(void)
 
 void backend_flush(void)
 {
+	transaction_commit();
+	update_fullscreen_bypass();
 	wl_display_flush_clients(server.wl_display);
 }
 
+uint32_t backend_request_count(void)
+{
+	return wl_display_get_serial(server.wl_display);
+}
+
 bool backend_dispatch_events(void)
 {
 	wl_event_loop_dispatch(server.wl_event_loop, 0);
@@ -1620,7 +2051,7 @@ void backend_destroy_window(bspwm_wid_t win)
 	struct bspwm_wlr_presel *p = presel_from_id(win);
 	if (p) {
 		wlr_scene_node_destroy(&p->rect->node);
-		wl_list_remove(&p->link);
+		object_registry_remove(p->id);
 		free(p);
 	}
 }
@@ -1629,7 +2060,9 @@ void backend_window_show(bspwm_wid_t win)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
 	if (tl && tl->scene_tree) {
-		wlr_scene_node_set_enabled(&tl->scene_tree->node, true);
+		tl->hidden = false;
+		toplevel_update_visibility(tl);
+		bypass_dirty = true;
 		return;
 	}
 	struct bspwm_wlr_presel *p = presel_from_id(win);
@@ -1642,7 +2075,8 @@ void backend_window_hide(bspwm_wid_t win)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
 	if (tl && tl->scene_tree) {
-		wlr_scene_node_set_enabled(&tl->scene_tree->node, false);
+		tl->hidden = true;
+		toplevel_update_visibility(tl);
 		return;
 	}
 	struct bspwm_wlr_presel *p = presel_from_id(win);
@@ -1651,11 +2085,52 @@ void backend_window_hide(bspwm_wid_t win)
 	}
 }
 
+void backend_window_park(bspwm_wid_t win, bool parked)
+{
+	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
+	if (tl && tl->scene_tree && tl->parked != parked) {
+		tl->parked = parked;
+		toplevel_update_visibility(tl);
+		if (!parked) {
+			bypass_dirty = true;
+		}
+	}
+}
+
+static bool toplevel_record_position(struct bspwm_wlr_toplevel *tl, int16_t x, int16_t y)
+{
+	if (tl->position_sent && tl->geometry.x == x && tl->geometry.y == y) {
+		return false;
+	}
+	tl->position_sent = true;
+	tl->geometry.x = x;
+	tl->geometry.y = y;
+	return true;
+}
+
+/* Every configure is a round trip with the client and a relayout on its
+ * side: skip the ones that repeat the last sent size. Moves stay in the
+ * scene graph, only these count as configures. */
+static bool toplevel_record_size(struct bspwm_wlr_toplevel *tl, uint16_t w, uint16_t h)
+{
+	if (tl->size_sent && tl->geometry.width == w && tl->geometry.height == h) {
+		lookup_stats.configures_suppressed++;
+		return false;
+	}
+	lookup_stats.configures_sent++;
+	tl->size_sent = true;
+	tl->geometry.width = w;
+	tl->geometry.height = h;
+	return true;
+}
+
 void backend_window_move(bspwm_wid_t win, int16_t x, int16_t y)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
 	if (tl && tl->scene_tree) {
-		wlr_scene_node_set_position(&tl->scene_tree->node, x, y);
+		if (toplevel_record_position(tl, x, y)) {
+			transaction_add(tl);
+		}
 		return;
 	}
 	struct bspwm_wlr_presel *p = presel_from_id(win);
@@ -1668,7 +2143,9 @@ void backend_window_resize(bspwm_wid_t win, uint16_t w, uint16_t h)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
 	if (tl) {
-		wlr_xdg_toplevel_set_size(tl->xdg_toplevel, w, h);
+		if (toplevel_record_size(tl, w, h)) {
+			transaction_wait(tl, wlr_xdg_toplevel_set_size(tl->xdg_toplevel, w, h));
+		}
 		return;
 	}
 	struct bspwm_wlr_presel *p = presel_from_id(win);
@@ -1681,10 +2158,12 @@ void backend_window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
 	if (tl) {
-		if (tl->scene_tree) {
-			wlr_scene_node_set_position(&tl->scene_tree->node, x, y);
+		if (tl->scene_tree && toplevel_record_position(tl, x, y)) {
+			transaction_add(tl);
+		}
+		if (toplevel_record_size(tl, w, h)) {
+			transaction_wait(tl, wlr_xdg_toplevel_set_size(tl->xdg_toplevel, w, h));
 		}
-		wlr_xdg_toplevel_set_size(tl->xdg_toplevel, w, h);
 		return;
 	}
 	struct bspwm_wlr_presel *p = presel_from_id(win);
@@ -1697,11 +2176,26 @@ void backend_window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t
 void backend_window_set_border_width(bspwm_wid_t win, uint32_t bw)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
-	if (!tl) return;
+	if (!tl || tl->border_width == bw) return;
 	tl->border_width = bw;
 	toplevel_update_borders(tl);
 }
 
+/* Sizes are settled by the clients on commit, in any order. */
+uint32_t backend_configure_serial(void)
+{
+	return 0;
+}
+
+void backend_forget_window(bspwm_wid_t win)
+{
+	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
+	if (!tl) return;
+	tl->position_sent = tl->size_sent = false;
+	tl->parked = false;
+	toplevel_update_visibility(tl);
+}
+
 void backend_window_set_border_color(bspwm_wid_t win, uint32_t color)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
@@ -1718,8 +2212,9 @@ bool backend_window_get_geometry(bspwm_wid_t win, bspwm_rect_t *rect)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
 	if (!tl) return false;
-	rect->x = tl->scene_tree->node.x;
-	rect->y = tl->scene_tree->node.y;
+	/* Report where a pending transaction puts the window */
+	rect->x = tl->txn_pending ? tl->geometry.x : tl->scene_tree->node.x;
+	rect->y = tl->txn_pending ? tl->geometry.y : tl->scene_tree->node.y;
 	rect->width = tl->xdg_toplevel->base->geometry.width;
 	rect->height = tl->xdg_toplevel->base->geometry.height;
 	return true;
@@ -1753,6 +2248,23 @@ void backend_window_stack_below(bspwm_wid_t w1, bspwm_wid_t w2)
 	}
 }
 
+void backend_window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings,
+                            uint32_t count, bool above)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		struct bspwm_wlr_toplevel *tl1 = toplevel_from_id(wins[i]);
+		struct bspwm_wlr_toplevel *tl2 = toplevel_from_id(siblings[i]);
+		if (!tl1 || !tl2 || !tl1->scene_tree || !tl2->scene_tree) {
+			continue;
+		}
+		if (above) {
+			wlr_scene_node_place_above(&tl1->scene_tree->node, &tl2->scene_tree->node);
+		} else {
+			wlr_scene_node_place_below(&tl1->scene_tree->node, &tl2->scene_tree->node);
+		}
+	}
+}
+
 void backend_window_raise(bspwm_wid_t win)
 {
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
@@ -1940,6 +2452,37 @@ bool backend_get_window_type(bspwm_wid_t win, bspwm_window_type_t *type)
 	return true; /* All xdg-shell toplevels are "normal" */
 }
 
+/* Nothing to pipeline here, every property is already in memory. */
+bspwm_attrs_cookie_t backend_request_window_attributes(bspwm_wid_t win, bool with_name)
+{
+	(void)win;
+	(void)with_name;
+	return (bspwm_attrs_cookie_t){0};
+}
+
+void backend_collect_window_attributes(bspwm_wid_t win, bspwm_attrs_cookie_t cookie, bspwm_window_attrs_t *attrs,
+                                       char *class_name, char *instance_name, char *name, size_t len)
+{
+	(void)cookie;
+	*attrs = (bspwm_window_attrs_t) {.transient_for = BSPWM_WID_NONE};
+	attrs->override_redirect = backend_is_override_redirect(win);
+	attrs->has_geometry = backend_window_get_geometry(win, &attrs->geometry);
+	attrs->has_type = backend_get_window_type(win, &attrs->type);
+	backend_get_transient_for(win, &attrs->transient_for);
+	backend_get_size_hints(win, &attrs->size_hints);
+	backend_get_icccm_props(win, &attrs->icccm_props);
+	backend_get_window_class(win, class_name, instance_name, len);
+	if (name != NULL) {
+		backend_get_window_name(win, name, len);
+	}
+}
+
+void backend_fetch_window_attributes(bspwm_wid_t win, bspwm_window_attrs_t *attrs,
+                                     char *class_name, char *instance_name, char *name, size_t len)
+{
+	backend_collect_window_attributes(win, (bspwm_attrs_cookie_t){0}, attrs, class_name, instance_name, name, len);
+}
+
 /* ------------------------------------------------------------------ */
 /*  EWMH (no-ops on Wayland — these are X11 concepts)                */
 /* ------------------------------------------------------------------ */
@@ -1993,6 +2536,7 @@ int backend_query_outputs(bspwm_output_info_t *outputs, int max)
 		outputs[count].rect.y = lo->y;
 		outputs[count].rect.width = out->wlr_output->width;
 		outputs[count].rect.height = out->wlr_output->height;
+		outputs[count].refresh = out->wlr_output->refresh > 0 ? (uint32_t) out->wlr_output->refresh : 0;
 
 		count++;
 	}
@@ -2004,6 +2548,43 @@ void backend_listen_output_changes(void)
 	/* Already handled via new_output listener */
 }
 
+bool backend_output_direct_scanout(bspwm_output_id_t id)
+{
+	struct bspwm_wlr_output *out;
+	wl_list_for_each(out, &server.outputs, link) {
+		if (out->id == id) {
+			return out->bypass && out->scanout;
+		}
+	}
+	return false;
+}
+
+bool backend_set_adaptive_sync(bspwm_output_id_t id, bool enable)
+{
+	struct bspwm_wlr_output *out;
+	wl_list_for_each(out, &server.outputs, link) {
+		if (out->id != id) {
+			continue;
+		}
+		struct wlr_output *wlr_output = out->wlr_output;
+		bool enabled = (wlr_output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED);
+		if (enabled == enable) {
+			return true;
+		}
+		if (enable && !wlr_output->adaptive_sync_supported) {
+			return false;
+		}
+		struct wlr_output_state state;
+		wlr_output_state_init(&state);
+		wlr_output_state_set_adaptive_sync_enabled(&state, enable);
+		bool ok = wlr_output_test_state(wlr_output, &state) &&
+		          wlr_output_commit_state(wlr_output, &state);
+		wlr_output_state_finish(&state);
+		return ok;
+	}
+	return !enable;
+}
+
 /* ------------------------------------------------------------------ */
 /*  Input                                                             */
 /* ------------------------------------------------------------------ */
@@ -2028,12 +2609,15 @@ void backend_query_pointer(bspwm_wid_t *win, bspwm_point_t *pos)
 			&server.scene->tree.node, server.cursor->x, server.cursor->y, &sx, &sy);
 		*win = BSPWM_WID_NONE;
 		while (node) {
-			if (node->data) {
-				struct bspwm_wlr_toplevel *tl = node->data;
-				*win = tl->id;
+			enum bspwm_wlr_kind *kind = node->data;
+			if (kind && *kind == WLR_KIND_TOPLEVEL) {
+				*win = ((struct bspwm_wlr_toplevel *) node->data)->id;
+				break;
+			} else if (kind && *kind == WLR_KIND_XWAYLAND) {
+				*win = ((struct bspwm_wlr_xwayland_surface *) node->data)->id;
 				break;
 			}
-			node = &node->parent->node;
+			node = node->parent ? &node->parent->node : NULL;
 		}
 	}
 }
@@ -2056,25 +2640,35 @@ uint16_t backend_get_lock_fields(void) { return 0; }
 
 bspwm_wid_t backend_create_presel_feedback(uint32_t color)
 {
-	if (!presel_list_initialized) {
-		wl_list_init(&presel_list);
-		presel_list_initialized = true;
-	}
-
 	float fcolor[4];
 	color_u32_to_float(color, fcolor);
 
 	struct bspwm_wlr_presel *p = calloc(1, sizeof(*p));
-	if (!p) return ++server.next_toplevel_id;
+	if (!p) return BSPWM_WID_NONE;
 
-	p->id = ++server.next_toplevel_id;
+	p->kind = WLR_KIND_PRESEL;
 	p->rect = wlr_scene_rect_create(&server.scene->tree, 1, 1, fcolor);
+	if (!p->rect) {
+		free(p);
+		return BSPWM_WID_NONE;
+	}
+	p->id = ++server.next_toplevel_id;
 	wlr_scene_node_set_enabled(&p->rect->node, false);
 
-	wl_list_insert(&presel_list, &p->link);
+	object_registry_add(p->id, p->kind, p);
 	return p->id;
 }
 
+void backend_set_presel_feedback_color(bspwm_wid_t win, uint32_t color)
+{
+	struct bspwm_wlr_presel *p = presel_from_id(win);
+	if (p && p->rect) {
+		float fcolor[4];
+		color_u32_to_float(color, fcolor);
+		wlr_scene_rect_set_color(p->rect, fcolor);
+	}
+}
+
 /* ------------------------------------------------------------------ */
 /*  Client message / close                                            */
 /* ------------------------------------------------------------------ */
@@ -2104,7 +2698,7 @@ void backend_send_configure_notify(bspwm_wid_t win, bspwm_rect_t rect, uint32_t
 	(void)border_width;
 	/* On Wayland, the compositor tells the client its size via configure */
 	struct bspwm_wlr_toplevel *tl = toplevel_from_id(win);
-	if (tl) {
+	if (tl && toplevel_record_size(tl, rect.width, rect.height)) {
 		wlr_xdg_toplevel_set_size(tl->xdg_toplevel, rect.width, rect.height);
 	}
 }
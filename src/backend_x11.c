@@ -50,6 +50,8 @@
 #include "backend_x11.h"
 #include "ewmh.h"
 #include "keybind.h"
+#include "lookup.h"
+#include "pointer.h"
 #include "settings.h"
 
 /* ------------------------------------------------------------------ */
@@ -84,6 +86,7 @@ int backend_init(int *default_screen_out)
 
 void backend_destroy(void)
 {
+	x11_free_keymap();
 	if (ewmh) {
 		xcb_ewmh_connection_wipe(ewmh);
 		free(ewmh);
@@ -106,6 +109,12 @@ void backend_flush(void)
 	xcb_flush(dpy);
 }
 
+uint32_t backend_request_count(void)
+{
+	/* NoOperation is the cheapest way to read the request sequence */
+	return xcb_no_operation(dpy).sequence;
+}
+
 bool backend_dispatch_events(void)
 {
 	xcb_aux_sync(dpy);
@@ -182,6 +191,7 @@ bspwm_wid_t backend_create_internal_window(const char *kind, bspwm_rect_t rect,
 
 void backend_destroy_window(bspwm_wid_t win)
 {
+	sent_geometry_forget(win);
 	xcb_destroy_window(dpy, win);
 }
 
@@ -195,34 +205,98 @@ void backend_window_hide(bspwm_wid_t win)
 	xcb_unmap_window(dpy, win);
 }
 
+static uint32_t configure_serial;
+
+/* Managed windows can only change geometry through us (substructure
+ * redirect), so a request repeating the last sent values is dropped. */
 void backend_window_move(bspwm_wid_t win, int16_t x, int16_t y)
 {
+	if (!sent_geometry_record_position(win, x, y) || sent_geometry_parked(win)) {
+		lookup_stats.configures_suppressed++;
+		return;
+	}
+	lookup_stats.configures_sent++;
 	uint32_t values[] = {(uint32_t)x, (uint32_t)y};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
+	configure_serial = xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values).sequence;
 }
 
 void backend_window_resize(bspwm_wid_t win, uint16_t w, uint16_t h)
 {
+	if (!sent_geometry_record_size(win, w, h)) {
+		lookup_stats.configures_suppressed++;
+		return;
+	}
+	lookup_stats.configures_sent++;
 	uint32_t values[] = {w, h};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+	configure_serial = xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values).sequence;
 }
 
 void backend_window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t w, uint16_t h)
 {
-	uint32_t values[] = {(uint32_t)x, (uint32_t)y, w, h};
-	xcb_configure_window(dpy, win,
-		XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
-		XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+	bool moved = sent_geometry_record_position(win, x, y) && !sent_geometry_parked(win);
+	bool resized = sent_geometry_record_size(win, w, h);
+	if (moved || resized) {
+		lookup_stats.configures_sent++;
+	} else {
+		lookup_stats.configures_suppressed++;
+	}
+	if (moved && resized) {
+		uint32_t values[] = {(uint32_t)x, (uint32_t)y, w, h};
+		configure_serial = xcb_configure_window(dpy, win,
+			XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+			XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values).sequence;
+	} else if (moved) {
+		uint32_t values[] = {(uint32_t)x, (uint32_t)y};
+		configure_serial = xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values).sequence;
+	} else if (resized) {
+		uint32_t values[] = {w, h};
+		configure_serial = xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values).sequence;
+	}
+}
+
+/* Parked windows sit left of the origin, where no output reaches: the
+ * width of a window and its borders can't exceed INT16_MAX. */
+#define PARKED_X  INT16_MIN
+
+void backend_window_park(bspwm_wid_t win, bool parked)
+{
+	bspwm_rect_t r;
+	if (!sent_geometry_record_parked(win, parked, &r)) {
+		if (!parked || sent_geometry_parked(win) || !backend_window_get_geometry(win, &r)) {
+			return;
+		}
+		sent_geometry_record_position(win, r.x, r.y);
+		if (!sent_geometry_record_parked(win, true, &r)) {
+			return;
+		}
+	}
+	lookup_stats.configures_sent++;
+	uint32_t values[] = {(uint32_t)(parked ? PARKED_X : r.x), (uint32_t)r.y};
+	configure_serial = xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values).sequence;
+}
+
+uint32_t backend_configure_serial(void)
+{
+	return configure_serial;
 }
 
 void backend_window_set_border_width(bspwm_wid_t win, uint32_t bw)
 {
+	if (!sent_geometry_record_border(win, bw))
+		return;
 	uint32_t values[] = {bw};
 	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_BORDER_WIDTH, values);
 }
 
+void backend_forget_window(bspwm_wid_t win)
+{
+	sent_geometry_forget(win);
+}
+
 void backend_window_set_border_color(bspwm_wid_t win, uint32_t color)
 {
+	if (!sent_geometry_record_border_color(win, color))
+		return;
 	uint32_t values[] = {color};
 	xcb_change_window_attributes(dpy, win, XCB_CW_BORDER_PIXEL, values);
 }
@@ -278,6 +352,17 @@ void backend_window_stack_below(bspwm_wid_t w1, bspwm_wid_t w2)
 		XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, values);
 }
 
+void backend_window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings,
+                            uint32_t count, bool above)
+{
+	uint32_t mode = above ? XCB_STACK_MODE_ABOVE : XCB_STACK_MODE_BELOW;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t values[] = {siblings[i], mode};
+		xcb_configure_window(dpy, wins[i],
+			XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, values);
+	}
+}
+
 void backend_window_raise(bspwm_wid_t win)
 {
 	uint32_t values[] = {XCB_STACK_MODE_ABOVE};
@@ -308,10 +393,10 @@ void backend_clear_input_focus(void)
 /*  Window properties                                                 */
 /* ------------------------------------------------------------------ */
 
-bool backend_get_window_class(bspwm_wid_t win, char *class_name, char *instance_name, size_t len)
+static bool collect_window_class(xcb_get_property_cookie_t cookie, char *class_name, char *instance_name, size_t len)
 {
 	xcb_icccm_get_wm_class_reply_t reply;
-	if (xcb_icccm_get_wm_class_reply(dpy, xcb_icccm_get_wm_class(dpy, win), &reply, NULL) != 1)
+	if (xcb_icccm_get_wm_class_reply(dpy, cookie, &reply, NULL) != 1)
 		return false;
 	if (reply.class_name)
 		snprintf(class_name, len, "%s", reply.class_name);
@@ -321,10 +406,15 @@ bool backend_get_window_class(bspwm_wid_t win, char *class_name, char *instance_
 	return true;
 }
 
-bool backend_get_window_name(bspwm_wid_t win, char *name, size_t len)
+bool backend_get_window_class(bspwm_wid_t win, char *class_name, char *instance_name, size_t len)
+{
+	return collect_window_class(xcb_icccm_get_wm_class(dpy, win), class_name, instance_name, len);
+}
+
+static bool collect_window_name(xcb_get_property_cookie_t cookie, char *name, size_t len)
 {
 	xcb_icccm_get_text_property_reply_t reply;
-	if (xcb_icccm_get_wm_name_reply(dpy, xcb_icccm_get_wm_name(dpy, win), &reply, NULL) != 1)
+	if (xcb_icccm_get_wm_name_reply(dpy, cookie, &reply, NULL) != 1)
 		return false;
 	size_t safe_len = (size_t)reply.name_len < len - 1 ? (size_t)reply.name_len : len - 1;
 	memcpy(name, reply.name, safe_len);
@@ -333,12 +423,14 @@ bool backend_get_window_name(bspwm_wid_t win, char *name, size_t len)
 	return true;
 }
 
-bool backend_get_icccm_props(bspwm_wid_t win, bspwm_icccm_props_t *props)
+bool backend_get_window_name(bspwm_wid_t win, char *name, size_t len)
 {
-	/* Pipeline: send both requests first */
-	xcb_get_property_cookie_t protos_cookie = xcb_icccm_get_wm_protocols(dpy, win, ewmh->WM_PROTOCOLS);
-	xcb_get_property_cookie_t hints_cookie = xcb_icccm_get_wm_hints(dpy, win);
+	return collect_window_name(xcb_icccm_get_wm_name(dpy, win), name, len);
+}
 
+static void collect_icccm_props(xcb_get_property_cookie_t protos_cookie, xcb_get_property_cookie_t hints_cookie,
+                                bspwm_icccm_props_t *props)
+{
 	/* Collect protocols */
 	xcb_icccm_get_wm_protocols_reply_t protos;
 	if (xcb_icccm_get_wm_protocols_reply(dpy, protos_cookie, &protos, NULL) == 1) {
@@ -357,15 +449,21 @@ bool backend_get_icccm_props(bspwm_wid_t win, bspwm_icccm_props_t *props)
 	    (hints.flags & XCB_ICCCM_WM_HINT_INPUT)) {
 		props->input_hint = hints.input;
 	}
+}
 
+bool backend_get_icccm_props(bspwm_wid_t win, bspwm_icccm_props_t *props)
+{
+	/* Pipeline: send both requests first */
+	xcb_get_property_cookie_t protos_cookie = xcb_icccm_get_wm_protocols(dpy, win, ewmh->WM_PROTOCOLS);
+	xcb_get_property_cookie_t hints_cookie = xcb_icccm_get_wm_hints(dpy, win);
+	collect_icccm_props(protos_cookie, hints_cookie, props);
 	return true;
 }
 
-bool backend_get_size_hints(bspwm_wid_t win, bspwm_size_hints_t *hints)
+static bool collect_size_hints(xcb_get_property_cookie_t cookie, bspwm_size_hints_t *hints)
 {
 	xcb_size_hints_t xcb_hints;
-	if (xcb_icccm_get_wm_normal_hints_reply(dpy,
-	    xcb_icccm_get_wm_normal_hints(dpy, win), &xcb_hints, NULL) != 1)
+	if (xcb_icccm_get_wm_normal_hints_reply(dpy, cookie, &xcb_hints, NULL) != 1)
 		return false;
 
 	hints->flags = 0;
@@ -396,15 +494,24 @@ bool backend_get_size_hints(bspwm_wid_t win, bspwm_size_hints_t *hints)
 	return true;
 }
 
-bool backend_get_transient_for(bspwm_wid_t win, bspwm_wid_t *transient_for)
+bool backend_get_size_hints(bspwm_wid_t win, bspwm_size_hints_t *hints)
+{
+	return collect_size_hints(xcb_icccm_get_wm_normal_hints(dpy, win), hints);
+}
+
+static bool collect_transient_for(xcb_get_property_cookie_t cookie, bspwm_wid_t *transient_for)
 {
 	xcb_window_t tf = XCB_NONE;
-	xcb_icccm_get_wm_transient_for_reply(dpy,
-		xcb_icccm_get_wm_transient_for(dpy, win), &tf, NULL);
+	xcb_icccm_get_wm_transient_for_reply(dpy, cookie, &tf, NULL);
 	*transient_for = tf;
 	return tf != XCB_NONE;
 }
 
+bool backend_get_transient_for(bspwm_wid_t win, bspwm_wid_t *transient_for)
+{
+	return collect_transient_for(xcb_icccm_get_wm_transient_for(dpy, win), transient_for);
+}
+
 bool backend_is_override_redirect(bspwm_wid_t win)
 {
 	xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(
@@ -434,11 +541,10 @@ void backend_set_window_state(bspwm_wid_t win, bspwm_wm_state_t state)
 /*  Window type                                                       */
 /* ------------------------------------------------------------------ */
 
-bool backend_get_window_type(bspwm_wid_t win, bspwm_window_type_t *type)
+static bool collect_window_type(xcb_get_property_cookie_t cookie, bspwm_window_type_t *type)
 {
 	xcb_ewmh_get_atoms_reply_t reply;
-	if (xcb_ewmh_get_wm_window_type_reply(ewmh,
-	    xcb_ewmh_get_wm_window_type(ewmh, win), &reply, NULL) != 1)
+	if (xcb_ewmh_get_wm_window_type_reply(ewmh, cookie, &reply, NULL) != 1)
 		return false;
 
 	bool found = false;
@@ -456,6 +562,123 @@ bool backend_get_window_type(bspwm_wid_t win, bspwm_window_type_t *type)
 	return true;
 }
 
+bool backend_get_window_type(bspwm_wid_t win, bspwm_window_type_t *type)
+{
+	return collect_window_type(xcb_ewmh_get_wm_window_type(ewmh, win), type);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Batched attribute fetch                                           */
+/* ------------------------------------------------------------------ */
+
+static uint8_t collect_initial_state(xcb_get_property_cookie_t cookie)
+{
+	uint8_t state = 0;
+	xcb_ewmh_get_atoms_reply_t reply;
+	if (xcb_ewmh_get_wm_state_reply(ewmh, cookie, &reply, NULL) != 1)
+		return state;
+	for (unsigned int i = 0; i < reply.atoms_len; i++) {
+		xcb_atom_t a = reply.atoms[i];
+		if (a == ewmh->_NET_WM_STATE_FULLSCREEN) state |= BSP_INITIAL_STATE_FULLSCREEN;
+		else if (a == ewmh->_NET_WM_STATE_ABOVE) state |= BSP_INITIAL_STATE_ABOVE;
+		else if (a == ewmh->_NET_WM_STATE_BELOW) state |= BSP_INITIAL_STATE_BELOW;
+		else if (a == ewmh->_NET_WM_STATE_STICKY) state |= BSP_INITIAL_STATE_STICKY;
+	}
+	xcb_ewmh_get_atoms_reply_wipe(&reply);
+	return state;
+}
+
+enum {
+	ATTRS_WINDOW,
+	ATTRS_GEOMETRY,
+	ATTRS_TYPE,
+	ATTRS_STATE,
+	ATTRS_TRANSIENT_FOR,
+	ATTRS_NORMAL_HINTS,
+	ATTRS_PROTOCOLS,
+	ATTRS_HINTS,
+	ATTRS_CLASS,
+	ATTRS_NAME,
+	ATTRS_REQUESTS
+};
+
+_Static_assert(ATTRS_REQUESTS <= LENGTH(((bspwm_attrs_cookie_t *) NULL)->sequence),
+               "bspwm_attrs_cookie_t can't hold every attribute request");
+
+bspwm_attrs_cookie_t backend_request_window_attributes(bspwm_wid_t win, bool with_name)
+{
+	bspwm_attrs_cookie_t cookie = {0};
+	cookie.sequence[ATTRS_WINDOW] = xcb_get_window_attributes(dpy, win).sequence;
+	cookie.sequence[ATTRS_GEOMETRY] = xcb_get_geometry(dpy, win).sequence;
+	cookie.sequence[ATTRS_TYPE] = xcb_ewmh_get_wm_window_type(ewmh, win).sequence;
+	cookie.sequence[ATTRS_STATE] = xcb_ewmh_get_wm_state(ewmh, win).sequence;
+	cookie.sequence[ATTRS_TRANSIENT_FOR] = xcb_icccm_get_wm_transient_for(dpy, win).sequence;
+	cookie.sequence[ATTRS_NORMAL_HINTS] = xcb_icccm_get_wm_normal_hints(dpy, win).sequence;
+	cookie.sequence[ATTRS_PROTOCOLS] = xcb_icccm_get_wm_protocols(dpy, win, ewmh->WM_PROTOCOLS).sequence;
+	cookie.sequence[ATTRS_HINTS] = xcb_icccm_get_wm_hints(dpy, win).sequence;
+	cookie.sequence[ATTRS_CLASS] = xcb_icccm_get_wm_class(dpy, win).sequence;
+	if (with_name) {
+		cookie.sequence[ATTRS_NAME] = xcb_icccm_get_wm_name(dpy, win).sequence;
+		cookie.has_name = true;
+	}
+	return cookie;
+}
+
+#define PROPERTY_COOKIE(c, i) ((xcb_get_property_cookie_t) {(c).sequence[(i)]})
+
+void backend_collect_window_attributes(bspwm_wid_t win, bspwm_attrs_cookie_t cookie, bspwm_window_attrs_t *attrs,
+                                       char *class_name, char *instance_name, char *name, size_t len)
+{
+	(void) win;
+	/* Without WM_HINTS a client accepts input, as make_client assumes. */
+	*attrs = (bspwm_window_attrs_t) {
+		.type = BSP_WINDOW_TYPE_NORMAL,
+		.transient_for = XCB_NONE,
+		.icccm_props.input_hint = true,
+	};
+
+	xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(dpy,
+		(xcb_get_window_attributes_cookie_t) {cookie.sequence[ATTRS_WINDOW]}, NULL);
+	if (wa != NULL) {
+		attrs->override_redirect = wa->override_redirect;
+		free(wa);
+	}
+
+	xcb_get_geometry_reply_t *geo = xcb_get_geometry_reply(dpy,
+		(xcb_get_geometry_cookie_t) {cookie.sequence[ATTRS_GEOMETRY]}, NULL);
+	if (geo != NULL) {
+		attrs->geometry = (bspwm_rect_t) {geo->x, geo->y, geo->width, geo->height};
+		attrs->has_geometry = true;
+		free(geo);
+	}
+
+	attrs->has_type = collect_window_type(PROPERTY_COOKIE(cookie, ATTRS_TYPE), &attrs->type);
+	attrs->initial_state = collect_initial_state(PROPERTY_COOKIE(cookie, ATTRS_STATE));
+	collect_transient_for(PROPERTY_COOKIE(cookie, ATTRS_TRANSIENT_FOR), &attrs->transient_for);
+	collect_size_hints(PROPERTY_COOKIE(cookie, ATTRS_NORMAL_HINTS), &attrs->size_hints);
+	collect_icccm_props(PROPERTY_COOKIE(cookie, ATTRS_PROTOCOLS), PROPERTY_COOKIE(cookie, ATTRS_HINTS), &attrs->icccm_props);
+	collect_window_class(PROPERTY_COOKIE(cookie, ATTRS_CLASS), class_name, instance_name, len);
+	if (name != NULL) {
+		name[0] = '\0';
+	}
+	if (cookie.has_name) {
+		if (name != NULL) {
+			collect_window_name(PROPERTY_COOKIE(cookie, ATTRS_NAME), name, len);
+		} else {
+			xcb_discard_reply(dpy, cookie.sequence[ATTRS_NAME]);
+		}
+	}
+}
+
+#undef PROPERTY_COOKIE
+
+void backend_fetch_window_attributes(bspwm_wid_t win, bspwm_window_attrs_t *attrs,
+                                     char *class_name, char *instance_name, char *name, size_t len)
+{
+	backend_collect_window_attributes(win, backend_request_window_attributes(win, name != NULL), attrs,
+	                                  class_name, instance_name, name, len);
+}
+
 /* ------------------------------------------------------------------ */
 /*  EWMH / compositor state                                          */
 /* ------------------------------------------------------------------ */
@@ -480,6 +703,31 @@ bool backend_ewmh_handle_struts(bspwm_wid_t win)
 
 #define MAX_MONITORS 256
 
+/* Refresh rate in mHz of the given mode, 0 when unknown. */
+static uint32_t mode_refresh(xcb_randr_get_screen_resources_reply_t *sres, xcb_randr_mode_t mode)
+{
+	xcb_randr_mode_info_t *modes = xcb_randr_get_screen_resources_modes(sres);
+	int len = xcb_randr_get_screen_resources_modes_length(sres);
+	for (int i = 0; i < len; i++) {
+		xcb_randr_mode_info_t *mi = &modes[i];
+		if (mi->id != mode) {
+			continue;
+		}
+		uint64_t vtotal = mi->vtotal;
+		if (mi->mode_flags & XCB_RANDR_MODE_FLAG_DOUBLE_SCAN) {
+			vtotal *= 2;
+		}
+		if (mi->mode_flags & XCB_RANDR_MODE_FLAG_INTERLACE) {
+			vtotal /= 2;
+		}
+		if (mi->htotal == 0 || vtotal == 0) {
+			return 0;
+		}
+		return (uint32_t) ((uint64_t) mi->dot_clock * 1000 / (mi->htotal * vtotal));
+	}
+	return 0;
+}
+
 int backend_query_outputs(bspwm_output_info_t *outputs, int max)
 {
 	xcb_randr_get_screen_resources_reply_t *sres =
@@ -522,6 +770,7 @@ int backend_query_outputs(bspwm_output_info_t *outputs, int max)
 				o->rect = (bspwm_rect_t){cir->x, cir->y, cir->width, cir->height};
 				o->id = xoutputs[i];
 				o->primary = (xoutputs[i] == primary_output);
+				o->refresh = mode_refresh(sres, cir->mode);
 
 				char *name = (char *)xcb_randr_get_output_info_name(info);
 				size_t name_len = xcb_randr_get_output_info_name_length(info);
@@ -546,6 +795,20 @@ void backend_listen_output_changes(void)
 	xcb_randr_select_input(dpy, root, XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE);
 }
 
+bool backend_set_adaptive_sync(bspwm_output_id_t id, bool enable)
+{
+	(void)id;
+	/* Variable refresh is up to the X driver and the client windows */
+	return !enable;
+}
+
+bool backend_output_direct_scanout(bspwm_output_id_t id)
+{
+	(void)id;
+	/* Unredirecting fullscreen windows is the X server's business */
+	return false;
+}
+
 /* ------------------------------------------------------------------ */
 /*  Input                                                             */
 /* ------------------------------------------------------------------ */
@@ -696,6 +959,9 @@ bool backend_register_root_events(void)
 bspwm_wid_t backend_create_presel_feedback(uint32_t color)
 {
 	bspwm_wid_t win = xcb_generate_id(dpy);
+	if (win == (bspwm_wid_t) -1) {
+		return BSPWM_WID_NONE;
+	}
 	uint32_t mask = XCB_CW_BACK_PIXEL | XCB_CW_SAVE_UNDER;
 	uint32_t values[] = {color, 1};
 	xcb_create_window(dpy, XCB_COPY_FROM_PARENT, win, root, 0, 0, 1, 1, 0,
@@ -706,6 +972,12 @@ bspwm_wid_t backend_create_presel_feedback(uint32_t color)
 	return win;
 }
 
+/* The background is painted when the window gets mapped. */
+void backend_set_presel_feedback_color(bspwm_wid_t win, uint32_t color)
+{
+	xcb_change_window_attributes(dpy, win, XCB_CW_BACK_PIXEL, &color);
+}
+
 /* ------------------------------------------------------------------ */
 /*  Atom helpers                                                      */
 /* ------------------------------------------------------------------ */
@@ -797,102 +1069,212 @@ bool x11_try_xinerama(void)
 /*  Keybinding grabs                                                   */
 /* ------------------------------------------------------------------ */
 
+/* Keyboard mapping, fetched on first use and refreshed on MappingNotify */
+static xcb_key_symbols_t *key_symbols;
+static xcb_get_modifier_mapping_reply_t *modifier_mapping;
+
+/* The keys grabbed on the root window, sorted, each through every
+ * combination of grab_lock_masks */
+typedef struct {
+	uint16_t modifiers;
+	xcb_keycode_t keycode;
+} key_grab_t;
+
+typedef struct {
+	key_grab_t *grabs;
+	size_t len;
+	size_t cap;
+} key_grab_set_t;
+
+static key_grab_set_t key_grabs;
+static uint16_t grab_lock_masks[8];
+static size_t grab_lock_masks_len;
+
+xcb_key_symbols_t *x11_key_symbols(void)
+{
+	if (key_symbols == NULL) {
+		key_symbols = xcb_key_symbols_alloc(dpy);
+	}
+	return key_symbols;
+}
+
+xcb_get_modifier_mapping_reply_t *x11_modifier_mapping(void)
+{
+	if (modifier_mapping == NULL) {
+		modifier_mapping = xcb_get_modifier_mapping_reply(dpy, xcb_get_modifier_mapping(dpy), NULL);
+	}
+	return modifier_mapping;
+}
+
+void x11_refresh_keymap(xcb_mapping_notify_event_t *e)
+{
+	if (e->request == XCB_MAPPING_KEYBOARD && key_symbols != NULL) {
+		xcb_refresh_keyboard_mapping(key_symbols, e);
+	} else if (e->request == XCB_MAPPING_MODIFIER) {
+		free(modifier_mapping);
+		modifier_mapping = NULL;
+	}
+}
+
+void x11_free_keymap(void)
+{
+	if (key_symbols != NULL) {
+		xcb_key_symbols_free(key_symbols);
+		key_symbols = NULL;
+	}
+	free(modifier_mapping);
+	modifier_mapping = NULL;
+	free(key_grabs.grabs);
+	key_grabs = (key_grab_set_t) {0};
+}
+
 void backend_ungrab_keys(void)
 {
 	xcb_ungrab_key(dpy, XCB_GRAB_ANY, root, XCB_MOD_MASK_ANY);
+	key_grabs.len = 0;
 }
 
-void backend_grab_keys(void)
+void backend_grab_keyboard(void)
 {
-	backend_ungrab_keys();
+	xcb_discard_reply(dpy, xcb_grab_keyboard(dpy, false, root, XCB_CURRENT_TIME,
+	                  XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC).sequence);
+}
 
-	if (keybind_table.count == 0)
-		return;
+void backend_ungrab_keyboard(void)
+{
+	xcb_ungrab_keyboard(dpy, XCB_CURRENT_TIME);
+}
 
-	/* TODO: cache the modifier mapping (currently fetched twice per call via
-	 * xcb_get_modifier_mapping_reply for Num_Lock and Scroll_Lock lookups)
-	 * and the xcb_key_symbols_t allocation, refreshing only on
-	 * XCB_MAPPING_NOTIFY, similarly to the previous key_symbols caching
-	 * fix. Avoids two server round-trips on every keybind reload. */
-	xcb_key_symbols_t *syms = xcb_key_symbols_alloc(dpy);
-	if (!syms)
-		return;
+static int key_grab_cmp(const void *a, const void *b)
+{
+	const key_grab_t *ga = a, *gb = b;
+	if (ga->keycode != gb->keycode) {
+		return ga->keycode < gb->keycode ? -1 : 1;
+	}
+	return (ga->modifiers > gb->modifiers) - (ga->modifiers < gb->modifiers);
+}
 
-	/* Lock mask combinations to grab through (NumLock, CapsLock, both, neither) */
-	uint16_t num_lock = 0, caps_lock = 0, scroll_lock = 0;
-	{
-		xcb_keycode_t *kc;
-		kc = xcb_key_symbols_get_keycode(syms, XK_Num_Lock);
-		if (kc) {
-			/* Find which modifier Num_Lock is mapped to */
-			xcb_get_modifier_mapping_reply_t *mmr =
-				xcb_get_modifier_mapping_reply(dpy, xcb_get_modifier_mapping(dpy), NULL);
-			if (mmr) {
-				xcb_keycode_t *modmap = xcb_get_modifier_mapping_keycodes(mmr);
-				int kpk = mmr->keycodes_per_modifier;
-				for (int i = 0; i < 8; i++) {
-					for (int j = 0; j < kpk; j++) {
-						if (modmap[i * kpk + j] == *kc)
-							num_lock = (uint16_t)(1 << i);
-					}
-				}
-				free(mmr);
-			}
-			free(kc);
+static bool key_grab_push(key_grab_set_t *set, key_grab_t g)
+{
+	if (set->len == set->cap) {
+		size_t cap = set->cap > 0 ? 2 * set->cap : 64;
+		key_grab_t *grabs = realloc(set->grabs, cap * sizeof(key_grab_t));
+		if (grabs == NULL) {
+			return false;
 		}
-		caps_lock = XCB_MOD_MASK_LOCK;
-		kc = xcb_key_symbols_get_keycode(syms, XK_Scroll_Lock);
-		if (kc) {
-			xcb_get_modifier_mapping_reply_t *mmr =
-				xcb_get_modifier_mapping_reply(dpy, xcb_get_modifier_mapping(dpy), NULL);
-			if (mmr) {
-				xcb_keycode_t *modmap = xcb_get_modifier_mapping_keycodes(mmr);
-				int kpk = mmr->keycodes_per_modifier;
-				for (int i = 0; i < 8; i++) {
-					for (int j = 0; j < kpk; j++) {
-						if (modmap[i * kpk + j] == *kc)
-							scroll_lock = (uint16_t)(1 << i);
-					}
-				}
-				free(mmr);
+		set->grabs = grabs;
+		set->cap = cap;
+	}
+	set->grabs[set->len++] = g;
+	return true;
+}
+
+/* The distinct combinations of the lock modifiers, none included */
+static size_t lock_combinations(uint16_t *masks)
+{
+	uint16_t locks[] = {num_lock, caps_lock, scroll_lock};
+	size_t len = 0;
+	for (unsigned int c = 0; c < 8; c++) {
+		uint16_t mask = 0;
+		for (unsigned int i = 0; i < LENGTH(locks); i++) {
+			if (c & (1 << i)) {
+				mask |= locks[i];
 			}
-			free(kc);
+		}
+		bool seen = false;
+		for (size_t i = 0; i < len && !seen; i++) {
+			seen = masks[i] == mask;
+		}
+		if (!seen) {
+			masks[len++] = mask;
 		}
 	}
+	return len;
+}
 
-	uint16_t lock_masks[] = {
-		0,
-		num_lock,
-		caps_lock,
-		scroll_lock,
-		num_lock | caps_lock,
-		num_lock | scroll_lock,
-		caps_lock | scroll_lock,
-		num_lock | caps_lock | scroll_lock,
-	};
-
-	/* KBMOD_* flags map directly to X11 modifier bits */
-	for (int i = 0; i < keybind_table.count; i++) {
-		keybind_t *kb = &keybind_table.binds[i];
-
-		xcb_keycode_t *keycodes = xcb_key_symbols_get_keycode(syms, kb->keysym);
-		if (!keycodes)
-			continue;
+static void grab_key(key_grab_t g, bool grab)
+{
+	for (size_t m = 0; m < grab_lock_masks_len; m++) {
+		if (grab) {
+			xcb_grab_key(dpy, 1, root, g.modifiers | grab_lock_masks[m],
+			             g.keycode, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+		} else {
+			xcb_ungrab_key(dpy, g.keycode, root, g.modifiers | grab_lock_masks[m]);
+		}
+	}
+}
 
-		uint16_t modfield = (uint16_t)kb->modifiers;
+/* Brings the grabs in line with the keybind table: only the keys that
+ * were bound or unbound since the last call are grabbed or ungrabbed. */
+void backend_grab_keys(void)
+{
+	xcb_key_symbols_t *syms = x11_key_symbols();
+	if (syms == NULL) {
+		return;
+	}
 
-		for (xcb_keycode_t *kc = keycodes; *kc != XCB_NO_SYMBOL; kc++) {
-			for (size_t m = 0; m < sizeof(lock_masks) / sizeof(lock_masks[0]); m++) {
-				xcb_grab_key(dpy, 1, root, modfield | lock_masks[m],
-				             *kc, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+	/* KBMOD_* flags map directly to X11 modifier bits. Only the first key
+	 * of a chord is grabbed, the keyboard is grabbed for the others. */
+	key_grab_set_t wanted = {0};
+	for (size_t i = 0; i < keybind_table.cap; i++) {
+		for (keybind_t *kb = keybind_table.buckets[i]; kb != NULL; kb = kb->next) {
+			xcb_keycode_t *keycodes = xcb_key_symbols_get_keycode(syms, kb->key.keysym);
+			if (keycodes == NULL) {
+				continue;
+			}
+			for (xcb_keycode_t *kc = keycodes; *kc != XCB_NO_SYMBOL; kc++) {
+				if (!key_grab_push(&wanted, (key_grab_t) {(uint16_t) kb->key.modifiers, *kc})) {
+					free(keycodes);
+					free(wanted.grabs);
+					return;
+				}
 			}
+			free(keycodes);
+		}
+	}
+	if (wanted.len > 0) {
+		qsort(wanted.grabs, wanted.len, sizeof(key_grab_t), key_grab_cmp);
+	}
+	size_t len = 0;
+	for (size_t i = 0; i < wanted.len; i++) {
+		if (len == 0 || key_grab_cmp(&wanted.grabs[len - 1], &wanted.grabs[i]) != 0) {
+			wanted.grabs[len++] = wanted.grabs[i];
 		}
+	}
+	wanted.len = len;
+
+	/* Grabs made through other lock masks are all redone */
+	uint16_t masks[8];
+	size_t masks_len = lock_combinations(masks);
+	if (masks_len != grab_lock_masks_len ||
+	    memcmp(masks, grab_lock_masks, masks_len * sizeof(uint16_t)) != 0) {
+		backend_ungrab_keys();
+		memcpy(grab_lock_masks, masks, masks_len * sizeof(uint16_t));
+		grab_lock_masks_len = masks_len;
+	}
 
-		free(keycodes);
+	bool changed = false;
+	size_t i = 0, j = 0;
+	while (i < key_grabs.len || j < wanted.len) {
+		int cmp = i == key_grabs.len ? 1 : j == wanted.len ? -1 :
+		          key_grab_cmp(&key_grabs.grabs[i], &wanted.grabs[j]);
+		if (cmp < 0) {
+			grab_key(key_grabs.grabs[i++], false);
+			changed = true;
+		} else if (cmp > 0) {
+			grab_key(wanted.grabs[j++], true);
+			changed = true;
+		} else {
+			i++, j++;
+		}
 	}
 
-	xcb_key_symbols_free(syms);
-	xcb_flush(dpy);
+	free(key_grabs.grabs);
+	key_grabs = wanted;
+
+	if (changed) {
+		xcb_flush(dpy);
+	}
 }
 
 void x11_setup_ewmh_supported(void)
@@ -49,4 +49,10 @@ void x11_setup_randr(void);
 bool x11_try_xinerama(void);
 void x11_setup_ewmh_supported(void);
 
+/* Keyboard mapping, fetched on first use and refreshed on MappingNotify */
+xcb_key_symbols_t *x11_key_symbols(void);
+xcb_get_modifier_mapping_reply_t *x11_modifier_mapping(void);
+void x11_refresh_keymap(xcb_mapping_notify_event_t *e);
+void x11_free_keymap(void);
+
 #endif
@@ -34,12 +34,20 @@
 #include <limits.h>
 #include <xcb/xcb.h>
 #include <errno.h>
+#include <stdint.h>
+#include <arpa/inet.h>
 #include "helpers.h"
 #include "common.h"
 
 #define MAX_ARGS 1024
 #define MSG_CHUNK_SIZE 4096
 
+static bool send_all(int fd, const char *data, size_t len);
+static bool recv_all(int fd, char *data, size_t len);
+static int run_batch(int sock_fd, FILE *input);
+static bool append_arg(char **msg, size_t *msg_size, size_t *msg_capacity, const char *arg);
+static int print_batch_replies(int sock_fd);
+
 int main(int argc, char *argv[])
 {
 	int sock_fd;
@@ -113,6 +121,12 @@ int main(int argc, char *argv[])
 		err("Failed to connect to the socket.\n");
 	}
 
+	if (streq(argv[1], "--batch")) {
+		int ret = run_batch(sock_fd, stdin);
+		close(sock_fd);
+		return ret;
+	}
+
 	msg = malloc(msg_capacity);
 	if (msg == NULL) {
 		close(sock_fd);
@@ -122,45 +136,53 @@ int main(int argc, char *argv[])
 	argc--, argv++;
 
 	for (int i = 0; i < argc; i++) {
-		size_t arg_len = strlen(argv[i]) + 1;
+		if (!append_arg(&msg, &msg_size, &msg_capacity, argv[i])) {
+			free(msg);
+			close(sock_fd);
+			err("Message too large.\n");
+		}
+	}
 
-		while (msg_size + arg_len > msg_capacity) {
-			size_t new_capacity = msg_capacity * 2;
-			if (new_capacity > INT_MAX) {
-				free(msg);
-				close(sock_fd);
-				err("Message too large.\n");
+	/* A batch without commands reads them from the standard input */
+	bool batch = streq(argv[0], "batch");
+	if (batch && argc == 1) {
+		char *line = NULL;
+		size_t line_cap = 0;
+		ssize_t line_len;
+		while ((line_len = getline(&line, &line_cap, stdin)) != -1) {
+			if (line_len > 0 && line[line_len - 1] == '\n') {
+				line[--line_len] = '\0';
+			}
+			if (line_len == 0 || line[0] == '#') {
+				continue;
 			}
-			char *new_msg = realloc(msg, new_capacity);
-			if (new_msg == NULL) {
+			if (!append_arg(&msg, &msg_size, &msg_capacity, line)) {
+				free(line);
 				free(msg);
-				msg = NULL;
 				close(sock_fd);
-				err("Failed to grow message buffer.\n");
+				err("Message too large.\n");
 			}
-			msg = new_msg;
-			msg_capacity = new_capacity;
 		}
-
-		memcpy(msg + msg_size, argv[i], arg_len - 1);
-		msg[msg_size + arg_len - 1] = '\0';
-		msg_size += arg_len;
+		free(line);
 	}
 
-	ssize_t sent = 0;
-	while (sent < (ssize_t)msg_size) {
-		ssize_t n = send(sock_fd, msg + sent, msg_size - sent, MSG_NOSIGNAL);
-		if (n == -1) {
-			if (errno == EINTR) continue;
-			free(msg);
-			close(sock_fd);
-			err("Failed to send the data.\n");
-		}
-		sent += n;
+	if (!send_all(sock_fd, msg, msg_size)) {
+		free(msg);
+		close(sock_fd);
+		err("Failed to send the data.\n");
 	}
 
 	free(msg);
 
+	/* The end of the stream tells bspwm that the message is complete */
+	shutdown(sock_fd, SHUT_WR);
+
+	if (batch) {
+		int ret = print_batch_replies(sock_fd);
+		close(sock_fd);
+		return ret;
+	}
+
 	int ret = EXIT_SUCCESS, nb;
 
 	struct pollfd fds[] = {
@@ -192,3 +214,199 @@ int main(int argc, char *argv[])
 	close(sock_fd);
 	return ret;
 }
+
+static bool append_arg(char **msg, size_t *msg_size, size_t *msg_capacity, const char *arg)
+{
+	size_t arg_len = strlen(arg) + 1;
+
+	while (*msg_size + arg_len > *msg_capacity) {
+		size_t new_capacity = *msg_capacity * 2;
+		if (new_capacity > INT_MAX) {
+			return false;
+		}
+		char *new_msg = realloc(*msg, new_capacity);
+		if (new_msg == NULL) {
+			return false;
+		}
+		*msg = new_msg;
+		*msg_capacity = new_capacity;
+	}
+
+	memcpy(*msg + *msg_size, arg, arg_len);
+	*msg_size += arg_len;
+	return true;
+}
+
+/* The reply to a batch is one frame per command, or a failure of the
+ * batch itself. */
+static int print_batch_replies(int sock_fd)
+{
+	char *rsp = NULL;
+	size_t rsp_size = 0, rsp_capacity = 0;
+	ssize_t nb;
+
+	do {
+		if (rsp_size == rsp_capacity) {
+			size_t new_capacity = rsp_capacity > 0 ? 2 * rsp_capacity : BUFSIZ;
+			char *new_rsp = realloc(rsp, new_capacity + 1);
+			if (new_rsp == NULL) {
+				free(rsp);
+				err("Failed to grow reply buffer.\n");
+			}
+			rsp = new_rsp;
+			rsp_capacity = new_capacity;
+		}
+		nb = recv(sock_fd, rsp + rsp_size, rsp_capacity - rsp_size, 0);
+		if (nb > 0) {
+			rsp_size += nb;
+		}
+	} while (nb > 0 || (nb == -1 && errno == EINTR));
+
+	int ret = EXIT_SUCCESS;
+	if (rsp_size > 0 && rsp[0] == FAILURE_MESSAGE[0]) {
+		rsp[rsp_size] = '\0';
+		fprintf(stderr, "%s", rsp + 1);
+		free(rsp);
+		return EXIT_FAILURE;
+	}
+
+	size_t pos = 0;
+	while (rsp_size - pos >= FRAME_HEADER_SIZE) {
+		uint32_t be;
+		memcpy(&be, rsp + pos, FRAME_HEADER_SIZE);
+		size_t len = ntohl(be);
+		pos += FRAME_HEADER_SIZE;
+		if (rsp_size - pos < len) {
+			break;
+		}
+		if (len > 0 && rsp[pos] == FAILURE_MESSAGE[0]) {
+			ret = EXIT_FAILURE;
+			fwrite(rsp + pos + 1, 1, len - 1, stderr);
+		} else {
+			fwrite(rsp + pos, 1, len, stdout);
+		}
+		pos += len;
+	}
+	if (pos != rsp_size) {
+		warn("Invalid reply.\n");
+		ret = EXIT_FAILURE;
+	}
+
+	free(rsp);
+	return ret;
+}
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+	size_t sent = 0;
+	while (sent < len) {
+		ssize_t n = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+		if (n == -1) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		sent += n;
+	}
+	return true;
+}
+
+static bool recv_all(int fd, char *data, size_t len)
+{
+	size_t got = 0;
+	while (got < len) {
+		ssize_t n = recv(fd, data + got, len - got, 0);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		got += n;
+	}
+	return true;
+}
+
+/* Read one command per line and send each of them as a frame over a single
+ * connection. Arguments are separated by spaces, a backslash escapes the
+ * next character. */
+static int run_batch(int sock_fd, FILE *input)
+{
+	int ret = EXIT_SUCCESS;
+	char *line = NULL;
+	size_t line_cap = 0;
+	ssize_t line_len;
+	char *msg = malloc(MAX_FRAME_SIZE + FRAME_HEADER_SIZE);
+	char *rsp = malloc(MAX_FRAME_SIZE + 1);
+
+	if (msg == NULL || rsp == NULL) {
+		free(msg);
+		free(rsp);
+		err("Failed to allocate message buffer.\n");
+	}
+
+	if (!send_all(sock_fd, FRAMED_HELLO, sizeof(FRAMED_HELLO))) {
+		free(msg);
+		free(rsp);
+		err("Failed to send the data.\n");
+	}
+
+	while ((line_len = getline(&line, &line_cap, input)) != -1) {
+		if (line_len > 0 && line[line_len - 1] == '\n') {
+			line[--line_len] = '\0';
+		}
+		size_t msg_size = 0;
+		bool overflow = false;
+		struct tokenize_state state;
+		char *tok = tokenize_with_escape(&state, line, ' ');
+		while (tok != NULL) {
+			size_t tok_len = strlen(tok) + 1;
+			if (tok_len > 1) {
+				if (msg_size + tok_len > MAX_FRAME_SIZE) {
+					overflow = true;
+				} else {
+					memcpy(msg + FRAME_HEADER_SIZE + msg_size, tok, tok_len);
+					msg_size += tok_len;
+				}
+			}
+			free(tok);
+			tok = (*state.pos == '\0' || overflow) ? NULL : tokenize_with_escape(&state, NULL, ' ');
+		}
+		if (overflow) {
+			warn("Command too long.\n");
+			ret = EXIT_FAILURE;
+			continue;
+		}
+		if (msg_size == 0 || msg[FRAME_HEADER_SIZE] == '#') {
+			continue;
+		}
+
+		uint32_t be = htonl(msg_size);
+		memcpy(msg, &be, FRAME_HEADER_SIZE);
+		if (!send_all(sock_fd, msg, msg_size + FRAME_HEADER_SIZE) ||
+		    !recv_all(sock_fd, (char *) &be, FRAME_HEADER_SIZE)) {
+			warn("Lost the connection.\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+		size_t rsp_size = ntohl(be);
+		if (rsp_size > MAX_FRAME_SIZE || !recv_all(sock_fd, rsp, rsp_size)) {
+			warn("Invalid reply.\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+		rsp[rsp_size] = '\0';
+		if (rsp_size > 0 && rsp[0] == FAILURE_MESSAGE[0]) {
+			ret = EXIT_FAILURE;
+			fprintf(stderr, "%s", rsp + 1);
+			fflush(stderr);
+		} else {
+			fwrite(rsp, 1, rsp_size, stdout);
+			fflush(stdout);
+		}
+	}
+
+	free(line);
+	free(msg);
+	free(rsp);
+	return ret;
+}
@@ -50,8 +50,11 @@
 #include "ewmh.h"
 #include "rule.h"
 #include "restore.h"
+#include "snapshot.h"
 #include "query.h"
 #include "keybind.h"
+#include "ipc.h"
+#include "pool.h"
 #include "bspwm.h"
 
 #ifdef BACKEND_X11
@@ -80,6 +83,8 @@ subscriber_list_t *subscribe_head;
 subscriber_list_t *subscribe_tail;
 pending_rule_t *pending_rule_head;
 pending_rule_t *pending_rule_tail;
+ipc_client_t *ipc_client_head;
+ipc_client_t *ipc_client_tail;
 
 bspwm_wid_t meta_window;
 motion_recorder_t motion_recorder;
@@ -94,6 +99,24 @@ volatile sig_atomic_t running;
 volatile bool restart;
 bool randr;
 
+/* Milliseconds until the first deadline the event loop has to wake up
+ * for, -1 if there's none. */
+static int next_timeout(void)
+{
+	int timeouts[] = {pending_rules_timeout(), keybind_chord_timeout(), ipc_clients_timeout(),
+#ifdef BACKEND_X11
+	                  configure_requests_timeout(),
+#endif
+	};
+	int timeout = -1;
+	for (size_t i = 0; i < LENGTH(timeouts); i++) {
+		if (timeouts[i] != -1 && (timeout == -1 || timeouts[i] < timeout)) {
+			timeout = timeouts[i];
+		}
+	}
+	return timeout;
+}
+
 int main(int argc, char *argv[])
 {
 	char socket_path[MAXLEN];
@@ -101,9 +124,8 @@ int main(int argc, char *argv[])
 	char state_path[MAXLEN] = {0};
 	int run_level = 0;
 	config_path[0] = '\0';
-	int sock_fd = -1, cli_fd, dpy_fd, n;
+	int sock_fd = -1, cli_fd, dpy_fd;
 	struct sockaddr_un sock_address;
-	char msg[BUFSIZ] = {0};
 	char *end;
 	int opt;
 
@@ -241,37 +263,43 @@ int main(int argc, char *argv[])
 
 	while (running) {
 
+		ewmh_flush_client_lists();
 		backend_flush();
 
-		int nfds = epoll_wait(epoll_fd, ep_events, MAX_EPOLL_EVENTS, -1);
+		int nfds = epoll_wait(epoll_fd, ep_events, MAX_EPOLL_EVENTS, next_timeout());
 		if (nfds == -1) {
 			if (errno == EINTR)
 				continue;
 			break;
 		}
 
+		hold_status();
+
 		for (int i = 0; i < nfds; i++) {
 			int fd = ep_events[i].data.fd;
 
-			/* Check pending rules */
-			bool handled = false;
-			pending_rule_t *pr = pending_rule_head;
-			while (pr != NULL) {
-				pending_rule_t *next = pr->next;
-				if (pr->fd == fd) {
-					if (manage_window(pr->win, pr->csq, pr->fd)) {
-						for (event_queue_t *eq = pr->event_head; eq != NULL; eq = eq->next) {
-							handle_event(eq->data);
-						}
-					}
-					remove_pending_rule(pr);
-					handled = true;
-					break;
-				}
-				pr = next;
+			pending_rule_t *pr = find_pending_rule(fd);
+			if (pr != NULL) {
+				release_pending_rule(pr);
+				continue;
 			}
-			if (handled)
+
+			if (is_rule_daemon_fd(fd)) {
+				read_rule_daemon();
 				continue;
+			}
+
+			ipc_client_t *ic = find_ipc_client(fd);
+			if (ic != NULL) {
+				handle_ipc_client(ic);
+				continue;
+			}
+
+			subscriber_list_t *sb = find_subscriber(fd);
+			if (sb != NULL) {
+				flush_subscriber(sb);
+				continue;
+			}
 
 			if (fd == sock_fd) {
 				cli_fd = accept(sock_fd, NULL, 0);
@@ -285,34 +313,31 @@ int main(int argc, char *argv[])
 					}
 				}
 				if (cli_fd > 0) {
-					n = recv(cli_fd, msg, sizeof(msg)-1, 0);
-					if (n > 0) {
-						msg[n] = '\0';
-						FILE *rsp = fdopen(cli_fd, "w");
-						if (rsp != NULL) {
-							handle_message(msg, n, rsp);
-							scratch_reset();
-						} else {
-							warn("Can't open the client socket as file.\n");
-							close(cli_fd);
-						}
+					ipc_client_t *nic = make_ipc_client(cli_fd);
+					if (nic != NULL) {
+						add_ipc_client(nic);
+						/* The message is usually there already */
+						handle_ipc_client(nic);
 					} else {
 						close(cli_fd);
 					}
 				}
 			} else if (fd == dpy_fd) {
 #ifdef BACKEND_X11
-				xcb_generic_event_t *event;
-				while ((event = xcb_poll_for_event(dpy)) != NULL) {
-					handle_event(event);
-					free(event);
-				}
+				handle_pending_events();
 #else
 				backend_dispatch_events();
 #endif
 			}
 		}
 
+		release_expired_rules(false);
+		release_expired_ipc_clients();
+		keybind_expire_chord();
+#ifdef BACKEND_X11
+		apply_deferred_configures();
+#endif
+
 		if (!backend_check_connection()) {
 			running = false;
 		}
@@ -322,6 +347,8 @@ int main(int argc, char *argv[])
 			prune_counter = 0;
 			prune_dead_subscribers();
 		}
+
+		release_status();
 	}
 
 	if (restart) {
@@ -331,11 +358,21 @@ int main(int argc, char *argv[])
 			snprintf(state_path, sizeof(state_path), STATE_PATH_TPL, host, dn, sn);
 		}
 		free(host);
-		FILE *f = fopen(state_path, "w");
-		query_state(f);
-		fclose(f);
+		if (!write_snapshot(state_path)) {
+			FILE *f = fopen(state_path, "w");
+			if (f != NULL) {
+				json_writer_t jw;
+				json_init(&jw, false);
+				query_state(&jw);
+				json_flush(&jw, f);
+				json_free(&jw);
+				fclose(f);
+			}
+		}
 	}
 
+	/* Leave the windows of hidden desktops unmapped, not parked */
+	set_composited_switching(false);
 	cleanup();
 	scratch_destroy();
 	ungrab_buttons();
@@ -398,6 +435,7 @@ void init(void)
 	stack_head = stack_tail = NULL;
 	subscribe_head = subscribe_tail = NULL;
 	pending_rule_head = pending_rule_tail = NULL;
+	ipc_client_head = ipc_client_tail = NULL;
 	auto_raise = sticky_still = hide_sticky = record_history = true;
 	exit_status = 0;
 	restart = false;
@@ -485,8 +523,14 @@ void cleanup(void)
 	while (pending_rule_head != NULL) {
 		remove_pending_rule(pending_rule_head);
 	}
+	stop_rule_daemon();
+	while (ipc_client_head != NULL) {
+		flush_ipc_client(ipc_client_head);
+		remove_ipc_client(ipc_client_head);
+	}
 
 	empty_history();
+	destroy_pools();
 }
 
 void sig_handler(int sig)
@@ -32,6 +32,7 @@
 #define CONFIG_NAME              WM_NAME "rc"
 #define CONFIG_HOME_ENV          "XDG_CONFIG_HOME"
 #define RUNTIME_DIR_ENV          "XDG_RUNTIME_DIR"
+#define XWAYLAND_ENV_VAR         "BSPWM_XWAYLAND"
 
 #define STATE_PATH_TPL           "/tmp/bspwm%s_%i_%i-state"
 
@@ -66,6 +67,8 @@ extern subscriber_list_t *subscribe_head;
 extern subscriber_list_t *subscribe_tail;
 extern pending_rule_t *pending_rule_head;
 extern pending_rule_t *pending_rule_tail;
+extern ipc_client_t *ipc_client_head;
+extern ipc_client_t *ipc_client_tail;
 
 extern bspwm_wid_t meta_window;
 extern motion_recorder_t motion_recorder;
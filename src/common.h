@@ -30,4 +30,11 @@
 
 #define FAILURE_MESSAGE  "\x07"
 
+/* A connection whose first message is this single argument switches to
+ * framed mode: every request and reply is then prefixed by its length as a
+ * 32-bit big-endian integer, and the connection stays open. */
+#define FRAMED_HELLO       "\x1b" "framed"
+#define FRAME_HEADER_SIZE  4
+#define MAX_FRAME_SIZE     (1024 * 1024)
+
 #endif
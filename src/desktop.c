@@ -36,6 +36,8 @@
 #include "desktop.h"
 #include "subscribe.h"
 #include "settings.h"
+#include "stack.h"
+#include "lookup.h"
 
 static inline void batch_ewmh_update(void)
 {
@@ -140,6 +142,7 @@ bool set_layout(monitor_t *m, desktop_t *d, layout_t l, bool user)
 		d->layout = l;
 
 	if (d->layout != old_layout) {
+		invalidate_layout_in(d->root);
 		handle_presel_feedbacks(m, d);
 		if (user)
 			arrange(m, d);
@@ -182,6 +185,7 @@ bool transfer_desktop(monitor_t *ms, monitor_t *md, desktop_t *d, bool follow)
 	}
 
 	insert_desktop(md, d);
+	window_index_add_in(md, d, d->root);
 	history_remove(d, NULL, false);
 
 	if (d_was_active) {
@@ -206,6 +210,7 @@ bool transfer_desktop(monitor_t *ms, monitor_t *md, desktop_t *d, bool follow)
 	}
 
 	adapt_geometry(&ms->rectangle, &md->rectangle, d->root);
+	invalidate_layout_in(d->root);
 	arrange(md, d);
 
 	if ((!follow || !d_was_active || !ms_was_focused) && md->desk == d) {
@@ -247,7 +252,6 @@ desktop_t *make_desktop(const char *name, uint32_t id)
 	d->padding = (padding_t) PADDING;
 	d->window_gap = window_gap;
 	d->border_width = border_width;
-	d->urgent_count = 0;
 	d->tile_limit_enabled = false;
 	d->max_tiles_per_desktop = 0;
 	return d;
@@ -280,6 +284,7 @@ void insert_desktop(monitor_t *m, desktop_t *d)
 		d->prev = m->desk_tail;
 		m->desk_tail = d;
 	}
+	flag_index_attach(m, d);
 }
 
 void add_desktop(monitor_t *m, desktop_t *d)
@@ -324,6 +329,7 @@ void unlink_desktop(monitor_t *m, desktop_t *d)
 		m->desk_tail = d->prev;
 	if (m->desk == d)
 		m->desk = NULL;
+	flag_index_detach(m, d);
 
 	d->prev = d->next = NULL;
 }
@@ -338,7 +344,7 @@ void remove_desktop(monitor_t *m, desktop_t *d)
 	remove_node(m, d, d->root);
 	unlink_desktop(m, d);
 	history_remove(d, NULL, false);
-	locate_window_cache_clear();
+	spatial_index_free(d);
 	free(d);
 
 	ewmh_update_current_desktop();
@@ -431,10 +437,18 @@ bool swap_desktops(monitor_t *m1, desktop_t *d1, monitor_t *m2, desktop_t *d2, b
 	d2->next = (n1 == d2) ? d1 : n1;
 
 	if (m1 != m2) {
+		window_index_add_in(m2, d1, d1->root);
+		window_index_add_in(m1, d2, d2->root);
+		flag_index_detach(m1, d1);
+		flag_index_detach(m2, d2);
+		flag_index_attach(m2, d1);
+		flag_index_attach(m1, d2);
 		adapt_geometry(&m1->rectangle, &m2->rectangle, d1->root);
 		adapt_geometry(&m2->rectangle, &m1->rectangle, d2->root);
 		history_remove(d1, NULL, false);
 		history_remove(d2, NULL, false);
+		invalidate_layout_in(d1->root);
+		invalidate_layout_in(d2->root);
 		arrange(m1, d2);
 		arrange(m2, d1);
 	}
@@ -442,12 +456,14 @@ bool swap_desktops(monitor_t *m1, desktop_t *d1, monitor_t *m2, desktop_t *d2, b
 	if (d1_stickies) {
 		transfer_sticky_nodes(m1, d1_stickies, m1, d2, d1_stickies->root);
 		unlink_desktop(m1, d1_stickies);
+		spatial_index_free(d1_stickies);
 		free(d1_stickies);
 	}
 
 	if (d2_stickies) {
 		transfer_sticky_nodes(m2, d2_stickies, m2, d1, d2_stickies->root);
 		unlink_desktop(m2, d2_stickies);
+		spatial_index_free(d2_stickies);
 		free(d2_stickies);
 	}
 
@@ -489,8 +505,20 @@ bool swap_desktops(monitor_t *m1, desktop_t *d1, monitor_t *m2, desktop_t *d2, b
 
 void show_desktop(desktop_t *d)
 {
-	if (d)
+	if (d) {
+		if (d->stale_colors) {
+			for (monitor_t *m = mon_head; m; m = m->next) {
+				for (desktop_t *e = m->desk_head; e; e = e->next) {
+					if (e == d) {
+						update_colors_in(d->root, d, m);
+					}
+				}
+			}
+			d->stale_colors = false;
+		}
 		show_node(d, d->root);
+		restack_presel_feedbacks(d);
+	}
 }
 
 void hide_desktop(desktop_t *d)
@@ -499,7 +527,37 @@ void hide_desktop(desktop_t *d)
 		hide_node(d, d->root);
 }
 
+/* The windows of hidden desktops are parked and mapped, unless hidden
+ * themselves, when switching is composited, and unmapped otherwise. */
+void set_composited_switching(bool value)
+{
+	if (value == composited_switching) {
+		return;
+	}
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+				if (n->client == NULL || n->client->shown) {
+					continue;
+				}
+				if (value) {
+					window_park(n->id, true);
+					if (!n->hidden) {
+						window_show(n->id);
+					}
+				} else {
+					if (!n->hidden) {
+						window_hide(n->id);
+					}
+					window_park(n->id, false);
+				}
+			}
+		}
+	}
+	composited_switching = value;
+}
+
 bool is_urgent(desktop_t *d)
 {
-	return d && d->urgent_count > 0;
+	return d && d->flag_count[NODE_FLAG_URGENT] > 0;
 }
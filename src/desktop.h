@@ -44,6 +44,7 @@ void merge_desktops(monitor_t *ms, desktop_t *ds, monitor_t *md, desktop_t *dd);
 bool swap_desktops(monitor_t *m1, desktop_t *d1, monitor_t *m2, desktop_t *d2, bool follow);
 void show_desktop(desktop_t *d);
 void hide_desktop(desktop_t *d);
+void set_composited_switching(bool value);
 bool is_urgent(desktop_t *d);
 
 #endif
@@ -21,6 +21,7 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <limits.h>
 #include <stdbool.h>
 #include "backend_x11.h"
 #include "keybind.h"
@@ -29,42 +30,51 @@
 #include "monitor.h"
 #include "query.h"
 #include "settings.h"
+#include "stats.h"
 #include "subscribe.h"
 #include "tree.h"
 #include "window.h"
 #include "pointer.h"
 #include "rule.h"
 #include "events.h"
+#include "lookup.h"
 
 /* randr_base is set in backend_x11.c */
 
 typedef void (*event_handler_t)(void *);
 static event_handler_t handlers[256] = {0};
+static latency_histogram_t *handler_latency[256] = {0};
 static bool handlers_initialized = false;
 
+#define ADD_HANDLER(type, handler) \
+	handlers[type] = handler; \
+	handler_latency[type] = make_latency_histogram(LATENCY_EVENTS, #handler);
+
 static void init_handlers(void)
 {
 	if (handlers_initialized)
 		return;
 
-	handlers[XCB_MAP_REQUEST] = map_request;
-	handlers[XCB_DESTROY_NOTIFY] = destroy_notify;
-	handlers[XCB_UNMAP_NOTIFY] = unmap_notify;
-	handlers[XCB_CLIENT_MESSAGE] = client_message;
-	handlers[XCB_CONFIGURE_REQUEST] = configure_request;
-	handlers[XCB_CONFIGURE_NOTIFY] = configure_notify;
-	handlers[XCB_PROPERTY_NOTIFY] = property_notify;
-	handlers[XCB_ENTER_NOTIFY] = enter_notify;
-	handlers[XCB_MOTION_NOTIFY] = motion_notify;
-	handlers[XCB_BUTTON_PRESS] = button_press;
-	handlers[XCB_FOCUS_IN] = focus_in;
-	handlers[XCB_KEY_PRESS] = key_press;
-	handlers[XCB_MAPPING_NOTIFY] = mapping_notify;
-	handlers[0] = process_error;
+	ADD_HANDLER(XCB_MAP_REQUEST, map_request)
+	ADD_HANDLER(XCB_DESTROY_NOTIFY, destroy_notify)
+	ADD_HANDLER(XCB_UNMAP_NOTIFY, unmap_notify)
+	ADD_HANDLER(XCB_CLIENT_MESSAGE, client_message)
+	ADD_HANDLER(XCB_CONFIGURE_REQUEST, configure_request)
+	ADD_HANDLER(XCB_CONFIGURE_NOTIFY, configure_notify)
+	ADD_HANDLER(XCB_PROPERTY_NOTIFY, property_notify)
+	ADD_HANDLER(XCB_ENTER_NOTIFY, enter_notify)
+	ADD_HANDLER(XCB_MOTION_NOTIFY, motion_notify)
+	ADD_HANDLER(XCB_BUTTON_PRESS, button_press)
+	ADD_HANDLER(XCB_FOCUS_IN, focus_in)
+	ADD_HANDLER(XCB_KEY_PRESS, key_press)
+	ADD_HANDLER(XCB_MAPPING_NOTIFY, mapping_notify)
+	ADD_HANDLER(0, process_error)
 
 	handlers_initialized = true;
 }
 
+#undef ADD_HANDLER
+
 void handle_event(void *evt)
 {
 	if (!evt)
@@ -75,12 +85,148 @@ void handle_event(void *evt)
 	uint8_t resp_type = ((xcb_generic_event_t *)evt)->response_type & 0x7f;
 	
 	if (handlers[resp_type]) {
+		uint64_t start = latency_now();
 		handlers[resp_type](evt);
+		latency_record(handler_latency[resp_type], start);
 	} else if (randr && resp_type == randr_base + XCB_RANDR_SCREEN_CHANGE_NOTIFY) {
 		update_monitors();
 	}
 }
 
+/* Key under which later events of a burst supersede earlier ones, the
+ * handlers of these events only care about the latest state. */
+typedef struct {
+	uint8_t type;
+	xcb_window_t win;
+	xcb_atom_t atom;
+	xcb_generic_event_t *kept;
+} coalesce_key_t;
+
+static bool coalesce_key(xcb_generic_event_t *evt, coalesce_key_t *key)
+{
+	key->type = evt->response_type & 0x7f;
+	key->atom = XCB_NONE;
+	switch (key->type) {
+		case XCB_MOTION_NOTIFY:
+			key->win = ((xcb_motion_notify_event_t *) evt)->event;
+			return true;
+		case XCB_ENTER_NOTIFY:
+			key->win = ((xcb_enter_notify_event_t *) evt)->event;
+			return true;
+		case XCB_PROPERTY_NOTIFY:
+			key->win = ((xcb_property_notify_event_t *) evt)->window;
+			key->atom = ((xcb_property_notify_event_t *) evt)->atom;
+			return true;
+		case XCB_CONFIGURE_REQUEST:
+			key->win = ((xcb_configure_request_event_t *) evt)->window;
+			return true;
+		default:
+			return false;
+	}
+}
+
+/* Events that can change how the ones around them are handled: nothing
+ * is coalesced across them. */
+static bool is_coalesce_barrier(xcb_generic_event_t *evt)
+{
+	switch (evt->response_type & 0x7f) {
+		case XCB_BUTTON_PRESS:
+		case XCB_BUTTON_RELEASE:
+		case XCB_KEY_PRESS:
+		case XCB_KEY_RELEASE:
+		case XCB_MAP_REQUEST:
+		case XCB_UNMAP_NOTIFY:
+		case XCB_DESTROY_NOTIFY:
+		case XCB_CLIENT_MESSAGE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/* Fold the fields of an earlier configure request that the later one
+ * doesn't set into the later one. */
+static void merge_configure_request(xcb_configure_request_event_t *dst, xcb_configure_request_event_t *src)
+{
+	uint16_t missing = src->value_mask & ~dst->value_mask;
+	if (missing & XCB_CONFIG_WINDOW_X)
+		dst->x = src->x;
+	if (missing & XCB_CONFIG_WINDOW_Y)
+		dst->y = src->y;
+	if (missing & XCB_CONFIG_WINDOW_WIDTH)
+		dst->width = src->width;
+	if (missing & XCB_CONFIG_WINDOW_HEIGHT)
+		dst->height = src->height;
+	if (missing & XCB_CONFIG_WINDOW_BORDER_WIDTH)
+		dst->border_width = src->border_width;
+	if (missing & XCB_CONFIG_WINDOW_SIBLING)
+		dst->sibling = src->sibling;
+	if (missing & XCB_CONFIG_WINDOW_STACK_MODE)
+		dst->stack_mode = src->stack_mode;
+	dst->value_mask |= missing;
+}
+
+/* Walk the batch backwards, drop every event superseded by a later one
+ * with the same key. */
+static void coalesce_events(xcb_generic_event_t **batch, size_t len)
+{
+	coalesce_key_t seen[MAX_EVENT_BATCH];
+	size_t seen_len = 0;
+
+	for (size_t i = len; i-- > 0;) {
+		xcb_generic_event_t *evt = batch[i];
+		coalesce_key_t key;
+		if (is_coalesce_barrier(evt)) {
+			seen_len = 0;
+			continue;
+		}
+		if (!coalesce_key(evt, &key)) {
+			continue;
+		}
+		size_t j;
+		for (j = 0; j < seen_len; j++) {
+			if (seen[j].type == key.type && seen[j].win == key.win && seen[j].atom == key.atom) {
+				break;
+			}
+		}
+		if (j < seen_len) {
+			if (key.type == XCB_CONFIGURE_REQUEST) {
+				merge_configure_request((xcb_configure_request_event_t *) seen[j].kept,
+				                        (xcb_configure_request_event_t *) evt);
+			}
+			free(evt);
+			batch[i] = NULL;
+		} else {
+			key.kept = evt;
+			seen[seen_len++] = key;
+		}
+	}
+}
+
+/* Handle the events in batches until none is left: the events queued by
+ * xcb while a handler waited on a reply are already off the socket, and
+ * epoll would not report them. */
+void handle_pending_events(void)
+{
+	xcb_generic_event_t *batch[MAX_EVENT_BATCH];
+	size_t len;
+
+	do {
+		len = 0;
+		xcb_generic_event_t *evt;
+		while (len < MAX_EVENT_BATCH && (evt = xcb_poll_for_event(dpy)) != NULL) {
+			batch[len++] = evt;
+		}
+		coalesce_events(batch, len);
+		for (size_t i = 0; i < len; i++) {
+			if (batch[i] != NULL) {
+				handle_event(batch[i]);
+				free(batch[i]);
+			}
+		}
+	} while (len > 0);
+}
+
 void map_request(void *evt)
 {
 	if (!evt)
@@ -90,6 +236,127 @@ void map_request(void *evt)
 	schedule_window(e->window);
 }
 
+/* Floating windows whose last configure request waits for a frame */
+typedef struct {
+	xcb_window_t win;
+	uint64_t due;
+} deferred_configure_t;
+
+static deferred_configure_t *deferred_configures = NULL;
+static size_t deferred_configures_len = 0;
+static size_t deferred_configures_cap = 0;
+
+/* Move a floating client to its requested rectangle. */
+static void apply_floating_configure(coordinates_t *loc)
+{
+	client_t *c = loc->node->client;
+	bspwm_rect_t r = c->floating_rectangle;
+
+	if (c->border_width <= (unsigned)(INT16_MAX - r.x))
+		r.x -= c->border_width;
+	if (c->border_width <= (unsigned)(INT16_MAX - r.y))
+		r.y -= c->border_width;
+
+	window_move_resize(loc->node->id, r.x, r.y, r.width, r.height);
+
+	if (loc->monitor && loc->desktop) {
+		put_status(SBSC_MASK_NODE_GEOMETRY, "node_geometry 0x%08X 0x%08X 0x%08X %ux%u+%i+%i\n",
+		          loc->monitor->id, loc->desktop->id, loc->node->id, r.width, r.height, r.x, r.y);
+
+		monitor_t *m = monitor_from_client(c);
+		if (m && m != loc->monitor) {
+			transfer_node(loc->monitor, loc->desktop, loc->node, m, m->desk, 
+			             m->desk ? m->desk->focus : NULL, false);
+		}
+	}
+}
+
+/* Count the configure requests of c and, past configure_rate_limit per
+ * second, hold them back to one per frame of m: returns true if the
+ * request, already stored in the floating rectangle, must not be applied
+ * now. A held back request is applied by apply_deferred_configures(). */
+static bool throttle_configure(client_t *c, monitor_t *m, xcb_window_t win)
+{
+	uint64_t now = get_time_ms();
+
+	if (now - c->configure_period >= 1000) {
+		c->configure_period = now;
+		c->configure_count = 0;
+	}
+	if (c->configure_count < UINT16_MAX)
+		c->configure_count++;
+
+	if (configure_rate_limit == 0 || c->configure_count <= configure_rate_limit) {
+		c->configure_applied = now;
+		return false;
+	}
+	if (c->configure_deferred)
+		return true;
+
+	uint32_t refresh = (m && m->refresh > 0) ? m->refresh : 60000;
+	uint64_t due = c->configure_applied + MAX(1000000 / refresh, 1);
+	if (now >= due) {
+		c->configure_applied = now;
+		return false;
+	}
+
+	if (deferred_configures_len == deferred_configures_cap) {
+		size_t cap = deferred_configures_cap ? deferred_configures_cap * 2 : 8;
+		deferred_configure_t *a = safe_realloc_array(deferred_configures, cap, sizeof(deferred_configure_t));
+		if (a == NULL) {
+			c->configure_applied = now;
+			return false;
+		}
+		deferred_configures = a;
+		deferred_configures_cap = cap;
+	}
+	deferred_configures[deferred_configures_len++] = (deferred_configure_t) {win, due};
+	c->configure_deferred = true;
+	return true;
+}
+
+int configure_requests_timeout(void)
+{
+	uint64_t now = get_time_ms();
+	int timeout = -1;
+	for (size_t i = 0; i < deferred_configures_len; i++) {
+		uint64_t due = deferred_configures[i].due;
+		int left = due > now ? (int) MIN(due - now, (uint64_t) INT_MAX) : 0;
+		if (timeout == -1 || left < timeout) {
+			timeout = left;
+		}
+	}
+	return timeout;
+}
+
+/* Apply the held back configure requests whose frame has come. */
+void apply_deferred_configures(void)
+{
+	uint64_t now = get_time_ms();
+	size_t i = 0;
+	while (i < deferred_configures_len) {
+		deferred_configure_t dc = deferred_configures[i];
+		if (dc.due > now) {
+			i++;
+			continue;
+		}
+		deferred_configures[i] = deferred_configures[--deferred_configures_len];
+		coordinates_t loc;
+		if (!locate_window(dc.win, &loc) || loc.node->client == NULL) {
+			continue;
+		}
+		client_t *c = loc.node->client;
+		if (!c->configure_deferred) {
+			continue;
+		}
+		c->configure_deferred = false;
+		c->configure_applied = now;
+		if (IS_FLOATING(c)) {
+			apply_floating_configure(&loc);
+		}
+	}
+}
+
 void configure_request(void *evt)
 {
 	if (!evt)
@@ -139,25 +406,9 @@ void configure_request(void *evt)
 		apply_size_hints(c, &width, &height);
 		c->floating_rectangle.width = width;
 		c->floating_rectangle.height = height;
-		bspwm_rect_t r = c->floating_rectangle;
-
-		if (c->border_width <= (unsigned)(INT16_MAX - r.x))
-			r.x -= c->border_width;
-		if (c->border_width <= (unsigned)(INT16_MAX - r.y))
-			r.y -= c->border_width;
 
-		window_move_resize(e->window, r.x, r.y, r.width, r.height);
-
-		if (loc.monitor && loc.desktop) {
-			put_status(SBSC_MASK_NODE_GEOMETRY, "node_geometry 0x%08X 0x%08X 0x%08X %ux%u+%i+%i\n",
-			          loc.monitor->id, loc.desktop->id, e->window, r.width, r.height, r.x, r.y);
-
-			monitor_t *m = monitor_from_client(c);
-			if (m && m != loc.monitor) {
-				transfer_node(loc.monitor, loc.desktop, loc.node, m, m->desk, 
-				             m->desk ? m->desk->focus : NULL, false);
-			}
-		}
+		if (!throttle_configure(c, loc.monitor, e->window))
+			apply_floating_configure(&loc);
 	} else if (c) {
 		if (c->state == STATE_PSEUDO_TILED) {
 			width = c->floating_rectangle.width;
@@ -170,6 +421,7 @@ void configure_request(void *evt)
 			if (width != c->floating_rectangle.width || height != c->floating_rectangle.height) {
 				c->floating_rectangle.width = width;
 				c->floating_rectangle.height = height;
+				mark_layout_dirty(loc.node);
 				if (loc.monitor && loc.desktop)
 					arrange(loc.monitor, loc.desktop);
 			}
@@ -193,6 +445,9 @@ void configure_notify(void *evt)
 	if (e->window == root) {
 		screen_width = e->width;
 		screen_height = e->height;
+	} else if (!sent_geometry_parked(e->window)) {
+		/* The position of a parked window isn't its geometry */
+		client_geometry_observed(e->window, (bspwm_rect_t) {e->x, e->y, e->width, e->height}, e->sequence);
 	}
 }
 
@@ -239,10 +494,19 @@ void property_notify(void *evt)
 		}
 	}
 
+	coordinates_t loc;
+
+	/* Titles change all the time and only rules read them, at manage
+	 * time: drop the stale one instead of fetching the new one */
+	if (e->atom == XCB_ATOM_WM_NAME || e->atom == ewmh->_NET_WM_NAME) {
+		if (locate_window(e->window, &loc) && loc.node && loc.node->client)
+			set_client_name(loc.node->client, NULL);
+		return;
+	}
+
 	if (e->atom != XCB_ATOM_WM_HINTS && e->atom != XCB_ATOM_WM_NORMAL_HINTS)
 		return;
 
-	coordinates_t loc;
 	if (!locate_window(e->window, &loc)) {
 		for (pending_rule_t *pr = pending_rule_head; pr; pr = pr->next) {
 			if (pr->win == e->window) {
@@ -262,6 +526,7 @@ void property_notify(void *evt)
 	} else if (e->atom == XCB_ATOM_WM_NORMAL_HINTS) {
 		client_t *c = loc.node->client;
 		if (backend_get_size_hints(e->window, &c->size_hints)) {
+			mark_layout_dirty(loc.node);
 			if (loc.monitor && loc.desktop)
 				arrange(loc.monitor, loc.desktop);
 		}
@@ -566,11 +831,9 @@ void handle_state(monitor_t *m, desktop_t *d, node_t *n, uint32_t state, unsigne
 #undef HANDLE_WM_STATE
 }
 
-static xcb_key_symbols_t *cached_key_symbols = NULL;
-
 void mapping_notify(void *evt)
 {
-	if (!evt || mapping_events_count == 0)
+	if (!evt)
 		return;
 
 	xcb_mapping_notify_event_t *e = (xcb_mapping_notify_event_t *) evt;
@@ -578,14 +841,17 @@ void mapping_notify(void *evt)
 	if (e->request == XCB_MAPPING_POINTER)
 		return;
 
+	/* The cached mapping follows every change, the grabs only as many
+	 * as mapping_events_count allows */
+	x11_refresh_keymap(e);
+
+	if (mapping_events_count == 0)
+		return;
+
 	if (mapping_events_count > 0)
 		mapping_events_count--;
 
-	if (cached_key_symbols != NULL) {
-		xcb_key_symbols_free(cached_key_symbols);
-		cached_key_symbols = NULL;
-	}
-
+	update_lock_fields();
 	ungrab_buttons();
 	grab_buttons();
 	backend_grab_keys();
@@ -597,23 +863,21 @@ void key_press(void *evt)
 		return;
 
 	xcb_key_press_event_t *e = (xcb_key_press_event_t *)evt;
+	xcb_key_symbols_t *syms = x11_key_symbols();
 
-	if (cached_key_symbols == NULL) {
-		cached_key_symbols = xcb_key_symbols_alloc(dpy);
-		if (!cached_key_symbols)
-			return;
-	}
+	if (!syms)
+		return;
 
-	xcb_keysym_t keysym = xcb_key_symbols_get_keysym(cached_key_symbols, e->detail, 0);
+	xcb_keysym_t keysym = xcb_key_symbols_get_keysym(syms, e->detail, 0);
 
 	/* Strip lock-key modifiers to match our KBMOD_* flags */
 	uint32_t modifiers = e->state & (BSP_MOD_MASK_SHIFT | BSP_MOD_MASK_CONTROL |
 	                                  BSP_MOD_MASK_1 | BSP_MOD_MASK_2 |
 	                                  BSP_MOD_MASK_3 | BSP_MOD_MASK_4 | BSP_MOD_MASK_5);
 
-	const char *cmd = keybind_match(modifiers, keysym);
-	if (cmd) {
-		keybind_exec(cmd);
+	const keybind_t *kb = keybind_match(modifiers, keysym);
+	if (kb) {
+		keybind_exec(kb);
 	}
 }
 
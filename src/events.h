@@ -29,6 +29,9 @@
 
 #define ERROR_CODE_BAD_WINDOW  3
 
+/* Events read off the connection before coalescing and dispatch */
+#define MAX_EVENT_BATCH  256
+
 extern uint8_t randr_base;
 
 /* Button list — values from backend.h */
@@ -38,8 +41,11 @@ static const uint8_t BUTTONS[] = {BSP_BUTTON_1, BSP_BUTTON_2, BSP_BUTTON_3};
  * from its event loop; the wlroots backend calls them from
  * its signal handlers. */
 void handle_event(void *evt);
+void handle_pending_events(void);
 void map_request(void *evt);
 void configure_request(void *evt);
+int configure_requests_timeout(void);
+void apply_deferred_configures(void);
 void configure_notify(void *evt);
 void destroy_notify(void *evt);
 void unmap_notify(void *evt);
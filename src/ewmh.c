@@ -35,6 +35,30 @@
 
 /* ewmh is defined in backend_x11.c */
 
+/* While positive, the root window properties are only marked: see
+ * hold_ewmh. */
+static unsigned int ewmh_hold_depth;
+static unsigned int ewmh_held;
+
+enum {
+	HELD_ACTIVE_WINDOW = 1 << 0,
+	HELD_NUMBER_OF_DESKTOPS = 1 << 1,
+	HELD_CURRENT_DESKTOP = 1 << 2,
+	HELD_WM_DESKTOPS = 1 << 3,
+	HELD_DESKTOP_NAMES = 1 << 4,
+	HELD_DESKTOP_VIEWPORT = 1 << 5,
+	HELD_CLIENT_LIST = 1 << 6,
+	HELD_CLIENT_LIST_STACKING = 1 << 7,
+};
+
+#define HOLD_UPDATE(bit) \
+	do { \
+		if (ewmh_hold_depth > 0) { \
+			ewmh_held |= (bit); \
+			return; \
+		} \
+	} while (0)
+
 void ewmh_init(void)
 {
 	backend_ewmh_init();
@@ -42,12 +66,14 @@ void ewmh_init(void)
 
 void ewmh_update_active_window(void)
 {
+	HOLD_UPDATE(HELD_ACTIVE_WINDOW);
 	xcb_window_t win = ((mon->desk->focus == NULL || mon->desk->focus->client == NULL) ? XCB_NONE : mon->desk->focus->id);
 	xcb_ewmh_set_active_window(ewmh, default_screen, win);
 }
 
 void ewmh_update_number_of_desktops(void)
 {
+	HOLD_UPDATE(HELD_NUMBER_OF_DESKTOPS);
 	uint32_t desktops_count = 0;
 
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
@@ -89,6 +115,7 @@ bool ewmh_locate_desktop(uint32_t i, coordinates_t *loc)
 
 void ewmh_update_current_desktop(void)
 {
+	HOLD_UPDATE(HELD_CURRENT_DESKTOP);
 	if (mon == NULL) {
 		return;
 	}
@@ -96,6 +123,46 @@ void ewmh_update_current_desktop(void)
 	xcb_ewmh_set_current_desktop(ewmh, default_screen, i);
 }
 
+void hold_ewmh(void)
+{
+	ewmh_hold_depth++;
+}
+
+void release_ewmh(void)
+{
+	if (ewmh_hold_depth > 1) {
+		ewmh_hold_depth--;
+		return;
+	}
+	ewmh_hold_depth = 0;
+	unsigned int held = ewmh_held;
+	ewmh_held = 0;
+	if (held & HELD_NUMBER_OF_DESKTOPS) {
+		ewmh_update_number_of_desktops();
+	}
+	if (held & HELD_WM_DESKTOPS) {
+		ewmh_update_wm_desktops();
+	}
+	if (held & HELD_DESKTOP_NAMES) {
+		ewmh_update_desktop_names();
+	}
+	if (held & HELD_DESKTOP_VIEWPORT) {
+		ewmh_update_desktop_viewport();
+	}
+	if (held & HELD_CURRENT_DESKTOP) {
+		ewmh_update_current_desktop();
+	}
+	if (held & HELD_ACTIVE_WINDOW) {
+		ewmh_update_active_window();
+	}
+	if (held & HELD_CLIENT_LIST) {
+		ewmh_update_client_list(false);
+	}
+	if (held & HELD_CLIENT_LIST_STACKING) {
+		ewmh_update_client_list(true);
+	}
+}
+
 void ewmh_set_wm_desktop(node_t *n, desktop_t *d)
 {
 	uint32_t i = ewmh_get_desktop_index(d);
@@ -109,6 +176,7 @@ void ewmh_set_wm_desktop(node_t *n, desktop_t *d)
 
 void ewmh_update_wm_desktops(void)
 {
+	HOLD_UPDATE(HELD_WM_DESKTOPS);
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
 		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
 			uint32_t i = ewmh_get_desktop_index(d);
@@ -124,6 +192,7 @@ void ewmh_update_wm_desktops(void)
 
 void ewmh_update_desktop_names(void)
 {
+	HOLD_UPDATE(HELD_DESKTOP_NAMES);
 	char *names = NULL;
 	size_t names_size = 0;
 	size_t names_capacity = MAXLEN;
@@ -177,6 +246,7 @@ void ewmh_update_desktop_names(void)
 
 void ewmh_update_desktop_viewport(void)
 {
+	HOLD_UPDATE(HELD_DESKTOP_VIEWPORT);
 	uint32_t desktops_count = 0;
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
 		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
@@ -261,76 +331,127 @@ bool ewmh_handle_struts(xcb_window_t win)
 	return changed;
 }
 
-void ewmh_update_client_list(bool stacking)
+/* Mirrors of _NET_CLIENT_LIST (in mapping order) and of the last
+ * published _NET_CLIENT_LIST_STACKING. The properties are rewritten by
+ * ewmh_flush_client_lists(), at most once per main loop iteration. */
+typedef struct {
+	xcb_window_t *wins;
+	uint32_t count;
+	uint32_t cap;
+} window_list_t;
+
+static window_list_t client_list;
+static window_list_t stacking_mirror;
+static window_list_t stacking_next;
+static bool client_list_dirty = true;
+static bool stacking_list_dirty = true;
+static bool stacking_list_published;
+
+static bool window_list_reserve(window_list_t *l, uint32_t count)
 {
-	if (clients_count == 0) {
-		xcb_ewmh_set_client_list(ewmh, default_screen, 0, NULL);
-		xcb_ewmh_set_client_list_stacking(ewmh, default_screen, 0, NULL);
-		return;
+	if (count <= l->cap) {
+		return true;
 	}
-
-	xcb_window_t *wins = calloc(clients_count, sizeof(xcb_window_t));
+	size_t cap = l->cap > 0 ? l->cap : 64;
+	while (cap < count) {
+		if (!safe_double(&cap) || cap > UINT32_MAX) {
+			return false;
+		}
+	}
+	xcb_window_t *wins = safe_realloc_array(l->wins, cap, sizeof(xcb_window_t));
 	if (wins == NULL) {
+		return false;
+	}
+	l->wins = wins;
+	l->cap = cap;
+	return true;
+}
+
+void ewmh_client_list_add(bspwm_wid_t win)
+{
+	if (!window_list_reserve(&client_list, client_list.count + 1)) {
 		return;
 	}
+	client_list.wins[client_list.count++] = win;
+	client_list_dirty = true;
+}
 
-	unsigned int i = 0;
+void ewmh_client_list_remove(bspwm_wid_t win)
+{
+	for (uint32_t i = client_list.count; i > 0; i--) {
+		if (client_list.wins[i - 1] == win) {
+			memmove(client_list.wins + i - 1, client_list.wins + i,
+			        (client_list.count - i) * sizeof(xcb_window_t));
+			client_list.count--;
+			client_list_dirty = true;
+			return;
+		}
+	}
+}
 
+void ewmh_update_client_list(bool stacking)
+{
+	HOLD_UPDATE(stacking ? HELD_CLIENT_LIST_STACKING : HELD_CLIENT_LIST);
 	if (stacking) {
-		for (stacking_list_t *s = stack_head; s != NULL; s = s->next) {
-			wins[i++] = s->node->id;
-		}
-		xcb_ewmh_set_client_list_stacking(ewmh, default_screen, i, wins);
+		stacking_list_dirty = true;
 	} else {
-		for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-			for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-				for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
-					if (n->client == NULL) {
-						continue;
-					}
-					wins[i++] = n->id;
+		client_list_dirty = true;
+	}
+}
+
+void ewmh_update_client_lists(void)
+{
+	client_list.count = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+				if (n->client == NULL ||
+				    !window_list_reserve(&client_list, client_list.count + 1)) {
+					continue;
 				}
+				client_list.wins[client_list.count++] = n->id;
 			}
 		}
-		xcb_ewmh_set_client_list(ewmh, default_screen, i, wins);
 	}
-
-	free(wins);
+	client_list_dirty = stacking_list_dirty = true;
 }
 
-void ewmh_update_client_lists(void)
+void ewmh_flush_client_lists(void)
 {
-	if (clients_count == 0) {
-		xcb_ewmh_set_client_list(ewmh, default_screen, 0, NULL);
-		xcb_ewmh_set_client_list_stacking(ewmh, default_screen, 0, NULL);
+	if (ewmh_hold_depth > 0) {
 		return;
 	}
 
-	xcb_window_t *wins = calloc(clients_count, sizeof(xcb_window_t));
-	if (wins == NULL) {
+	if (client_list_dirty) {
+		xcb_ewmh_set_client_list(ewmh, default_screen, client_list.count, client_list.wins);
+		client_list_dirty = false;
+	}
+
+	if (!stacking_list_dirty) {
 		return;
 	}
+	stacking_list_dirty = false;
 
-	unsigned int i = 0;
-	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
-				if (n->client == NULL) {
-					continue;
-				}
-				wins[i++] = n->id;
-			}
+	stacking_next.count = 0;
+	for (stacking_list_t *s = stack_head; s != NULL; s = s->next) {
+		if (!window_list_reserve(&stacking_next, stacking_next.count + 1)) {
+			return;
 		}
+		stacking_next.wins[stacking_next.count++] = s->node->id;
 	}
-	xcb_ewmh_set_client_list(ewmh, default_screen, i, wins);
 
-	i = 0;
-	for (stacking_list_t *s = stack_head; s != NULL; s = s->next) {
-		wins[i++] = s->node->id;
+	/* restacking often leaves the order unchanged: spare the pagers */
+	if (stacking_list_published && stacking_next.count == stacking_mirror.count &&
+	    (stacking_next.count == 0 ||
+	     memcmp(stacking_next.wins, stacking_mirror.wins, stacking_next.count * sizeof(xcb_window_t)) == 0)) {
+		return;
 	}
-	xcb_ewmh_set_client_list_stacking(ewmh, default_screen, i, wins);
 
-	free(wins);
+	xcb_ewmh_set_client_list_stacking(ewmh, default_screen, stacking_next.count, stacking_next.wins);
+	window_list_t tmp = stacking_mirror;
+	stacking_mirror = stacking_next;
+	stacking_next = tmp;
+	stacking_list_published = true;
 }
 
 void ewmh_wm_state_update(node_t *n)
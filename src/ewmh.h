@@ -37,9 +37,16 @@ void ewmh_set_wm_desktop(node_t *n, desktop_t *d);
 void ewmh_update_wm_desktops(void);
 void ewmh_update_desktop_names(void);
 void ewmh_update_desktop_viewport(void);
+/* Between hold_ewmh and release_ewmh, the root window properties are
+ * updated once, when released. */
+void hold_ewmh(void);
+void release_ewmh(void);
 bool ewmh_handle_struts(bspwm_wid_t win);
 void ewmh_update_client_list(bool stacking);
 void ewmh_update_client_lists(void);
+void ewmh_client_list_add(bspwm_wid_t win);
+void ewmh_client_list_remove(bspwm_wid_t win);
+void ewmh_flush_client_lists(void);
 void ewmh_wm_state_update(node_t *n);
 void ewmh_set_supporting(bspwm_wid_t win);
 
@@ -31,6 +31,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <inttypes.h>
+#include <time.h>
 #include "bspwm.h"
 
 /* Mark as cold - rarely executed, improves instruction cache (nomt-style) */
@@ -241,6 +243,83 @@ int vasprintf(char **buf, const char *fmt, va_list args)
 	return size;
 }
 
+/* Milliseconds on the monotonic clock */
+uint64_t get_time_ms(void)
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		return 0;
+	}
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint32_t name_hash(const char *s, size_t len, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (size_t i = 0; i < len; i++) {
+		h = (h ^ (unsigned char) s[i]) * 16777619u;
+	}
+	/* Spread the seed over the low bits the slot is taken from */
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	return h;
+}
+
+static bool name_table_build(name_table_t *t)
+{
+	if (t->count > UINT8_MAX) {
+		return false;
+	}
+	for (uint32_t seed = 1; seed < (1 << 16); seed++) {
+		memset(t->slots, 0, sizeof(t->slots));
+		size_t i;
+		for (i = 0; i < t->count; i++) {
+			if (t->names[i] == NULL) {
+				continue;
+			}
+			uint8_t *slot = &t->slots[name_hash(t->names[i], strlen(t->names[i]), seed) & (NAME_TABLE_SLOTS - 1)];
+			if (*slot != 0) {
+				break;
+			}
+			*slot = i + 1;
+		}
+		if (i == t->count) {
+			t->seed = seed;
+			return true;
+		}
+	}
+	return false;
+}
+
+int name_table_lookup(name_table_t *t, const char *name)
+{
+	return name_table_lookup_len(t, name, strlen(name));
+}
+
+static bool name_eq(const char *s, const char *name, size_t len)
+{
+	return strncmp(s, name, len) == 0 && s[len] == '\0';
+}
+
+int name_table_lookup_len(name_table_t *t, const char *name, size_t len)
+{
+	if (!t->ready) {
+		t->perfect = name_table_build(t);
+		t->ready = true;
+	}
+	if (!t->perfect) {
+		for (size_t i = 0; i < t->count; i++) {
+			if (t->names[i] != NULL && name_eq(t->names[i], name, len)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+	uint8_t slot = t->slots[name_hash(name, len, t->seed) & (NAME_TABLE_SLOTS - 1)];
+	return (slot != 0 && name_eq(t->names[slot - 1], name, len)) ? slot - 1 : -1;
+}
+
 bool is_hex_color(const char *color)
 {
 	if (color[0] != '#' || strlen(color) != 7) {
@@ -255,53 +334,161 @@ bool is_hex_color(const char *color)
 }
 
 /*
- * Scratch arena implementation - simple bump allocator.
- * All allocations are 8-byte aligned for safety.
+ * Scratch arena implementation - chained bump allocator.
+ * All allocations are aligned for any object type.
  */
+#define SCRATCH_ALIGN  _Alignof(max_align_t)
+
 static scratch_arena_t scratch = {0};
 
-void scratch_init(void)
+static scratch_chunk_t *make_scratch_chunk(size_t size)
+{
+	scratch_chunk_t *c = malloc(sizeof(scratch_chunk_t) + size);
+	if (c == NULL) {
+		return NULL;
+	}
+	c->next = NULL;
+	c->size = size;
+	c->used = 0;
+	scratch.chunk_count++;
+	return c;
+}
+
+static void free_scratch_chunks_after(scratch_chunk_t *c)
 {
-	if (scratch.base != NULL) return;
-	scratch.base = malloc(SCRATCH_ARENA_SIZE);
-	if (scratch.base) {
-		scratch.capacity = SCRATCH_ARENA_SIZE;
-		scratch.offset = 0;
+	scratch_chunk_t *n = c->next;
+	c->next = NULL;
+	while (n != NULL) {
+		scratch_chunk_t *next = n->next;
+		free(n);
+		scratch.chunk_count--;
+		n = next;
 	}
 }
 
+void scratch_init(void)
+{
+	if (scratch.head != NULL) return;
+	scratch.head = scratch.current = make_scratch_chunk(SCRATCH_CHUNK_SIZE);
+	scratch.used = scratch.peak = 0;
+}
+
 void scratch_destroy(void)
 {
-	free(scratch.base);
-	scratch.base = NULL;
-	scratch.capacity = 0;
-	scratch.offset = 0;
+	if (scratch.head == NULL) return;
+	free_scratch_chunks_after(scratch.head);
+	free(scratch.head);
+	scratch = (scratch_arena_t) {0};
 }
 
 void scratch_reset(void)
 {
-	scratch.offset = 0;
+	if (scratch.head == NULL) return;
+	free_scratch_chunks_after(scratch.head);
+	scratch.head->used = 0;
+	scratch.current = scratch.head;
+	scratch.used = scratch.peak = 0;
 }
 
 void *scratch_alloc(size_t size)
 {
-	if (!scratch.base || size == 0) return NULL;
-
-	/* 8-byte alignment */
-	size_t aligned = (size + 7) & ~(size_t)7;
+	if (size == 0 || size > SIZE_MAX - SCRATCH_ALIGN) return NULL;
+	if (scratch.head == NULL) {
+		scratch_init();
+		if (scratch.head == NULL) return NULL;
+	}
 
-	if (scratch.offset + aligned > scratch.capacity) {
-		/* Arena exhausted - return NULL, don't malloc (would leak) */
-		warn("Scratch arena exhausted (%zu/%zu), returning NULL\n",
-		     scratch.offset, scratch.capacity);
-		return NULL;
+	size_t aligned = (size + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1);
+	scratch_chunk_t *c = scratch.current;
+
+	/* The current chunk is always the last one: the chunks after a mark
+	 * are freed when it is released. */
+	if (aligned > c->size - c->used) {
+		size_t chunk_size = MAX(aligned, (size_t) SCRATCH_CHUNK_SIZE);
+		scratch_chunk_t *n = make_scratch_chunk(chunk_size);
+		if (n == NULL) {
+			warn("Scratch arena: can't grow by %zu bytes.\n", chunk_size);
+			return NULL;
+		}
+		c->next = n;
+		scratch.current = c = n;
+		scratch.grows++;
 	}
 
-	void *ptr = scratch.base + scratch.offset;
-	scratch.offset += aligned;
+	void *ptr = (char *) c->data + c->used;
+	c->used += aligned;
+	scratch.used += aligned;
+	if (scratch.used > scratch.peak) {
+		scratch.peak = scratch.used;
+	}
+	if (scratch.used > scratch.max_peak) {
+		scratch.max_peak = scratch.used;
+	}
 	return ptr;
 }
 
+char *scratch_printf(const char *fmt, ...)
+{
+	va_list ap, aq;
+	va_start(ap, fmt);
+	va_copy(aq, ap);
+	int len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	char *buf = len < 0 ? NULL : scratch_alloc((size_t) len + 1);
+	if (buf != NULL) {
+		vsnprintf(buf, (size_t) len + 1, fmt, aq);
+	}
+	va_end(aq);
+	return buf;
+}
+
+scratch_mark_t scratch_mark(void)
+{
+	scratch_mark_t m = {
+		.chunk = scratch.current,
+		.chunk_used = scratch.current != NULL ? scratch.current->used : 0,
+		.used = scratch.used,
+		.peak = scratch.peak,
+	};
+	scratch.peak = scratch.used;
+	return m;
+}
+
+size_t scratch_release(scratch_mark_t mark)
+{
+	size_t high = scratch.peak - mark.used;
+	if (mark.chunk != NULL) {
+		free_scratch_chunks_after(mark.chunk);
+		mark.chunk->used = mark.chunk_used;
+		scratch.current = mark.chunk;
+	} else if (scratch.head != NULL) {
+		/* The arena was created after the mark was taken. */
+		free_scratch_chunks_after(scratch.head);
+		scratch.head->used = 0;
+		scratch.current = scratch.head;
+	}
+	scratch.used = mark.used;
+	scratch.peak = MAX(mark.peak, scratch.peak);
+	return high;
+}
+
+const scratch_arena_t *scratch_arena(void)
+{
+	return &scratch;
+}
+
+void print_scratch_stats(FILE *rsp)
+{
+	fprintf(rsp, "{\"chunkSize\":%d,\"chunks\":%zu,\"inUse\":%zu,\"peak\":%zu,\"grows\":%" PRIu64 "}",
+	        SCRATCH_CHUNK_SIZE, scratch.chunk_count, scratch.used, scratch.max_peak, scratch.grows);
+}
+
+void reset_scratch_stats(void)
+{
+	scratch.max_peak = scratch.used;
+	scratch.grows = 0;
+}
+
 char *tokenize_with_escape(struct tokenize_state *state, const char *s, char sep)
 {
     if (s != NULL) {
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <float.h>
 
@@ -52,6 +53,7 @@
 #define CHILD_POL_STR(A)  ((A) == FIRST_CHILD ? "first_child" : "second_child")
 #define AUTO_SCM_STR(A)   ((A) == SCHEME_LONGEST_SIDE ? "longest_side" : ((A) == SCHEME_ALTERNATE ? "alternate" : "spiral"))
 #define TIGHTNESS_STR(A)  ((A) == TIGHTNESS_HIGH ? "high" : "low")
+#define OVERFLOW_STR(A)   ((A) == OVERFLOW_DROP_OLDEST ? "drop_oldest" : ((A) == OVERFLOW_COALESCE ? "coalesce" : "disconnect"))
 #define SPLIT_TYPE_STR(A) ((A) == TYPE_HORIZONTAL ? "horizontal" : "vertical")
 #define SPLIT_MODE_STR(A) ((A) == MODE_AUTOMATIC ? "automatic" : "manual")
 #define SPLIT_DIR_STR(A)  ((A) == DIR_NORTH ? "north" : ((A) == DIR_WEST ? "west" : ((A) == DIR_SOUTH ? "south" : "east")))
@@ -137,6 +139,32 @@ __attribute__((warn_unused_result)) char *mktempfifo(const char *template);
 __attribute__((warn_unused_result, format(printf, 2, 3))) int asprintf(char **buf, const char *fmt, ...);
 __attribute__((warn_unused_result, format(printf, 2, 0))) int vasprintf(char **buf, const char *fmt, va_list args);
 __attribute__((warn_unused_result)) bool is_hex_color(const char *color);
+uint64_t get_time_ms(void);
+
+/* Perfect hash of a fixed list of names, the NULL ones left out. The
+ * first lookup searches a seed under which no two names share a slot,
+ * so that a lookup is one hash and one comparison however long the list
+ * is; a list without such a seed, e.g. with duplicates, is scanned.
+ * Lists hold at most 255 names. */
+#define NAME_TABLE_SLOTS  512
+
+typedef struct {
+	const char *const *names;
+	size_t count;
+	uint32_t seed;
+	bool ready;
+	bool perfect;
+	uint8_t slots[NAME_TABLE_SLOTS];  /* index + 1, 0 when free */
+} name_table_t;
+
+#define NAME_TABLE(names)  {(names), LENGTH(names), 0, false, false, {0}}
+
+/* Returns the index of the name, or -1. */
+int name_table_lookup(name_table_t *t, const char *name);
+/* Same for a name that isn't NUL terminated, e.g. a JSON key. */
+int name_table_lookup_len(name_table_t *t, const char *name, size_t len);
+/* The seeded hash behind name tables. */
+uint32_t name_hash(const char *s, size_t len, uint32_t seed);
 
 struct tokenize_state {
 	bool in_escape;
@@ -149,18 +177,48 @@ __attribute__((warn_unused_result)) char *tokenize_with_escape(struct tokenize_s
  * Scratch arena - bump allocator for temporary allocations.
  * Reset after each command cycle to "free" all at once.
  * Prevents leaks in complex parsing paths.
+ *
+ * The arena is a chain of chunks: it grows by a chunk when the current one
+ * is full, and scratch_reset frees every chunk but the first. A mark taken
+ * with scratch_mark is given back by scratch_release, in LIFO order, which
+ * lets code running outside of a command cycle use the arena too.
  */
-#define SCRATCH_ARENA_SIZE (256 * 1024)  /* 256KB - increased for safety */
+#define SCRATCH_CHUNK_SIZE (64 * 1024)
+
+typedef struct scratch_chunk_t scratch_chunk_t;
+struct scratch_chunk_t {
+	scratch_chunk_t *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+};
 
 typedef struct {
-	char *base;
-	size_t offset;
-	size_t capacity;
+	scratch_chunk_t *head;     /* retained across resets */
+	scratch_chunk_t *current;
+	size_t used;               /* bytes handed out since the last reset */
+	size_t peak;               /* highest 'used' since the innermost mark */
+	size_t max_peak;           /* highest 'used' since the last stats reset */
+	size_t chunk_count;
+	uint64_t grows;
 } scratch_arena_t;
 
+typedef struct {
+	scratch_chunk_t *chunk;
+	size_t chunk_used;
+	size_t used;
+	size_t peak;
+} scratch_mark_t;
+
 void scratch_init(void);
 void scratch_destroy(void);
 void scratch_reset(void);  /* "free" all allocations */
 __attribute__((warn_unused_result, malloc)) void *scratch_alloc(size_t size);
+__attribute__((format(printf, 1, 2))) char *scratch_printf(const char *fmt, ...);
+scratch_mark_t scratch_mark(void);
+size_t scratch_release(scratch_mark_t mark);  /* returns the peak usage above the mark */
+const scratch_arena_t *scratch_arena(void);  /* read only, for the stats */
+void print_scratch_stats(FILE *rsp);
+void reset_scratch_stats(void);
 
 #endif
@@ -25,13 +25,18 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "bspwm.h"
+#include "settings.h"
 #include "tree.h"
 #include "query.h"
 #include "history.h"
+#include "pool.h"
+
+static size_t history_count;
+static pool_t history_pool = POOL_INIT("history", history_t);
 
 history_t *make_history(monitor_t *m, desktop_t *d, node_t *n)
 {
-	history_t *h = calloc(1, sizeof(history_t));
+	history_t *h = pool_alloc(&history_pool);
 	if (h == NULL) {
 		return NULL;
 	}
@@ -41,6 +46,126 @@ history_t *make_history(monitor_t *m, desktop_t *d, node_t *n)
 	return h;
 }
 
+/* Both entries refer to the same location. */
+static bool history_same(history_t *a, history_t *b)
+{
+	return (a->loc.node != NULL && a->loc.node == b->loc.node) ||
+	       (a->loc.node == NULL && a->loc.desktop == b->loc.desktop);
+}
+
+/* Spreads the order keys evenly over the whole list. */
+static void history_renumber(void)
+{
+	uint64_t o = HISTORY_ORDER_GAP;
+	for (history_t *h = history_head; h != NULL; h = h->next) {
+		h->order = o;
+		o += HISTORY_ORDER_GAP;
+	}
+}
+
+/* Gives the freshly linked entry `h` an order key between its neighbors. */
+static void history_order(history_t *h)
+{
+	uint64_t lo = (h->prev != NULL ? h->prev->order : 0);
+	if (h->next == NULL) {
+		if (lo <= UINT64_MAX - HISTORY_ORDER_GAP) {
+			h->order = lo + HISTORY_ORDER_GAP;
+			return;
+		}
+	} else if (h->next->order - lo >= 2) {
+		h->order = lo + (h->next->order - lo) / 2;
+		return;
+	}
+	history_renumber();
+}
+
+/* Pushes `h` at the front of the node and desktop chains it belongs to. */
+static void history_chain(history_t *h)
+{
+	node_t *n = h->loc.node;
+	desktop_t *d = h->loc.desktop;
+	if (n != NULL) {
+		h->node_older = n->history;
+		if (n->history != NULL) {
+			n->history->node_newer = h;
+		}
+		n->history = h;
+	}
+	if (d != NULL) {
+		h->desk_older = d->history;
+		if (d->history != NULL) {
+			d->history->desk_newer = h;
+		}
+		d->history = h;
+	}
+	history_count++;
+}
+
+/* Detaches `h` from the list and from its chains, and frees it. */
+static void history_free(history_t *h)
+{
+	if (h->prev != NULL) {
+		h->prev->next = h->next;
+	}
+	if (h->next != NULL) {
+		h->next->prev = h->prev;
+	}
+	if (history_head == h) {
+		history_head = h->next;
+	}
+	if (history_tail == h) {
+		history_tail = h->prev;
+	}
+	if (history_needle == h) {
+		history_needle = (h->next != NULL ? h->next : h->prev);
+	}
+
+	if (h->node_newer != NULL) {
+		h->node_newer->node_older = h->node_older;
+	} else if (h->loc.node != NULL) {
+		h->loc.node->history = h->node_older;
+	}
+	if (h->node_older != NULL) {
+		h->node_older->node_newer = h->node_newer;
+	}
+
+	if (h->desk_newer != NULL) {
+		h->desk_newer->desk_older = h->desk_older;
+	} else if (h->loc.desktop != NULL) {
+		h->loc.desktop->history = h->desk_older;
+	}
+	if (h->desk_older != NULL) {
+		h->desk_older->desk_newer = h->desk_newer;
+	}
+
+	history_count--;
+	pool_free(&history_pool, h);
+}
+
+/* Removes `b` and the duplicate entries that its removal brings together. */
+static void history_drop(history_t *b)
+{
+	history_t *a = b->next;
+	history_t *c = b->prev;
+	history_free(b);
+	if (a == NULL) {
+		return;
+	}
+	while (c != NULL && history_same(a, c)) {
+		history_t *p = c->prev;
+		history_free(c);
+		c = p;
+	}
+}
+
+/* Evicts the oldest entries until the history fits in `history_size`. */
+void history_trim(void)
+{
+	while (history_size > 0 && history_count > history_size) {
+		history_free(history_head);
+	}
+}
+
 void history_add(monitor_t *m, desktop_t *d, node_t *n, bool focused)
 {
 	if (!record_history) {
@@ -51,6 +176,10 @@ void history_add(monitor_t *m, desktop_t *d, node_t *n, bool focused)
 		history_needle = NULL;
 	}
 
+	if (history_tail != NULL && ((n != NULL && history_tail->loc.node == n) || (n == NULL && d == history_tail->loc.desktop))) {
+		return;
+	}
+
 	history_t *h = make_history(m, d, n);
 	if (h == NULL) {
 		return;
@@ -58,14 +187,27 @@ void history_add(monitor_t *m, desktop_t *d, node_t *n, bool focused)
 
 	if (history_head == NULL) {
 		history_head = history_tail = h;
-	} else if ((n != NULL && history_tail->loc.node != n) || (n == NULL && d != history_tail->loc.desktop)) {
-		history_t *ip = focused ? history_tail : NULL;
-
-		for (history_t *hh = history_tail; hh != NULL; hh = hh->prev) {
-			if ((n != NULL && hh->loc.node == n) || (n == NULL && d == hh->loc.desktop)) {
+		history_order(h);
+	} else {
+		/* only the newest entry of a node can still be its latest, and */
+		/* nothing older than the last desktop entry of `d` can be either */
+		if (n != NULL) {
+			if (n->history != NULL) {
+				n->history->latest = false;
+			}
+		} else if (d != NULL) {
+			for (history_t *hh = d->history; hh != NULL; hh = hh->desk_older) {
 				hh->latest = false;
+				if (hh->loc.node == NULL) {
+					break;
+				}
 			}
-			if (ip == NULL && ((n != NULL && hh->loc.desktop == d) || (n == NULL && hh->loc.monitor == m))) {
+		}
+
+		history_t *ip = focused ? history_tail : NULL;
+
+		for (history_t *hh = history_tail; ip == NULL && hh != NULL; hh = hh->prev) {
+			if ((n != NULL && hh->loc.desktop == d) || (n == NULL && hh->loc.monitor == m)) {
 				ip = hh;
 			}
 		}
@@ -84,9 +226,10 @@ void history_add(monitor_t *m, desktop_t *d, node_t *n, bool focused)
 			}
 			history_insert_before(h, ip);
 		}
-	} else {
-		free(h);
 	}
+
+	history_chain(h);
+	history_trim();
 }
 
 // Inserts `a` after `b`.
@@ -101,6 +244,7 @@ void history_insert_after(history_t *a, history_t *b)
 	if (history_tail == b) {
 		history_tail = a;
 	}
+	history_order(a);
 }
 
 // Inserts `a` before `b`.
@@ -115,69 +259,38 @@ void history_insert_before(history_t *a, history_t *b)
 	if (history_head == b) {
 		history_head = a;
 	}
+	history_order(a);
 }
 
 void history_remove(desktop_t *d, node_t *n, bool deep)
 {
-	/* removing from the newest to the oldest is required */
-	/* for maintaining the *latest* attribute */
-	history_t *b = history_tail;
-	while (b != NULL) {
-		if ((n != NULL && ((deep && is_descendant(b->loc.node, n)) || (!deep && b->loc.node == n))) ||
-		    (n == NULL && d == b->loc.desktop)) {
-			history_t *a = b->next;
-			history_t *c = b->prev;
-			if (a != NULL) {
-				/* remove duplicate entries */
-				while (c != NULL && ((a->loc.node != NULL && a->loc.node == c->loc.node) ||
-				       (a->loc.node == NULL && a->loc.desktop == c->loc.desktop))) {
-					history_t *p = c->prev;
-					/* update head/tail/needle BEFORE freeing c, each independently */
-					/* a/p survive this merge; c->next still points at the
-					 * entry freed on the previous iteration (links are not
-					 * repaired until after the loop), so never use it here. */
-					if (history_head == c) {
-						history_head = a;
-					}
-					if (history_tail == c) {
-						history_tail = p;
-					}
-					if (history_needle == c) {
-						history_needle = (a != NULL ? a : p);
-					}
-					free(c);
-					c = p;
-				}
-				a->prev = c;
-			}
-			if (c != NULL) {
-				c->next = a;
-			}
-			/* update head/tail/needle BEFORE freeing b, each independently */
-			if (history_tail == b) {
-				history_tail = c;
-			}
-			if (history_head == b) {
-				history_head = a;
-			}
-			if (history_needle == b) {
-				history_needle = (a != NULL ? a : c);
+	/* each drop may also free entries of the chain being walked, */
+	/* hence always restart from its front */
+	if (n == NULL) {
+		if (d == NULL) {
+			return;
+		}
+		while (d->history != NULL) {
+			history_drop(d->history);
+		}
+	} else if (!deep) {
+		while (n->history != NULL) {
+			history_drop(n->history);
+		}
+	} else {
+		node_t *last = second_extrema(n);
+		for (node_t *f = first_extrema(n); f != NULL; f = (f == last ? NULL : next_node(f))) {
+			while (f->history != NULL) {
+				history_drop(f->history);
 			}
-			free(b);
-			b = c;
-		} else {
-			b = b->prev;
 		}
 	}
 }
 
 void empty_history(void)
 {
-	history_t *h = history_head;
-	while (h != NULL) {
-		history_t *next = h->next;
-		free(h);
-		h = next;
+	while (history_head != NULL) {
+		history_free(history_head);
 	}
 	history_head = history_tail = NULL;
 }
@@ -322,17 +435,11 @@ bool history_find_monitor(history_dir_t hdi, coordinates_t *ref, coordinates_t *
 	return false;
 }
 
-uint32_t history_rank(node_t *n)
+/* Only meaningful relatively to other ranks: lower means more recent. */
+uint64_t history_rank(node_t *n)
 {
-	uint32_t r = 0;
-	history_t *h = history_tail;
-	while (h != NULL && (!h->latest || h->loc.node != n)) {
-		h = h->prev;
-		r++;
-	}
-	if (h == NULL) {
-		return UINT32_MAX;
-	} else {
-		return r;
+	if (n == NULL || n->history == NULL || !n->history->latest) {
+		return UINT64_MAX;
 	}
+	return history_tail->order - n->history->order;
 }
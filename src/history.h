@@ -27,11 +27,14 @@
 
 #include "types.h"
 
+#define HISTORY_ORDER_GAP  (1ULL << 16)
+
 history_t *make_history(monitor_t *m, desktop_t *d, node_t *n);
 void history_add(monitor_t *m, desktop_t *d, node_t *n, bool focused);
 void history_insert_after(history_t *a, history_t *b);
 void history_insert_before(history_t *a, history_t *b);
 void history_remove(desktop_t *d, node_t *n, bool deep);
+void history_trim(void);
 void empty_history(void);
 node_t *history_last_node(desktop_t *d, node_t *n);
 desktop_t *history_last_desktop(monitor_t *m, desktop_t *d);
@@ -42,6 +45,6 @@ bool history_find_newest_desktop(coordinates_t *ref, coordinates_t *dst, desktop
 bool history_find_desktop(history_dir_t hdi, coordinates_t *ref, coordinates_t *dst, desktop_select_t *sel);
 bool history_find_newest_monitor(coordinates_t *ref, coordinates_t *dst, monitor_select_t *sel);
 bool history_find_monitor(history_dir_t hdi, coordinates_t *ref, coordinates_t *dst, monitor_select_t *sel);
-uint32_t history_rank(node_t *n);
+uint64_t history_rank(node_t *n);
 
 #endif
@@ -0,0 +1,146 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "helpers.h"
+#include "intern.h"
+
+typedef struct interned_t interned_t;
+struct interned_t {
+	interned_t *next;  /* in its bucket */
+	uint32_t hash;
+	uint32_t refs;
+	char str[];
+};
+
+#define INTERN_MIN_BUCKETS  64
+
+static interned_t **buckets;
+static size_t bucket_count;
+static size_t interned_count;
+
+static interned_t *header(const char *s)
+{
+	return (interned_t *) (s - offsetof(interned_t, str));
+}
+
+static interned_t *lookup(const char *s, size_t len, uint32_t hash)
+{
+	if (bucket_count == 0) {
+		return NULL;
+	}
+	for (interned_t *e = buckets[hash & (bucket_count - 1)]; e != NULL; e = e->next) {
+		if (e->hash == hash && strncmp(e->str, s, len) == 0 && e->str[len] == '\0') {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/* Keep the load under one string per bucket. */
+static bool grow(void)
+{
+	size_t count = bucket_count == 0 ? INTERN_MIN_BUCKETS : 2 * bucket_count;
+	interned_t **b = calloc(count, sizeof(interned_t *));
+	if (b == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < bucket_count; i++) {
+		for (interned_t *e = buckets[i], *next; e != NULL; e = next) {
+			next = e->next;
+			e->next = b[e->hash & (count - 1)];
+			b[e->hash & (count - 1)] = e;
+		}
+	}
+	free(buckets);
+	buckets = b;
+	bucket_count = count;
+	return true;
+}
+
+const char *intern(const char *s)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+	size_t len = strlen(s);
+	uint32_t hash = name_hash(s, len, 0);
+	interned_t *e = lookup(s, len, hash);
+	if (e != NULL) {
+		e->refs++;
+		return e->str;
+	}
+	if (interned_count >= bucket_count && !grow()) {
+		return NULL;
+	}
+	e = malloc(sizeof(interned_t) + len + 1);
+	if (e == NULL) {
+		return NULL;
+	}
+	e->hash = hash;
+	e->refs = 1;
+	memcpy(e->str, s, len + 1);
+	e->next = buckets[hash & (bucket_count - 1)];
+	buckets[hash & (bucket_count - 1)] = e;
+	interned_count++;
+	return e->str;
+}
+
+const char *intern_ref(const char *s)
+{
+	if (s != NULL) {
+		header(s)->refs++;
+	}
+	return s;
+}
+
+const char *intern_find(const char *s)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+	size_t len = strlen(s);
+	interned_t *e = lookup(s, len, name_hash(s, len, 0));
+	return e == NULL ? NULL : e->str;
+}
+
+void intern_release(const char *s)
+{
+	if (s == NULL) {
+		return;
+	}
+	interned_t *e = header(s);
+	if (--e->refs > 0) {
+		return;
+	}
+	interned_t **link = &buckets[e->hash & (bucket_count - 1)];
+	while (*link != e) {
+		link = &(*link)->next;
+	}
+	*link = e->next;
+	interned_count--;
+	free(e);
+}
@@ -0,0 +1,432 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include "bspwm.h"
+#include "common.h"
+#include "helpers.h"
+#include "messages.h"
+#include "ipc.h"
+
+static bool read_input(ipc_client_t *ic);
+static bool serve_legacy(ipc_client_t *ic);
+static bool process_frames(ipc_client_t *ic);
+static bool queue_output(ipc_client_t *ic, const char *data, size_t len);
+static bool write_output(ipc_client_t *ic);
+
+ipc_client_t *make_ipc_client(int fd)
+{
+	ipc_client_t *ic = calloc(1, sizeof(ipc_client_t));
+	if (ic == NULL) {
+		return NULL;
+	}
+	ic->prev = ic->next = NULL;
+	ic->fd = fd;
+	ic->buf = ic->out = NULL;
+	ic->len = ic->cap = 0;
+	ic->out_pos = ic->out_len = ic->out_cap = 0;
+	return ic;
+}
+
+void add_ipc_client(ipc_client_t *ic)
+{
+	if (ic == NULL) {
+		return;
+	}
+	if (ipc_client_head == NULL) {
+		ipc_client_head = ipc_client_tail = ic;
+	} else {
+		ipc_client_tail->next = ic;
+		ic->prev = ipc_client_tail;
+		ipc_client_tail = ic;
+	}
+	fcntl(ic->fd, F_SETFD, FD_CLOEXEC | fcntl(ic->fd, F_GETFD));
+	fcntl(ic->fd, F_SETFL, O_NONBLOCK | fcntl(ic->fd, F_GETFL));
+	ic->events = EPOLLIN;
+	struct epoll_event ev = { .events = ic->events, .data.fd = ic->fd };
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ic->fd, &ev);
+}
+
+/* A client handed over to the subscribers has no descriptor left. */
+void remove_ipc_client(ipc_client_t *ic)
+{
+	if (ic == NULL) {
+		return;
+	}
+	ipc_client_t *a = ic->prev;
+	ipc_client_t *b = ic->next;
+	if (a != NULL) {
+		a->next = b;
+	}
+	if (b != NULL) {
+		b->prev = a;
+	}
+	if (ic == ipc_client_head) {
+		ipc_client_head = b;
+	}
+	if (ic == ipc_client_tail) {
+		ipc_client_tail = a;
+	}
+	if (ic->fd != -1) {
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ic->fd, NULL);
+		close(ic->fd);
+	}
+	free(ic->buf);
+	free(ic->out);
+	free(ic);
+}
+
+ipc_client_t *find_ipc_client(int fd)
+{
+	for (ipc_client_t *ic = ipc_client_head; ic != NULL; ic = ic->next) {
+		if (ic->fd == fd) {
+			return ic;
+		}
+	}
+	return NULL;
+}
+
+static void set_events(ipc_client_t *ic, uint32_t events)
+{
+	if (ic->events != events) {
+		ic->events = events;
+		struct epoll_event ev = { .events = events, .data.fd = ic->fd };
+		epoll_ctl(epoll_fd, EPOLL_CTL_MOD, ic->fd, &ev);
+	}
+}
+
+/* The deadline runs until a legacy connection is served, and while a
+ * frame is partial or output is unsent. Any progress clears it, so that
+ * it starts over from here. */
+static void update_deadline(ipc_client_t *ic)
+{
+	if (ic->framed && ic->len == 0 && ic->out_pos == ic->out_len) {
+		ic->deadline = 0;
+	} else if (ic->deadline == 0) {
+		ic->deadline = get_time_ms() + IPC_CLIENT_TIMEOUT;
+	}
+}
+
+static bool reserve(char **buf, size_t *cap, size_t size)
+{
+	if (size <= *cap) {
+		return true;
+	}
+	size_t c = MAX(*cap, (size_t) BUFSIZ);
+	while (c < size) {
+		if (!safe_double(&c)) {
+			return false;
+		}
+	}
+	char *b = realloc(*buf, c);
+	if (b == NULL) {
+		return false;
+	}
+	*buf = b;
+	*cap = c;
+	return true;
+}
+
+static void consume_input(ipc_client_t *ic, size_t len)
+{
+	memmove(ic->buf, ic->buf + len, ic->len - len);
+	ic->len -= len;
+}
+
+/* Only the client's own output is waited for: a framed client gets no
+ * new answer before it read the previous one. */
+void handle_ipc_client(ipc_client_t *ic)
+{
+	bool ok;
+	if (ic->out_pos < ic->out_len) {
+		ok = write_output(ic) && (!ic->framed || process_frames(ic));
+	} else {
+		ok = read_input(ic);
+	}
+	if (!ok || (ic->closing && ic->out_pos == ic->out_len)) {
+		remove_ipc_client(ic);
+		return;
+	}
+	update_deadline(ic);
+}
+
+void flush_ipc_client(ipc_client_t *ic)
+{
+	if (ic->out_pos < ic->out_len) {
+		write_output(ic);
+	}
+}
+
+int ipc_clients_timeout(void)
+{
+	uint64_t now = get_time_ms();
+	int timeout = -1;
+	for (ipc_client_t *ic = ipc_client_head; ic != NULL; ic = ic->next) {
+		if (ic->deadline == 0) {
+			continue;
+		}
+		int left = ic->deadline > now ? (int) MIN(ic->deadline - now, (uint64_t) INT_MAX) : 0;
+		if (timeout == -1 || left < timeout) {
+			timeout = left;
+		}
+	}
+	return timeout;
+}
+
+/* A legacy client that doesn't close its end after a message too large
+ * to be taken as complete early gets it served here, any other expired
+ * client is dropped. */
+void release_expired_ipc_clients(void)
+{
+	uint64_t now = get_time_ms();
+	ipc_client_t *ic = ipc_client_head;
+	while (ic != NULL) {
+		ipc_client_t *next = ic->next;
+		if (ic->deadline != 0 && ic->deadline <= now) {
+			bool legacy = !ic->framed && !ic->closing && ic->len > 0 && ic->buf[ic->len - 1] == '\0';
+			if (legacy && serve_legacy(ic) && ic->out_pos < ic->out_len) {
+				ic->deadline = 0;
+				update_deadline(ic);
+			} else {
+				remove_ipc_client(ic);
+			}
+		}
+		ic = next;
+	}
+}
+
+/* Read what's there, up to IPC_READ_BUDGET bytes, and serve what's
+ * complete. Returns false if the client must be removed. */
+static bool read_input(ipc_client_t *ic)
+{
+	size_t budget = IPC_READ_BUDGET;
+	bool drained = false, eof = false;
+
+	while (budget > 0) {
+		/* One spare byte terminates legacy messages */
+		if (ic->cap - ic->len < 2 && !reserve(&ic->buf, &ic->cap, ic->len + BUFSIZ)) {
+			return false;
+		}
+		ssize_t n = recv(ic->fd, ic->buf + ic->len, MIN(ic->cap - ic->len - 1, budget), MSG_DONTWAIT);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				drained = true;
+				break;
+			}
+			return false;
+		}
+		if (n == 0) {
+			eof = drained = true;
+			break;
+		}
+		ic->len += n;
+		budget -= n;
+		ic->deadline = 0;
+		if (ic->len > 2 * (size_t) MAX_FRAME_SIZE) {
+			return false;
+		}
+	}
+
+	if (!ic->framed && ic->len > 0 && ic->buf[0] == FRAMED_HELLO[0]) {
+		if (ic->len < sizeof(FRAMED_HELLO)) {
+			return !eof;
+		}
+		if (memcmp(ic->buf, FRAMED_HELLO, sizeof(FRAMED_HELLO)) != 0) {
+			return false;
+		}
+		consume_input(ic, sizeof(FRAMED_HELLO));
+		ic->framed = true;
+	}
+
+	if (ic->framed) {
+		if (!process_frames(ic)) {
+			return false;
+		}
+		ic->closing = eof;
+		return true;
+	}
+
+	/* A legacy message has no length: it is complete at the end of the
+	 * stream, which bspc closes after sending, or when the socket is
+	 * drained after a final null byte and it is small enough to have
+	 * come in one piece. */
+	if (ic->len > MAX_FRAME_SIZE) {
+		return false;
+	}
+	if (eof || (drained && ic->len > 0 && ic->len < BUFSIZ && ic->buf[ic->len - 1] == '\0')) {
+		return ic->len > 0 && serve_legacy(ic);
+	}
+	return true;
+}
+
+static bool is_subscribe(const char *msg, size_t len)
+{
+	return len >= sizeof("subscribe") && memcmp(msg, "subscribe", sizeof("subscribe")) == 0;
+}
+
+/* Answer the message of a legacy connection, which is closed after. */
+static bool serve_legacy(ipc_client_t *ic)
+{
+	ic->buf[ic->len] = '\0';
+	ic->closing = true;
+
+	/* The subscriber takes the connection over. */
+	if (is_subscribe(ic->buf, ic->len)) {
+		int fd = ic->fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		ic->fd = -1;
+		FILE *rsp = fdopen(fd, "w");
+		if (rsp != NULL) {
+			handle_message(ic->buf, ic->len, rsp);
+			scratch_reset();
+		} else {
+			warn("Can't open the client socket as file.\n");
+			close(fd);
+		}
+		ic->len = 0;
+		return true;
+	}
+
+	char *out = NULL;
+	size_t out_len = 0;
+	FILE *rsp = open_memstream(&out, &out_len);
+	if (rsp == NULL) {
+		return false;
+	}
+	handle_message(ic->buf, ic->len, rsp);
+	scratch_reset();
+	ic->len = 0;
+	bool queued = queue_output(ic, out, out_len);
+	free(out);
+	return queued && write_output(ic);
+}
+
+/* Serve the complete frames for as long as the answers are sent right
+ * away. Returns false if the client misbehaved. */
+static bool process_frames(ipc_client_t *ic)
+{
+	size_t pos = 0;
+	bool ok = true;
+
+	while (ic->out_pos == ic->out_len && ic->len - pos >= FRAME_HEADER_SIZE) {
+		uint32_t be;
+		memcpy(&be, ic->buf + pos, FRAME_HEADER_SIZE);
+		size_t flen = ntohl(be);
+		if (flen > MAX_FRAME_SIZE) {
+			ok = false;
+			break;
+		}
+		if (ic->len - pos - FRAME_HEADER_SIZE < flen) {
+			break;
+		}
+
+		char *msg = ic->buf + pos + FRAME_HEADER_SIZE;
+		pos += FRAME_HEADER_SIZE + flen;
+
+		char *out = NULL;
+		size_t out_len = 0;
+		FILE *rsp = open_memstream(&out, &out_len);
+		if (rsp == NULL) {
+			ok = false;
+			break;
+		}
+
+		/* The subscriber would take over the stream, which is a
+		 * per-request buffer here. */
+		if (is_subscribe(msg, flen)) {
+			fail(rsp, "subscribe: Not available on framed connections.\n");
+			fclose(rsp);
+		} else {
+			handle_message(msg, flen, rsp);
+			scratch_reset();
+		}
+
+		bool queued = out_len <= MAX_FRAME_SIZE;
+		if (queued) {
+			be = htonl(out_len);
+			queued = queue_output(ic, (char *) &be, FRAME_HEADER_SIZE) &&
+			         queue_output(ic, out, out_len);
+		}
+		free(out);
+		if (!queued || !write_output(ic)) {
+			ok = false;
+			break;
+		}
+	}
+
+	if (pos > 0) {
+		consume_input(ic, pos);
+	}
+
+	return ok;
+}
+
+static bool queue_output(ipc_client_t *ic, const char *data, size_t len)
+{
+	if (len == 0) {
+		return true;
+	}
+	if (!reserve(&ic->out, &ic->out_cap, ic->out_len + len)) {
+		return false;
+	}
+	memcpy(ic->out + ic->out_len, data, len);
+	ic->out_len += len;
+	return true;
+}
+
+/* Send what the socket takes, and wait for it to take the rest. */
+static bool write_output(ipc_client_t *ic)
+{
+	while (ic->out_pos < ic->out_len) {
+		ssize_t n = send(ic->fd, ic->out + ic->out_pos, ic->out_len - ic->out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				set_events(ic, EPOLLOUT);
+				return true;
+			}
+			return false;
+		}
+		ic->out_pos += n;
+		ic->deadline = 0;
+	}
+	ic->out_pos = ic->out_len = 0;
+	set_events(ic, EPOLLIN);
+	return true;
+}
@@ -0,0 +1,50 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BSPWM_IPC_H
+#define BSPWM_IPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "types.h"
+
+/* Connections are only read and written as far as the socket allows
+ * without blocking. One with a partial message or unsent output is
+ * dropped after IPC_CLIENT_TIMEOUT milliseconds without progress, and at
+ * most IPC_READ_BUDGET bytes are read from it per wakeup. */
+#define IPC_CLIENT_TIMEOUT  2000
+#define IPC_READ_BUDGET     (64 * 1024)
+
+ipc_client_t *make_ipc_client(int fd);
+void add_ipc_client(ipc_client_t *ic);
+void remove_ipc_client(ipc_client_t *ic);
+ipc_client_t *find_ipc_client(int fd);
+void handle_ipc_client(ipc_client_t *ic);
+/* Last attempt at sending the pending output, before exiting. */
+void flush_ipc_client(ipc_client_t *ic);
+int ipc_clients_timeout(void);
+void release_expired_ipc_clients(void);
+
+#endif
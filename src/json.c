@@ -0,0 +1,376 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "json.h"
+
+#define JSON_IOV_MAX  64
+
+void json_init(json_writer_t *jw, bool compact)
+{
+	memset(jw, 0, sizeof(json_writer_t));
+	jw->compact = compact;
+}
+
+void json_free(json_writer_t *jw)
+{
+	for (size_t i = 0; i < jw->chunks_count; i++) {
+		free(jw->chunks[i].data);
+	}
+	free(jw->chunks);
+	free(jw->frames);
+	memset(jw, 0, sizeof(json_writer_t));
+}
+
+static bool next_chunk(json_writer_t *jw)
+{
+	size_t i = jw->chunks_count > 0 ? jw->cur + 1 : 0;
+	if (i < jw->chunks_count) {
+		jw->cur = i;
+		jw->chunks[i].len = 0;
+		return true;
+	}
+	if (jw->chunks_count == jw->chunks_cap) {
+		size_t cap = jw->chunks_cap > 0 ? 2 * jw->chunks_cap : 4;
+		json_chunk_t *chunks = realloc(jw->chunks, cap * sizeof(json_chunk_t));
+		if (chunks == NULL) {
+			jw->failed = true;
+			return false;
+		}
+		jw->chunks = chunks;
+		jw->chunks_cap = cap;
+	}
+	char *data = malloc(JSON_CHUNK_SIZE);
+	if (data == NULL) {
+		jw->failed = true;
+		return false;
+	}
+	jw->chunks[i] = (json_chunk_t) {data, 0};
+	jw->chunks_count++;
+	jw->cur = i;
+	return true;
+}
+
+static inline size_t room(json_writer_t *jw)
+{
+	return jw->chunks_count > 0 ? JSON_CHUNK_SIZE - jw->chunks[jw->cur].len : 0;
+}
+
+static void put(json_writer_t *jw, const char *s, size_t n)
+{
+	while (n > 0 && !jw->failed) {
+		size_t r = room(jw);
+		if (r == 0) {
+			next_chunk(jw);
+			continue;
+		}
+		if (r > n) {
+			r = n;
+		}
+		json_chunk_t *c = &jw->chunks[jw->cur];
+		memcpy(c->data + c->len, s, r);
+		c->len += r;
+		s += r;
+		n -= r;
+	}
+}
+
+static inline void put_char(json_writer_t *jw, char c)
+{
+	put(jw, &c, 1);
+}
+
+/* Returns room for at least JSON_RESERVE contiguous bytes. */
+static char *reserve(json_writer_t *jw)
+{
+	if (jw->failed || (room(jw) < JSON_RESERVE && !next_chunk(jw))) {
+		return NULL;
+	}
+	json_chunk_t *c = &jw->chunks[jw->cur];
+	return c->data + c->len;
+}
+
+static void put_uint(json_writer_t *jw, uint64_t v)
+{
+	char tmp[20];
+	char *p = tmp + sizeof(tmp);
+	do {
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while (v > 0);
+	put(jw, p, tmp + sizeof(tmp) - p);
+}
+
+static void put_string(json_writer_t *jw, const char *s)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	const char *run = s;
+	put_char(jw, '"');
+	for (; *s != '\0'; s++) {
+		unsigned char c = *s;
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+		put(jw, run, s - run);
+		run = s + 1;
+		switch (c) {
+			case '"': put(jw, "\\\"", 2); break;
+			case '\\': put(jw, "\\\\", 2); break;
+			case '\n': put(jw, "\\n", 2); break;
+			case '\r': put(jw, "\\r", 2); break;
+			case '\t': put(jw, "\\t", 2); break;
+			default: {
+				char esc[6] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xF]};
+				put(jw, esc, sizeof(esc));
+				break;
+			}
+		}
+	}
+	put(jw, run, s - run);
+	put_char(jw, '"');
+}
+
+/* Emits the separator and the key that precede a value. */
+static void begin_value(json_writer_t *jw, const char *key)
+{
+	if (jw->depth > 0) {
+		json_frame_t *f = &jw->frames[jw->depth - 1];
+		if (!f->empty) {
+			put_char(jw, ',');
+		}
+		f->empty = false;
+	}
+	if (key != NULL) {
+		put_string(jw, key);
+		put_char(jw, ':');
+	}
+}
+
+static void begin_container(json_writer_t *jw, const char *key, char open)
+{
+	if (jw->failed) {
+		return;
+	}
+	if (jw->depth == jw->frames_cap) {
+		size_t cap = jw->frames_cap > 0 ? 2 * jw->frames_cap : 16;
+		json_frame_t *frames = realloc(jw->frames, cap * sizeof(json_frame_t));
+		if (frames == NULL) {
+			jw->failed = true;
+			return;
+		}
+		jw->frames = frames;
+		jw->frames_cap = cap;
+	}
+	json_frame_t f = {
+		.chunk = jw->cur,
+		.offset = jw->chunks_count > 0 ? jw->chunks[jw->cur].len : 0,
+		.parent_empty = jw->depth > 0 && jw->frames[jw->depth - 1].empty,
+		.empty = true,
+		.keyed = key != NULL,
+	};
+	begin_value(jw, key);
+	put_char(jw, open);
+	jw->frames[jw->depth++] = f;
+}
+
+static void end_container(json_writer_t *jw, char close)
+{
+	if (jw->failed || jw->depth == 0) {
+		return;
+	}
+	json_frame_t *f = &jw->frames[--jw->depth];
+	if (jw->compact && f->keyed && f->empty) {
+		/* Take back the separator, the key and the opening bracket. */
+		jw->cur = f->chunk;
+		if (jw->chunks_count > 0) {
+			jw->chunks[jw->cur].len = f->offset;
+		}
+		if (jw->depth > 0) {
+			jw->frames[jw->depth - 1].empty = f->parent_empty;
+		}
+		return;
+	}
+	put_char(jw, close);
+}
+
+void json_raw(json_writer_t *jw, const char *s)
+{
+	put(jw, s, strlen(s));
+}
+
+void json_begin_object(json_writer_t *jw, const char *key)
+{
+	begin_container(jw, key, '{');
+}
+
+void json_end_object(json_writer_t *jw)
+{
+	end_container(jw, '}');
+}
+
+void json_begin_array(json_writer_t *jw, const char *key)
+{
+	begin_container(jw, key, '[');
+}
+
+void json_end_array(json_writer_t *jw)
+{
+	end_container(jw, ']');
+}
+
+static inline bool omitted(json_writer_t *jw, const char *key, bool is_default)
+{
+	return jw->failed || (jw->compact && key != NULL && is_default);
+}
+
+void json_null(json_writer_t *jw, const char *key)
+{
+	if (omitted(jw, key, true)) {
+		return;
+	}
+	begin_value(jw, key);
+	put(jw, "null", 4);
+}
+
+void json_bool(json_writer_t *jw, const char *key, bool v)
+{
+	if (omitted(jw, key, !v)) {
+		return;
+	}
+	begin_value(jw, key);
+	if (v) {
+		put(jw, "true", 4);
+	} else {
+		put(jw, "false", 5);
+	}
+}
+
+void json_int(json_writer_t *jw, const char *key, int64_t v)
+{
+	if (omitted(jw, key, v == 0)) {
+		return;
+	}
+	begin_value(jw, key);
+	if (v < 0) {
+		put_char(jw, '-');
+		put_uint(jw, (uint64_t) 0 - (uint64_t) v);
+	} else {
+		put_uint(jw, (uint64_t) v);
+	}
+}
+
+void json_uint(json_writer_t *jw, const char *key, uint64_t v)
+{
+	if (omitted(jw, key, v == 0)) {
+		return;
+	}
+	begin_value(jw, key);
+	put_uint(jw, v);
+}
+
+void json_double(json_writer_t *jw, const char *key, double v)
+{
+	if (omitted(jw, key, v == 0)) {
+		return;
+	}
+	begin_value(jw, key);
+	char *p = reserve(jw);
+	if (p == NULL) {
+		return;
+	}
+	int n = snprintf(p, JSON_RESERVE, "%lf", v);
+	if (n >= JSON_RESERVE) {
+		n = snprintf(p, JSON_RESERVE, "%.17g", v);
+	}
+	if (n > 0) {
+		jw->chunks[jw->cur].len += n;
+	}
+}
+
+void json_string(json_writer_t *jw, const char *key, const char *s)
+{
+	if (omitted(jw, key, s == NULL)) {
+		return;
+	}
+	begin_value(jw, key);
+	if (s == NULL) {
+		put(jw, "null", 4);
+	} else {
+		put_string(jw, s);
+	}
+}
+
+/* Sends the whole document with as few writev calls as possible. Memory
+ * streams have no descriptor and get the chunks through stdio. */
+bool json_flush(json_writer_t *jw, FILE *rsp)
+{
+	if (jw->failed || rsp == NULL) {
+		return false;
+	}
+	if (jw->chunks_count == 0) {
+		return true;
+	}
+	size_t count = jw->cur + 1;
+	if (fflush(rsp) == EOF) {
+		return false;
+	}
+	int fd = fileno(rsp);
+	if (fd == -1) {
+		for (size_t i = 0; i < count; i++) {
+			if (fwrite(jw->chunks[i].data, 1, jw->chunks[i].len, rsp) != jw->chunks[i].len) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct iovec iov[JSON_IOV_MAX];
+	for (size_t base = 0; base < count; base += JSON_IOV_MAX) {
+		int n = 0;
+		for (size_t i = base; i < count && n < JSON_IOV_MAX; i++) {
+			iov[n++] = (struct iovec) {jw->chunks[i].data, jw->chunks[i].len};
+		}
+		int i = 0;
+		while (i < n) {
+			ssize_t w = writev(fd, iov + i, n - i);
+			if (w == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			while (i < n && (size_t) w >= iov[i].iov_len) {
+				w -= iov[i].iov_len;
+				i++;
+			}
+			if (i < n) {
+				iov[i].iov_base = (char *) iov[i].iov_base + w;
+				iov[i].iov_len -= w;
+			}
+		}
+	}
+	return true;
+}
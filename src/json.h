@@ -0,0 +1,82 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef BSPWM_JSON_H
+#define BSPWM_JSON_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Streaming JSON emitter: the output is formatted into a list of chunks
+ * and handed to the kernel at once by json_flush(). Separators are
+ * inserted by the writer. In compact mode, members whose value is false,
+ * zero, null or an empty object or array are left out. */
+#define JSON_CHUNK_SIZE  16384
+#define JSON_RESERVE     64
+
+typedef struct {
+	char *data;
+	size_t len;
+} json_chunk_t;
+
+typedef struct {
+	size_t chunk;
+	size_t offset;
+	bool parent_empty;
+	bool empty;
+	bool keyed;
+} json_frame_t;
+
+typedef struct {
+	json_chunk_t *chunks;
+	size_t chunks_count;
+	size_t chunks_cap;
+	size_t cur;
+	json_frame_t *frames;
+	size_t depth;
+	size_t frames_cap;
+	bool compact;
+	bool failed;
+} json_writer_t;
+
+void json_init(json_writer_t *jw, bool compact);
+void json_free(json_writer_t *jw);
+bool json_flush(json_writer_t *jw, FILE *rsp);
+
+void json_raw(json_writer_t *jw, const char *s);
+void json_begin_object(json_writer_t *jw, const char *key);
+void json_end_object(json_writer_t *jw);
+void json_begin_array(json_writer_t *jw, const char *key);
+void json_end_array(json_writer_t *jw);
+
+/* A NULL key emits a bare value, for array elements and the top level. */
+void json_null(json_writer_t *jw, const char *key);
+void json_bool(json_writer_t *jw, const char *key, bool v);
+void json_int(json_writer_t *jw, const char *key, int64_t v);
+void json_uint(json_writer_t *jw, const char *key, uint64_t v);
+void json_double(json_writer_t *jw, const char *key, double v);
+void json_string(json_writer_t *jw, const char *key, const char *s);
+
+#endif
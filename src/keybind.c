@@ -30,43 +30,300 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <spawn.h>
 #include <xkbcommon/xkbcommon.h>
 #include "helpers.h"
+#include "common.h"
+#include "backend.h"
+#include "messages.h"
 #include "keybind.h"
 
-keybind_table_t keybind_table;
+extern char **environ;
 
-void keybind_init(void)
+keybind_map_t keybind_table;
+
+/* Where the keys pressed so far lead to, NULL when no chord is pending */
+static keybind_t *chord_node;
+static uint64_t chord_deadline;
+
+/* Fibonacci hashing of the keysym, mixed with the modifiers */
+static inline size_t keystroke_index(keystroke_t key, size_t cap)
+{
+	uint32_t k = key.keysym ^ (key.modifiers << 24);
+	return (uint32_t) (k * UINT32_C(2654435769)) >> (32 - __builtin_ctzl(cap));
+}
+
+static inline bool keystroke_eq(keystroke_t a, keystroke_t b)
+{
+	return a.keysym == b.keysym && a.modifiers == b.modifiers;
+}
+
+static keybind_t *map_find(keybind_map_t *map, keystroke_t key)
 {
-	keybind_table.count = 0;
-	memset(keybind_table.binds, 0, sizeof(keybind_table.binds));
+	if (map->cap == 0) {
+		return NULL;
+	}
+	for (keybind_t *kb = map->buckets[keystroke_index(key, map->cap)]; kb != NULL; kb = kb->next) {
+		if (keystroke_eq(kb->key, key)) {
+			return kb;
+		}
+	}
+	return NULL;
 }
 
-bool keybind_add(uint32_t modifiers, uint32_t keysym, const char *command)
+static bool map_grow(keybind_map_t *map)
 {
-	if (keybind_table.count >= MAX_KEYBINDS)
+	size_t cap = map->cap == 0 ? KEYBIND_INIT_CAP : map->cap;
+	if (map->cap > 0 && !safe_double(&cap)) {
 		return false;
+	}
+	keybind_t **buckets = safe_calloc(cap, sizeof(keybind_t *));
+	if (buckets == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < map->cap; i++) {
+		keybind_t *kb = map->buckets[i];
+		while (kb != NULL) {
+			keybind_t *next = kb->next;
+			size_t j = keystroke_index(kb->key, cap);
+			kb->next = buckets[j];
+			buckets[j] = kb;
+			kb = next;
+		}
+	}
+	free(map->buckets);
+	map->buckets = buckets;
+	map->cap = cap;
+	return true;
+}
 
-	keybind_t *kb = &keybind_table.binds[keybind_table.count++];
-	kb->modifiers = modifiers;
-	kb->keysym = keysym;
+/* Return the binding of the given key, creating an empty one if needed. */
+static keybind_t *map_insert(keybind_map_t *map, keystroke_t key)
+{
+	keybind_t *kb = map_find(map, key);
+	if (kb != NULL) {
+		return kb;
+	}
+	if (map->count >= map->cap && !map_grow(map)) {
+		return NULL;
+	}
+	kb = calloc(1, sizeof(keybind_t));
+	if (kb == NULL) {
+		return NULL;
+	}
+	kb->key = key;
+	size_t i = keystroke_index(key, map->cap);
+	kb->next = map->buckets[i];
+	map->buckets[i] = kb;
+	map->count++;
+	return kb;
+}
+
+static void map_clear(keybind_map_t *map)
+{
+	for (size_t i = 0; i < map->cap; i++) {
+		keybind_t *kb = map->buckets[i];
+		while (kb != NULL) {
+			keybind_t *next = kb->next;
+			map_clear(&kb->next_keys);
+			free(kb);
+			kb = next;
+		}
+	}
+	free(map->buckets);
+	map->buckets = NULL;
+	map->cap = map->count = 0;
+}
+
+/* Unlink and free the binding of the given key. */
+static void map_delete(keybind_map_t *map, keystroke_t key)
+{
+	if (map->cap == 0) {
+		return;
+	}
+	for (keybind_t **p = &map->buckets[keystroke_index(key, map->cap)]; *p != NULL; p = &(*p)->next) {
+		keybind_t *kb = *p;
+		if (keystroke_eq(kb->key, key)) {
+			*p = kb->next;
+			map_clear(&kb->next_keys);
+			free(kb);
+			map->count--;
+			return;
+		}
+	}
+}
+
+static void reset_chord(void)
+{
+	if (chord_node != NULL) {
+		chord_node = NULL;
+		backend_ungrab_keyboard();
+	}
+}
+
+/* Characters that need a shell to be interpreted */
+#define SHELL_CHARS  "\"'\\$`;|&<>(){}[]*?~#!\n"
+
+/* Split commands made of plain words starting with bspc into the argument
+ * vector process_message expects, leave everything else to the shell. */
+static void tokenize_bspc_command(keybind_t *kb)
+{
+	kb->argc = 0;
+	kb->args_len = 0;
+	if (strpbrk(kb->command, SHELL_CHARS) != NULL) {
+		return;
+	}
+	char buf[MAX_COMMAND];
+	snprintf(buf, sizeof(buf), "%s", kb->command);
+	char *saveptr;
+	char *word = strtok_r(buf, " \t", &saveptr);
+	if (word == NULL || strchr(word, '=') != NULL) {
+		return;
+	}
+	char *base = strrchr(word, '/');
+	if (!streq(base != NULL ? base + 1 : word, "bspc")) {
+		return;
+	}
+	int argc = 0;
+	size_t len = 0;
+	for (word = strtok_r(NULL, " \t", &saveptr); word != NULL; word = strtok_r(NULL, " \t", &saveptr)) {
+		/* bspc's own options and subscriptions need the real client */
+		if (argc == 0 && (word[0] == '-' || streq(word, "subscribe"))) {
+			return;
+		}
+		size_t n = strlen(word) + 1;
+		memcpy(kb->args + len, word, n);
+		len += n;
+		argc++;
+	}
+	kb->args_len = len;
+	kb->argc = argc;
+}
+
+void keybind_init(void)
+{
+	chord_node = NULL;
+	map_clear(&keybind_table);
+}
+
+bool keybind_add(const keystroke_t *keys, size_t len, const char *command)
+{
+	if (len == 0 || len > MAX_CHORD) {
+		return false;
+	}
+	/* A chord prefix can't be bound itself, nor extend a binding */
+	keybind_map_t *map = &keybind_table;
+	for (size_t i = 0; i < len; i++) {
+		keybind_t *kb = map_find(map, keys[i]);
+		if (kb == NULL) {
+			break;
+		}
+		if ((i + 1 < len && kb->command[0] != '\0') ||
+		    (i + 1 == len && kb->next_keys.count > 0)) {
+			return false;
+		}
+		map = &kb->next_keys;
+	}
+	reset_chord();
+	map = &keybind_table;
+	keybind_t *kb = NULL;
+	for (size_t i = 0; i < len; i++) {
+		kb = map_insert(map, keys[i]);
+		if (kb == NULL) {
+			return false;
+		}
+		map = &kb->next_keys;
+	}
 	snprintf(kb->command, sizeof(kb->command), "%s", command);
+	tokenize_bspc_command(kb);
+	return true;
+}
+
+static bool remove_keys(keybind_map_t *map, const keystroke_t *keys, size_t len)
+{
+	keybind_t *kb = map_find(map, keys[0]);
+	if (kb == NULL) {
+		return false;
+	}
+	if (len == 1) {
+		if (kb->command[0] == '\0') {
+			return false;
+		}
+	} else if (!remove_keys(&kb->next_keys, keys + 1, len - 1)) {
+		return false;
+	}
+	/* Prune the prefixes left without continuation */
+	if (kb->next_keys.count == 0) {
+		map_delete(map, keys[0]);
+	}
 	return true;
 }
 
+bool keybind_remove(const keystroke_t *keys, size_t len)
+{
+	if (len == 0 || len > MAX_CHORD) {
+		return false;
+	}
+	reset_chord();
+	return remove_keys(&keybind_table, keys, len);
+}
+
 void keybind_clear(void)
 {
-	keybind_table.count = 0;
+	reset_chord();
+	map_clear(&keybind_table);
 }
 
-const char *keybind_match(uint32_t modifiers, uint32_t keysym)
+/* Modifier keys pressed while typing a chord don't interrupt it */
+static bool is_modifier_keysym(uint32_t keysym)
 {
-	for (int i = 0; i < keybind_table.count; i++) {
-		keybind_t *kb = &keybind_table.binds[i];
-		if (kb->keysym == keysym && kb->modifiers == modifiers)
-			return kb->command;
+	return (keysym >= XKB_KEY_Shift_L && keysym <= XKB_KEY_Hyper_R) ||
+	       (keysym >= XKB_KEY_ISO_Lock && keysym <= XKB_KEY_ISO_Level5_Lock);
+}
+
+const keybind_t *keybind_match(uint32_t modifiers, uint32_t keysym)
+{
+	keybind_expire_chord();
+	if (chord_node != NULL && is_modifier_keysym(keysym)) {
+		return NULL;
+	}
+	keybind_map_t *map = chord_node != NULL ? &chord_node->next_keys : &keybind_table;
+	keybind_t *kb = map_find(map, (keystroke_t) {modifiers, keysym});
+	if (kb == NULL) {
+		reset_chord();
+		return NULL;
+	}
+	if (kb->next_keys.count > 0) {
+		if (chord_node == NULL) {
+			backend_grab_keyboard();
+		}
+		chord_node = kb;
+		chord_deadline = get_time_ms() + CHORD_TIMEOUT;
+		return NULL;
+	}
+	reset_chord();
+	return kb;
+}
+
+bool keybind_chord_pending(void)
+{
+	return chord_node != NULL;
+}
+
+int keybind_chord_timeout(void)
+{
+	if (chord_node == NULL) {
+		return -1;
+	}
+	uint64_t now = get_time_ms();
+	return chord_deadline > now ? (int) (chord_deadline - now) : 0;
+}
+
+void keybind_expire_chord(void)
+{
+	if (chord_node != NULL && get_time_ms() >= chord_deadline) {
+		reset_chord();
 	}
-	return NULL;
 }
 
 /* Parse a modifier name to flag */
@@ -134,16 +391,136 @@ bool keybind_parse_combo(const char *combo, uint32_t *modifiers, uint32_t *keysy
 	return false;
 }
 
-void keybind_exec(const char *command)
+bool keybind_parse_chord(const char *chord, keystroke_t *keys, size_t *len)
 {
-	if (!command || !*command) return;
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%s", chord);
+	*len = 0;
 
-	pid_t pid = fork();
-	if (pid == 0) {
-		setsid();
-		execl("/bin/sh", "/bin/sh", "-c", command, (char *)NULL);
-		_exit(127);
+	char *saveptr;
+	for (char *combo = strtok_r(buf, ";", &saveptr); combo != NULL; combo = strtok_r(NULL, ";", &saveptr)) {
+		if (*len >= MAX_CHORD ||
+		    !keybind_parse_combo(combo, &keys[*len].modifiers, &keys[*len].keysym)) {
+			return false;
+		}
+		(*len)++;
 	}
+
+	return *len > 0;
+}
+
+static void print_keystroke(keystroke_t key, FILE *rsp)
+{
+	static const struct {
+		uint32_t mask;
+		const char *name;
+	} mods[] = {
+		{KBMOD_SUPER, "super"},
+		{KBMOD_ALT, "alt"},
+		{KBMOD_CTRL, "ctrl"},
+		{KBMOD_SHIFT, "shift"},
+		{KBMOD_MOD2, "mod2"},
+		{KBMOD_MOD3, "mod3"},
+		{KBMOD_MOD5, "mod5"},
+	};
+	for (size_t i = 0; i < LENGTH(mods); i++) {
+		if (key.modifiers & mods[i].mask) {
+			fprintf(rsp, "%s + ", mods[i].name);
+		}
+	}
+	char keysym_name[64];
+	xkb_keysym_get_name(key.keysym, keysym_name, sizeof(keysym_name));
+	fprintf(rsp, "%s", keysym_name);
+}
+
+static void list_keys(keybind_map_t *map, keystroke_t *keys, size_t len, FILE *rsp)
+{
+	for (size_t i = 0; i < map->cap; i++) {
+		for (keybind_t *kb = map->buckets[i]; kb != NULL; kb = kb->next) {
+			keys[len] = kb->key;
+			if (kb->next_keys.count > 0 && len + 1 < MAX_CHORD) {
+				list_keys(&kb->next_keys, keys, len + 1, rsp);
+				continue;
+			}
+			for (size_t j = 0; j <= len; j++) {
+				if (j > 0) {
+					fprintf(rsp, " ; ");
+				}
+				print_keystroke(keys[j], rsp);
+			}
+			fprintf(rsp, "\n\t%s\n", kb->command);
+		}
+	}
+}
+
+void keybind_list(FILE *rsp)
+{
+	keystroke_t keys[MAX_CHORD];
+	list_keys(&keybind_table, keys, 0, rsp);
+}
+
+/* Run a pre-tokenized bspc command in process. The response goes to a
+ * memory stream, failures are reported on stderr like bspc would. */
+static bool dispatch_bspc_command(const keybind_t *kb)
+{
+	char buf[MAX_COMMAND];
+	char *args[MAX_COMMAND / 2];
+	memcpy(buf, kb->args, kb->args_len);
+	int num = 0;
+	for (size_t i = 0; i < kb->args_len && num < (int) LENGTH(args); i += strlen(buf + i) + 1) {
+		args[num++] = buf + i;
+	}
+
+	char *out = NULL;
+	size_t len = 0;
+	FILE *rsp = open_memstream(&out, &len);
+	if (rsp == NULL) {
+		return false;
+	}
+	process_message(args, num, rsp);
+	if (len > 0 && out[0] == FAILURE_MESSAGE[0]) {
+		warn("%s: %s", kb->command, out + 1);
+	}
+	free(out);
+	scratch_reset();
+	return true;
+}
+
+static void spawn_shell_command(const char *command)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	if (posix_spawn_file_actions_init(&actions) != 0) {
+		return;
+	}
+	if (posix_spawnattr_init(&attr) != 0) {
+		posix_spawn_file_actions_destroy(&actions);
+		return;
+	}
+	int dpy_fd = backend_get_fd();
+	if (dpy_fd >= 0) {
+		posix_spawn_file_actions_addclose(&actions, dpy_fd);
+	}
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+
+	pid_t pid;
+	char *argv[] = {"/bin/sh", "-c", (char *) command, NULL};
+	if (posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ) != 0) {
+		warn("Couldn't spawn '%s'.\n", command);
+	}
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+}
+
+void keybind_exec(const keybind_t *kb)
+{
+	if (!kb || !kb->command[0]) return;
+
+	if (kb->argc > 0 && dispatch_bspc_command(kb))
+		return;
+
+	spawn_shell_command(kb->command);
 }
 
 bool keybind_load_config(const char *path)
@@ -170,14 +547,15 @@ bool keybind_load_config(const char *path)
 			/* This line is the command for the previous combo */
 			while (*p && isspace(*p)) p++;
 
-			uint32_t modifiers, keysym;
-			if (keybind_parse_combo(pending_combo, &modifiers, &keysym)) {
-				keybind_add(modifiers, keysym, p);
+			keystroke_t keys[MAX_CHORD];
+			size_t len;
+			if (keybind_parse_chord(pending_combo, keys, &len)) {
+				keybind_add(keys, len, p);
 			}
 			pending_combo[0] = '\0';
 		} else {
-			/* Check if line contains '+' (key combo) */
-			if (strchr(p, '+') != NULL) {
+			/* Check if line contains '+' or ';' (key combo or chord) */
+			if (strchr(p, '+') != NULL || strchr(p, ';') != NULL) {
 				snprintf(pending_combo, sizeof(pending_combo), "%s", p);
 			}
 		}
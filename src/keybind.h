@@ -25,11 +25,14 @@
 #ifndef BSPWM_KEYBIND_H
 #define BSPWM_KEYBIND_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
-#define MAX_KEYBINDS  256
 #define MAX_COMMAND   512
+#define MAX_CHORD     8      /* keys of a chord sequence */
+#define CHORD_TIMEOUT 2000   /* ms to wait for the next key of a chord */
+#define KEYBIND_INIT_CAP  16
 
 /* Modifier flags (match WLR_MODIFIER_* / X11 mod masks) */
 #define KBMOD_SHIFT   (1 << 0)
@@ -44,34 +47,73 @@
 typedef struct {
 	uint32_t modifiers;           /* KBMOD_* flags */
 	uint32_t keysym;              /* XKB keysym (e.g. XKB_KEY_Return) */
-	char command[MAX_COMMAND];    /* shell command to execute */
-} keybind_t;
+} keystroke_t;
 
+typedef struct keybind_t keybind_t;
+
+/* Bindings hashed on (modifiers, keysym), chained per bucket */
 typedef struct {
-	keybind_t binds[MAX_KEYBINDS];
-	int count;
-} keybind_table_t;
+	keybind_t **buckets;
+	size_t cap;                   /* power of two, 0 until the first add */
+	size_t count;
+} keybind_map_t;
+
+/* A node of the chord prefix tree: either a command or the keys that
+ * may follow it. */
+struct keybind_t {
+	keystroke_t key;
+	char command[MAX_COMMAND];    /* shell command, empty for a chord prefix */
+	char args[MAX_COMMAND];       /* NUL separated bspc arguments, see argc */
+	size_t args_len;
+	int argc;                     /* > 0 if command is a plain bspc call */
+	keybind_map_t next_keys;      /* continuations of a chord */
+	keybind_t *next;              /* bucket chain */
+};
 
-extern keybind_table_t keybind_table;
+/* The keys that start a binding */
+extern keybind_map_t keybind_table;
 
 /* Initialize the keybinding system */
 void keybind_init(void);
 
-/* Add a keybinding. Returns false if table is full. */
-bool keybind_add(uint32_t modifiers, uint32_t keysym, const char *command);
+/* Add a binding for the given sequence of keys, replacing the command of
+ * an existing one. Returns false if the sequence conflicts with a chord
+ * (it is a prefix of another binding, or has one as a prefix). */
+bool keybind_add(const keystroke_t *keys, size_t len, const char *command);
+
+/* Remove a binding. Returns false if there's none for this sequence. */
+bool keybind_remove(const keystroke_t *keys, size_t len);
 
 /* Remove all keybindings */
 void keybind_clear(void);
 
-/* Try to match a key event. Returns the command string if matched, NULL otherwise. */
-const char *keybind_match(uint32_t modifiers, uint32_t keysym);
+/* Feed a key press to the chord state machine. Returns the binding once
+ * it is complete, NULL otherwise. */
+const keybind_t *keybind_match(uint32_t modifiers, uint32_t keysym);
+
+/* Whether a chord is in progress, every key press belongs to it. */
+bool keybind_chord_pending(void);
+
+/* Milliseconds until the pending chord times out, -1 if there's none. */
+int keybind_chord_timeout(void);
+
+/* Abort the pending chord if it timed out. */
+void keybind_expire_chord(void);
 
 /* Parse a keybinding string like "super + Return" into modifiers + keysym.
  * Returns true on success. */
 bool keybind_parse_combo(const char *combo, uint32_t *modifiers, uint32_t *keysym);
 
-/* Execute a shell command asynchronously (fork+exec) */
-void keybind_exec(const char *command);
+/* Parse a sequence of combos separated by ';', like "super + w ; a".
+ * Returns true on success. */
+bool keybind_parse_chord(const char *chord, keystroke_t *keys, size_t *len);
+
+/* Print every binding, one "keys\n\tcommand" entry each */
+void keybind_list(FILE *rsp);
+
+/* Run the command of a binding: plain bspc calls are handed to
+ * process_message directly, anything else is spawned through the shell. */
+void keybind_exec(const keybind_t *kb);
 
 /* Load keybindings from a config file (sxhkd-compatible format) */
 bool keybind_load_config(const char *path);
@@ -0,0 +1,684 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "bspwm.h"
+#include "backend.h"
+#include "helpers.h"
+#include "tree.h"
+#include "lookup.h"
+
+/* Open-addressing table with linear probing. Every slot starts with its
+ * 32-bit key, zero marks an empty slot. */
+typedef struct {
+	uint8_t *slots;
+	size_t slot_size;
+	size_t cap;
+	size_t count;
+} id_table_t;
+
+typedef struct {
+	bspwm_wid_t win;
+	coordinates_t loc;
+} window_slot_t;
+
+typedef struct {
+	uint32_t id;
+	node_t *node;
+} node_slot_t;
+
+typedef struct {
+	uint32_t id;
+	int kind;
+	void *object;
+} object_slot_t;
+
+typedef enum {
+	SENT_POSITION = 1 << 0,
+	SENT_SIZE = 1 << 1,
+	SENT_BORDER = 1 << 2,
+	SENT_BORDER_COLOR = 1 << 3,
+	SENT_PARKED = 1 << 4,
+} sent_field_t;
+
+typedef struct {
+	bspwm_wid_t win;
+	uint8_t known;
+	bspwm_rect_t rect;
+	uint32_t border_width;
+	uint32_t border_color;
+} sent_slot_t;
+
+static id_table_t window_table = {NULL, sizeof(window_slot_t), 0, 0};
+static id_table_t node_table = {NULL, sizeof(node_slot_t), 0, 0};
+static id_table_t sent_table = {NULL, sizeof(sent_slot_t), 0, 0};
+static id_table_t object_table = {NULL, sizeof(object_slot_t), 0, 0};
+
+lookup_stats_t lookup_stats;
+
+#define SLOT_AT(t, i)  ((void *) ((t)->slots + (i) * (t)->slot_size))
+#define SLOT_KEY(s)    (*(uint32_t *) (s))
+
+/* Fibonacci hashing: ids are mostly sequential, keeping the top bits of
+ * the product spreads them over the whole table. */
+static inline size_t slot_index(uint32_t key, size_t cap)
+{
+	return (uint32_t) (key * UINT32_C(2654435769)) >> (32 - __builtin_ctzl(cap));
+}
+
+static bool id_table_grow(id_table_t *t)
+{
+	size_t cap = t->cap == 0 ? ID_TABLE_INIT_CAP : t->cap;
+	if (t->cap > 0 && !safe_double(&cap)) {
+		return false;
+	}
+	uint8_t *slots = safe_calloc(cap, t->slot_size);
+	if (slots == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < t->cap; i++) {
+		void *s = SLOT_AT(t, i);
+		if (SLOT_KEY(s) == 0) {
+			continue;
+		}
+		size_t j = slot_index(SLOT_KEY(s), cap);
+		while (SLOT_KEY(slots + j * t->slot_size) != 0) {
+			j = (j + 1) & (cap - 1);
+		}
+		memcpy(slots + j * t->slot_size, s, t->slot_size);
+	}
+	free(t->slots);
+	t->slots = slots;
+	t->cap = cap;
+	return true;
+}
+
+static void *id_table_find(id_table_t *t, uint32_t key)
+{
+	if (t->cap == 0 || key == 0) {
+		return NULL;
+	}
+	for (size_t i = slot_index(key, t->cap); SLOT_KEY(SLOT_AT(t, i)) != 0; i = (i + 1) & (t->cap - 1)) {
+		if (SLOT_KEY(SLOT_AT(t, i)) == key) {
+			return SLOT_AT(t, i);
+		}
+	}
+	return NULL;
+}
+
+/* Return the slot of the given key, claiming a new one if needed. */
+static void *id_table_insert(id_table_t *t, uint32_t key)
+{
+	if (key == 0) {
+		return NULL;
+	}
+	void *s = id_table_find(t, key);
+	if (s != NULL) {
+		return s;
+	}
+	/* Keep the load factor under one half */
+	if (2 * (t->count + 1) > t->cap && !id_table_grow(t)) {
+		warn("Failed to grow an id table.\n");
+		return NULL;
+	}
+	size_t i = slot_index(key, t->cap);
+	while (SLOT_KEY(SLOT_AT(t, i)) != 0) {
+		i = (i + 1) & (t->cap - 1);
+	}
+	s = SLOT_AT(t, i);
+	SLOT_KEY(s) = key;
+	t->count++;
+	return s;
+}
+
+/* Backward-shift deletion: no tombstones, probe chains stay short. */
+static void id_table_delete(id_table_t *t, void *s)
+{
+	size_t mask = t->cap - 1;
+	size_t i = ((uint8_t *) s - t->slots) / t->slot_size;
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		void *sj = SLOT_AT(t, j);
+		if (SLOT_KEY(sj) == 0) {
+			break;
+		}
+		size_t k = slot_index(SLOT_KEY(sj), t->cap);
+		/* Move j into the hole at i unless its home slot k lies cyclically in (i, j] */
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+			memcpy(SLOT_AT(t, i), sj, t->slot_size);
+			i = j;
+		}
+	}
+	memset(SLOT_AT(t, i), 0, t->slot_size);
+	t->count--;
+}
+
+static void id_table_clear(id_table_t *t)
+{
+	free(t->slots);
+	t->slots = NULL;
+	t->cap = t->count = 0;
+}
+
+#undef SLOT_AT
+#undef SLOT_KEY
+
+void window_index_add(bspwm_wid_t win, monitor_t *m, desktop_t *d, node_t *n)
+{
+	window_slot_t *s = id_table_insert(&window_table, win);
+	if (s != NULL) {
+		s->loc = (coordinates_t) {m, d, n};
+	}
+}
+
+void window_index_remove(bspwm_wid_t win)
+{
+	window_slot_t *s = id_table_find(&window_table, win);
+	if (s != NULL) {
+		id_table_delete(&window_table, s);
+	}
+}
+
+bool window_index_get(bspwm_wid_t win, coordinates_t *loc)
+{
+	window_slot_t *s = id_table_find(&window_table, win);
+	if (s == NULL) {
+		lookup_stats.window_misses++;
+		return false;
+	}
+	lookup_stats.window_hits++;
+	*loc = s->loc;
+	return true;
+}
+
+void window_index_add_in(monitor_t *m, desktop_t *d, node_t *n)
+{
+	for (node_t *f = first_extrema(n); f != NULL; f = next_leaf(f, n)) {
+		if (f->client != NULL) {
+			window_index_add(f->id, m, d, f);
+		}
+	}
+}
+
+void window_index_remove_in(node_t *n)
+{
+	for (node_t *f = first_extrema(n); f != NULL; f = next_leaf(f, n)) {
+		if (f->client != NULL) {
+			window_index_remove(f->id);
+		}
+	}
+}
+
+void window_index_clear(void)
+{
+	id_table_clear(&window_table);
+}
+
+static uint8_t node_flags(node_t *n)
+{
+	return (n->hidden ? 1u << NODE_FLAG_HIDDEN : 0) |
+	       (n->sticky ? 1u << NODE_FLAG_STICKY : 0) |
+	       (n->private ? 1u << NODE_FLAG_PRIVATE : 0) |
+	       (n->locked ? 1u << NODE_FLAG_LOCKED : 0) |
+	       (n->marked ? 1u << NODE_FLAG_MARKED : 0) |
+	       (n->client != NULL && n->client->urgent ? 1u << NODE_FLAG_URGENT : 0);
+}
+
+static void flag_link(monitor_t *m, desktop_t *d, node_t *n, node_flag_t f)
+{
+	n->flag_prev[f] = NULL;
+	n->flag_next[f] = d->flag_head[f];
+	if (d->flag_head[f] != NULL) {
+		d->flag_head[f]->flag_prev[f] = n;
+	}
+	d->flag_head[f] = n;
+	d->flag_count[f]++;
+	if (m != NULL) {
+		m->flag_count[f]++;
+	}
+	n->indexed_flags |= 1u << f;
+}
+
+static void flag_unlink(monitor_t *m, desktop_t *d, node_t *n, node_flag_t f)
+{
+	if (n->flag_prev[f] != NULL) {
+		n->flag_prev[f]->flag_next[f] = n->flag_next[f];
+	} else {
+		d->flag_head[f] = n->flag_next[f];
+	}
+	if (n->flag_next[f] != NULL) {
+		n->flag_next[f]->flag_prev[f] = n->flag_prev[f];
+	}
+	n->flag_prev[f] = n->flag_next[f] = NULL;
+	d->flag_count[f]--;
+	if (m != NULL) {
+		m->flag_count[f]--;
+	}
+	n->indexed_flags &= ~(1u << f);
+}
+
+/* Preorder successor of n within the subtree rooted at r. */
+static node_t *next_in_subtree(node_t *n, node_t *r)
+{
+	if (n->first_child != NULL) {
+		return n->first_child;
+	}
+	while (n != r && n->parent != NULL) {
+		if (n == n->parent->first_child && n->parent->second_child != NULL) {
+			return n->parent->second_child;
+		}
+		n = n->parent;
+	}
+	return NULL;
+}
+
+void flag_index_update(monitor_t *m, desktop_t *d, node_t *n)
+{
+	if (d == NULL || n == NULL) {
+		return;
+	}
+	uint8_t flags = node_flags(n);
+	uint8_t changed = flags ^ n->indexed_flags;
+	for (node_flag_t f = 0; changed != 0; f++, changed >>= 1) {
+		if (!(changed & 1)) {
+			continue;
+		}
+		if (flags & (1u << f)) {
+			flag_link(m, d, n, f);
+		} else {
+			flag_unlink(m, d, n, f);
+		}
+	}
+}
+
+void flag_index_add_in(monitor_t *m, desktop_t *d, node_t *n)
+{
+	for (node_t *f = n; f != NULL; f = next_in_subtree(f, n)) {
+		flag_index_update(m, d, f);
+	}
+	spatial_index_invalidate(d);
+}
+
+void flag_index_remove(monitor_t *m, desktop_t *d, node_t *n)
+{
+	for (node_flag_t f = 0; n->indexed_flags != 0; f++) {
+		if (n->indexed_flags & (1u << f)) {
+			flag_unlink(m, d, n, f);
+		}
+	}
+}
+
+void flag_index_remove_in(monitor_t *m, desktop_t *d, node_t *n)
+{
+	if (d == NULL) {
+		return;
+	}
+	for (node_t *f = n; f != NULL; f = next_in_subtree(f, n)) {
+		flag_index_remove(m, d, f);
+	}
+	spatial_index_invalidate(d);
+}
+
+void flag_index_attach(monitor_t *m, desktop_t *d)
+{
+	for (node_flag_t f = 0; f < NODE_FLAGS_COUNT; f++) {
+		m->flag_count[f] += d->flag_count[f];
+	}
+}
+
+void flag_index_detach(monitor_t *m, desktop_t *d)
+{
+	for (node_flag_t f = 0; f < NODE_FLAGS_COUNT; f++) {
+		m->flag_count[f] -= d->flag_count[f];
+	}
+}
+
+/* Picks, among the flags of 'flags', the one with the fewest nodes in
+ * 'counts'. Returns false when one of them has none. */
+bool flag_index_rarest(const unsigned int *counts, uint8_t flags, node_flag_t *rarest)
+{
+	unsigned int best = UINT_MAX;
+	for (node_flag_t f = 0; f < NODE_FLAGS_COUNT; f++) {
+		if (!(flags & (1u << f))) {
+			continue;
+		}
+		if (counts[f] == 0) {
+			return false;
+		}
+		if (counts[f] < best) {
+			best = counts[f];
+			*rarest = f;
+		}
+	}
+	return true;
+}
+
+/* The edge of r facing a window searched from in direction dir, computed
+ * as boundary_distance does. */
+static int32_t facing_edge(bspwm_rect_t r, direction_t dir)
+{
+	switch (dir) {
+		case DIR_NORTH:
+			return (int16_t) (r.y + r.height - 1);
+		case DIR_WEST:
+			return (int16_t) (r.x + r.width - 1);
+		case DIR_SOUTH:
+			return r.y;
+		default:
+			return r.x;
+	}
+}
+
+static int key_cmp(const void *a, const void *b)
+{
+	int32_t ka = ((const spatial_key_t *) a)->key;
+	int32_t kb = ((const spatial_key_t *) b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+static bool spatial_index_reserve(spatial_index_t *s, uint32_t n)
+{
+	if (n <= s->capacity) {
+		return true;
+	}
+	uint32_t cap = MAX(n, 2 * s->capacity);
+	spatial_entry_t *entries = realloc(s->entries, cap * sizeof(spatial_entry_t));
+	if (entries == NULL) {
+		return false;
+	}
+	s->entries = entries;
+	for (int i = 0; i < 4; i++) {
+		spatial_key_t *keys = realloc(s->keys[i], cap * sizeof(spatial_key_t));
+		if (keys == NULL) {
+			return false;
+		}
+		s->keys[i] = keys;
+	}
+	s->capacity = cap;
+	return true;
+}
+
+spatial_index_t *spatial_index_get(desktop_t *d)
+{
+	spatial_index_t *s = &d->spatial;
+	if (s->valid) {
+		return s;
+	}
+
+	uint32_t tiled = 0, floating = 0;
+	for (node_t *f = first_extrema(d->root); f != NULL; f = next_leaf(f, d->root)) {
+		if (f->client != NULL) {
+			if (IS_FLOATING(f->client)) {
+				floating++;
+			} else {
+				tiled++;
+			}
+		}
+	}
+	if (!spatial_index_reserve(s, tiled + floating)) {
+		return NULL;
+	}
+
+	/* Floating rectangles change without a layout pass: those leaves are
+	 * only listed, their rectangles are read at search time. */
+	uint32_t t = 0, fl = tiled, order = 0;
+	for (node_t *f = first_extrema(d->root); f != NULL; f = next_leaf(f, d->root)) {
+		if (f->client == NULL) {
+			continue;
+		}
+		if (IS_FLOATING(f->client)) {
+			s->entries[fl++] = (spatial_entry_t) {f, f->client->floating_rectangle, order++};
+			continue;
+		}
+		s->entries[t] = (spatial_entry_t) {f, f->client->tiled_rectangle, order++};
+		for (direction_t dir = DIR_NORTH; dir <= DIR_EAST; dir++) {
+			s->keys[dir][t] = (spatial_key_t) {facing_edge(s->entries[t].rect, dir), t};
+		}
+		t++;
+	}
+	for (direction_t dir = DIR_NORTH; dir <= DIR_EAST; dir++) {
+		qsort(s->keys[dir], tiled, sizeof(spatial_key_t), key_cmp);
+	}
+
+	s->tiled_count = tiled;
+	s->floating_count = floating;
+	s->valid = true;
+	return s;
+}
+
+void spatial_index_invalidate(desktop_t *d)
+{
+	d->spatial.valid = false;
+}
+
+void spatial_index_free(desktop_t *d)
+{
+	spatial_index_t *s = &d->spatial;
+	free(s->entries);
+	for (int i = 0; i < 4; i++) {
+		free(s->keys[i]);
+	}
+	*s = (spatial_index_t) {0};
+}
+
+static client_t *managed_client(bspwm_wid_t win)
+{
+	window_slot_t *s = id_table_find(&window_table, win);
+	return s != NULL && s->loc.node != NULL ? s->loc.node->client : NULL;
+}
+
+void client_geometry_sent(bspwm_wid_t win, bspwm_rect_t r, unsigned int fields)
+{
+	client_t *c = managed_client(win);
+	if (c == NULL) {
+		return;
+	}
+	c->geometry_serial = backend_configure_serial();
+	if (fields == (GEOMETRY_POSITION | GEOMETRY_SIZE)) {
+		c->geometry = r;
+		c->geometry_known = true;
+	} else if (c->geometry_known) {
+		if (fields & GEOMETRY_POSITION) {
+			c->geometry.x = r.x;
+			c->geometry.y = r.y;
+		}
+		if (fields & GEOMETRY_SIZE) {
+			c->geometry.width = r.width;
+			c->geometry.height = r.height;
+		}
+	}
+}
+
+/* Serials only carry their low 16 bits in the events. */
+void client_geometry_observed(bspwm_wid_t win, bspwm_rect_t r, uint32_t serial)
+{
+	client_t *c = managed_client(win);
+	if (c == NULL || (int16_t) (uint16_t) (serial - c->geometry_serial) < 0) {
+		return;
+	}
+	c->geometry = r;
+	c->geometry_known = true;
+}
+
+/* A later node with the same id takes the slot over: ids are unique in a
+ * consistent tree and a stale entry must never outlive its node. */
+void node_registry_add(node_t *n)
+{
+	node_slot_t *s = id_table_insert(&node_table, n->id);
+	if (s != NULL) {
+		s->node = n;
+	}
+}
+
+void node_registry_remove(node_t *n)
+{
+	node_slot_t *s = id_table_find(&node_table, n->id);
+	if (s != NULL && s->node == n) {
+		id_table_delete(&node_table, s);
+	}
+}
+
+void node_registry_set_id(node_t *n, uint32_t id)
+{
+	node_registry_remove(n);
+	n->id = id;
+	node_registry_add(n);
+}
+
+node_t *node_registry_get(uint32_t id)
+{
+	node_slot_t *s = id_table_find(&node_table, id);
+	return s == NULL ? NULL : s->node;
+}
+
+void node_registry_clear(void)
+{
+	id_table_clear(&node_table);
+}
+
+size_t node_registry_count(void)
+{
+	return node_table.count;
+}
+
+void object_registry_add(uint32_t id, int kind, void *object)
+{
+	object_slot_t *s = id_table_insert(&object_table, id);
+	if (s != NULL) {
+		s->kind = kind;
+		s->object = object;
+	}
+}
+
+void object_registry_remove(uint32_t id)
+{
+	object_slot_t *s = id_table_find(&object_table, id);
+	if (s != NULL) {
+		id_table_delete(&object_table, s);
+	}
+}
+
+void *object_registry_get(uint32_t id, int kind)
+{
+	object_slot_t *s = id_table_find(&object_table, id);
+	return (s == NULL || s->kind != kind) ? NULL : s->object;
+}
+
+void object_registry_clear(void)
+{
+	id_table_clear(&object_table);
+}
+
+/* When the table can't grow, report a change: sending too much is safe. */
+bool sent_geometry_record_position(bspwm_wid_t win, int16_t x, int16_t y)
+{
+	sent_slot_t *s = id_table_insert(&sent_table, win);
+	if (s == NULL) {
+		return true;
+	}
+	if ((s->known & SENT_POSITION) && s->rect.x == x && s->rect.y == y) {
+		return false;
+	}
+	s->known |= SENT_POSITION;
+	s->rect.x = x;
+	s->rect.y = y;
+	return true;
+}
+
+bool sent_geometry_record_size(bspwm_wid_t win, uint16_t w, uint16_t h)
+{
+	sent_slot_t *s = id_table_insert(&sent_table, win);
+	if (s == NULL) {
+		return true;
+	}
+	if ((s->known & SENT_SIZE) && s->rect.width == w && s->rect.height == h) {
+		return false;
+	}
+	s->known |= SENT_SIZE;
+	s->rect.width = w;
+	s->rect.height = h;
+	return true;
+}
+
+bool sent_geometry_record_border(bspwm_wid_t win, uint32_t bw)
+{
+	sent_slot_t *s = id_table_insert(&sent_table, win);
+	if (s == NULL) {
+		return true;
+	}
+	if ((s->known & SENT_BORDER) && s->border_width == bw) {
+		return false;
+	}
+	s->known |= SENT_BORDER;
+	s->border_width = bw;
+	return true;
+}
+
+bool sent_geometry_record_border_color(bspwm_wid_t win, uint32_t color)
+{
+	sent_slot_t *s = id_table_insert(&sent_table, win);
+	if (s == NULL) {
+		return true;
+	}
+	if ((s->known & SENT_BORDER_COLOR) && s->border_color == color) {
+		return false;
+	}
+	s->known |= SENT_BORDER_COLOR;
+	s->border_color = color;
+	return true;
+}
+
+bool sent_geometry_record_parked(bspwm_wid_t win, bool parked, bspwm_rect_t *rect)
+{
+	sent_slot_t *s = id_table_insert(&sent_table, win);
+	if (s == NULL || !(s->known & SENT_POSITION) || parked == ((s->known & SENT_PARKED) != 0)) {
+		return false;
+	}
+	if (parked) {
+		s->known |= SENT_PARKED;
+	} else {
+		s->known &= ~SENT_PARKED;
+	}
+	*rect = s->rect;
+	return true;
+}
+
+bool sent_geometry_parked(bspwm_wid_t win)
+{
+	sent_slot_t *s = id_table_find(&sent_table, win);
+	return s != NULL && (s->known & SENT_PARKED);
+}
+
+void sent_geometry_forget(bspwm_wid_t win)
+{
+	sent_slot_t *s = id_table_find(&sent_table, win);
+	if (s != NULL) {
+		id_table_delete(&sent_table, s);
+	}
+}
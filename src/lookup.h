@@ -0,0 +1,126 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BSPWM_LOOKUP_H
+#define BSPWM_LOOKUP_H
+
+#include "types.h"
+
+#define ID_TABLE_INIT_CAP  64
+
+/* Index from window id to the coordinates of its node. It is kept in sync
+ * by the tree operations that move client nodes between desktops and
+ * monitors. */
+void window_index_add(bspwm_wid_t win, monitor_t *m, desktop_t *d, node_t *n);
+void window_index_remove(bspwm_wid_t win);
+bool window_index_get(bspwm_wid_t win, coordinates_t *loc);
+void window_index_add_in(monitor_t *m, desktop_t *d, node_t *n);
+void window_index_remove_in(node_t *n);
+void window_index_clear(void);
+
+/* Per-desktop lists of the nodes having each flag, see node_flag_t. The
+ * monitor counts are the sums over its desktops. flag_index_update links
+ * and unlinks a node after one of its flags changed; the _in variants
+ * cover a subtree entering or leaving a desktop, attach and detach a
+ * desktop entering or leaving a monitor. */
+void flag_index_update(monitor_t *m, desktop_t *d, node_t *n);
+void flag_index_add_in(monitor_t *m, desktop_t *d, node_t *n);
+void flag_index_remove(monitor_t *m, desktop_t *d, node_t *n);
+void flag_index_remove_in(monitor_t *m, desktop_t *d, node_t *n);
+void flag_index_attach(monitor_t *m, desktop_t *d);
+void flag_index_detach(monitor_t *m, desktop_t *d);
+bool flag_index_rarest(const unsigned int *counts, uint8_t flags, node_flag_t *rarest);
+
+/* Spatial index of the client leaves of each desktop, for the directional
+ * searches. It is rebuilt on demand after being invalidated by a subtree
+ * entering or leaving the desktop, a layout pass moving one of its
+ * leaves, or a state change. Returns NULL when out of memory. */
+spatial_index_t *spatial_index_get(desktop_t *d);
+void spatial_index_invalidate(desktop_t *d);
+void spatial_index_free(desktop_t *d);
+
+/* Registry of every live node by id, receptacles and internal nodes
+ * included. Nodes enter it in make_node and leave it when freed. */
+void node_registry_add(node_t *n);
+void node_registry_remove(node_t *n);
+void node_registry_set_id(node_t *n, uint32_t id);
+node_t *node_registry_get(uint32_t id);
+void node_registry_clear(void);
+size_t node_registry_count(void);
+
+/* Registry of the objects a backend identifies by its own ids, each with
+ * a kind chosen by the backend. A lookup only finds an object of the
+ * kind asked for. */
+void object_registry_add(uint32_t id, int kind, void *object);
+void object_registry_remove(uint32_t id);
+void *object_registry_get(uint32_t id, int kind);
+void object_registry_clear(void);
+
+/* Geometry of the managed windows, kept in their client so that reading
+ * it takes no round trip. It follows the configure requests we send, the
+ * serial of the last one being recorded, and the geometry the server
+ * reports, unless the report predates that request. */
+#define GEOMETRY_POSITION  (1 << 0)
+#define GEOMETRY_SIZE      (1 << 1)
+
+void client_geometry_sent(bspwm_wid_t win, bspwm_rect_t r, unsigned int fields);
+void client_geometry_observed(bspwm_wid_t win, bspwm_rect_t r, uint32_t serial);
+
+/* Last geometry and border the backend sent to each window. The
+ * record_* functions store the new values and tell whether they differ
+ * from the recorded ones, so that no-op configures can be dropped. */
+bool sent_geometry_record_position(bspwm_wid_t win, int16_t x, int16_t y);
+bool sent_geometry_record_size(bspwm_wid_t win, uint16_t w, uint16_t h);
+bool sent_geometry_record_border(bspwm_wid_t win, uint32_t bw);
+bool sent_geometry_record_border_color(bspwm_wid_t win, uint32_t color);
+void sent_geometry_forget(bspwm_wid_t win);
+
+/* Parked windows keep their recorded position, the one to restore on
+ * unparking. record_parked fails for a window whose position was never
+ * sent, otherwise it tells whether the state changed and gives the
+ * recorded geometry. */
+bool sent_geometry_record_parked(bspwm_wid_t win, bool parked, bspwm_rect_t *rect);
+bool sent_geometry_parked(bspwm_wid_t win);
+
+/* Counters of query --metrics: the window index lookups, the reads of
+ * get_window_rectangle the cached geometry answered, the configures
+ * the backends sent or dropped as repeating the last sent values, and
+ * the windows parked and mapped. */
+typedef struct {
+	uint64_t window_hits;
+	uint64_t window_misses;
+	uint64_t geometry_hits;
+	uint64_t geometry_misses;
+	uint64_t configures_sent;
+	uint64_t configures_suppressed;
+	uint64_t parks;
+	uint64_t unparks;
+	uint64_t maps;
+	uint64_t unmaps;
+} lookup_stats_t;
+
+extern lookup_stats_t lookup_stats;
+
+#endif
@@ -29,14 +29,20 @@
 #include <stdarg.h>
 #include <inttypes.h>
 #include <unistd.h>
+#include <arpa/inet.h>
 #include "bspwm.h"
 #include "desktop.h"
+#include "ewmh.h"
+#include "history.h"
 #include "monitor.h"
 #include "pointer.h"
 #include "query.h"
 #include "rule.h"
 #include "restore.h"
 #include "settings.h"
+#include "stack.h"
+#include "stats.h"
+#include "trace.h"
 #include "tree.h"
 #include "window.h"
 #include "common.h"
@@ -45,16 +51,188 @@
 #include "keybind.h"
 #include "messages.h"
 
+/* The settings known to config, see set_setting and get_setting */
+#define SETTINGS(X) \
+	X(BORDER_WIDTH, border_width) \
+	X(HONOR_SIZE_HINTS, honor_size_hints) \
+	X(WINDOW_GAP, window_gap) \
+	X(TOP_PADDING, top_padding) \
+	X(RIGHT_PADDING, right_padding) \
+	X(BOTTOM_PADDING, bottom_padding) \
+	X(LEFT_PADDING, left_padding) \
+	X(TOP_MONOCLE_PADDING, top_monocle_padding) \
+	X(RIGHT_MONOCLE_PADDING, right_monocle_padding) \
+	X(BOTTOM_MONOCLE_PADDING, bottom_monocle_padding) \
+	X(LEFT_MONOCLE_PADDING, left_monocle_padding) \
+	X(EXTERNAL_RULES_COMMAND, external_rules_command) \
+	X(STATUS_PREFIX, status_prefix) \
+	X(EXTERNAL_RULES_DAEMON, external_rules_daemon) \
+	X(EXTERNAL_RULES_TIMEOUT, external_rules_timeout) \
+	X(HISTORY_SIZE, history_size) \
+	X(SPLIT_RATIO, split_ratio) \
+	X(NORMAL_BORDER_COLOR, normal_border_color) \
+	X(ACTIVE_BORDER_COLOR, active_border_color) \
+	X(FOCUSED_BORDER_COLOR, focused_border_color) \
+	X(PRESEL_FEEDBACK_COLOR, presel_feedback_color) \
+	X(INITIAL_POLARITY, initial_polarity) \
+	X(AUTOMATIC_SCHEME, automatic_scheme) \
+	X(SUBSCRIBER_OVERFLOW, subscriber_overflow) \
+	X(MAPPING_EVENTS_COUNT, mapping_events_count) \
+	X(DIRECTIONAL_FOCUS_TIGHTNESS, directional_focus_tightness) \
+	X(IGNORE_EWMH_FULLSCREEN, ignore_ewmh_fullscreen) \
+	X(POINTER_MODIFIER, pointer_modifier) \
+	X(POINTER_MOTION_INTERVAL, pointer_motion_interval) \
+	X(POINTER_ACTION1, pointer_action1) \
+	X(POINTER_ACTION2, pointer_action2) \
+	X(POINTER_ACTION3, pointer_action3) \
+	X(CLICK_TO_FOCUS, click_to_focus) \
+	X(SINGLE_MONOCLE, single_monocle) \
+	X(FOCUS_FOLLOWS_POINTER, focus_follows_pointer) \
+	X(PRESEL_FEEDBACK, presel_feedback) \
+	X(BORDERLESS_MONOCLE, borderless_monocle) \
+	X(GAPLESS_MONOCLE, gapless_monocle) \
+	X(BORDERLESS_SINGLETON, borderless_singleton) \
+	X(SWALLOW_FIRST_CLICK, swallow_first_click) \
+	X(POINTER_MOTION_SYNC, pointer_motion_sync) \
+	X(POINTER_FOLLOWS_FOCUS, pointer_follows_focus) \
+	X(POINTER_FOLLOWS_MONITOR, pointer_follows_monitor) \
+	X(IGNORE_EWMH_FOCUS, ignore_ewmh_focus) \
+	X(IGNORE_EWMH_STRUTS, ignore_ewmh_struts) \
+	X(CENTER_PSEUDO_TILED, center_pseudo_tiled) \
+	X(COMPOSITED_SWITCHING, composited_switching) \
+	X(REMOVAL_ADJUSTMENT, removal_adjustment) \
+	X(TILE_LIMIT_ENABLED, tile_limit_enabled) \
+	X(MAX_TILES_PER_DESKTOP, max_tiles_per_desktop) \
+	X(EDGE_SNAP_ENABLED, edge_snap_enabled) \
+	X(EDGE_SNAP_THRESHOLD, edge_snap_threshold) \
+	X(RAISE_FLOATING_ON_CLICK, raise_floating_on_click) \
+	X(CASCADE_OFFSET, cascade_offset) \
+	X(CONFIGURE_RATE_LIMIT, configure_rate_limit) \
+	X(REMOVE_DISABLED_MONITORS, remove_disabled_monitors) \
+	X(REMOVE_UNPLUGGED_MONITORS, remove_unplugged_monitors) \
+	X(MERGE_OVERLAPPING_MONITORS, merge_overlapping_monitors) \
+	X(ADAPTIVE_SYNC, adaptive_sync)
+
+#define SETTING_ID(id, name)  SETTING_##id,
+#define SETTING_NAME(id, name)  #name,
+typedef enum {
+	SETTINGS(SETTING_ID)
+} setting_id_t;
+static const char *const setting_names[] = {SETTINGS(SETTING_NAME)};
+#undef SETTING_ID
+#undef SETTING_NAME
+
+static name_table_t setting_table = NAME_TABLE(setting_names);
+
+/* Command flags, as the short and the long spelling, NULL when there is
+ * none; both map to the same option id. */
+#define OPTION_NAMES(id, short_name, long_name)  short_name, long_name,
+
+#define NODE_OPTIONS(X) \
+	X(FOCUS, "-f", "--focus") \
+	X(ACTIVATE, "-a", "--activate") \
+	X(TO_DESKTOP, "-d", "--to-desktop") \
+	X(TO_MONITOR, "-m", "--to-monitor") \
+	X(TO_NODE, "-n", "--to-node") \
+	X(SWAP, "-s", "--swap") \
+	X(LAYER, "-l", "--layer") \
+	X(STATE, "-t", "--state") \
+	X(FLAG, "-g", "--flag") \
+	X(PRESEL_DIR, "-p", "--presel-dir") \
+	X(PRESEL_RATIO, "-o", "--presel-ratio") \
+	X(MOVE, "-v", "--move") \
+	X(RESIZE, "-z", "--resize") \
+	X(TYPE, "-y", "--type") \
+	X(RATIO, "-r", "--ratio") \
+	X(FLIP, "-F", "--flip") \
+	X(ROTATE, "-R", "--rotate") \
+	X(EQUALIZE, "-E", "--equalize") \
+	X(BALANCE, "-B", "--balance") \
+	X(CIRCULATE, "-C", "--circulate") \
+	X(INSERT_RECEPTACLE, "-i", "--insert-receptacle") \
+	X(CENTER, NULL, "--center") \
+	X(CLOSE, "-c", "--close") \
+	X(KILL, "-k", "--kill")
+
+#define OPTION_ID(id, short_name, long_name)  NODE_OPT_##id,
+enum {
+	NODE_OPTIONS(OPTION_ID)
+};
+#undef OPTION_ID
+static const char *const node_option_names[] = {NODE_OPTIONS(OPTION_NAMES)};
+static name_table_t node_option_table = NAME_TABLE(node_option_names);
+
+#define DESKTOP_OPTIONS(X) \
+	X(FOCUS, "-f", "--focus") \
+	X(ACTIVATE, "-a", "--activate") \
+	X(TO_MONITOR, "-m", "--to-monitor") \
+	X(SWAP, "-s", "--swap") \
+	X(BUBBLE, "-b", "--bubble") \
+	X(LAYOUT, "-l", "--layout") \
+	X(RENAME, "-n", "--rename") \
+	X(REMOVE, "-r", "--remove")
+
+#define OPTION_ID(id, short_name, long_name)  DESKTOP_OPT_##id,
+enum {
+	DESKTOP_OPTIONS(OPTION_ID)
+};
+#undef OPTION_ID
+static const char *const desktop_option_names[] = {DESKTOP_OPTIONS(OPTION_NAMES)};
+static name_table_t desktop_option_table = NAME_TABLE(desktop_option_names);
+
+#define MONITOR_OPTIONS(X) \
+	X(FOCUS, "-f", "--focus") \
+	X(SWAP, "-s", "--swap") \
+	X(RESET_DESKTOPS, "-d", "--reset-desktops") \
+	X(ADD_DESKTOPS, "-a", "--add-desktops") \
+	X(REMOVE, "-r", "--remove") \
+	X(REORDER_DESKTOPS, "-o", "--reorder-desktops") \
+	X(RECTANGLE, "-g", "--rectangle") \
+	X(RENAME, "-n", "--rename")
+
+#define OPTION_ID(id, short_name, long_name)  MONITOR_OPT_##id,
+enum {
+	MONITOR_OPTIONS(OPTION_ID)
+};
+#undef OPTION_ID
+static const char *const monitor_option_names[] = {MONITOR_OPTIONS(OPTION_NAMES)};
+static name_table_t monitor_option_table = NAME_TABLE(monitor_option_names);
+
+#define CONFIG_OPTIONS(X) \
+	X(MONITOR, "-m", "--monitor") \
+	X(DESKTOP, "-d", "--desktop") \
+	X(NODE, "-n", "--node")
+
+#define OPTION_ID(id, short_name, long_name)  CONFIG_OPT_##id,
+enum {
+	CONFIG_OPTIONS(OPTION_ID)
+};
+#undef OPTION_ID
+static const char *const config_option_names[] = {CONFIG_OPTIONS(OPTION_NAMES)};
+static name_table_t config_option_table = NAME_TABLE(config_option_names);
+
+#undef OPTION_NAMES
+
+static int find_option(name_table_t *table, const char *arg)
+{
+	int i = name_table_lookup(table, arg);
+	return i < 0 ? -1 : i / 2;
+}
+
 void handle_message(char *msg, int msg_len, FILE *rsp)
 {
 	/*
 	 * Use scratch arena for args - no need to free on error paths.
 	 * scratch_reset() is called after handle_message() returns.
-	 * Pre-allocate 256 slots (2KB) - enough for any reasonable command.
+	 * One slot per null terminated argument, messages have no length
+	 * limit but the connection's.
 	 */
-	#define MAX_ARGS 256
 	int num = 0;
-	char **args = scratch_alloc(MAX_ARGS * sizeof(char *));
+	int count = 0;
+	for (int i = 0; i < msg_len; i++) {
+		count += (msg[i] == 0);
+	}
+	char **args = scratch_alloc(MAX(count, 1) * sizeof(char *));
 
 	if (args == NULL) {
 		perror("Handle message: scratch_alloc");
@@ -64,17 +242,6 @@ void handle_message(char *msg, int msg_len, FILE *rsp)
 
 	for (int i = 0, j = 0; i < msg_len; i++) {
 		if (msg[i] == 0) {
-			if (j >= msg_len) {
-				/* No free needed - scratch_reset handles it */
-				perror("Handle message: buffer overflow");
-				fclose(rsp);
-				return;
-			}
-			if (num >= MAX_ARGS) {
-				fail(rsp, "Too many arguments.\n");
-				fclose(rsp);
-				return;
-			}
 			args[num++] = msg + j;
 			j = i + 1;
 		}
@@ -106,14 +273,25 @@ static const command_entry_t command_table[] = {
 	{"rule", cmd_rule, false},
 	{"config", cmd_config, false},
 	{"keybind", cmd_keybind, false},
+	{"batch", cmd_batch, false},
 	{NULL, NULL, false}
 };
 
+static latency_histogram_t *command_latency[LENGTH(command_table)];
+
 void process_message(char **args, int num, FILE *rsp)
 {
 	for (const command_entry_t *cmd = command_table; cmd->name; cmd++) {
 		if (streq(cmd->name, *args)) {
+			size_t i = cmd - command_table;
+			if (command_latency[i] == NULL) {
+				command_latency[i] = make_latency_histogram(LATENCY_COMMANDS, cmd->name);
+			}
+			uint64_t start = latency_now();
+			scratch_mark_t mark = scratch_mark();
 			cmd->handler(++args, --num, rsp);
+			latency_record_scratch(command_latency[i], scratch_release(mark));
+			latency_record(command_latency[i], start);
 			if (cmd->returns_early) return;
 			goto found;
 		}
@@ -166,496 +344,537 @@ void cmd_node(char **args, int num, FILE *rsp)
 	bool changed = false;
 
 	while (num > 0) {
-		if (streq("-f", *args) || streq("--focus", *args)) {
-			coordinates_t dst = trg;
-			if (num > 1 && *(args + 1)[0] != OPT_CHR) {
-				num--, args++;
-				int ret;
-				if ((ret = node_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
-					handle_failure(ret, "node -f", *args, rsp);
-					break;
+		int opt = find_option(&node_option_table, *args);
+		switch (opt) {
+			case NODE_OPT_FOCUS: {
+				coordinates_t dst = trg;
+				if (num > 1 && *(args + 1)[0] != OPT_CHR) {
+					num--, args++;
+					int ret;
+					if ((ret = node_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
+						handle_failure(ret, "node -f", *args, rsp);
+						goto end;
+					}
 				}
-			}
-			if (dst.node == NULL || !focus_node(dst.monitor, dst.desktop, dst.node)) {
-				fail(rsp, "%s", "");
-				break;
-			}
-		} else if (streq("-a", *args) || streq("--activate", *args)) {
-			coordinates_t dst = trg;
-			if (num > 1 && *(args + 1)[0] != OPT_CHR) {
-				num--, args++;
-				int ret;
-				if ((ret = node_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
-					handle_failure(ret, "node -a", *args, rsp);
-					break;
+				if (dst.node == NULL || !focus_node(dst.monitor, dst.desktop, dst.node)) {
+					fail(rsp, "%s", "");
+					goto end;
 				}
-			}
-			if (dst.node == NULL || !activate_node(dst.monitor, dst.desktop, dst.node)) {
-				fail(rsp, "%s", "");
-				break;
-			}
-		} else if (streq("-d", *args) || streq("--to-desktop", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = desktop_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				bool follow = false;
-				if (num > 1 && streq("--follow", *(args+1))) {
-					follow = true;
+			case NODE_OPT_ACTIVATE: {
+				coordinates_t dst = trg;
+				if (num > 1 && *(args + 1)[0] != OPT_CHR) {
 					num--, args++;
+					int ret;
+					if ((ret = node_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
+						handle_failure(ret, "node -a", *args, rsp);
+						goto end;
+					}
 				}
-				if (transfer_node(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.desktop, dst.desktop->focus, follow)) {
-					trg.monitor = dst.monitor;
-					trg.desktop = dst.desktop;
-				} else {
+				if (dst.node == NULL || !activate_node(dst.monitor, dst.desktop, dst.node)) {
 					fail(rsp, "%s", "");
-					break;
+					goto end;
 				}
-			} else {
-				handle_failure(ret, "node -d", *args, rsp);
-				break;
-			}
-		} else if (streq("-m", *args) || streq("--to-monitor", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = monitor_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				bool follow = false;
-				if (num > 1 && streq("--follow", *(args+1))) {
-					follow = true;
-					num--, args++;
+			case NODE_OPT_TO_DESKTOP: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
 				}
-				if (transfer_node(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.monitor->desk, dst.monitor->desk->focus, follow)) {
-					trg.monitor = dst.monitor;
-					trg.desktop = dst.monitor->desk;
+				coordinates_t dst;
+				int ret;
+				if ((ret = desktop_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					bool follow = false;
+					if (num > 1 && streq("--follow", *(args+1))) {
+						follow = true;
+						num--, args++;
+					}
+					if (transfer_node(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.desktop, dst.desktop->focus, follow)) {
+						trg.monitor = dst.monitor;
+						trg.desktop = dst.desktop;
+					} else {
+						fail(rsp, "%s", "");
+						goto end;
+					}
 				} else {
-					fail(rsp, "%s", "");
-					break;
+					handle_failure(ret, "node -d", *args, rsp);
+					goto end;
 				}
-			} else {
-				handle_failure(ret, "node -m", *args, rsp);
-				break;
-			}
-		} else if (streq("-n", *args) || streq("--to-node", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = node_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				bool follow = false;
-				if (num > 1 && streq("--follow", *(args+1))) {
-					follow = true;
-					num--, args++;
+			case NODE_OPT_TO_MONITOR: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
 				}
-				if (transfer_node(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.desktop, dst.node, follow)) {
-					trg.monitor = dst.monitor;
-					trg.desktop = dst.desktop;
+				coordinates_t dst;
+				int ret;
+				if ((ret = monitor_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					bool follow = false;
+					if (num > 1 && streq("--follow", *(args+1))) {
+						follow = true;
+						num--, args++;
+					}
+					if (transfer_node(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.monitor->desk, dst.monitor->desk->focus, follow)) {
+						trg.monitor = dst.monitor;
+						trg.desktop = dst.monitor->desk;
+					} else {
+						fail(rsp, "%s", "");
+						goto end;
+					}
 				} else {
-					fail(rsp, "%s", "");
-					break;
+					handle_failure(ret, "node -m", *args, rsp);
+					goto end;
 				}
-			} else {
-				handle_failure(ret, "node -n", *args, rsp);
-				break;
-			}
-		} else if (streq("-s", *args) || streq("--swap", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = node_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				bool follow = false;
-				if (num > 1 && streq("--follow", *(args+1))) {
-					follow = true;
-					num--, args++;
+			case NODE_OPT_TO_NODE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
 				}
-				if (swap_nodes(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.desktop, dst.node, follow)) {
-					trg.monitor = dst.monitor;
-					trg.desktop = dst.desktop;
+				coordinates_t dst;
+				int ret;
+				if ((ret = node_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					bool follow = false;
+					if (num > 1 && streq("--follow", *(args+1))) {
+						follow = true;
+						num--, args++;
+					}
+					if (transfer_node(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.desktop, dst.node, follow)) {
+						trg.monitor = dst.monitor;
+						trg.desktop = dst.desktop;
+					} else {
+						fail(rsp, "%s", "");
+						goto end;
+					}
 				} else {
-					fail(rsp, "%s", "");
-					break;
+					handle_failure(ret, "node -n", *args, rsp);
+					goto end;
 				}
-			} else {
-				handle_failure(ret, "node -s", *args, rsp);
-				break;
-			}
-		} else if (streq("-l", *args) || streq("--layer", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			stack_layer_t lyr;
-			if (parse_stack_layer(*args, &lyr)) {
-				if (!set_layer(trg.monitor, trg.desktop, trg.node, lyr)) {
-					fail(rsp, "%s", "");
-					break;
+			case NODE_OPT_SWAP: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
 				}
-			} else {
-				fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			}
-		} else if (streq("-t", *args) || streq("--state", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			client_state_t cst;
-			bool alternate = false;
-			if ((*args)[0] == '~') {
-				alternate = true;
-				(*args)++;
-			}
-			if (alternate && (*args)[0] == '\0') {
-				if (trg.node != NULL && trg.node->client != NULL) {
-					cst = trg.node->client->last_state;
+				coordinates_t dst;
+				int ret;
+				if ((ret = node_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					bool follow = false;
+					if (num > 1 && streq("--follow", *(args+1))) {
+						follow = true;
+						num--, args++;
+					}
+					if (swap_nodes(trg.monitor, trg.desktop, trg.node, dst.monitor, dst.desktop, dst.node, follow)) {
+						trg.monitor = dst.monitor;
+						trg.desktop = dst.desktop;
+					} else {
+						fail(rsp, "%s", "");
+						goto end;
+					}
 				} else {
-					fail(rsp, "%s", "");
-					break;
-				}
-			} else if (parse_client_state(*args, &cst)) {
-				if (alternate && trg.node != NULL && trg.node->client != NULL &&
-				    trg.node->client->state == cst) {
-					cst = trg.node->client->last_state;
+					handle_failure(ret, "node -s", *args, rsp);
+					goto end;
 				}
-			} else {
-				fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			}
-			if (!set_state(trg.monitor, trg.desktop, trg.node, cst)) {
-				fail(rsp, "%s", "");
-				break;
-			}
-			changed = true;
-		} else if (streq("-g", *args) || streq("--flag", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
 				break;
 			}
-			char *key = strtok(*args, EQL_TOK);
-			char *val = strtok(NULL, EQL_TOK);
-			alter_state_t a;
-			bool b;
-			if (val == NULL) {
-				a = ALTER_TOGGLE;
-			} else {
-				if (parse_bool(val, &b)) {
-					a = ALTER_SET;
+			case NODE_OPT_LAYER: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				stack_layer_t lyr;
+				if (parse_stack_layer(*args, &lyr)) {
+					if (!set_layer(trg.monitor, trg.desktop, trg.node, lyr)) {
+						fail(rsp, "%s", "");
+						goto end;
+					}
 				} else {
-					fail(rsp, "node %s: Invalid value for %s: '%s'.\n", *(args - 1), key, val);
-					break;
+					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
 				}
-			}
-			if (streq("hidden", key)) {
-				set_hidden(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->hidden));
-				changed = true;
-			} else if (streq("sticky", key)) {
-				set_sticky(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->sticky));
-			} else if (streq("private", key)) {
-				set_private(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->private));
-			} else if (streq("locked", key)) {
-				set_locked(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->locked));
-			} else if (streq("marked", key)) {
-				set_marked(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->marked));
-			} else {
-				fail(rsp, "node %s: Invalid key: '%s'.\n", *(args - 1), key);
-				break;
-			}
-		} else if (streq("-p", *args) || streq("--presel-dir", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.node == NULL || trg.node->vacant) {
-				fail(rsp, "%s", "");
 				break;
 			}
-			if (streq("cancel", *args)) {
-				cancel_presel(trg.monitor, trg.desktop, trg.node);
-			} else {
+			case NODE_OPT_STATE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				client_state_t cst;
 				bool alternate = false;
 				if ((*args)[0] == '~') {
 					alternate = true;
 					(*args)++;
 				}
-				direction_t dir;
-				if (parse_direction(*args, &dir)) {
-					if (alternate && trg.node->presel != NULL && trg.node->presel->split_dir == dir) {
-						cancel_presel(trg.monitor, trg.desktop, trg.node);
+				if (alternate && (*args)[0] == '\0') {
+					if (trg.node != NULL && trg.node->client != NULL) {
+						cst = trg.node->client->last_state;
 					} else {
-						presel_dir(trg.monitor, trg.desktop, trg.node, dir);
-						if (!IS_RECEPTACLE(trg.node)) {
-							draw_presel_feedback(trg.monitor, trg.desktop, trg.node);
-						}
+						fail(rsp, "%s", "");
+						goto end;
+					}
+				} else if (parse_client_state(*args, &cst)) {
+					if (alternate && trg.node != NULL && trg.node->client != NULL &&
+					    trg.node->client->state == cst) {
+						cst = trg.node->client->last_state;
 					}
 				} else {
-					fail(rsp, "node %s: Invalid argument: '%s%s'.\n", *(args - 1), alternate?"~":"", *args);
-					break;
+					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
 				}
-			}
-		} else if (streq("-o", *args) || streq("--presel-ratio", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.node == NULL || trg.node->vacant) {
-				fail(rsp, "%s", "");
-				break;
-			}
-			double rat;
-			if (sscanf(*args, "%lf", &rat) != 1 || rat <= 0 || rat >= 1) {
-				fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			} else {
-				presel_ratio(trg.monitor, trg.desktop, trg.node, rat);
-				draw_presel_feedback(trg.monitor, trg.desktop, trg.node);
-			}
-		} else if (streq("-v", *args) || streq("--move", *args)) {
-			num--, args++;
-			if (num < 2) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+				if (!set_state(trg.monitor, trg.desktop, trg.node, cst)) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				changed = true;
 				break;
 			}
-			int dx = 0, dy = 0;
-			if (sscanf(*args, "%i", &dx) == 1) {
+			case NODE_OPT_FLAG: {
 				num--, args++;
-				if (sscanf(*args, "%i", &dy) == 1) {
-					if (!move_client(&trg, dx, dy)) {
-						fail(rsp, "%s", "");
-						break;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				char *key = strtok(*args, EQL_TOK);
+				char *val = strtok(NULL, EQL_TOK);
+				alter_state_t a;
+				bool b;
+				if (val == NULL) {
+					a = ALTER_TOGGLE;
+				} else {
+					if (parse_bool(val, &b)) {
+						a = ALTER_SET;
+					} else {
+						fail(rsp, "node %s: Invalid value for %s: '%s'.\n", *(args - 1), key, val);
+						goto end;
 					}
+				}
+				if (streq("hidden", key)) {
+					set_hidden(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->hidden));
+					changed = true;
+				} else if (streq("sticky", key)) {
+					set_sticky(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->sticky));
+				} else if (streq("private", key)) {
+					set_private(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->private));
+				} else if (streq("locked", key)) {
+					set_locked(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->locked));
+				} else if (streq("marked", key)) {
+					set_marked(trg.monitor, trg.desktop, trg.node, (a == ALTER_SET ? b : !trg.node->marked));
 				} else {
-					fail(rsp, "node %s: Invalid dy argument: '%s'.\n", *(args - 3), *args);
-					break;
+					fail(rsp, "node %s: Invalid key: '%s'.\n", *(args - 1), key);
+					goto end;
 				}
-			} else {
-				fail(rsp, "node %s: Invalid dx argument: '%s'.\n", *(args - 2), *args);
 				break;
 			}
-		} else if (streq("-z", *args) || streq("--resize", *args)) {
-			num--, args++;
-			if (num < 3) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+			case NODE_OPT_PRESEL_DIR:
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL || trg.node->vacant) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				if (streq("cancel", *args)) {
+					cancel_presel(trg.monitor, trg.desktop, trg.node);
+				} else {
+					bool alternate = false;
+					if ((*args)[0] == '~') {
+						alternate = true;
+						(*args)++;
+					}
+					direction_t dir;
+					if (parse_direction(*args, &dir)) {
+						if (alternate && trg.node->presel != NULL && trg.node->presel->split_dir == dir) {
+							cancel_presel(trg.monitor, trg.desktop, trg.node);
+						} else {
+							presel_dir(trg.monitor, trg.desktop, trg.node, dir);
+							if (!IS_RECEPTACLE(trg.node)) {
+								draw_presel_feedback(trg.monitor, trg.desktop, trg.node);
+							}
+						}
+					} else {
+						fail(rsp, "node %s: Invalid argument: '%s%s'.\n", *(args - 1), alternate?"~":"", *args);
+						goto end;
+					}
+				}
+				break;
+			case NODE_OPT_PRESEL_RATIO: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL || trg.node->vacant) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				double rat;
+				if (sscanf(*args, "%lf", &rat) != 1 || rat <= 0 || rat >= 1) {
+					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
+				} else {
+					presel_ratio(trg.monitor, trg.desktop, trg.node, rat);
+					draw_presel_feedback(trg.monitor, trg.desktop, trg.node);
+				}
 				break;
 			}
-			resize_handle_t rh;
-			if (parse_resize_handle(*args, &rh)) {
+			case NODE_OPT_MOVE: {
 				num--, args++;
+				if (num < 2) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
 				int dx = 0, dy = 0;
 				if (sscanf(*args, "%i", &dx) == 1) {
 					num--, args++;
 					if (sscanf(*args, "%i", &dy) == 1) {
-						if (!resize_client(&trg, rh, dx, dy, true)) {
+						if (!move_client(&trg, dx, dy)) {
 							fail(rsp, "%s", "");
-							break;
+							goto end;
 						}
 					} else {
 						fail(rsp, "node %s: Invalid dy argument: '%s'.\n", *(args - 3), *args);
-						break;
+						goto end;
 					}
 				} else {
 					fail(rsp, "node %s: Invalid dx argument: '%s'.\n", *(args - 2), *args);
-					break;
+					goto end;
 				}
-			} else {
-				fail(rsp, "node %s: Invalid resize handle argument: '%s'.\n", *(args - 1), *args);
 				break;
 			}
-		} else if (streq("-y", *args) || streq("--type", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+			case NODE_OPT_RESIZE: {
+				num--, args++;
+				if (num < 3) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				resize_handle_t rh;
+				if (parse_resize_handle(*args, &rh)) {
+					num--, args++;
+					int dx = 0, dy = 0;
+					if (sscanf(*args, "%i", &dx) == 1) {
+						num--, args++;
+						if (sscanf(*args, "%i", &dy) == 1) {
+							if (!resize_client(&trg, rh, dx, dy, true)) {
+								fail(rsp, "%s", "");
+								goto end;
+							}
+						} else {
+							fail(rsp, "node %s: Invalid dy argument: '%s'.\n", *(args - 3), *args);
+							goto end;
+						}
+					} else {
+						fail(rsp, "node %s: Invalid dx argument: '%s'.\n", *(args - 2), *args);
+						goto end;
+					}
+				} else {
+					fail(rsp, "node %s: Invalid resize handle argument: '%s'.\n", *(args - 1), *args);
+					goto end;
+				}
 				break;
 			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
+			case NODE_OPT_TYPE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				cycle_dir_t cyc;
+				split_type_t typ;
+				if (parse_cycle_direction(*args, &cyc)) {
+					set_type(trg.node, (trg.node->split_type + 1) % 2);
+					changed = true;
+				} else if (parse_split_type(*args, &typ)) {
+					changed |= set_type(trg.node, typ);
+				} else {
+					fail(rsp, "%s", "");
+					goto end;
+				}
 				break;
 			}
-			cycle_dir_t cyc;
-			split_type_t typ;
-			if (parse_cycle_direction(*args, &cyc)) {
-				set_type(trg.node, (trg.node->split_type + 1) % 2);
-				changed = true;
-			} else if (parse_split_type(*args, &typ)) {
-				changed |= set_type(trg.node, typ);
-			} else {
-				fail(rsp, "%s", "");
-				break;
-			}
-		} else if (streq("-r", *args) || streq("--ratio", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
-				break;
-			}
-			if ((*args)[0] == '+' || (*args)[0] == '-') {
-				float delta;
-				if (sscanf(*args, "%f", &delta) == 1) {
-					double rat = trg.node->split_ratio;
-					if (delta > -1 && delta < 1) {
-						rat += delta;
+			case NODE_OPT_RATIO:
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				if ((*args)[0] == '+' || (*args)[0] == '-') {
+					float delta;
+					if (sscanf(*args, "%f", &delta) == 1) {
+						double rat = trg.node->split_ratio;
+						if (delta > -1 && delta < 1) {
+							rat += delta;
+						} else {
+							int max = (trg.node->split_type == TYPE_HORIZONTAL ? trg.node->rectangle.height : trg.node->rectangle.width);
+							rat = ((max * rat) + delta) / max;
+						}
+						if (rat > 0 && rat < 1) {
+							changed |= set_ratio(trg.node, rat);
+						} else {
+							fail(rsp, "%s", "");
+							goto end;
+						}
 					} else {
-						int max = (trg.node->split_type == TYPE_HORIZONTAL ? trg.node->rectangle.height : trg.node->rectangle.width);
-						rat = ((max * rat) + delta) / max;
+						fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+						goto end;
 					}
-					if (rat > 0 && rat < 1) {
+				} else {
+					double rat;
+					if (sscanf(*args, "%lf", &rat) == 1 && rat > 0 && rat < 1) {
 						changed |= set_ratio(trg.node, rat);
 					} else {
-						fail(rsp, "%s", "");
-						break;
+						fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+						goto end;
 					}
-				} else {
-					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-					break;
 				}
-			} else {
-				double rat;
-				if (sscanf(*args, "%lf", &rat) == 1 && rat > 0 && rat < 1) {
-					changed |= set_ratio(trg.node, rat);
+				break;
+			case NODE_OPT_FLIP: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				flip_t flp;
+				if (parse_flip(*args, &flp)) {
+					flip_tree(trg.node, flp);
+					changed = true;
 				} else {
-					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-					break;
+					fail(rsp, "%s", "");
+					goto end;
 				}
-			}
-		} else if (streq("-F", *args) || streq("--flip", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
+			case NODE_OPT_ROTATE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				int deg;
+				if (parse_degree(*args, &deg)) {
+					rotate_tree(trg.node, deg);
+					changed = true;
+				} else {
+					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
+				}
 				break;
 			}
-			flip_t flp;
-			if (parse_flip(*args, &flp)) {
-				flip_tree(trg.node, flp);
+			case NODE_OPT_EQUALIZE:
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				equalize_tree(trg.node);
 				changed = true;
-			} else {
-				fail(rsp, "%s", "");
-				break;
-			}
-		} else if (streq("-R", *args) || streq("--rotate", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
 				break;
-			}
-			int deg;
-			if (parse_degree(*args, &deg)) {
-				rotate_tree(trg.node, deg);
+			case NODE_OPT_BALANCE:
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				balance_tree(trg.node);
 				changed = true;
-			} else {
-				fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			}
-		} else if (streq("-E", *args) || streq("--equalize", *args)) {
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
 				break;
-			}
-			equalize_tree(trg.node);
-			changed = true;
-		} else if (streq("-B", *args) || streq("--balance", *args)) {
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
-				break;
-			}
-			balance_tree(trg.node);
-			changed = true;
-		} else if (streq("-C", *args) || streq("--circulate", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
+			case NODE_OPT_CIRCULATE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "node %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				circulate_dir_t cir;
+				if (parse_circulate_direction(*args, &cir)) {
+					circulate_leaves(trg.monitor, trg.desktop, trg.node, cir);
+					changed = true;
+				} else {
+					fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
+				}
 				break;
 			}
-			circulate_dir_t cir;
-			if (parse_circulate_direction(*args, &cir)) {
-				circulate_leaves(trg.monitor, trg.desktop, trg.node, cir);
+			case NODE_OPT_INSERT_RECEPTACLE:
+				insert_receptacle(trg.monitor, trg.desktop, trg.node);
 				changed = true;
-			} else {
-				fail(rsp, "node %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			}
-		} else if (streq("-i", *args) || streq("--insert-receptacle", *args)) {
-			insert_receptacle(trg.monitor, trg.desktop, trg.node);
-			changed = true;
-		} else if (streq("--center", *args)) {
-			if (trg.node == NULL || trg.node->client == NULL) {
-				fail(rsp, "%s", "");
-				break;
-			}
-			if (IS_FLOATING(trg.node->client)) {
-				window_center(trg.monitor, trg.node->client);
-				bspwm_rect_t *r = &trg.node->client->floating_rectangle;
-				window_move_resize(trg.node->id, r->x, r->y, r->width, r->height);
-			}
-		} else if (streq("-c", *args) || streq("--close", *args)) {
-			if (num > 1) {
-				fail(rsp, "node %s: Trailing commands.\n", *args);
-				break;
-			}
-			if (trg.node == NULL || locked_count(trg.node) > 0) {
-				fail(rsp, "%s", "");
-				break;
-			}
-			close_node(trg.node);
-			break;
-		} else if (streq("-k", *args) || streq("--kill", *args)) {
-			if (num > 1) {
-				fail(rsp, "node %s: Trailing commands.\n", *args);
 				break;
-			}
-			if (trg.node == NULL) {
-				fail(rsp, "%s", "");
+			case NODE_OPT_CENTER:
+				if (trg.node == NULL || trg.node->client == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				if (IS_FLOATING(trg.node->client)) {
+					window_center(trg.monitor, trg.node->client);
+					bspwm_rect_t *r = &trg.node->client->floating_rectangle;
+					window_move_resize(trg.node->id, r->x, r->y, r->width, r->height);
+				}
 				break;
-			}
-			kill_node(trg.monitor, trg.desktop, trg.node);
-			changed = true;
-			break;
-		} else {
-			fail(rsp, "node: Unknown command: '%s'.\n", *args);
-			break;
+			case NODE_OPT_CLOSE:
+				if (num > 1) {
+					fail(rsp, "node %s: Trailing commands.\n", *args);
+					goto end;
+				}
+				if (trg.node == NULL || locked_count(trg.node) > 0) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				close_node(trg.node);
+				goto end;
+			case NODE_OPT_KILL:
+				if (num > 1) {
+					fail(rsp, "node %s: Trailing commands.\n", *args);
+					goto end;
+				}
+				if (trg.node == NULL) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
+				kill_node(trg.monitor, trg.desktop, trg.node);
+				changed = true;
+				goto end;
+			default:
+				fail(rsp, "node: Unknown command: '%s'.\n", *args);
+				goto end;
 		}
 
 		num--, args++;
 	}
 
+end:
 	if (changed) {
 		arrange(trg.monitor, trg.desktop);
 	}
@@ -694,166 +913,183 @@ void cmd_desktop(char **args, int num, FILE *rsp)
 	bool changed = false;
 
 	while (num > 0) {
-		if (streq("-f", *args) || streq("--focus", *args)) {
-			coordinates_t dst = trg;
-			if (num > 1 && *(args + 1)[0] != OPT_CHR) {
-				num--, args++;
-				int ret;
-				if ((ret = desktop_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
-					handle_failure(ret, "desktop -f", *args, rsp);
-					break;
-				}
-			}
-			focus_node(dst.monitor, dst.desktop, NULL);
-		} else if (streq("-a", *args) || streq("--activate", *args)) {
-			coordinates_t dst = trg;
-			if (num > 1 && *(args + 1)[0] != OPT_CHR) {
-				num--, args++;
-				int ret;
-				if ((ret = desktop_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
-					handle_failure(ret, "desktop -a", *args, rsp);
-					break;
+		int opt = find_option(&desktop_option_table, *args);
+		switch (opt) {
+			case DESKTOP_OPT_FOCUS: {
+				coordinates_t dst = trg;
+				if (num > 1 && *(args + 1)[0] != OPT_CHR) {
+					num--, args++;
+					int ret;
+					if ((ret = desktop_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
+						handle_failure(ret, "desktop -f", *args, rsp);
+						goto end;
+					}
 				}
-			}
-			if (activate_desktop(dst.monitor, dst.desktop)) {
-				activate_node(dst.monitor, dst.desktop, NULL);
-			} else {
-				fail(rsp, "%s", "");
-				break;
-			}
-		} else if (streq("-m", *args) || streq("--to-monitor", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			if (trg.monitor->desk_head == trg.monitor->desk_tail) {
-				fail(rsp, "%s", "");
+				focus_node(dst.monitor, dst.desktop, NULL);
 				break;
 			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = monitor_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				bool follow = false;
-				if (num > 1 && streq("--follow", *(args+1))) {
-					follow = true;
+			case DESKTOP_OPT_ACTIVATE: {
+				coordinates_t dst = trg;
+				if (num > 1 && *(args + 1)[0] != OPT_CHR) {
 					num--, args++;
+					int ret;
+					if ((ret = desktop_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
+						handle_failure(ret, "desktop -a", *args, rsp);
+						goto end;
+					}
 				}
-				if (transfer_desktop(trg.monitor, dst.monitor, trg.desktop, follow)) {
-					trg.monitor = dst.monitor;
+				if (activate_desktop(dst.monitor, dst.desktop)) {
+					activate_node(dst.monitor, dst.desktop, NULL);
 				} else {
 					fail(rsp, "%s", "");
-					break;
+					goto end;
 				}
-			} else {
-				handle_failure(ret, "desktop -m", *args, rsp);
 				break;
 			}
-		} else if (streq("-s", *args) || streq("--swap", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = desktop_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				bool follow = false;
-				if (num > 1 && streq("--follow", *(args+1))) {
-					follow = true;
-					num--, args++;
+			case DESKTOP_OPT_TO_MONITOR: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
+					goto end;
 				}
-				if (swap_desktops(trg.monitor, trg.desktop, dst.monitor, dst.desktop, follow)) {
-					trg.monitor = dst.monitor;
-				} else {
+				if (trg.monitor->desk_head == trg.monitor->desk_tail) {
 					fail(rsp, "%s", "");
-					break;
+					goto end;
+				}
+				coordinates_t dst;
+				int ret;
+				if ((ret = monitor_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					bool follow = false;
+					if (num > 1 && streq("--follow", *(args+1))) {
+						follow = true;
+						num--, args++;
+					}
+					if (transfer_desktop(trg.monitor, dst.monitor, trg.desktop, follow)) {
+						trg.monitor = dst.monitor;
+					} else {
+						fail(rsp, "%s", "");
+						goto end;
+					}
+				} else {
+					handle_failure(ret, "desktop -m", *args, rsp);
+					goto end;
 				}
-			} else {
-				handle_failure(ret, "desktop -s", *args, rsp);
-				break;
-			}
-		} else if (streq("-b", *args) || streq("--bubble", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
 				break;
 			}
-			cycle_dir_t cyc;
-			if (parse_cycle_direction(*args, &cyc)) {
-				desktop_t *d = trg.desktop;
-				if (cyc == CYCLE_PREV) {
-					if (d->prev == NULL) {
-						while (d->next != NULL) {
-							swap_desktops(trg.monitor, d, trg.monitor, d->next, false);
-						}
+			case DESKTOP_OPT_SWAP: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				coordinates_t dst;
+				int ret;
+				if ((ret = desktop_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					bool follow = false;
+					if (num > 1 && streq("--follow", *(args+1))) {
+						follow = true;
+						num--, args++;
+					}
+					if (swap_desktops(trg.monitor, trg.desktop, dst.monitor, dst.desktop, follow)) {
+						trg.monitor = dst.monitor;
 					} else {
-						swap_desktops(trg.monitor, d, trg.monitor, d->prev, false);
+						fail(rsp, "%s", "");
+						goto end;
 					}
 				} else {
-					if (d->next == NULL) {
-						while (d->prev != NULL) {
+					handle_failure(ret, "desktop -s", *args, rsp);
+					goto end;
+				}
+				break;
+			}
+			case DESKTOP_OPT_BUBBLE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				cycle_dir_t cyc;
+				if (parse_cycle_direction(*args, &cyc)) {
+					desktop_t *d = trg.desktop;
+					if (cyc == CYCLE_PREV) {
+						if (d->prev == NULL) {
+							while (d->next != NULL) {
+								swap_desktops(trg.monitor, d, trg.monitor, d->next, false);
+							}
+						} else {
 							swap_desktops(trg.monitor, d, trg.monitor, d->prev, false);
 						}
 					} else {
-						swap_desktops(trg.monitor, d, trg.monitor, d->next, false);
+						if (d->next == NULL) {
+							while (d->prev != NULL) {
+								swap_desktops(trg.monitor, d, trg.monitor, d->prev, false);
+							}
+						} else {
+							swap_desktops(trg.monitor, d, trg.monitor, d->next, false);
+						}
 					}
+				} else {
+					fail(rsp, "desktop %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
 				}
-			} else {
-				fail(rsp, "desktop %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			}
-		} else if (streq("-l", *args) || streq("--layout", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
-				break;
-			}
-			bool ret;
-			layout_t lyt;
-			cycle_dir_t cyc;
-			if (parse_cycle_direction(*args, &cyc)) {
-				ret = set_layout(trg.monitor, trg.desktop, (trg.desktop->user_layout + 1) % 2, true);
-			} else if (parse_layout(*args, &lyt)) {
-				ret = set_layout(trg.monitor, trg.desktop, lyt, true);
-			} else {
-				fail(rsp, "desktop %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				break;
-			}
-			if (!ret) {
-				fail(rsp, "%s", "");
 				break;
 			}
-		} else if (streq("-n", *args) || streq("--rename", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
+			case DESKTOP_OPT_LAYOUT: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				bool ret;
+				layout_t lyt;
+				cycle_dir_t cyc;
+				if (parse_cycle_direction(*args, &cyc)) {
+					ret = set_layout(trg.monitor, trg.desktop, (trg.desktop->user_layout + 1) % 2, true);
+				} else if (parse_layout(*args, &lyt)) {
+					ret = set_layout(trg.monitor, trg.desktop, lyt, true);
+				} else {
+					fail(rsp, "desktop %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					goto end;
+				}
+				if (!ret) {
+					fail(rsp, "%s", "");
+					goto end;
+				}
 				break;
 			}
-			rename_desktop(trg.monitor, trg.desktop, *args);
-		} else if (streq("-r", *args) || streq("--remove", *args)) {
-			if (num > 1) {
-				fail(rsp, "desktop %s: Trailing commands.\n", *args);
+			case DESKTOP_OPT_RENAME:
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "desktop %s: Not enough arguments.\n", *(args - 1));
+					goto end;
+				}
+				rename_desktop(trg.monitor, trg.desktop, *args);
 				break;
-			}
-			if (trg.monitor->desk_head != trg.monitor->desk_tail) {
-				desktop_t *fallback = trg.desktop->prev == NULL ?
-				                      trg.desktop->next :
-				                      trg.desktop->prev;
-				merge_desktops(trg.monitor, trg.desktop, trg.monitor, fallback);
-				remove_desktop(trg.monitor, trg.desktop);
-				return;
-			} else {
-				fail(rsp, "%s", "");
+			case DESKTOP_OPT_REMOVE:
+				if (num > 1) {
+					fail(rsp, "desktop %s: Trailing commands.\n", *args);
+					goto end;
+				}
+				if (trg.monitor->desk_head != trg.monitor->desk_tail) {
+					desktop_t *fallback = trg.desktop->prev == NULL ?
+					                      trg.desktop->next :
+					                      trg.desktop->prev;
+					merge_desktops(trg.monitor, trg.desktop, trg.monitor, fallback);
+					remove_desktop(trg.monitor, trg.desktop);
+					return;
+				} else {
+					fail(rsp, "%s", "");
+					goto end;
+				}
 				break;
-			}
-		} else {
-			fail(rsp, "desktop: Unknown command: '%s'.\n", *args);
-			break;
+			default:
+				fail(rsp, "desktop: Unknown command: '%s'.\n", *args);
+				goto end;
 		}
 		num--, args++;
 	}
 
+end:
 	if (changed) {
 		arrange(trg.monitor, trg.desktop);
 	}
@@ -890,124 +1126,138 @@ void cmd_monitor(char **args, int num, FILE *rsp)
 	}
 
 	while (num > 0) {
-		if (streq("-f", *args) || streq("--focus", *args)) {
-			coordinates_t dst = trg;
-			if (num > 1 && *(args + 1)[0] != OPT_CHR) {
+		int opt = find_option(&monitor_option_table, *args);
+		switch (opt) {
+			case MONITOR_OPT_FOCUS: {
+				coordinates_t dst = trg;
+				if (num > 1 && *(args + 1)[0] != OPT_CHR) {
+					num--, args++;
+					int ret;
+					if ((ret = monitor_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
+						handle_failure(ret, "monitor -f", *args, rsp);
+						fail(rsp, "%s", "");
+						return;
+					}
+				}
+				focus_node(dst.monitor, NULL, NULL);
+				break;
+			}
+			case MONITOR_OPT_SWAP: {
 				num--, args++;
-				int ret;
-				if ((ret = monitor_from_desc(*args, &ref, &dst)) != SELECTOR_OK) {
-					handle_failure(ret, "monitor -f", *args, rsp);
-					fail(rsp, "%s", "");
+				if (num < 1) {
+					fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
 					return;
 				}
-			}
-			focus_node(dst.monitor, NULL, NULL);
-		} else if (streq("-s", *args) || streq("--swap", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
-				return;
-			}
-			coordinates_t dst;
-			int ret;
-			if ((ret = monitor_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
-				if (!swap_monitors(trg.monitor, dst.monitor)) {
-					fail(rsp, "%s", "");
+				coordinates_t dst;
+				int ret;
+				if ((ret = monitor_from_desc(*args, &ref, &dst)) == SELECTOR_OK) {
+					if (!swap_monitors(trg.monitor, dst.monitor)) {
+						fail(rsp, "%s", "");
+						return;
+					}
+				} else {
+					handle_failure(ret, "monitor -s", *args, rsp);
 					return;
 				}
-			} else {
-				handle_failure(ret, "monitor -s", *args, rsp);
-				return;
-			}
-		} else if (streq("-d", *args) || streq("--reset-desktops", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
-				return;
+				break;
 			}
-			desktop_t *d = trg.monitor->desk_head;
-			while (num > 0 && d != NULL) {
-				rename_desktop(trg.monitor, d, *args);
-				d = d->next;
+			case MONITOR_OPT_RESET_DESKTOPS: {
 				num--, args++;
+				if (num < 1) {
+					fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				desktop_t *d = trg.monitor->desk_head;
+				while (num > 0 && d != NULL) {
+					rename_desktop(trg.monitor, d, *args);
+					d = d->next;
+					num--, args++;
+				}
+				put_status(SBSC_MASK_REPORT);
+				while (num > 0) {
+					add_desktop(trg.monitor, make_desktop(*args, BSPWM_WID_NONE));
+					num--, args++;
+				}
+				while (d != NULL) {
+					desktop_t *next = d->next;
+					if (d == mon->desk && d->prev != NULL) {
+						focus_node(trg.monitor, d->prev, d->prev->focus);
+					}
+					merge_desktops(trg.monitor, d, mon, mon->desk);
+					remove_desktop(trg.monitor, d);
+					d = next;
+				}
+				break;
 			}
-			put_status(SBSC_MASK_REPORT);
-			while (num > 0) {
-				add_desktop(trg.monitor, make_desktop(*args, BSPWM_WID_NONE));
+			case MONITOR_OPT_ADD_DESKTOPS:
 				num--, args++;
-			}
-			while (d != NULL) {
-				desktop_t *next = d->next;
-				if (d == mon->desk && d->prev != NULL) {
-					focus_node(trg.monitor, d->prev, d->prev->focus);
+				if (num < 1) {
+					fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+					return;
 				}
-				merge_desktops(trg.monitor, d, mon, mon->desk);
-				remove_desktop(trg.monitor, d);
-				d = next;
-			}
-		} else if (streq("-a", *args) || streq("--add-desktops", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+				while (num > 0) {
+					add_desktop(trg.monitor, make_desktop(*args, BSPWM_WID_NONE));
+					num--, args++;
+				}
+				break;
+			case MONITOR_OPT_REMOVE:
+				if (num > 1) {
+					fail(rsp, "monitor %s: Trailing commands.\n", *args);
+					return;
+				}
+				if (mon_head == mon_tail) {
+					fail(rsp, "%s", "");
+					return;
+				}
+				remove_monitor(trg.monitor);
 				return;
-			}
-			while (num > 0) {
-				add_desktop(trg.monitor, make_desktop(*args, BSPWM_WID_NONE));
+			case MONITOR_OPT_REORDER_DESKTOPS: {
 				num--, args++;
-			}
-		} else if (streq("-r", *args) || streq("--remove", *args)) {
-			if (num > 1) {
-				fail(rsp, "monitor %s: Trailing commands.\n", *args);
-				return;
-			}
-			if (mon_head == mon_tail) {
-				fail(rsp, "%s", "");
-				return;
-			}
-			remove_monitor(trg.monitor);
-			return;
-		} else if (streq("-o", *args) || streq("--reorder-desktops", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
-				return;
-			}
-			desktop_t *d = trg.monitor->desk_head;
-			while (d != NULL && num > 0) {
-				desktop_t *next = d->next;
-				coordinates_t dst;
-				if (locate_desktop(*args, &dst) && dst.monitor == trg.monitor) {
-					swap_desktops(trg.monitor, d, dst.monitor, dst.desktop, false);
-					if (next == dst.desktop) {
-						next = d;
+				if (num < 1) {
+					fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				desktop_t *d = trg.monitor->desk_head;
+				while (d != NULL && num > 0) {
+					desktop_t *next = d->next;
+					coordinates_t dst;
+					if (locate_desktop(*args, &dst) && dst.monitor == trg.monitor) {
+						swap_desktops(trg.monitor, d, dst.monitor, dst.desktop, false);
+						if (next == dst.desktop) {
+							next = d;
+						}
 					}
+					d = next;
+					num--, args++;
 				}
-				d = next;
-				num--, args++;
-			}
-		} else if (streq("-g", *args) || streq("--rectangle", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
-				return;
+				break;
 			}
-			bspwm_rect_t r;
-			if (parse_rectangle(*args, &r)) {
-				update_root(trg.monitor, &r);
-			} else {
-				fail(rsp, "monitor %s: Invalid argument: '%s'.\n", *(args - 1), *args);
-				return;
+			case MONITOR_OPT_RECTANGLE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				bspwm_rect_t r;
+				if (parse_rectangle(*args, &r)) {
+					update_root(trg.monitor, &r);
+				} else {
+					fail(rsp, "monitor %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+					return;
+				}
+				break;
 			}
-		} else if (streq("-n", *args) || streq("--rename", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+			case MONITOR_OPT_RENAME:
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "monitor %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				rename_monitor(trg.monitor, *args);
+				break;
+			default:
+				fail(rsp, "monitor: Unknown command: '%s'.\n", *args);
 				return;
-			}
-			rename_monitor(trg.monitor, *args);
-		} else {
-			fail(rsp, "monitor: Unknown command: '%s'.\n", *args);
-			return;
 		}
 		num--, args++;
 	}
@@ -1034,6 +1284,7 @@ void cmd_query(char **args, int num, FILE *rsp)
 	node_select_t *node_sel = NULL;
 	domain_t dom = DOMAIN_TREE;
 	bool print_ids = true;
+	bool compact = false;
 	uint8_t d = 0;
 
 	while (num > 0) {
@@ -1151,8 +1402,12 @@ void cmd_query(char **args, int num, FILE *rsp)
 					goto end;
 				}
 			}
+		} else if (streq("--metrics", *args)) {
+			dom = DOMAIN_METRICS, d++;
 		} else if (streq("--names", *args)) {
 			print_ids = false;
+		} else if (streq("--compact", *args)) {
+			compact = true;
 		} else {
 			fail(rsp, "query: Unknown option: '%s'.\n", *args);
 			goto end;
@@ -1175,11 +1430,26 @@ void cmd_query(char **args, int num, FILE *rsp)
 		goto end;
 	}
 
+	if (dom == DOMAIN_METRICS) {
+		if (!print_ids || compact || trg.monitor != NULL ||
+		    monitor_sel != NULL || desktop_sel != NULL || node_sel != NULL) {
+			fail(rsp, "query --metrics: Takes no other options.\n");
+		} else {
+			print_metrics(rsp);
+		}
+		goto end;
+	}
+
 	if (!print_ids && (dom == DOMAIN_NODE || dom == DOMAIN_TREE)) {
 		fail(rsp, "query -%c: --names only applies to -M and -D.\n", dom == DOMAIN_NODE ? 'N' : 'T');
 		goto end;
 	}
 
+	if (compact && dom != DOMAIN_TREE) {
+		fail(rsp, "query: --compact only applies to -T.\n");
+		goto end;
+	}
+
 	if ((dom == DOMAIN_MONITOR && (desktop_sel != NULL || node_sel != NULL)) ||
 	    (dom == DOMAIN_DESKTOP && node_sel != NULL)) {
 		fail(rsp, "query -%c: Incompatible descriptor-free constraints.\n", dom == DOMAIN_MONITOR ? 'M' : 'D');
@@ -1199,14 +1469,18 @@ void cmd_query(char **args, int num, FILE *rsp)
 			fail(rsp, "%s", "");
 		}
 	} else {
+		json_writer_t jw;
+		json_init(&jw, compact);
 		if (trg.node != NULL) {
-			query_node(trg.node, rsp);
+			query_node(trg.node, NULL, &jw);
 		} else if (trg.desktop != NULL) {
-			query_desktop(trg.desktop, rsp);
+			query_desktop(trg.desktop, NULL, &jw);
 		} else  {
-			query_monitor(trg.monitor, rsp);
+			query_monitor(trg.monitor, NULL, &jw);
 		}
-		fprintf(rsp, "\n");
+		json_raw(&jw, "\n");
+		json_flush(&jw, rsp);
+		json_free(&jw);
 	}
 
 end:
@@ -1312,8 +1586,16 @@ void cmd_wm(char **args, int num, FILE *rsp)
 
 	while (num > 0) {
 		if (streq("-d", *args) || streq("--dump-state", *args)) {
-			query_state(rsp);
-			fprintf(rsp, "\n");
+			bool compact = num > 1 && streq("--compact", *(args + 1));
+			if (compact) {
+				num--, args++;
+			}
+			json_writer_t jw;
+			json_init(&jw, compact);
+			query_state(&jw);
+			json_raw(&jw, "\n");
+			json_flush(&jw, rsp);
+			json_free(&jw);
 		} else if (streq("-l", *args) || streq("--load-state", *args)) {
 			num--, args++;
 			if (num < 1) {
@@ -1364,6 +1646,14 @@ void cmd_wm(char **args, int num, FILE *rsp)
 			adopt_orphans();
 		} else if (streq("-g", *args) || streq("--get-status", *args)) {
 			print_report(rsp);
+		} else if (streq("-S", *args) || streq("--stats", *args)) {
+			print_latency_stats(rsp);
+			fprintf(rsp, "\n");
+		} else if (streq("--reset-stats", *args)) {
+			reset_latency_stats();
+		} else if (streq("--dump-trace", *args)) {
+			print_trace(rsp);
+			fprintf(rsp, "\n");
 		} else if (streq("-h", *args) || streq("--record-history", *args)) {
 			num--, args++;
 			if (num < 1) {
@@ -1396,9 +1686,79 @@ void cmd_subscribe(char **args, int num, FILE *rsp)
 	FILE *stream = rsp;
 	char *fifo_path = NULL;
 	subscriber_mask_t mask;
+	bool json = false;
+	char *subtype = NULL;
+	coordinates_t ref = {mon, mon->desk, mon->desk->focus};
+	coordinates_t trg = {NULL, NULL, NULL};
+	uint32_t monitor_id = 0, desktop_id = 0, node_id = 0;
 
 	while (num > 0) {
-		if (streq("-c", *args) || streq("--count", *args)) {
+		if (streq("--format=json", *args) || streq("--format=text", *args)) {
+			json = streq("--format=json", *args);
+		} else if (streq("-F", *args) || streq("--format", *args)) {
+			num--, args++;
+			if (num < 1) {
+				fail(rsp, "subscribe %s: Not enough arguments.\n", *(args - 1));
+				goto failed;
+			}
+			if (streq("json", *args) || streq("text", *args)) {
+				json = streq("json", *args);
+			} else {
+				fail(rsp, "subscribe %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+				goto failed;
+			}
+		} else if (streq("-m", *args) || streq("--monitor", *args)) {
+			num--, args++;
+			if (num < 1) {
+				fail(rsp, "subscribe %s: Not enough arguments.\n", *(args - 1));
+				goto failed;
+			}
+			int ret;
+			if ((ret = monitor_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
+				handle_failure(ret, "subscribe -m", *args, rsp);
+				goto failed;
+			}
+			monitor_id = trg.monitor->id;
+		} else if (streq("-d", *args) || streq("--desktop", *args)) {
+			num--, args++;
+			if (num < 1) {
+				fail(rsp, "subscribe %s: Not enough arguments.\n", *(args - 1));
+				goto failed;
+			}
+			int ret;
+			if ((ret = desktop_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
+				handle_failure(ret, "subscribe -d", *args, rsp);
+				goto failed;
+			}
+			desktop_id = trg.desktop->id;
+		} else if (streq("-n", *args) || streq("--node", *args)) {
+			num--, args++;
+			if (num < 1) {
+				fail(rsp, "subscribe %s: Not enough arguments.\n", *(args - 1));
+				goto failed;
+			}
+			int ret;
+			if ((ret = node_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
+				handle_failure(ret, "subscribe -n", *args, rsp);
+				goto failed;
+			}
+			if (trg.node == NULL) {
+				handle_failure(SELECTOR_INVALID, "subscribe -n", *args, rsp);
+				goto failed;
+			}
+			node_id = trg.node->id;
+		} else if (streq("-t", *args) || streq("--subtype", *args)) {
+			num--, args++;
+			if (num < 1) {
+				fail(rsp, "subscribe %s: Not enough arguments.\n", *(args - 1));
+				goto failed;
+			}
+			if (strlen(*args) >= SMALEN) {
+				fail(rsp, "subscribe %s: Invalid argument: '%s'.\n", *(args - 1), *args);
+				goto failed;
+			}
+			subtype = *args;
+		} else if (streq("-c", *args) || streq("--count", *args)) {
 			num--, args++;
 			if (num < 1) {
 				fail(rsp, "subscribe %s: Not enough arguments.\n", *(args - 1));
@@ -1441,6 +1801,15 @@ void cmd_subscribe(char **args, int num, FILE *rsp)
 	}
 
 	subscriber_list_t *sb = make_subscriber(stream, fifo_path, field, count);
+	if (sb != NULL) {
+		sb->json = json;
+		sb->monitor_id = monitor_id;
+		sb->desktop_id = desktop_id;
+		sb->node_id = node_id;
+		if (subtype != NULL) {
+			snprintf(sb->subtype, sizeof(sb->subtype), "%s", subtype);
+		}
+	}
 	add_subscriber(sb);
 	return;
 
@@ -1464,6 +1833,113 @@ void cmd_quit(char **args, int num, FILE *rsp)
 	running = false;
 }
 
+/* Run one command line of a batch, split like the lines of bspc --batch,
+ * and close its response stream. */
+/* Whether a message picks nodes by their position or resizes against
+ * their tiled rectangles, which the arrange held by the batch leaves
+ * stale until it is flushed. */
+static bool reads_layout(char **args, int num)
+{
+	if (streq("query", *args)) {
+		return true;
+	} else if (!streq("node", *args)) {
+		return false;
+	}
+	for (int i = 1; i < num; i++) {
+		int opt = find_option(&node_option_table, args[i]);
+		if (opt == NODE_OPT_MOVE || opt == NODE_OPT_RESIZE) {
+			return true;
+		}
+		char desc[MAXLEN];
+		snprintf(desc, sizeof(desc), "%s", args[i]);
+		direction_t dir;
+		for (char *tok = strtok(desc, "#.:/@"); tok != NULL; tok = strtok(NULL, "#.:/@")) {
+			if (parse_direction(tok, &dir)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void run_batch_command(const char *line, FILE *rsp)
+{
+	char **args = scratch_alloc((strlen(line) / 2 + 1) * sizeof(char *));
+	if (args == NULL) {
+		fail(rsp, "batch: Out of memory.\n");
+		fclose(rsp);
+		return;
+	}
+
+	int num = 0;
+	struct tokenize_state state;
+	char *tok = tokenize_with_escape(&state, line, ' ');
+	while (tok != NULL) {
+		if (tok[0] != '\0') {
+			args[num++] = tok;
+		} else {
+			free(tok);
+		}
+		tok = (*state.pos == '\0') ? NULL : tokenize_with_escape(&state, NULL, ' ');
+	}
+
+	if (num < 1) {
+		fail(rsp, "batch: Empty command.\n");
+		fclose(rsp);
+	} else if (streq("subscribe", *args) || streq("batch", *args)) {
+		/* A subscriber would take over a per-command buffer */
+		fail(rsp, "batch: %s: Not available in a batch.\n", *args);
+		fclose(rsp);
+	} else {
+		/* Nodes are picked and queried with the geometry the
+		 * commands so far lead to */
+		if (reads_layout(args, num)) {
+			flush_arrange();
+		}
+		process_message(args, num, rsp);
+	}
+
+	for (int i = 0; i < num; i++) {
+		free(args[i]);
+	}
+}
+
+void cmd_batch(char **args, int num, FILE *rsp)
+{
+	if (num < 1) {
+		fail(rsp, "batch: Missing commands.\n");
+		return;
+	}
+
+	/* The side effects of the whole batch are applied once, at the end */
+	hold_status();
+	hold_ewmh();
+	hold_stack();
+	hold_arrange();
+
+	for (; num > 0; num--, args++) {
+		char *out = NULL;
+		size_t out_len = 0;
+		FILE *cmd_rsp = open_memstream(&out, &out_len);
+		if (cmd_rsp != NULL) {
+			run_batch_command(*args, cmd_rsp);
+		}
+		/* Each response is a frame of its own, see bspc.c */
+		static const char no_memory[] = FAILURE_MESSAGE "batch: Out of memory.\n";
+		const char *data = (cmd_rsp != NULL) ? out : no_memory;
+		size_t len = (cmd_rsp != NULL) ? out_len : sizeof(no_memory) - 1;
+		uint32_t be = htonl(len);
+		fwrite(&be, 1, FRAME_HEADER_SIZE, rsp);
+		fwrite(data, 1, len, rsp);
+		free(out);
+	}
+
+	release_arrange();
+	release_stack();
+	release_ewmh();
+	release_status();
+}
+
 void cmd_config(char **args, int num, FILE *rsp)
 {
 	if (num < 1) {
@@ -1480,42 +1956,50 @@ void cmd_config(char **args, int num, FILE *rsp)
 	coordinates_t trg = {NULL, NULL, NULL};
 
 	while (num > 0 && (*args)[0] == OPT_CHR) {
-		if (streq("-m", *args) || streq("--monitor", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "config %s: Not enough arguments.\n", *(args - 1));
-				return;
-			}
-			int ret;
-			if ((ret = monitor_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
-				handle_failure(ret, "config -m", *args, rsp);
-				return;
-			}
-		} else if (streq("-d", *args) || streq("--desktop", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "config %s: Not enough arguments.\n", *(args - 1));
-				return;
+		int opt = find_option(&config_option_table, *args);
+		switch (opt) {
+			case CONFIG_OPT_MONITOR: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "config %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				int ret;
+				if ((ret = monitor_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
+					handle_failure(ret, "config -m", *args, rsp);
+					return;
+				}
+				break;
 			}
-			int ret;
-			if ((ret = desktop_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
-				handle_failure(ret, "config -d", *args, rsp);
-				return;
+			case CONFIG_OPT_DESKTOP: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "config %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				int ret;
+				if ((ret = desktop_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
+					handle_failure(ret, "config -d", *args, rsp);
+					return;
+				}
+				break;
 			}
-		} else if (streq("-n", *args) || streq("--node", *args)) {
-			num--, args++;
-			if (num < 1) {
-				fail(rsp, "config %s: Not enough arguments.\n", *(args - 1));
-				return;
+			case CONFIG_OPT_NODE: {
+				num--, args++;
+				if (num < 1) {
+					fail(rsp, "config %s: Not enough arguments.\n", *(args - 1));
+					return;
+				}
+				int ret;
+				if ((ret = node_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
+					handle_failure(ret, "config -n", *args, rsp);
+					return;
+				}
+				break;
 			}
-			int ret;
-			if ((ret = node_from_desc(*args, &ref, &trg)) != SELECTOR_OK) {
-				handle_failure(ret, "config -n", *args, rsp);
+			default:
+				fail(rsp, "config: Unknown option: '%s'.\n", *args);
 				return;
-			}
-		} else {
-			fail(rsp, "config: Unknown option: '%s'.\n", *args);
-			return;
 		}
 		num--, args++;
 	}
@@ -1530,36 +2014,25 @@ void cmd_config(char **args, int num, FILE *rsp)
 
 void set_setting(coordinates_t loc, char *name, char *value, FILE *rsp)
 {
+	int setting = name_table_lookup(&setting_table, name);
 	bool colors_changed = false;
 #define SET_DEF_DEFMON_DEFDESK_WIN(k, v) \
-		if (loc.node != NULL) { \
-			for (node_t *n = first_extrema(loc.node); n != NULL; n = next_leaf(n, loc.node)) { \
-				if (n->client != NULL) { \
-					n->client->k = v; \
-				} \
-			} \
-		} else if (loc.desktop != NULL) { \
-			loc.desktop->k = v; \
-			for (node_t *n = first_extrema(loc.desktop->root); n != NULL; n = next_leaf(n, loc.desktop->root)) { \
-				if (n->client != NULL) { \
-					n->client->k = v; \
+			if (loc.node != NULL) { \
+				for (node_t *n = first_extrema(loc.node); n != NULL; n = next_leaf(n, loc.node)) { \
+					if (n->client != NULL) { \
+						n->client->k = v; \
+					} \
 				} \
-			} \
-		} else if (loc.monitor != NULL) { \
-			loc.monitor->k = v; \
-			for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) { \
-				d->k = v; \
-				for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) { \
+			} else if (loc.desktop != NULL) { \
+				loc.desktop->k = v; \
+				for (node_t *n = first_extrema(loc.desktop->root); n != NULL; n = next_leaf(n, loc.desktop->root)) { \
 					if (n->client != NULL) { \
 						n->client->k = v; \
 					} \
 				} \
-			} \
-		} else { \
-			k = v; \
-			for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
-				m->k = v; \
-				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) { \
+			} else if (loc.monitor != NULL) { \
+				loc.monitor->k = v; \
+				for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) { \
 					d->k = v; \
 					for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) { \
 						if (n->client != NULL) { \
@@ -1567,401 +2040,550 @@ void set_setting(coordinates_t loc, char *name, char *value, FILE *rsp)
 						} \
 					} \
 				} \
-			} \
-		}
-	if (streq("border_width", name)) {
-		unsigned int bw;
-		if (sscanf(value, "%u", &bw) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+			} else { \
+				k = v; \
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
+					m->k = v; \
+					for (desktop_t *d = m->desk_head; d != NULL; d = d->next) { \
+						d->k = v; \
+						for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) { \
+							if (n->client != NULL) { \
+								n->client->k = v; \
+							} \
+						} \
+					} \
+				} \
+			}
+	switch (setting) {
+		case SETTING_BORDER_WIDTH: {
+			unsigned int bw;
+			if (sscanf(value, "%u", &bw) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			SET_DEF_DEFMON_DEFDESK_WIN(border_width, bw)
+			break;
 		}
-		SET_DEF_DEFMON_DEFDESK_WIN(border_width, bw)
 #undef SET_DEF_DEFMON_DEFDESK_WIN
 #define SET_DEF_WIN(k, v) \
-		if (loc.node != NULL) { \
-			for (node_t *n = first_extrema(loc.node); n != NULL; n = next_leaf(n, loc.node)) { \
-				if (n->client != NULL) { \
-					n->client->k = v; \
-				} \
-			} \
-		} else if (loc.desktop != NULL) { \
-			for (node_t *n = first_extrema(loc.desktop->root); n != NULL; n = next_leaf(n, loc.desktop->root)) { \
-				if (n->client != NULL) { \
-					n->client->k = v; \
+			if (loc.node != NULL) { \
+				for (node_t *n = first_extrema(loc.node); n != NULL; n = next_leaf(n, loc.node)) { \
+					if (n->client != NULL) { \
+						n->client->k = v; \
+					} \
 				} \
-			} \
-		} else if (loc.monitor != NULL) { \
-			for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) { \
-				for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) { \
+			} else if (loc.desktop != NULL) { \
+				for (node_t *n = first_extrema(loc.desktop->root); n != NULL; n = next_leaf(n, loc.desktop->root)) { \
 					if (n->client != NULL) { \
 						n->client->k = v; \
 					} \
 				} \
-			} \
-		} else { \
-			k = v; \
-			for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
-				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) { \
+			} else if (loc.monitor != NULL) { \
+				for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) { \
 					for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) { \
 						if (n->client != NULL) { \
 							n->client->k = v; \
 						} \
 					} \
 				} \
-			} \
-		}
-	} else if (streq("honor_size_hints", name)) {
-		honor_size_hints_mode_t hsh;
-		if (!parse_honor_size_hints_mode(value, &hsh)) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+			} else { \
+				k = v; \
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
+					for (desktop_t *d = m->desk_head; d != NULL; d = d->next) { \
+						for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) { \
+							if (n->client != NULL) { \
+								n->client->k = v; \
+							} \
+						} \
+					} \
+				} \
+			}
+		case SETTING_HONOR_SIZE_HINTS: {
+			honor_size_hints_mode_t hsh;
+			if (!parse_honor_size_hints_mode(value, &hsh)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			SET_DEF_WIN(honor_size_hints, hsh)
+			break;
 		}
-		SET_DEF_WIN(honor_size_hints, hsh)
 #undef SET_DEF_WIN
 #define SET_DEF_DEFMON_DESK(k, v) \
-		if (loc.desktop != NULL) { \
-			loc.desktop->k = v; \
-		} else if (loc.monitor != NULL) { \
-			loc.monitor->k = v; \
-			for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) { \
-				d->k = v; \
-			} \
-		} else { \
-			k = v; \
-			for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
-				m->k = v; \
-				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) { \
+			if (loc.desktop != NULL) { \
+				loc.desktop->k = v; \
+			} else if (loc.monitor != NULL) { \
+				loc.monitor->k = v; \
+				for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) { \
 					d->k = v; \
 				} \
-			} \
-		}
-	} else if (streq("window_gap", name)) {
-		int wg;
-		if (sscanf(value, "%i", &wg) != 1) {
-			fail(rsp, "%s", "");
-			return;
+			} else { \
+				k = v; \
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
+					m->k = v; \
+					for (desktop_t *d = m->desk_head; d != NULL; d = d->next) { \
+						d->k = v; \
+					} \
+				} \
+			}
+		case SETTING_WINDOW_GAP: {
+			int wg;
+			if (sscanf(value, "%i", &wg) != 1) {
+				fail(rsp, "%s", "");
+				return;
+			}
+			SET_DEF_DEFMON_DESK(window_gap, wg)
+			break;
 		}
-		SET_DEF_DEFMON_DESK(window_gap, wg)
 #undef SET_DEF_DEFMON_DESK
 #define SET_DEF_MON_DESK(k, v) \
-		if (loc.desktop != NULL) { \
-			loc.desktop->k = v; \
-		} else if (loc.monitor != NULL) { \
-			loc.monitor->k = v; \
-		} else { \
-			k = v; \
-			for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
-				m->k = v; \
-			} \
-		}
-	} else if (streq("top_padding", name)) {
-		int tp;
-		if (sscanf(value, "%i", &tp) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+			if (loc.desktop != NULL) { \
+				loc.desktop->k = v; \
+			} else if (loc.monitor != NULL) { \
+				loc.monitor->k = v; \
+			} else { \
+				k = v; \
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) { \
+					m->k = v; \
+				} \
+			}
+		case SETTING_TOP_PADDING: {
+			int tp;
+			if (sscanf(value, "%i", &tp) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			SET_DEF_MON_DESK(padding.top, tp)
+			break;
 		}
-		SET_DEF_MON_DESK(padding.top, tp)
-	} else if (streq("right_padding", name)) {
-		int rp;
-		if (sscanf(value, "%i", &rp) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_RIGHT_PADDING: {
+			int rp;
+			if (sscanf(value, "%i", &rp) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			SET_DEF_MON_DESK(padding.right, rp)
+			break;
 		}
-		SET_DEF_MON_DESK(padding.right, rp)
-	} else if (streq("bottom_padding", name)) {
-		int bp;
-		if (sscanf(value, "%i", &bp) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_BOTTOM_PADDING: {
+			int bp;
+			if (sscanf(value, "%i", &bp) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			SET_DEF_MON_DESK(padding.bottom, bp)
+			break;
 		}
-		SET_DEF_MON_DESK(padding.bottom, bp)
-	} else if (streq("left_padding", name)) {
-		int lp;
-		if (sscanf(value, "%i", &lp) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_LEFT_PADDING: {
+			int lp;
+			if (sscanf(value, "%i", &lp) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			SET_DEF_MON_DESK(padding.left, lp)
+			break;
 		}
-		SET_DEF_MON_DESK(padding.left, lp)
 #undef SET_DEF_MON_DESK
-	} else if (streq("top_monocle_padding", name)) {
-		if (sscanf(value, "%i", &monocle_padding.top) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-		}
-	} else if (streq("right_monocle_padding", name)) {
-		if (sscanf(value, "%i", &monocle_padding.right) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-		}
-	} else if (streq("bottom_monocle_padding", name)) {
-		if (sscanf(value, "%i", &monocle_padding.bottom) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-		}
-	} else if (streq("left_monocle_padding", name)) {
-		if (sscanf(value, "%i", &monocle_padding.left) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-		}
+		case SETTING_TOP_MONOCLE_PADDING:
+			if (sscanf(value, "%i", &monocle_padding.top) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+			}
+			break;
+		case SETTING_RIGHT_MONOCLE_PADDING:
+			if (sscanf(value, "%i", &monocle_padding.right) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+			}
+			break;
+		case SETTING_BOTTOM_MONOCLE_PADDING:
+			if (sscanf(value, "%i", &monocle_padding.bottom) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+			}
+			break;
+		case SETTING_LEFT_MONOCLE_PADDING:
+			if (sscanf(value, "%i", &monocle_padding.left) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+			}
+			break;
 #define SET_STR(s) \
-	} else if (streq(#s, name)) { \
-		if (snprintf(s, sizeof(s), "%s", value) < 0) { \
-			fail(rsp, "%s", ""); \
-			return; \
-		}
-	SET_STR(external_rules_command)
-	SET_STR(status_prefix)
+			if (snprintf(s, sizeof(s), "%s", value) < 0) { \
+				fail(rsp, "%s", ""); \
+				return; \
+			}
+		case SETTING_EXTERNAL_RULES_COMMAND:
+			SET_STR(external_rules_command)
+			stop_rule_daemon();
+			break;
+		case SETTING_STATUS_PREFIX:
+			SET_STR(status_prefix)
+			invalidate_report();
+			break;
 #undef SET_STR
-	} else if (streq("split_ratio", name)) {
-		double r;
-		if (sscanf(value, "%lf", &r) == 1 && r > 0 && r < 1) {
-			split_ratio = r;
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
+		case SETTING_EXTERNAL_RULES_DAEMON:
+			if (!parse_bool(value, &external_rules_daemon)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			stop_rule_daemon();
+			break;
+		case SETTING_EXTERNAL_RULES_TIMEOUT:
+			if (sscanf(value, "%u", &external_rules_timeout) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
+		case SETTING_HISTORY_SIZE:
+			if (sscanf(value, "%u", &history_size) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			history_trim();
+			break;
+		case SETTING_SPLIT_RATIO: {
+			double r;
+			if (sscanf(value, "%lf", &r) == 1 && r > 0 && r < 1) {
+				split_ratio = r;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
 			return;
 		}
-		return;
-#define SET_COLOR(s) \
-	} else if (streq(#s, name)) { \
-		if (!is_hex_color(value)) { \
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
-			return; \
-		} else { \
-			snprintf(s, sizeof(s), "%s", value); \
-			colors_changed = true; \
-		}
-	SET_COLOR(normal_border_color)
-	SET_COLOR(active_border_color)
-	SET_COLOR(focused_border_color)
-	SET_COLOR(presel_feedback_color)
+#define SET_COLOR(k, s) \
+		case SETTING_##k: \
+			if (!is_hex_color(value)) { \
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
+				return; \
+			} else { \
+				snprintf(s, sizeof(s), "%s", value); \
+				colors_changed = true; \
+			} \
+			break;
+		SET_COLOR(NORMAL_BORDER_COLOR, normal_border_color)
+		SET_COLOR(ACTIVE_BORDER_COLOR, active_border_color)
+		SET_COLOR(FOCUSED_BORDER_COLOR, focused_border_color)
+		SET_COLOR(PRESEL_FEEDBACK_COLOR, presel_feedback_color)
 #undef SET_COLOR
-	} else if (streq("initial_polarity", name)) {
-		child_polarity_t p;
-		if (parse_child_polarity(value, &p)) {
-			initial_polarity = p;
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
-		}
-	} else if (streq("automatic_scheme", name)) {
-		automatic_scheme_t a;
-		if (parse_automatic_scheme(value, &a)) {
-			automatic_scheme = a;
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
-		}
-	} else if (streq("mapping_events_count", name)) {
-		if (sscanf(value, "%" SCNi8, &mapping_events_count) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
-		}
-	} else if (streq("directional_focus_tightness", name)) {
-		tightness_t p;
-		if (parse_tightness(value, &p)) {
-			directional_focus_tightness = p;
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
-		}
-	} else if (streq("ignore_ewmh_fullscreen", name)) {
-		state_transition_t m;
-		if (parse_state_transition(value, &m)) {
-			ignore_ewmh_fullscreen = m;
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_INITIAL_POLARITY: {
+			child_polarity_t p;
+			if (parse_child_polarity(value, &p)) {
+				initial_polarity = p;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-	} else if (streq("pointer_modifier", name)) {
-		if (parse_modifier_mask(value, &pointer_modifier)) {
-			ungrab_buttons();
-			grab_buttons();
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_AUTOMATIC_SCHEME: {
+			automatic_scheme_t a;
+			if (parse_automatic_scheme(value, &a)) {
+				automatic_scheme = a;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-	} else if (streq("pointer_motion_interval", name)) {
-		if (sscanf(value, "%u", &pointer_motion_interval) != 1) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_SUBSCRIBER_OVERFLOW: {
+			subscriber_overflow_t o;
+			if (parse_subscriber_overflow(value, &o)) {
+				subscriber_overflow = o;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-	} else if (streq("pointer_action1", name) ||
-	           streq("pointer_action2", name) ||
-	           streq("pointer_action3", name)) {
-		int index = name[14] - '1';
-		if (parse_pointer_action(value, &pointer_actions[index])) {
-			ungrab_buttons();
-			grab_buttons();
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_MAPPING_EVENTS_COUNT:
+			if (sscanf(value, "%" SCNi8, &mapping_events_count) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
+		case SETTING_DIRECTIONAL_FOCUS_TIGHTNESS: {
+			tightness_t p;
+			if (parse_tightness(value, &p)) {
+				directional_focus_tightness = p;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-	} else if (streq("click_to_focus", name)) {
-		if (parse_button_index(value, &click_to_focus)) {
-			ungrab_buttons();
-			grab_buttons();
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_IGNORE_EWMH_FULLSCREEN: {
+			state_transition_t m;
+			if (parse_state_transition(value, &m)) {
+				ignore_ewmh_fullscreen = m;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-	} else if (streq("single_monocle", name)) {
-		bool b;
-		if (parse_bool(value, &b)) {
-			if (b == single_monocle) {
-				fail(rsp, "%s", "");
+		case SETTING_POINTER_MODIFIER:
+			if (parse_modifier_mask(value, &pointer_modifier)) {
+				ungrab_buttons();
+				grab_buttons();
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
 				return;
 			}
-			single_monocle = b;
-			for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-					layout_t l = (single_monocle && tiled_count(d->root, true) <= 1) ? LAYOUT_MONOCLE : d->user_layout;
-					set_layout(m, d, l, false);
-				}
+			break;
+		case SETTING_POINTER_MOTION_INTERVAL:
+			if (sscanf(value, "%u", &pointer_motion_interval) != 1) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
 			}
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+			break;
+		case SETTING_POINTER_ACTION1:
+		case SETTING_POINTER_ACTION2:
+		case SETTING_POINTER_ACTION3: {
+			int index = setting - SETTING_POINTER_ACTION1;
+			if (parse_pointer_action(value, &pointer_actions[index])) {
+				ungrab_buttons();
+				grab_buttons();
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-	} else if (streq("focus_follows_pointer", name)) {
-		bool b;
-		if (parse_bool(value, &b)) {
-			if (b == focus_follows_pointer) {
-				fail(rsp, "%s", "");
+		case SETTING_CLICK_TO_FOCUS:
+			if (parse_button_index(value, &click_to_focus)) {
+				ungrab_buttons();
+				grab_buttons();
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
 				return;
 			}
-			focus_follows_pointer = b;
-			for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-				if (focus_follows_pointer) {
-					window_show(m->root);
-				} else {
-					window_hide(m->root);
+			break;
+		case SETTING_SINGLE_MONOCLE: {
+			bool b;
+			if (parse_bool(value, &b)) {
+				if (b == single_monocle) {
+					fail(rsp, "%s", "");
+					return;
 				}
-				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-					listen_enter_notify(d->root, focus_follows_pointer);
+				single_monocle = b;
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+					for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+						layout_t l = (single_monocle && tiled_count(d->root, true) <= 1) ? LAYOUT_MONOCLE : d->user_layout;
+						set_layout(m, d, l, false);
+					}
 				}
-			}
-			if (focus_follows_pointer) {
-				update_motion_recorder();
 			} else {
-				disable_motion_recorder();
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
 			}
-			return;
-		} else {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+			break;
 		}
-#define SET_BOOL(s) \
-	} else if (streq(#s, name)) { \
-		if (!parse_bool(value, &s)) { \
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
-			return; \
+		case SETTING_FOCUS_FOLLOWS_POINTER: {
+			bool b;
+			if (parse_bool(value, &b)) {
+				if (b == focus_follows_pointer) {
+					fail(rsp, "%s", "");
+					return;
+				}
+				focus_follows_pointer = b;
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+					if (focus_follows_pointer) {
+						window_show(m->root);
+					} else {
+						window_hide(m->root);
+					}
+					for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+						listen_enter_notify(d->root, focus_follows_pointer);
+					}
+				}
+				if (focus_follows_pointer) {
+					update_motion_recorder();
+				} else {
+					disable_motion_recorder();
+				}
+				return;
+			} else {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			break;
 		}
-		SET_BOOL(presel_feedback)
-		SET_BOOL(borderless_monocle)
-		SET_BOOL(gapless_monocle)
-		SET_BOOL(borderless_singleton)
-		SET_BOOL(swallow_first_click)
-		SET_BOOL(pointer_follows_focus)
-		SET_BOOL(pointer_follows_monitor)
-		SET_BOOL(ignore_ewmh_focus)
-		SET_BOOL(ignore_ewmh_struts)
-		SET_BOOL(center_pseudo_tiled)
-		SET_BOOL(removal_adjustment)
-#undef SET_BOOL
-	} else if (streq("tile_limit_enabled", name)) {
-		bool b;
-		if (!parse_bool(value, &b)) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+		case SETTING_COMPOSITED_SWITCHING: {
+			bool b;
+			if (!parse_bool(value, &b)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			set_composited_switching(b);
 			return;
 		}
+#define SET_BOOL(k, s) \
+		case SETTING_##k: \
+			if (!parse_bool(value, &s)) { \
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
+				return; \
+			} \
+			break;
+		SET_BOOL(PRESEL_FEEDBACK, presel_feedback)
+		SET_BOOL(BORDERLESS_MONOCLE, borderless_monocle)
+		SET_BOOL(GAPLESS_MONOCLE, gapless_monocle)
+		SET_BOOL(BORDERLESS_SINGLETON, borderless_singleton)
+		SET_BOOL(SWALLOW_FIRST_CLICK, swallow_first_click)
+		SET_BOOL(POINTER_MOTION_SYNC, pointer_motion_sync)
+		SET_BOOL(POINTER_FOLLOWS_FOCUS, pointer_follows_focus)
+		SET_BOOL(POINTER_FOLLOWS_MONITOR, pointer_follows_monitor)
+		SET_BOOL(IGNORE_EWMH_FOCUS, ignore_ewmh_focus)
+		SET_BOOL(IGNORE_EWMH_STRUTS, ignore_ewmh_struts)
+		SET_BOOL(CENTER_PSEUDO_TILED, center_pseudo_tiled)
+		SET_BOOL(REMOVAL_ADJUSTMENT, removal_adjustment)
+#undef SET_BOOL
+		case SETTING_TILE_LIMIT_ENABLED: {
+			bool b;
+			if (!parse_bool(value, &b)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
 
-		if (loc.desktop != NULL) {
-			loc.desktop->tile_limit_enabled = b;
-			return;
-		}
+			if (loc.desktop != NULL) {
+				loc.desktop->tile_limit_enabled = b;
+				return;
+			}
 
-		if (loc.monitor != NULL) {
-			for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) {
-				d->tile_limit_enabled = b;
+			if (loc.monitor != NULL) {
+				for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) {
+					d->tile_limit_enabled = b;
+				}
+				return;
 			}
-			return;
-		}
 
-		tile_limit_enabled = b;
-		for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-			for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-				d->tile_limit_enabled = b;
+			tile_limit_enabled = b;
+			for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+					d->tile_limit_enabled = b;
+				}
 			}
+			break;
 		}
-	} else if (streq("max_tiles_per_desktop", name)) {
-		int limit;
-		if (sscanf(value, "%i", &limit) != 1 || limit < 1 || limit > MAX_TILES_PER_DESKTOP) {
-			fail(rsp, "config: %s: Invalid value: '%s' (must be 1-%d).\n", name, value, MAX_TILES_PER_DESKTOP);
-			return;
-		}
+		case SETTING_MAX_TILES_PER_DESKTOP: {
+			int limit;
+			if (sscanf(value, "%i", &limit) != 1 || limit < 1 || limit > MAX_TILES_PER_DESKTOP) {
+				fail(rsp, "config: %s: Invalid value: '%s' (must be 1-%d).\n", name, value, MAX_TILES_PER_DESKTOP);
+				return;
+			}
 
-		if (loc.desktop != NULL) {
-			loc.desktop->max_tiles_per_desktop = limit;
-			return;
-		}
+			if (loc.desktop != NULL) {
+				loc.desktop->max_tiles_per_desktop = limit;
+				return;
+			}
 
-		if (loc.monitor != NULL) {
-			for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) {
-				d->max_tiles_per_desktop = limit;
+			if (loc.monitor != NULL) {
+				for (desktop_t *d = loc.monitor->desk_head; d != NULL; d = d->next) {
+					d->max_tiles_per_desktop = limit;
+				}
+				return;
 			}
-			return;
-		}
 
-		max_tiles_per_desktop = limit;
-		for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-			for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-				d->max_tiles_per_desktop = limit;
+			max_tiles_per_desktop = limit;
+			for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+				for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+					d->max_tiles_per_desktop = limit;
+				}
 			}
+			break;
 		}
-	} else if (streq("edge_snap_enabled", name)) {
-		bool b;
-		if (!parse_bool(value, &b)) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_EDGE_SNAP_ENABLED: {
+			bool b;
+			if (!parse_bool(value, &b)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			edge_snap_enabled = b;
+			break;
 		}
-		edge_snap_enabled = b;
-	} else if (streq("edge_snap_threshold", name)) {
-		int t;
-		if (sscanf(value, "%i", &t) != 1 || t < 1 || t > 100) {
-			fail(rsp, "config: %s: Invalid value: '%s' (must be 1-100).\n", name, value);
-			return;
+		case SETTING_EDGE_SNAP_THRESHOLD: {
+			int t;
+			if (sscanf(value, "%i", &t) != 1 || t < 1 || t > 100) {
+				fail(rsp, "config: %s: Invalid value: '%s' (must be 1-100).\n", name, value);
+				return;
+			}
+			edge_snap_threshold = t;
+			break;
 		}
-		edge_snap_threshold = t;
-	} else if (streq("raise_floating_on_click", name)) {
-		bool b;
-		if (!parse_bool(value, &b)) {
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
-			return;
+		case SETTING_RAISE_FLOATING_ON_CLICK: {
+			bool b;
+			if (!parse_bool(value, &b)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			raise_floating_on_click = b;
+			break;
 		}
-		raise_floating_on_click = b;
-	} else if (streq("cascade_offset", name)) {
-		int o;
-		if (sscanf(value, "%i", &o) != 1 || o < 0 || o > 100) {
-			fail(rsp, "config: %s: Invalid value: '%s' (must be 0-100).\n", name, value);
-			return;
+		case SETTING_CASCADE_OFFSET: {
+			int o;
+			if (sscanf(value, "%i", &o) != 1 || o < 0 || o > 100) {
+				fail(rsp, "config: %s: Invalid value: '%s' (must be 0-100).\n", name, value);
+				return;
+			}
+			cascade_offset = o;
+			break;
 		}
-		cascade_offset = o;
-#define SET_MON_BOOL(s) \
-	} else if (streq(#s, name)) { \
-		if (!parse_bool(value, &s)) { \
-			fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
-			return; \
-		} \
-		if (s) { \
-			update_monitors(); \
+		case SETTING_CONFIGURE_RATE_LIMIT: {
+			int l;
+			if (sscanf(value, "%i", &l) != 1 || l < 0 || l > 10000) {
+				fail(rsp, "config: %s: Invalid value: '%s' (must be 0-10000).\n", name, value);
+				return;
+			}
+			configure_rate_limit = l;
+			break;
 		}
-		SET_MON_BOOL(remove_disabled_monitors)
-		SET_MON_BOOL(remove_unplugged_monitors)
-		SET_MON_BOOL(merge_overlapping_monitors)
+#define SET_MON_BOOL(k, s) \
+		case SETTING_##k: \
+			if (!parse_bool(value, &s)) { \
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value); \
+				return; \
+			} \
+			if (s) { \
+				update_monitors(); \
+			} \
+			break;
+		SET_MON_BOOL(REMOVE_DISABLED_MONITORS, remove_disabled_monitors)
+		SET_MON_BOOL(REMOVE_UNPLUGGED_MONITORS, remove_unplugged_monitors)
+		SET_MON_BOOL(MERGE_OVERLAPPING_MONITORS, merge_overlapping_monitors)
 #undef SET_MON_BOOL
-	} else {
-		fail(rsp, "config: Unknown setting: '%s'.\n", name);
-		return;
+		case SETTING_ADAPTIVE_SYNC: {
+			bool b;
+			if (!parse_bool(value, &b)) {
+				fail(rsp, "config: %s: Invalid value: '%s'.\n", name, value);
+				return;
+			}
+			if (loc.monitor != NULL) {
+				if (!backend_set_adaptive_sync(loc.monitor->output_id, b)) {
+					fail(rsp, "config: %s: Not supported by monitor '%s'.\n", name, loc.monitor->name);
+					return;
+				}
+				loc.monitor->adaptive_sync = b;
+			} else {
+				monitor_t *unsupported = NULL;
+				for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+					if (backend_set_adaptive_sync(m->output_id, b)) {
+						m->adaptive_sync = b;
+					} else if (unsupported == NULL) {
+						unsupported = m;
+					}
+				}
+				if (unsupported != NULL) {
+					fail(rsp, "config: %s: Not supported by monitor '%s'.\n", name, unsupported->name);
+					return;
+				}
+				adaptive_sync = b;
+			}
+			break;
+		}
+		default:
+			fail(rsp, "config: Unknown setting: '%s'.\n", name);
+			return;
 	}
 
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
 		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			invalidate_layout_in(d->root);
 			arrange(m, d);
 			if (colors_changed) {
 				update_colors_in(d->root, d, m);
@@ -1972,134 +2594,188 @@ void set_setting(coordinates_t loc, char *name, char *value, FILE *rsp)
 
 void get_setting(coordinates_t loc, char *name, FILE* rsp)
 {
-	if (streq("split_ratio", name)) {
-		fprintf(rsp, "%lf", split_ratio);
-	} else if (streq("border_width", name)) {
-		if (loc.node != NULL) {
-			for (node_t *n = first_extrema(loc.node); n != NULL; n = next_leaf(n, loc.node)) {
-				if (n->client != NULL) {
-					fprintf(rsp, "%u", n->client->border_width);
-					break;
-				}
-			}
-		} else if (loc.desktop != NULL) {
-			fprintf(rsp, "%u", loc.desktop->border_width);
-		} else if (loc.monitor != NULL) {
-			fprintf(rsp, "%u", loc.monitor->border_width);
-		} else {
-			fprintf(rsp, "%u", border_width);
-		}
-	} else if (streq("window_gap", name)) {
-		if (loc.desktop != NULL) {
-			fprintf(rsp, "%i", loc.desktop->window_gap);
-		} else if (loc.monitor != NULL) {
-			fprintf(rsp, "%i", loc.monitor->window_gap);
-		} else {
-			fprintf(rsp, "%i", window_gap);
-		}
+	int setting = name_table_lookup(&setting_table, name);
+	switch (setting) {
+		case SETTING_SPLIT_RATIO:
+			fprintf(rsp, "%lf", split_ratio);
+			break;
+		case SETTING_BORDER_WIDTH:
+			if (loc.node != NULL) {
+				for (node_t *n = first_extrema(loc.node); n != NULL; n = next_leaf(n, loc.node)) {
+					if (n->client != NULL) {
+						fprintf(rsp, "%u", n->client->border_width);
+						break;
+					}
+				}
+			} else if (loc.desktop != NULL) {
+				fprintf(rsp, "%u", loc.desktop->border_width);
+			} else if (loc.monitor != NULL) {
+				fprintf(rsp, "%u", loc.monitor->border_width);
+			} else {
+				fprintf(rsp, "%u", border_width);
+			}
+			break;
+		case SETTING_WINDOW_GAP:
+			if (loc.desktop != NULL) {
+				fprintf(rsp, "%i", loc.desktop->window_gap);
+			} else if (loc.monitor != NULL) {
+				fprintf(rsp, "%i", loc.monitor->window_gap);
+			} else {
+				fprintf(rsp, "%i", window_gap);
+			}
+			break;
 #define GET_DEF_MON_DESK(k) \
-		if (loc.desktop != NULL) { \
-			fprintf(rsp, "%i", loc.desktop->k); \
-		} else if (loc.monitor != NULL) { \
-			fprintf(rsp, "%i", loc.monitor->k); \
-		} else { \
-			fprintf(rsp, "%i", k); \
-		}
-	} else if (streq("top_padding", name)) {
-		GET_DEF_MON_DESK(padding.top)
-	} else if (streq("right_padding", name)) {
-		GET_DEF_MON_DESK(padding.right)
-	} else if (streq("bottom_padding", name)) {
-		GET_DEF_MON_DESK(padding.bottom)
-	} else if (streq("left_padding", name)) {
-		GET_DEF_MON_DESK(padding.left)
+			if (loc.desktop != NULL) { \
+				fprintf(rsp, "%i", loc.desktop->k); \
+			} else if (loc.monitor != NULL) { \
+				fprintf(rsp, "%i", loc.monitor->k); \
+			} else { \
+				fprintf(rsp, "%i", k); \
+			}
+		case SETTING_TOP_PADDING:
+			GET_DEF_MON_DESK(padding.top)
+			break;
+		case SETTING_RIGHT_PADDING:
+			GET_DEF_MON_DESK(padding.right)
+			break;
+		case SETTING_BOTTOM_PADDING:
+			GET_DEF_MON_DESK(padding.bottom)
+			break;
+		case SETTING_LEFT_PADDING:
+			GET_DEF_MON_DESK(padding.left)
+			break;
 #undef GET_DEF_MON_DESK
-	} else if (streq("top_monocle_padding", name)) {
-		fprintf(rsp, "%i", monocle_padding.top);
-	} else if (streq("right_monocle_padding", name)) {
-		fprintf(rsp, "%i", monocle_padding.right);
-	} else if (streq("bottom_monocle_padding", name)) {
-		fprintf(rsp, "%i", monocle_padding.bottom);
-	} else if (streq("left_monocle_padding", name)) {
-		fprintf(rsp, "%i", monocle_padding.left);
-	} else if (streq("external_rules_command", name)) {
-		fprintf(rsp, "%s", external_rules_command);
-	} else if (streq("status_prefix", name)) {
-		fprintf(rsp, "%s", status_prefix);
-	} else if (streq("initial_polarity", name)) {
-		fprintf(rsp, "%s", CHILD_POL_STR(initial_polarity));
-	} else if (streq("automatic_scheme", name)) {
-		fprintf(rsp, "%s", AUTO_SCM_STR(automatic_scheme));
-	} else if (streq("honor_size_hints", name)) {
-		fprintf(rsp, "%s", HSH_MODE_STR(honor_size_hints));
-	} else if (streq("mapping_events_count", name)) {
-		fprintf(rsp, "%" PRIi8, mapping_events_count);
-	} else if (streq("directional_focus_tightness", name)) {
-		fprintf(rsp, "%s", TIGHTNESS_STR(directional_focus_tightness));
-	} else if (streq("ignore_ewmh_fullscreen", name)) {
-		print_ignore_request(ignore_ewmh_fullscreen, rsp);
-	} else if (streq("pointer_modifier", name)) {
-		print_modifier_mask(pointer_modifier, rsp);
-	} else if (streq("click_to_focus", name)) {
-		print_button_index(click_to_focus, rsp);
-	} else if (streq("pointer_motion_interval", name)) {
-		fprintf(rsp, "%u", pointer_motion_interval);
-	} else if (streq("pointer_action1", name) ||
-	           streq("pointer_action2", name) ||
-	           streq("pointer_action3", name)) {
-		int index = name[14] - '1';
-		print_pointer_action(pointer_actions[index], rsp);
-#define GET_COLOR(s) \
-	} else if (streq(#s, name)) { \
-		fprintf(rsp, "%s", s);
-	GET_COLOR(normal_border_color)
-	GET_COLOR(active_border_color)
-	GET_COLOR(focused_border_color)
-	GET_COLOR(presel_feedback_color)
+		case SETTING_ADAPTIVE_SYNC:
+			fprintf(rsp, "%s", BOOL_STR(loc.monitor != NULL ? loc.monitor->adaptive_sync : adaptive_sync));
+			break;
+		case SETTING_TOP_MONOCLE_PADDING:
+			fprintf(rsp, "%i", monocle_padding.top);
+			break;
+		case SETTING_RIGHT_MONOCLE_PADDING:
+			fprintf(rsp, "%i", monocle_padding.right);
+			break;
+		case SETTING_BOTTOM_MONOCLE_PADDING:
+			fprintf(rsp, "%i", monocle_padding.bottom);
+			break;
+		case SETTING_LEFT_MONOCLE_PADDING:
+			fprintf(rsp, "%i", monocle_padding.left);
+			break;
+		case SETTING_EXTERNAL_RULES_COMMAND:
+			fprintf(rsp, "%s", external_rules_command);
+			break;
+		case SETTING_EXTERNAL_RULES_DAEMON:
+			fprintf(rsp, "%s", BOOL_STR(external_rules_daemon));
+			break;
+		case SETTING_EXTERNAL_RULES_TIMEOUT:
+			fprintf(rsp, "%u", external_rules_timeout);
+			break;
+		case SETTING_STATUS_PREFIX:
+			fprintf(rsp, "%s", status_prefix);
+			break;
+		case SETTING_HISTORY_SIZE:
+			fprintf(rsp, "%u", history_size);
+			break;
+		case SETTING_INITIAL_POLARITY:
+			fprintf(rsp, "%s", CHILD_POL_STR(initial_polarity));
+			break;
+		case SETTING_AUTOMATIC_SCHEME:
+			fprintf(rsp, "%s", AUTO_SCM_STR(automatic_scheme));
+			break;
+		case SETTING_SUBSCRIBER_OVERFLOW:
+			fprintf(rsp, "%s", OVERFLOW_STR(subscriber_overflow));
+			break;
+		case SETTING_HONOR_SIZE_HINTS:
+			fprintf(rsp, "%s", HSH_MODE_STR(honor_size_hints));
+			break;
+		case SETTING_MAPPING_EVENTS_COUNT:
+			fprintf(rsp, "%" PRIi8, mapping_events_count);
+			break;
+		case SETTING_DIRECTIONAL_FOCUS_TIGHTNESS:
+			fprintf(rsp, "%s", TIGHTNESS_STR(directional_focus_tightness));
+			break;
+		case SETTING_IGNORE_EWMH_FULLSCREEN:
+			print_ignore_request(ignore_ewmh_fullscreen, rsp);
+			break;
+		case SETTING_POINTER_MODIFIER:
+			print_modifier_mask(pointer_modifier, rsp);
+			break;
+		case SETTING_CLICK_TO_FOCUS:
+			print_button_index(click_to_focus, rsp);
+			break;
+		case SETTING_POINTER_MOTION_INTERVAL:
+			fprintf(rsp, "%u", pointer_motion_interval);
+			break;
+		case SETTING_POINTER_ACTION1:
+		case SETTING_POINTER_ACTION2:
+		case SETTING_POINTER_ACTION3: {
+			int index = setting - SETTING_POINTER_ACTION1;
+			print_pointer_action(pointer_actions[index], rsp);
+			break;
+		}
+#define GET_COLOR(k, s) \
+		case SETTING_##k: \
+			fprintf(rsp, "%s", s); \
+			break;
+		GET_COLOR(NORMAL_BORDER_COLOR, normal_border_color)
+		GET_COLOR(ACTIVE_BORDER_COLOR, active_border_color)
+		GET_COLOR(FOCUSED_BORDER_COLOR, focused_border_color)
+		GET_COLOR(PRESEL_FEEDBACK_COLOR, presel_feedback_color)
 #undef GET_COLOR
-#define GET_BOOL(s) \
-	} else if (streq(#s, name)) { \
-		fprintf(rsp, "%s", BOOL_STR(s));
-	GET_BOOL(presel_feedback)
-	GET_BOOL(borderless_monocle)
-	GET_BOOL(gapless_monocle)
-	GET_BOOL(single_monocle)
-	GET_BOOL(borderless_singleton)
-	GET_BOOL(swallow_first_click)
-	GET_BOOL(focus_follows_pointer)
-	GET_BOOL(pointer_follows_focus)
-	GET_BOOL(pointer_follows_monitor)
-	GET_BOOL(ignore_ewmh_focus)
-	GET_BOOL(ignore_ewmh_struts)
-	GET_BOOL(center_pseudo_tiled)
-	GET_BOOL(removal_adjustment)
-	GET_BOOL(remove_disabled_monitors)
-	GET_BOOL(remove_unplugged_monitors)
-	GET_BOOL(merge_overlapping_monitors)
+#define GET_BOOL(k, s) \
+		case SETTING_##k: \
+			fprintf(rsp, "%s", BOOL_STR(s)); \
+			break;
+		GET_BOOL(PRESEL_FEEDBACK, presel_feedback)
+		GET_BOOL(BORDERLESS_MONOCLE, borderless_monocle)
+		GET_BOOL(GAPLESS_MONOCLE, gapless_monocle)
+		GET_BOOL(SINGLE_MONOCLE, single_monocle)
+		GET_BOOL(BORDERLESS_SINGLETON, borderless_singleton)
+		GET_BOOL(SWALLOW_FIRST_CLICK, swallow_first_click)
+		GET_BOOL(POINTER_MOTION_SYNC, pointer_motion_sync)
+		GET_BOOL(FOCUS_FOLLOWS_POINTER, focus_follows_pointer)
+		GET_BOOL(POINTER_FOLLOWS_FOCUS, pointer_follows_focus)
+		GET_BOOL(POINTER_FOLLOWS_MONITOR, pointer_follows_monitor)
+		GET_BOOL(IGNORE_EWMH_FOCUS, ignore_ewmh_focus)
+		GET_BOOL(IGNORE_EWMH_STRUTS, ignore_ewmh_struts)
+		GET_BOOL(CENTER_PSEUDO_TILED, center_pseudo_tiled)
+		GET_BOOL(COMPOSITED_SWITCHING, composited_switching)
+		GET_BOOL(REMOVAL_ADJUSTMENT, removal_adjustment)
+		GET_BOOL(REMOVE_DISABLED_MONITORS, remove_disabled_monitors)
+		GET_BOOL(REMOVE_UNPLUGGED_MONITORS, remove_unplugged_monitors)
+		GET_BOOL(MERGE_OVERLAPPING_MONITORS, merge_overlapping_monitors)
 #undef GET_BOOL
-	} else if (streq("tile_limit_enabled", name)) {
-		if (loc.desktop != NULL) {
-			fprintf(rsp, "%s", BOOL_STR(loc.desktop->tile_limit_enabled));
-		} else {
-			fprintf(rsp, "%s", BOOL_STR(tile_limit_enabled));
-		}
-	} else if (streq("max_tiles_per_desktop", name)) {
-		if (loc.desktop != NULL) {
-			fprintf(rsp, "%i", loc.desktop->max_tiles_per_desktop);
-		} else {
-			fprintf(rsp, "%i", max_tiles_per_desktop);
-		}
-	} else if (streq("edge_snap_enabled", name)) {
-		fprintf(rsp, "%s", BOOL_STR(edge_snap_enabled));
-	} else if (streq("edge_snap_threshold", name)) {
-		fprintf(rsp, "%i", edge_snap_threshold);
-	} else if (streq("raise_floating_on_click", name)) {
-		fprintf(rsp, "%s", BOOL_STR(raise_floating_on_click));
-	} else if (streq("cascade_offset", name)) {
-		fprintf(rsp, "%i", cascade_offset);
-	} else {
-		fail(rsp, "config: Unknown setting: '%s'.\n", name);
-		return;
+		case SETTING_TILE_LIMIT_ENABLED:
+			if (loc.desktop != NULL) {
+				fprintf(rsp, "%s", BOOL_STR(loc.desktop->tile_limit_enabled));
+			} else {
+				fprintf(rsp, "%s", BOOL_STR(tile_limit_enabled));
+			}
+			break;
+		case SETTING_MAX_TILES_PER_DESKTOP:
+			if (loc.desktop != NULL) {
+				fprintf(rsp, "%i", loc.desktop->max_tiles_per_desktop);
+			} else {
+				fprintf(rsp, "%i", max_tiles_per_desktop);
+			}
+			break;
+		case SETTING_EDGE_SNAP_ENABLED:
+			fprintf(rsp, "%s", BOOL_STR(edge_snap_enabled));
+			break;
+		case SETTING_EDGE_SNAP_THRESHOLD:
+			fprintf(rsp, "%i", edge_snap_threshold);
+			break;
+		case SETTING_RAISE_FLOATING_ON_CLICK:
+			fprintf(rsp, "%s", BOOL_STR(raise_floating_on_click));
+			break;
+		case SETTING_CASCADE_OFFSET:
+			fprintf(rsp, "%i", cascade_offset);
+			break;
+		case SETTING_CONFIGURE_RATE_LIMIT:
+			fprintf(rsp, "%i", configure_rate_limit);
+			break;
+		default:
+			fail(rsp, "config: Unknown setting: '%s'.\n", name);
+			return;
 	}
 	fprintf(rsp, "\n");
 }
@@ -2131,6 +2807,7 @@ void fail(FILE *rsp, char *fmt, ...)
 /*
  * bspc keybind --add "super + Return" "alacritty"
  * bspc keybind --add "super + q" "bspc node -c"
+ * bspc keybind --add "super + w ; f" "firefox"
  * bspc keybind --remove "super + Return"
  * bspc keybind --list
  * bspc keybind --clear
@@ -2149,8 +2826,9 @@ void cmd_keybind(char **args, int num, FILE *rsp)
 			fail(rsp, "keybind --add: Need COMBO and COMMAND.\n");
 			return;
 		}
-		uint32_t modifiers, keysym;
-		if (!keybind_parse_combo(args[0], &modifiers, &keysym)) {
+		keystroke_t keys[MAX_CHORD];
+		size_t len;
+		if (!keybind_parse_chord(args[0], keys, &len)) {
 			fail(rsp, "keybind --add: Invalid key combo: '%s'.\n", args[0]);
 			return;
 		}
@@ -2166,8 +2844,8 @@ void cmd_keybind(char **args, int num, FILE *rsp)
 			off += arglen;
 		}
 		cmd_buf[off] = '\0';
-		if (!keybind_add(modifiers, keysym, cmd_buf)) {
-			fail(rsp, "keybind --add: Keybind table full.\n");
+		if (!keybind_add(keys, len, cmd_buf)) {
+			fail(rsp, "keybind --add: Conflicts with a key chord: '%s'.\n", args[0]);
 		} else {
 			backend_grab_keys();
 		}
@@ -2177,38 +2855,19 @@ void cmd_keybind(char **args, int num, FILE *rsp)
 			fail(rsp, "keybind --remove: Need COMBO.\n");
 			return;
 		}
-		uint32_t modifiers, keysym;
-		if (!keybind_parse_combo(args[0], &modifiers, &keysym)) {
+		keystroke_t keys[MAX_CHORD];
+		size_t len;
+		if (!keybind_parse_chord(args[0], keys, &len)) {
 			fail(rsp, "keybind --remove: Invalid key combo: '%s'.\n", args[0]);
 			return;
 		}
-		/* Find and remove */
-		for (int i = 0; i < keybind_table.count; i++) {
-			if (keybind_table.binds[i].modifiers == modifiers &&
-			    keybind_table.binds[i].keysym == keysym) {
-				/* Shift remaining entries down */
-				memmove(&keybind_table.binds[i], &keybind_table.binds[i+1],
-				        (keybind_table.count - i - 1) * sizeof(keybind_t));
-				keybind_table.count--;
-				backend_grab_keys();
-				return;
-			}
+		if (keybind_remove(keys, len)) {
+			backend_grab_keys();
+		} else {
+			fail(rsp, "keybind --remove: Binding not found.\n");
 		}
-		fail(rsp, "keybind --remove: Binding not found.\n");
 	} else if (streq("-l", *args) || streq("--list", *args)) {
-		for (int i = 0; i < keybind_table.count; i++) {
-			keybind_t *kb = &keybind_table.binds[i];
-			char combo[128] = {0};
-			int off = 0;
-			if (kb->modifiers & KBMOD_SUPER) off += snprintf(combo + off, sizeof(combo) - off, "super + ");
-			if (kb->modifiers & KBMOD_ALT)   off += snprintf(combo + off, sizeof(combo) - off, "alt + ");
-			if (kb->modifiers & KBMOD_CTRL)   off += snprintf(combo + off, sizeof(combo) - off, "ctrl + ");
-			if (kb->modifiers & KBMOD_SHIFT)  off += snprintf(combo + off, sizeof(combo) - off, "shift + ");
-			char keysym_name[64];
-			xkb_keysym_get_name(kb->keysym, keysym_name, sizeof(keysym_name));
-			snprintf(combo + off, sizeof(combo) - off, "%s", keysym_name);
-			fprintf(rsp, "%s\n\t%s\n", combo, kb->command);
-		}
+		keybind_list(rsp);
 	} else if (streq("-c", *args) || streq("--clear", *args)) {
 		keybind_clear();
 		backend_grab_keys();
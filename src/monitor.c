@@ -71,6 +71,7 @@ monitor_t *make_monitor(const char *name, bspwm_rect_t *rect, uint32_t id)
 	m->padding = padding;
 	m->border_width = border_width;
 	m->window_gap = window_gap;
+	m->adaptive_sync = adaptive_sync;
 	m->root = BSPWM_WID_NONE;
 	m->prev = m->next = NULL;
 	m->desk = m->desk_head = m->desk_tail = NULL;
@@ -109,6 +110,7 @@ void update_root(monitor_t *m, bspwm_rect_t *rect)
 			if (n->client)
 				adapt_geometry(&last_rect, rect, n);
 		}
+		invalidate_layout_in(d->root);
 		arrange(m, d);
 	}
 	reorder_monitor(m);
@@ -297,7 +299,6 @@ void remove_monitor(monitor_t *m)
 	monitor_t *last_mon = mon;
 	unlink_monitor(m);
 	backend_destroy_window(m->root);
-	locate_window_cache_clear();
 	free(m);
 
 	if (mon != last_mon)
@@ -455,7 +456,9 @@ bool find_any_monitor(coordinates_t *ref, coordinates_t *dst, monitor_select_t *
 }
 
 /* Query outputs from the backend and update monitor state.
- * This replaces the old RandR-specific implementation. */
+ * This replaces the old RandR-specific implementation.
+ * Only the monitors whose rectangle changed are rearranged, and the root
+ * window properties are updated once, at the end. */
 bool update_monitors(void)
 {
 	bspwm_output_info_t outputs[MAX_MONITORS];
@@ -463,6 +466,9 @@ bool update_monitors(void)
 	if (len <= 0)
 		return false;
 
+	hold_ewmh();
+	hold_arrange();
+
 	monitor_t *last_wired = NULL;
 
 	for (monitor_t *m = mon_head; m; m = m->next)
@@ -471,7 +477,9 @@ bool update_monitors(void)
 	for (int i = 0; i < len; i++) {
 		last_wired = get_monitor_by_output_id(outputs[i].id);
 		if (last_wired) {
-			update_root(last_wired, &outputs[i].rect);
+			if (!rect_eq(last_wired->rectangle, outputs[i].rect)) {
+				update_root(last_wired, &outputs[i].rect);
+			}
 			last_wired->wired = true;
 		} else {
 			last_wired = make_monitor(outputs[i].name, &outputs[i].rect, BSPWM_WID_NONE);
@@ -480,6 +488,12 @@ bool update_monitors(void)
 				add_monitor(last_wired);
 			}
 		}
+		if (last_wired) {
+			last_wired->refresh = outputs[i].refresh;
+			if (last_wired->adaptive_sync) {
+				backend_set_adaptive_sync(last_wired->output_id, true);
+			}
+		}
 
 		if (outputs[i].primary && last_wired)
 			pri_mon = last_wired;
@@ -529,6 +543,9 @@ bool update_monitors(void)
 			add_desktop(m, make_desktop(NULL, BSPWM_WID_NONE));
 	}
 
+	release_arrange();
+	release_ewmh();
+
 	if (!running && mon) {
 		if (pri_mon)
 			mon = pri_mon;
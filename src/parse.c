@@ -118,6 +118,12 @@ LOOKUP_TABLE(automatic_scheme, automatic_scheme_t) {
    {"spiral", SCHEME_SPIRAL}
 };
 
+LOOKUP_TABLE(subscriber_overflow, subscriber_overflow_t) {
+   {"coalesce", OVERFLOW_COALESCE},
+   {"disconnect", OVERFLOW_DISCONNECT},
+   {"drop_oldest", OVERFLOW_DROP_OLDEST}
+};
+
 LOOKUP_TABLE(tightness, tightness_t) {
    {"high", TIGHTNESS_HIGH},
    {"low", TIGHTNESS_LOW}
@@ -138,6 +144,7 @@ BINARY_SEARCH_PARSER(resize_handle, resize_handle_t)
 BINARY_SEARCH_PARSER(pointer_action, pointer_action_t)
 BINARY_SEARCH_PARSER(child_polarity, child_polarity_t)
 BINARY_SEARCH_PARSER(automatic_scheme, automatic_scheme_t)
+BINARY_SEARCH_PARSER(subscriber_overflow, subscriber_overflow_t)
 BINARY_SEARCH_PARSER(tightness, tightness_t)
 
 // optimized bool parser - check first char
@@ -433,98 +440,149 @@ bool parse_subscriber_mask(char *s, subscriber_mask_t *mask)
    return false;
 }
 
-// Modifier parsing using string interning
-#define PARSE_MODIFIER(name, field) \
-   if (strcmp(#field, tok) == 0) { \
-       sel->field = OPTION_TRUE; \
-   } else if (tok[0] == '!' && strcmp(#field, tok + 1) == 0) { \
-       sel->field = OPTION_FALSE; \
+// sorted modifier tables
+LOOKUP_TABLE(monitor_modifier, uint32_t) {
+   {"focused", MONITOR_MOD_FOCUSED},
+   {"occupied", MONITOR_MOD_OCCUPIED}
+};
+
+LOOKUP_TABLE(desktop_modifier, uint32_t) {
+   {"active", DESKTOP_MOD_ACTIVE},
+   {"focused", DESKTOP_MOD_FOCUSED},
+   {"local", DESKTOP_MOD_LOCAL},
+   {"monocle", DESKTOP_MOD_MONOCLE},
+   {"occupied", DESKTOP_MOD_OCCUPIED},
+   {"tiled", DESKTOP_MOD_TILED},
+   {"urgent", DESKTOP_MOD_URGENT},
+   {"user_monocle", DESKTOP_MOD_USER_MONOCLE},
+   {"user_tiled", DESKTOP_MOD_USER_TILED}
+};
+
+LOOKUP_TABLE(node_modifier, uint32_t) {
+   {"above", NODE_MOD_ABOVE},
+   {"active", NODE_MOD_ACTIVE | NODE_MOD_ACTIVE_DESKTOP},
+   {"ancestor_of", NODE_MOD_ANCESTOR_OF},
+   {"automatic", NODE_MOD_AUTOMATIC},
+   {"below", NODE_MOD_BELOW},
+   {"descendant_of", NODE_MOD_DESCENDANT_OF},
+   {"floating", NODE_MOD_FLOATING},
+   {"focused", NODE_MOD_FOCUSED},
+   {"fullscreen", NODE_MOD_FULLSCREEN},
+   {"hidden", NODE_MOD_HIDDEN},
+   {"horizontal", NODE_MOD_HORIZONTAL},
+   {"leaf", NODE_MOD_LEAF},
+   {"local", NODE_MOD_LOCAL},
+   {"locked", NODE_MOD_LOCKED},
+   {"marked", NODE_MOD_MARKED},
+   {"normal", NODE_MOD_NORMAL},
+   {"private", NODE_MOD_PRIVATE},
+   {"pseudo_tiled", NODE_MOD_PSEUDO_TILED},
+   {"same_class", NODE_MOD_SAME_CLASS},
+   {"sticky", NODE_MOD_STICKY},
+   {"tiled", NODE_MOD_TILED},
+   {"urgent", NODE_MOD_URGENT},
+   {"vertical", NODE_MOD_VERTICAL},
+   {"window", NODE_MOD_WINDOW}
+};
+
+BINARY_SEARCH_PARSER(monitor_modifier, uint32_t)
+BINARY_SEARCH_PARSER(desktop_modifier, uint32_t)
+BINARY_SEARCH_PARSER(node_modifier, uint32_t)
+
+/* Compiled modifier lists, keyed by the descriptor they were parsed from.
+ * A bar polling the same few selectors only tokenizes them once. */
+#define SELECTOR_CACHE_SIZE  64
+#define SELECTOR_KEY_LEN     64
+
+typedef struct {
+   char desc[SELECTOR_KEY_LEN];
+   uint32_t mask;
+   uint32_t want;
+} selector_plan_t;
+
+typedef bool (*modifier_parser_t)(char *s, uint32_t *v);
+
+static selector_plan_t monitor_plans[SELECTOR_CACHE_SIZE];
+static selector_plan_t desktop_plans[SELECTOR_CACHE_SIZE];
+static selector_plan_t node_plans[SELECTOR_CACHE_SIZE];
+
+static uint32_t selector_hash(const char *s, size_t len)
+{
+   uint32_t h = 2166136261u;
+   for (size_t i = 0; i < len; i++) {
+       h = (h ^ (unsigned char) s[i]) * 16777619u;
    }
+   return h;
+}
 
-bool parse_monitor_modifiers(char *desc, monitor_select_t *sel)
+/* Modifiers are read from right to left, the leftmost occurrence wins. */
+static bool compile_modifiers(char *desc, modifier_parser_t parse_one, uint32_t *mask, uint32_t *want)
 {
    char *tok;
    while ((tok = strrchr(desc, CAT_CHR)) != NULL) {
        tok[0] = '\0';
        tok++;
-
-       if (strcmp("occupied", tok) == 0) {
-           sel->occupied = OPTION_TRUE;
-       } else if (tok[0] == '!' && strcmp("occupied", tok + 1) == 0) {
-           sel->occupied = OPTION_FALSE;
-       } else PARSE_MODIFIER(monitor, focused)
-       else {
+       bool negated = tok[0] == '!';
+       uint32_t bit;
+       if (!parse_one(tok + negated, &bit)) {
            return false;
        }
+       *mask |= bit;
+       if (negated) {
+           *want &= ~bit;
+       } else {
+           *want |= bit;
+       }
    }
    return true;
 }
 
-bool parse_desktop_modifiers(char *desc, desktop_select_t *sel)
+/* Strips the modifiers off desc and merges them into (mask, want). */
+static bool parse_modifiers(char *desc, selector_plan_t *plans, modifier_parser_t parse_one, uint32_t *mask, uint32_t *want)
 {
-   char *tok;
-   while ((tok = strrchr(desc, CAT_CHR)) != NULL) {
-       tok[0] = '\0';
-       tok++;
+   char *cut = strchr(desc, CAT_CHR);
+   if (cut == NULL) {
+       return true;
+   }
+
+   size_t len = strlen(desc);
+   selector_plan_t *slot = NULL;
+   if (len < SELECTOR_KEY_LEN) {
+       slot = &plans[selector_hash(desc, len) & (SELECTOR_CACHE_SIZE - 1)];
+   }
 
-       if (strcmp("occupied", tok) == 0) {
-           sel->occupied = OPTION_TRUE;
-       } else if (tok[0] == '!' && strcmp("occupied", tok + 1) == 0) {
-           sel->occupied = OPTION_FALSE;
+   selector_plan_t plan = {0};
+   if (slot != NULL && memcmp(slot->desc, desc, len + 1) == 0) {
+       *cut = '\0';
+       plan = *slot;
+   } else {
+       if (slot != NULL) {
+           memcpy(plan.desc, desc, len + 1);
        }
-       else PARSE_MODIFIER(desktop, focused)
-       else PARSE_MODIFIER(desktop, active)
-       else PARSE_MODIFIER(desktop, urgent)
-       else PARSE_MODIFIER(desktop, local)
-       else PARSE_MODIFIER(desktop, tiled)
-       else PARSE_MODIFIER(desktop, monocle)
-       else PARSE_MODIFIER(desktop, user_tiled)
-       else PARSE_MODIFIER(desktop, user_monocle)
-       else {
+       if (!compile_modifiers(desc, parse_one, &plan.mask, &plan.want)) {
            return false;
        }
+       if (slot != NULL) {
+           *slot = plan;
+       }
    }
+
+   *mask |= plan.mask;
+   *want = (*want & ~plan.mask) | plan.want;
    return true;
 }
 
-bool parse_node_modifiers(char *desc, node_select_t *sel)
+bool parse_monitor_modifiers(char *desc, monitor_select_t *sel)
 {
-   char *tok;
-   while ((tok = strrchr(desc, CAT_CHR)) != NULL) {
-       tok[0] = '\0';
-       tok++;
+   return parse_modifiers(desc, monitor_plans, parse_monitor_modifier, &sel->mask, &sel->want);
+}
 
-       if (strcmp("tiled", tok) == 0) {
-           sel->tiled = OPTION_TRUE;
-       } else if (tok[0] == '!' && strcmp("tiled", tok + 1) == 0) {
-           sel->tiled = OPTION_FALSE;
-       }
-       else PARSE_MODIFIER(node, automatic)
-       else PARSE_MODIFIER(node, focused)
-       else PARSE_MODIFIER(node, active)
-       else PARSE_MODIFIER(node, local)
-       else PARSE_MODIFIER(node, leaf)
-       else PARSE_MODIFIER(node, window)
-       else PARSE_MODIFIER(node, pseudo_tiled)
-       else PARSE_MODIFIER(node, floating)
-       else PARSE_MODIFIER(node, fullscreen)
-       else PARSE_MODIFIER(node, hidden)
-       else PARSE_MODIFIER(node, sticky)
-       else PARSE_MODIFIER(node, private)
-       else PARSE_MODIFIER(node, locked)
-       else PARSE_MODIFIER(node, marked)
-       else PARSE_MODIFIER(node, urgent)
-       else PARSE_MODIFIER(node, same_class)
-       else PARSE_MODIFIER(node, descendant_of)
-       else PARSE_MODIFIER(node, ancestor_of)
-       else PARSE_MODIFIER(node, below)
-       else PARSE_MODIFIER(node, normal)
-       else PARSE_MODIFIER(node, above)
-       else PARSE_MODIFIER(node, horizontal)
-       else PARSE_MODIFIER(node, vertical)
-       else {
-           return false;
-       }
-   }
-   return true;
+bool parse_desktop_modifiers(char *desc, desktop_select_t *sel)
+{
+   return parse_modifiers(desc, desktop_plans, parse_desktop_modifier, &sel->mask, &sel->want);
+}
+
+bool parse_node_modifiers(char *desc, node_select_t *sel)
+{
+   return parse_modifiers(desc, node_plans, parse_node_modifier, &sel->mask, &sel->want);
 }
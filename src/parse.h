@@ -28,6 +28,7 @@ bool parse_child_polarity(char *s, child_polarity_t *p);
 bool parse_automatic_scheme(char *s, automatic_scheme_t *a);
 bool parse_honor_size_hints_mode(char *s, honor_size_hints_mode_t *a);
 bool parse_state_transition(char *s, state_transition_t *m);
+bool parse_subscriber_overflow(char *s, subscriber_overflow_t *o);
 bool parse_tightness(char *s, tightness_t *t);
 bool parse_degree(char *s, int *d);
 bool parse_id(char *s, uint32_t *id);
@@ -35,6 +36,9 @@ bool parse_bool_declaration(char *s, char **key, bool *value, alter_state_t *sta
 bool parse_index(char *s, uint16_t *idx);
 bool parse_rectangle(char *s, bspwm_rect_t *r);
 bool parse_subscriber_mask(char *s, subscriber_mask_t *mask);
+bool parse_monitor_modifier(char *s, uint32_t *v);
+bool parse_desktop_modifier(char *s, uint32_t *v);
+bool parse_node_modifier(char *s, uint32_t *v);
 bool parse_monitor_modifiers(char *desc, monitor_select_t *sel);
 bool parse_desktop_modifiers(char *desc, desktop_select_t *sel);
 bool parse_node_modifiers(char *desc, node_select_t *sel);
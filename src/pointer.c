@@ -22,6 +22,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <xcb/xcb_keysyms.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include "backend_x11.h"
@@ -29,6 +30,7 @@
 #include "query.h"
 #include "settings.h"
 #include "stack.h"
+#include "stats.h"
 #include "tree.h"
 #include "monitor.h"
 #include "subscribe.h"
@@ -49,14 +51,19 @@ static snap_zone_t current_snap_zone = SNAP_NONE;
 static monitor_t *snap_target_monitor = NULL;
 
 void pointer_init(void)
+{
+	update_lock_fields();
+	grabbing = false;
+	grabbed_node = NULL;
+}
+
+void update_lock_fields(void)
 {
 	num_lock = modfield_from_keysym(XK_Num_Lock);
 	caps_lock = modfield_from_keysym(XK_Caps_Lock);
 	scroll_lock = modfield_from_keysym(XK_Scroll_Lock);
 	if (caps_lock == XCB_NO_SYMBOL)
 		caps_lock = XCB_MOD_MASK_LOCK;
-	grabbing = false;
-	grabbed_node = NULL;
 }
 
 
@@ -128,25 +135,17 @@ void ungrab_buttons(void)
 int16_t modfield_from_keysym(uint32_t keysym)
 {
 	uint16_t modfield = 0;
-	xcb_keycode_t *keycodes = NULL, *mod_keycodes = NULL;
-	xcb_get_modifier_mapping_reply_t *reply = NULL;
-	xcb_key_symbols_t *symbols = xcb_key_symbols_alloc(dpy);
+	xcb_key_symbols_t *symbols = x11_key_symbols();
+	xcb_get_modifier_mapping_reply_t *reply = x11_modifier_mapping();
 
-	if (!symbols)
+	if (!symbols || !reply || reply->keycodes_per_modifier < 1)
 		return 0;
 
-	keycodes = xcb_key_symbols_get_keycode(symbols, keysym);
+	xcb_keycode_t *keycodes = xcb_key_symbols_get_keycode(symbols, keysym);
 	if (!keycodes)
-		goto end;
-
-	reply = xcb_get_modifier_mapping_reply(dpy, xcb_get_modifier_mapping(dpy), NULL);
-	if (!reply || reply->keycodes_per_modifier < 1)
-		goto end;
-
-	mod_keycodes = xcb_get_modifier_mapping_keycodes(reply);
-	if (!mod_keycodes)
-		goto end;
+		return 0;
 
+	xcb_keycode_t *mod_keycodes = xcb_get_modifier_mapping_keycodes(reply);
 	unsigned int num_mod = xcb_get_modifier_mapping_keycodes_length(reply) / reply->keycodes_per_modifier;
 	for (unsigned int i = 0; i < num_mod && i < 8; i++) {
 		for (unsigned int j = 0; j < reply->keycodes_per_modifier; j++) {
@@ -160,10 +159,7 @@ int16_t modfield_from_keysym(uint32_t keysym)
 		}
 	}
 
-end:
-	xcb_key_symbols_free(symbols);
 	free(keycodes);
-	free(reply);
 	return modfield;
 }
 
@@ -287,6 +283,77 @@ bool grab_pointer(pointer_action_t pac)
 	return true;
 }
 
+/* Events of a drag synchronized with the monitor refresh. */
+typedef struct {
+	xcb_generic_event_t *motion;  /* latest motion not yet applied */
+	xcb_generic_event_t *next;    /* event received after it */
+	uint64_t next_frame;          /* monotonic ns */
+} drag_queue_t;
+
+/* Time between two frames of the given monitor, in nanoseconds. */
+static uint64_t frame_interval(monitor_t *m)
+{
+	if (m != NULL && m->refresh > 0) {
+		return 1000000000000ULL / m->refresh;
+	}
+	return (uint64_t) pointer_motion_interval * 1000000;
+}
+
+/* Wait for the next event of a synchronized drag. Queued motion events
+ * are drained and only the latest one is kept: it is returned at most
+ * once per frame, or as soon as another event has to be handled after it. */
+static xcb_generic_event_t *wait_for_drag_event(drag_queue_t *q, uint64_t interval)
+{
+	while (true) {
+		if (q->next != NULL) {
+			if (q->motion != NULL) {
+				break;
+			}
+			xcb_generic_event_t *evt = q->next;
+			q->next = NULL;
+			return evt;
+		}
+
+		/* Flush before draining: nothing may read the connection between
+		 * the last poll for an event and the wait on its descriptor. */
+		xcb_flush(dpy);
+		xcb_generic_event_t *evt;
+		while ((evt = xcb_poll_for_event(dpy)) != NULL) {
+			if (XCB_EVENT_RESPONSE_TYPE(evt) != XCB_MOTION_NOTIFY) {
+				q->next = evt;
+				break;
+			}
+			free(q->motion);
+			q->motion = evt;
+		}
+
+		if (q->next != NULL) {
+			continue;
+		}
+
+		if (xcb_connection_has_error(dpy)) {
+			return NULL;
+		}
+
+		int timeout = -1;
+		if (q->motion != NULL) {
+			uint64_t now = latency_now();
+			if (now >= q->next_frame) {
+				break;
+			}
+			timeout = (int) ((q->next_frame - now + 999999) / 1000000);
+		}
+
+		struct pollfd pfd = {.fd = xcb_get_file_descriptor(dpy), .events = POLLIN};
+		poll(&pfd, 1, timeout);
+	}
+
+	xcb_generic_event_t *evt = q->motion;
+	q->motion = NULL;
+	q->next_frame = latency_now() + interval;
+	return evt;
+}
+
 void track_pointer(coordinates_t loc, pointer_action_t pac, bspwm_point_t pos)
 {
 	node_t *n = loc.node;
@@ -300,6 +367,7 @@ void track_pointer(coordinates_t loc, pointer_action_t pac, bspwm_point_t pos)
 	snap_zone_t final_snap_zone = SNAP_NONE;
 
 	xcb_generic_event_t *evt = NULL;
+	drag_queue_t queue = {NULL, NULL, 0};
 
 	grabbing = true;
 	grabbed_node = n;
@@ -307,7 +375,17 @@ void track_pointer(coordinates_t loc, pointer_action_t pac, bspwm_point_t pos)
 
 	do {
 		free(evt);
-		evt = xcb_wait_for_event(dpy);
+		/* The drag runs inside one main loop iteration */
+		flush_status();
+		if (pointer_motion_sync) {
+			evt = wait_for_drag_event(&queue, frame_interval(loc.monitor));
+			if (!evt) {
+				grabbing = false;
+				break;
+			}
+		} else {
+			evt = xcb_wait_for_event(dpy);
+		}
 		if (!evt) {
 			xcb_flush(dpy);
 			continue;
@@ -317,7 +395,7 @@ void track_pointer(coordinates_t loc, pointer_action_t pac, bspwm_point_t pos)
 		if (resp_type == XCB_MOTION_NOTIFY) {
 			xcb_motion_notify_event_t *e = (xcb_motion_notify_event_t*) evt;
 			uint32_t dtime = e->time - last_motion_time;
-			if (dtime < pointer_motion_interval)
+			if (!pointer_motion_sync && dtime < pointer_motion_interval)
 				continue;
 
 			last_motion_time = e->time;
@@ -385,6 +463,12 @@ void track_pointer(coordinates_t loc, pointer_action_t pac, bspwm_point_t pos)
 	free(evt);
 	xcb_ungrab_pointer(dpy, XCB_CURRENT_TIME);
 
+	free(queue.motion);
+	if (queue.next != NULL) {
+		handle_event(queue.next);
+		free(queue.next);
+	}
+
 	if (!grabbed_node) {
 		grabbing = false;
 		return;
@@ -556,6 +640,7 @@ void apply_snap_zone(coordinates_t *loc, monitor_t *target_monitor, snap_zone_t
 
 	/* Apply the target rectangle */
 	n->client->floating_rectangle = target;
+	mark_layout_dirty(n);
 	arrange(m, d);
 }
 
@@ -0,0 +1,135 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "helpers.h"
+#include "pool.h"
+
+static pool_t *pool_head;
+
+static bool pool_grow(pool_t *p)
+{
+	if (p->per_slab == 0) {
+		/* keep every object aligned like the slab data */
+		size_t a = sizeof(max_align_t);
+		p->size = MAX((p->size + a - 1) / a * a, sizeof(void *));
+		p->per_slab = MAX((POOL_SLAB_SIZE - sizeof(pool_slab_t)) / p->size, 1);
+	}
+
+	pool_slab_t *s = malloc(sizeof(pool_slab_t) + p->per_slab * p->size);
+	if (s == NULL) {
+		return false;
+	}
+	s->next = p->slabs;
+	p->slabs = s;
+	p->slab_count++;
+
+	/* thread the new objects, first ones first out */
+	unsigned char *base = (unsigned char *) s->data;
+	for (size_t i = p->per_slab; i > 0; i--) {
+		void *obj = base + (i - 1) * p->size;
+		*(void **) obj = p->free_list;
+		p->free_list = obj;
+	}
+
+	if (!p->registered) {
+		p->next = pool_head;
+		pool_head = p;
+		p->registered = true;
+	}
+	return true;
+}
+
+void *pool_alloc(pool_t *p)
+{
+	if (p->free_list == NULL && !pool_grow(p)) {
+		return NULL;
+	}
+	void *obj = p->free_list;
+	p->free_list = *(void **) obj;
+	memset(obj, 0, p->size);
+	p->in_use++;
+	p->allocs++;
+	if (p->in_use > p->peak) {
+		p->peak = p->in_use;
+	}
+	return obj;
+}
+
+bool pool_reserve(pool_t *p, size_t count)
+{
+	while (p->slab_count * p->per_slab - p->in_use < count) {
+		if (!pool_grow(p)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void pool_free(pool_t *p, void *obj)
+{
+	if (obj == NULL) {
+		return;
+	}
+	*(void **) obj = p->free_list;
+	p->free_list = obj;
+	p->in_use--;
+}
+
+void destroy_pools(void)
+{
+	for (pool_t *p = pool_head; p != NULL; p = p->next) {
+		pool_slab_t *s = p->slabs;
+		while (s != NULL) {
+			pool_slab_t *next = s->next;
+			free(s);
+			s = next;
+		}
+		p->slabs = NULL;
+		p->free_list = NULL;
+		p->slab_count = p->in_use = 0;
+	}
+}
+
+void print_pool_stats(FILE *rsp)
+{
+	fprintf(rsp, "{");
+	for (pool_t *p = pool_head; p != NULL; p = p->next) {
+		fprintf(rsp, "%s\"%s\":{\"objectSize\":%zu,\"slabs\":%zu,\"capacity\":%zu,\"inUse\":%zu,\"peak\":%zu,\"allocs\":%" PRIu64 "}",
+		        p == pool_head ? "" : ",", p->name, p->size, p->slab_count,
+		        p->slab_count * p->per_slab, p->in_use, p->peak, p->allocs);
+	}
+	fprintf(rsp, "}");
+}
+
+void reset_pool_stats(void)
+{
+	for (pool_t *p = pool_head; p != NULL; p = p->next) {
+		p->peak = p->in_use;
+		p->allocs = 0;
+	}
+}
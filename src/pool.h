@@ -0,0 +1,70 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BSPWM_POOL_H
+#define BSPWM_POOL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Fixed size object pools: objects are carved out of slabs of about
+ * POOL_SLAB_SIZE bytes and recycled through a free list. Slabs are kept
+ * until exit, a pool only ever grows to its peak occupancy. */
+#define POOL_SLAB_SIZE  16384
+
+typedef struct pool_slab_t pool_slab_t;
+struct pool_slab_t {
+	pool_slab_t *next;
+	max_align_t data[];
+};
+
+typedef struct pool_t pool_t;
+struct pool_t {
+	const char *name;
+	size_t size;
+	size_t per_slab;
+	void *free_list;
+	pool_slab_t *slabs;
+	size_t slab_count;
+	size_t in_use;
+	size_t peak;
+	uint64_t allocs;
+	pool_t *next;
+	bool registered;
+};
+
+#define POOL_INIT(n, t)  {.name = (n), .size = sizeof(t)}
+
+/* Returns a zeroed object, or NULL. */
+void *pool_alloc(pool_t *p);
+/* Grows the pool until count objects can be taken without growing it. */
+bool pool_reserve(pool_t *p, size_t count);
+void pool_free(pool_t *p, void *obj);
+void destroy_pools(void);
+void print_pool_stats(FILE *rsp);
+void reset_pool_stats(void);
+
+#endif
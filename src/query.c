@@ -34,6 +34,7 @@
 #include "tree.h"
 #include "query.h"
 #include "geometry.h"
+#include "lookup.h"
 
 #define MAX_RECURSION_DEPTH 1000
 
@@ -55,253 +56,231 @@ void release_query_buffer(query_buffer_t *buf)
 	if (buf) buf->in_use = false;
 }
 
-static void query_node_depth(node_t *n, FILE *rsp, int depth);
+static void query_node_depth(node_t *n, const char *key, json_writer_t *jw, int depth);
 static int query_node_ids_in_depth(node_t *n, desktop_t *d, monitor_t *m, coordinates_t *ref,
                                    coordinates_t *trg, node_select_t *sel, FILE *rsp, int depth);
+static int query_flagged_node_ids(monitor_t *m, desktop_t *d, node_flag_t f, coordinates_t *ref,
+                                  coordinates_t *trg, node_select_t *sel, FILE *rsp);
 
-void query_state(FILE *rsp)
+void query_state(json_writer_t *jw)
 {
-	if (!rsp) return;
-	
-	fprintf(rsp, "{");
-	fprintf(rsp, "\"focusedMonitorId\":%u,", mon ? mon->id : 0);
+	json_begin_object(jw, NULL);
+	json_uint(jw, "focusedMonitorId", mon ? mon->id : 0);
 	if (pri_mon) {
-		fprintf(rsp, "\"primaryMonitorId\":%u,", pri_mon->id);
+		json_uint(jw, "primaryMonitorId", pri_mon->id);
 	}
-	fprintf(rsp, "\"clientsCount\":%i,", clients_count);
-	fprintf(rsp, "\"monitors\":");
-	fprintf(rsp, "[");
+	json_int(jw, "clientsCount", clients_count);
+	json_begin_array(jw, "monitors");
 	for (monitor_t *m = mon_head; m; m = m->next) {
-		query_monitor(m, rsp);
-		if (m->next) {
-			fprintf(rsp, ",");
-		}
+		query_monitor(m, NULL, jw);
 	}
-	fprintf(rsp, "]");
-	fprintf(rsp,",");
-	fprintf(rsp, "\"focusHistory\":");
-	query_history(rsp);
-	fprintf(rsp,",");
-	fprintf(rsp, "\"stackingList\":");
-	query_stack(rsp);
+	json_end_array(jw);
+	query_history("focusHistory", jw);
+	query_stack("stackingList", jw);
 	if (restart) {
-		fprintf(rsp,",");
-		fprintf(rsp, "\"eventSubscribers\":");
-		query_subscribers(rsp);
+		query_subscribers("eventSubscribers", jw);
 	}
-	fprintf(rsp, "}");
+	json_end_object(jw);
 }
 
-void query_monitor(monitor_t *m, FILE *rsp)
+void query_monitor(monitor_t *m, const char *key, json_writer_t *jw)
 {
-	if (!m || !rsp) return;
-	
-	fprintf(rsp, "{");
-	fprintf(rsp, "\"name\":\"%s\",", m->name);
-	fprintf(rsp, "\"id\":%u,", m->id);
-	fprintf(rsp, "\"randrId\":%u,", m->output_id);
-	fprintf(rsp, "\"wired\":%s,", BOOL_STR(m->wired));
-	fprintf(rsp, "\"stickyCount\":%i,", m->sticky_count);
-	fprintf(rsp, "\"windowGap\":%i,", m->window_gap);
-	fprintf(rsp, "\"borderWidth\":%u,", m->border_width);
-	fprintf(rsp, "\"focusedDesktopId\":%u,", m->desk ? m->desk->id : 0);
-	fprintf(rsp, "\"padding\":");
-	query_padding(m->padding, rsp);
-	fprintf(rsp,",");
-	fprintf(rsp, "\"rectangle\":");
-	query_rectangle(m->rectangle, rsp);
-	fprintf(rsp,",");
-	fprintf(rsp, "\"desktops\":");
-	fprintf(rsp, "[");
+	if (!m) {
+		json_null(jw, key);
+		return;
+	}
+
+	json_begin_object(jw, key);
+	json_string(jw, "name", m->name);
+	json_uint(jw, "id", m->id);
+	json_uint(jw, "randrId", m->output_id);
+	json_bool(jw, "wired", m->wired);
+	json_bool(jw, "adaptiveSync", m->adaptive_sync);
+	json_bool(jw, "directScanout", backend_output_direct_scanout(m->output_id));
+	json_int(jw, "stickyCount", m->sticky_count);
+	json_int(jw, "windowGap", m->window_gap);
+	json_uint(jw, "borderWidth", m->border_width);
+	json_uint(jw, "focusedDesktopId", m->desk ? m->desk->id : 0);
+	query_padding(m->padding, "padding", jw);
+	query_rectangle(m->rectangle, "rectangle", jw);
+	json_begin_array(jw, "desktops");
 	for (desktop_t *d = m->desk_head; d; d = d->next) {
-		query_desktop(d, rsp);
-		if (d->next) {
-			fprintf(rsp,",");
-		}
+		query_desktop(d, NULL, jw);
 	}
-	fprintf(rsp, "]");
-	fprintf(rsp, "}");
+	json_end_array(jw);
+	json_end_object(jw);
 }
 
-void query_desktop(desktop_t *d, FILE *rsp)
+void query_desktop(desktop_t *d, const char *key, json_writer_t *jw)
 {
-	if (!d || !rsp) return;
-	
-	fprintf(rsp, "{");
-	fprintf(rsp, "\"name\":\"%s\",", d->name);
-	fprintf(rsp, "\"id\":%u,", d->id);
-	fprintf(rsp, "\"layout\":\"%s\",", LAYOUT_STR(d->layout));
-	fprintf(rsp, "\"userLayout\":\"%s\",", LAYOUT_STR(d->user_layout));
-	fprintf(rsp, "\"windowGap\":%i,", d->window_gap);
-	fprintf(rsp, "\"borderWidth\":%u,", d->border_width);
-	fprintf(rsp, "\"focusedNodeId\":%u,", d->focus ? d->focus->id : 0);
-	fprintf(rsp, "\"padding\":");
-	query_padding(d->padding, rsp);
-	fprintf(rsp,",");
-	fprintf(rsp, "\"root\":");
-	query_node_depth(d->root, rsp, 0);
-	fprintf(rsp, "}");
+	if (!d) {
+		json_null(jw, key);
+		return;
+	}
+
+	json_begin_object(jw, key);
+	json_string(jw, "name", d->name);
+	json_uint(jw, "id", d->id);
+	json_string(jw, "layout", LAYOUT_STR(d->layout));
+	json_string(jw, "userLayout", LAYOUT_STR(d->user_layout));
+	json_int(jw, "windowGap", d->window_gap);
+	json_uint(jw, "borderWidth", d->border_width);
+	json_uint(jw, "focusedNodeId", d->focus ? d->focus->id : 0);
+	query_padding(d->padding, "padding", jw);
+	query_node_depth(d->root, "root", jw, 0);
+	json_end_object(jw);
 }
 
-static void query_node_depth(node_t *n, FILE *rsp, int depth)
+static void query_node_depth(node_t *n, const char *key, json_writer_t *jw, int depth)
 {
-	if (depth > MAX_RECURSION_DEPTH || !rsp) {
-		fprintf(rsp, "null");
+	if (!n || depth > MAX_RECURSION_DEPTH) {
+		json_null(jw, key);
 		return;
 	}
-	
-	if (!n) {
-		fprintf(rsp, "null");
-	} else {
-		fprintf(rsp, "{");
-		fprintf(rsp, "\"id\":%u,", n->id);
-		fprintf(rsp, "\"splitType\":\"%s\",", SPLIT_TYPE_STR(n->split_type));
-		fprintf(rsp, "\"splitRatio\":%lf,", n->split_ratio);
-		fprintf(rsp, "\"vacant\":%s,", BOOL_STR(n->vacant));
-		fprintf(rsp, "\"hidden\":%s,", BOOL_STR(n->hidden));
-		fprintf(rsp, "\"sticky\":%s,", BOOL_STR(n->sticky));
-		fprintf(rsp, "\"private\":%s,", BOOL_STR(n->private));
-		fprintf(rsp, "\"locked\":%s,", BOOL_STR(n->locked));
-		fprintf(rsp, "\"marked\":%s,", BOOL_STR(n->marked));
-		fprintf(rsp, "\"presel\":");
-		query_presel(n->presel, rsp);
-		fprintf(rsp,",");
-		fprintf(rsp, "\"rectangle\":");
-		query_rectangle(n->rectangle, rsp);
-		fprintf(rsp,",");
-		fprintf(rsp, "\"constraints\":");
-		query_constraints(n->constraints, rsp);
-		fprintf(rsp,",");
-		fprintf(rsp, "\"firstChild\":");
-		query_node_depth(n->first_child, rsp, depth + 1);
-		fprintf(rsp,",");
-		fprintf(rsp, "\"secondChild\":");
-		query_node_depth(n->second_child, rsp, depth + 1);
-		fprintf(rsp,",");
-		fprintf(rsp, "\"client\":");
-		query_client(n->client, rsp);
-		fprintf(rsp, "}");
-	}
+
+	json_begin_object(jw, key);
+	json_uint(jw, "id", n->id);
+	json_string(jw, "splitType", SPLIT_TYPE_STR(n->split_type));
+	json_double(jw, "splitRatio", n->split_ratio);
+	json_bool(jw, "vacant", n->vacant);
+	json_bool(jw, "hidden", n->hidden);
+	json_bool(jw, "sticky", n->sticky);
+	json_bool(jw, "private", n->private);
+	json_bool(jw, "locked", n->locked);
+	json_bool(jw, "marked", n->marked);
+	query_presel(n->presel, "presel", jw);
+	query_rectangle(n->rectangle, "rectangle", jw);
+	query_constraints(n->constraints, "constraints", jw);
+	query_node_depth(n->first_child, "firstChild", jw, depth + 1);
+	query_node_depth(n->second_child, "secondChild", jw, depth + 1);
+	query_client(n->client, "client", jw);
+	json_end_object(jw);
 }
 
-void query_node(node_t *n, FILE *rsp)
+void query_node(node_t *n, const char *key, json_writer_t *jw)
 {
-	query_node_depth(n, rsp, 0);
+	query_node_depth(n, key, jw, 0);
 }
 
-void query_presel(presel_t *p, FILE *rsp)
+void query_presel(presel_t *p, const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	
 	if (!p) {
-		fprintf(rsp, "null");
-	} else {
-		fprintf(rsp, "{\"splitDir\":\"%s\",\"splitRatio\":%lf}", 
-		        SPLIT_DIR_STR(p->split_dir), p->split_ratio);
+		json_null(jw, key);
+		return;
 	}
+
+	json_begin_object(jw, key);
+	json_string(jw, "splitDir", SPLIT_DIR_STR(p->split_dir));
+	json_double(jw, "splitRatio", p->split_ratio);
+	json_end_object(jw);
 }
 
-void query_client(client_t *c, FILE *rsp)
+void query_client(client_t *c, const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	
 	if (!c) {
-		fprintf(rsp, "null");
-	} else {
-		fprintf(rsp, "{");
-		fprintf(rsp, "\"className\":\"%s\",", c->class_name);
-		fprintf(rsp, "\"instanceName\":\"%s\",", c->instance_name);
-		fprintf(rsp, "\"borderWidth\":%u,", c->border_width);
-		fprintf(rsp, "\"state\":\"%s\",", STATE_STR(c->state));
-		fprintf(rsp, "\"lastState\":\"%s\",", STATE_STR(c->last_state));
-		fprintf(rsp, "\"layer\":\"%s\",", LAYER_STR(c->layer));
-		fprintf(rsp, "\"lastLayer\":\"%s\",", LAYER_STR(c->last_layer));
-		fprintf(rsp, "\"urgent\":%s,", BOOL_STR(c->urgent));
-		fprintf(rsp, "\"shown\":%s,", BOOL_STR(c->shown));
-		fprintf(rsp, "\"tiledRectangle\":");
-		query_rectangle(c->tiled_rectangle, rsp);
-		fprintf(rsp,",");
-		fprintf(rsp, "\"floatingRectangle\":");
-		query_rectangle(c->floating_rectangle, rsp);
-		fprintf(rsp, "}");
+		json_null(jw, key);
+		return;
 	}
+
+	json_begin_object(jw, key);
+	json_string(jw, "className", c->class_name);
+	json_string(jw, "instanceName", c->instance_name);
+	json_uint(jw, "borderWidth", c->border_width);
+	json_string(jw, "state", STATE_STR(c->state));
+	json_string(jw, "lastState", STATE_STR(c->last_state));
+	json_string(jw, "layer", LAYER_STR(c->layer));
+	json_string(jw, "lastLayer", LAYER_STR(c->last_layer));
+	json_bool(jw, "urgent", c->urgent);
+	json_bool(jw, "shown", c->shown);
+	query_rectangle(c->tiled_rectangle, "tiledRectangle", jw);
+	query_rectangle(c->floating_rectangle, "floatingRectangle", jw);
+	json_end_object(jw);
 }
 
-void query_rectangle(bspwm_rect_t r, FILE *rsp)
+void query_rectangle(bspwm_rect_t r, const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	fprintf(rsp, "{\"x\":%i,\"y\":%i,\"width\":%u,\"height\":%u}", r.x, r.y, r.width, r.height);
+	json_begin_object(jw, key);
+	json_int(jw, "x", r.x);
+	json_int(jw, "y", r.y);
+	json_uint(jw, "width", r.width);
+	json_uint(jw, "height", r.height);
+	json_end_object(jw);
 }
 
-void query_constraints(constraints_t c, FILE *rsp)
+void query_constraints(constraints_t c, const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	fprintf(rsp, "{\"min_width\":%u,\"min_height\":%u}", c.min_width, c.min_height);
+	json_begin_object(jw, key);
+	json_uint(jw, "min_width", c.min_width);
+	json_uint(jw, "min_height", c.min_height);
+	json_end_object(jw);
 }
 
-void query_padding(padding_t p, FILE *rsp)
+void query_padding(padding_t p, const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	fprintf(rsp, "{\"top\":%i,\"right\":%i,\"bottom\":%i,\"left\":%i}", p.top, p.right, p.bottom, p.left);
+	json_begin_object(jw, key);
+	json_int(jw, "top", p.top);
+	json_int(jw, "right", p.right);
+	json_int(jw, "bottom", p.bottom);
+	json_int(jw, "left", p.left);
+	json_end_object(jw);
 }
 
-void query_history(FILE *rsp)
+void query_history(const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	
-	fprintf(rsp, "[");
+	json_begin_array(jw, key);
 	for (history_t *h = history_head; h; h = h->next) {
-		query_coordinates(&h->loc, rsp);
-		if (h->next) {
-			fprintf(rsp, ",");
-		}
+		query_coordinates(&h->loc, NULL, jw);
 	}
-	fprintf(rsp, "]");
+	json_end_array(jw);
 }
 
-void query_coordinates(coordinates_t *loc, FILE *rsp)
+void query_coordinates(coordinates_t *loc, const char *key, json_writer_t *jw)
 {
-	if (!loc || !rsp) return;
-	
-	fprintf(rsp, "{\"monitorId\":%u,\"desktopId\":%u,\"nodeId\":%u}", 
-	        loc->monitor ? loc->monitor->id : 0,
-	        loc->desktop ? loc->desktop->id : 0,
-	        loc->node ? loc->node->id : 0);
+	if (!loc) {
+		json_null(jw, key);
+		return;
+	}
+
+	json_begin_object(jw, key);
+	json_uint(jw, "monitorId", loc->monitor ? loc->monitor->id : 0);
+	json_uint(jw, "desktopId", loc->desktop ? loc->desktop->id : 0);
+	json_uint(jw, "nodeId", loc->node ? loc->node->id : 0);
+	json_end_object(jw);
 }
 
-void query_stack(FILE *rsp)
+void query_stack(const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	
-	fprintf(rsp, "[");
+	json_begin_array(jw, key);
 	for (stacking_list_t *s = stack_head; s; s = s->next) {
-		if (s->node)
-			fprintf(rsp, "%u", s->node->id);
-		if (s->next) {
-			fprintf(rsp, ",");
+		if (s->node) {
+			json_uint(jw, NULL, s->node->id);
 		}
 	}
-	fprintf(rsp, "]");
+	json_end_array(jw);
 }
 
-void query_subscribers(FILE *rsp)
+void query_subscribers(const char *key, json_writer_t *jw)
 {
-	if (!rsp) return;
-	
-	fprintf(rsp, "[");
+	json_begin_array(jw, key);
 	for (subscriber_list_t *s = subscribe_head; s; s = s->next) {
-		fprintf(rsp, "{\"fileDescriptor\": %i", s->stream ? fileno(s->stream) : -1);
+		json_begin_object(jw, NULL);
+		json_int(jw, "fileDescriptor", s->stream ? fileno(s->stream) : -1);
 		if (s->fifo_path) {
-			fprintf(rsp, ",\"fifoPath\":\"%s\"", s->fifo_path);
+			json_string(jw, "fifoPath", s->fifo_path);
 		}
-		fprintf(rsp, ",\"field\":%i,\"count\":%i}", s->field, s->count);
-		if (s->next) {
-			fprintf(rsp, ",");
-		}
-	}
-	fprintf(rsp, "]");
+		json_int(jw, "field", s->field);
+		json_int(jw, "count", s->count);
+		json_bool(jw, "json", s->json);
+		json_uint(jw, "monitorId", s->monitor_id);
+		json_uint(jw, "desktopId", s->desktop_id);
+		json_uint(jw, "nodeId", s->node_id);
+		json_string(jw, "subtype", s->subtype);
+		json_end_object(jw);
+	}
+	json_end_array(jw);
 }
 
+
 int query_node_ids(coordinates_t *mon_ref, coordinates_t *desk_ref, coordinates_t* ref, 
                    coordinates_t *trg, monitor_select_t *mon_sel, desktop_select_t *desk_sel, 
                    node_select_t *sel, FILE *rsp)
@@ -309,24 +288,69 @@ int query_node_ids(coordinates_t *mon_ref, coordinates_t *desk_ref, coordinates_
 	if (!rsp) return 0;
 	
 	int count = 0;
+	uint8_t flags = sel ? NODE_FLAGS_OF_MODIFIERS(sel->mask & sel->want) : 0;
+	node_flag_t f;
+
 	for (monitor_t *m = mon_head; m; m = m->next) {
 		coordinates_t loc = {m, NULL, NULL};
 		if ((trg && trg->monitor && m != trg->monitor) ||
+		    (flags && !flag_index_rarest(m->flag_count, flags, &f)) ||
 		    (mon_sel && !monitor_matches(&loc, mon_ref, mon_sel))) {
 			continue;
 		}
 		for (desktop_t *d = m->desk_head; d; d = d->next) {
 			coordinates_t loc = {m, d, NULL};
 			if ((trg && trg->desktop && d != trg->desktop) ||
+			    (flags && !flag_index_rarest(d->flag_count, flags, &f)) ||
 			    (desk_sel && !desktop_matches(&loc, desk_ref, desk_sel))) {
 				continue;
 			}
-			count += query_node_ids_in_depth(d->root, d, m, ref, trg, sel, rsp, 0);
+			if (flags) {
+				count += query_flagged_node_ids(m, d, f, ref, trg, sel, rsp);
+			} else {
+				count += query_node_ids_in_depth(d->root, d, m, ref, trg, sel, rsp, 0);
+			}
 		}
 	}
 	return count;
 }
 
+static int compare_preorder(const void *a, const void *b)
+{
+	node_t *na = *(node_t *const *) a;
+	node_t *nb = *(node_t *const *) b;
+	return na == nb ? 0 : (precedes(na, nb) ? -1 : 1);
+}
+
+/* Walks the list of the nodes of d having the flag f instead of the whole
+ * tree, the matches are printed in tree order. */
+static int query_flagged_node_ids(monitor_t *m, desktop_t *d, node_flag_t f, coordinates_t *ref,
+                                  coordinates_t *trg, node_select_t *sel, FILE *rsp)
+{
+	scratch_mark_t mark = scratch_mark();
+	node_t **matches = scratch_alloc(d->flag_count[f] * sizeof(node_t *));
+	if (!matches) {
+		scratch_release(mark);
+		return query_node_ids_in_depth(d->root, d, m, ref, trg, sel, rsp, 0);
+	}
+
+	size_t len = 0;
+	for (node_t *n = d->flag_head[f]; n && len < d->flag_count[f]; n = n->flag_next[f]) {
+		coordinates_t loc = {m, d, n};
+		if ((!trg || !trg->node || n == trg->node) && node_matches(&loc, ref, sel)) {
+			matches[len++] = n;
+		}
+	}
+
+	qsort(matches, len, sizeof(node_t *), compare_preorder);
+	for (size_t i = 0; i < len; i++) {
+		fprintf(rsp, "0x%08X\n", matches[i]->id);
+	}
+
+	scratch_release(mark);
+	return (int) len;
+}
+
 static int query_node_ids_in_depth(node_t *n, desktop_t *d, monitor_t *m, coordinates_t *ref,
                                    coordinates_t *trg, node_select_t *sel, FILE *rsp, int depth)
 {
@@ -538,21 +562,17 @@ void resolve_rule_consequence(rule_consequence_t *csq)
 #undef PRINT_OBJECT_ID
 }
 
+/* The buffer comes from the scratch arena, it is NULL on failure. */
 void print_rule_consequence(char **buf, rule_consequence_t *csq)
 {
 	if (!buf || !csq) return;
 	
 	char *rect_buf = NULL;
 	print_rectangle(&rect_buf, csq->rect);
-	if (!rect_buf) {
-		rect_buf = malloc(1);
-		if (rect_buf)
-			*rect_buf = '\0';
-	}
 
-	int ret = asprintf(buf, "monitor=%s desktop=%s node=%s state=%s layer=%s honor_size_hints=%s "
-	                   "split_dir=%s split_ratio=%lf hidden=%s sticky=%s private=%s locked=%s "
-	                   "marked=%s center=%s follow=%s manage=%s focus=%s border=%s rectangle=%s",
+	*buf = scratch_printf("monitor=%s desktop=%s node=%s state=%s layer=%s honor_size_hints=%s "
+	                      "split_dir=%s split_ratio=%lf hidden=%s sticky=%s private=%s locked=%s "
+	                      "marked=%s center=%s follow=%s manage=%s focus=%s border=%s rectangle=%s",
 	        csq->monitor_desc, csq->desktop_desc, csq->node_desc,
 	        csq->state ? STATE_STR(*csq->state) : "",
 	        csq->layer ? LAYER_STR(*csq->layer) : "",
@@ -562,20 +582,15 @@ void print_rule_consequence(char **buf, rule_consequence_t *csq)
 	        ON_OFF_STR(csq->locked), ON_OFF_STR(csq->marked), ON_OFF_STR(csq->center),
 	        ON_OFF_STR(csq->follow), ON_OFF_STR(csq->manage), ON_OFF_STR(csq->focus),
 	        ON_OFF_STR(csq->border), rect_buf ? rect_buf : "");
-	
-	free(rect_buf);
-	
-	if (ret < 0)
-		*buf = NULL;
 }
 
+/* The buffer comes from the scratch arena, it is NULL without a rectangle. */
 void print_rectangle(char **buf, bspwm_rect_t *rect)
 {
 	if (!buf) return;
 	
 	if (rect) {
-		if (asprintf(buf, "%hux%hu+%hi+%hi", rect->width, rect->height, rect->x, rect->y) < 0)
-			*buf = NULL;
+		*buf = scratch_printf("%hux%hu+%hi+%hi", rect->width, rect->height, rect->x, rect->y);
 	} else {
 		*buf = NULL;
 	}
@@ -583,58 +598,17 @@ void print_rectangle(char **buf, bspwm_rect_t *rect)
 
 node_select_t make_node_select(void)
 {
-	node_select_t sel = {
-		.automatic = OPTION_NONE,
-		.focused = OPTION_NONE,
-		.active = OPTION_NONE,
-		.local = OPTION_NONE,
-		.leaf = OPTION_NONE,
-		.window = OPTION_NONE,
-		.tiled = OPTION_NONE,
-		.pseudo_tiled = OPTION_NONE,
-		.floating = OPTION_NONE,
-		.fullscreen = OPTION_NONE,
-		.hidden = OPTION_NONE,
-		.sticky = OPTION_NONE,
-		.private = OPTION_NONE,
-		.locked = OPTION_NONE,
-		.marked = OPTION_NONE,
-		.urgent = OPTION_NONE,
-		.same_class = OPTION_NONE,
-		.descendant_of = OPTION_NONE,
-		.ancestor_of = OPTION_NONE,
-		.below = OPTION_NONE,
-		.normal = OPTION_NONE,
-		.above = OPTION_NONE,
-		.horizontal = OPTION_NONE,
-		.vertical = OPTION_NONE
-	};
-	return sel;
+	return (node_select_t) {0, 0};
 }
 
 desktop_select_t make_desktop_select(void)
 {
-	desktop_select_t sel = {
-		.occupied = OPTION_NONE,
-		.focused = OPTION_NONE,
-		.active = OPTION_NONE,
-		.urgent = OPTION_NONE,
-		.local = OPTION_NONE,
-		.tiled = OPTION_NONE,
-		.monocle = OPTION_NONE,
-		.user_tiled = OPTION_NONE,
-		.user_monocle = OPTION_NONE
-	};
-	return sel;
+	return (desktop_select_t) {0, 0};
 }
 
 monitor_select_t make_monitor_select(void)
 {
-	monitor_select_t sel = {
-		.occupied = OPTION_NONE,
-		.focused = OPTION_NONE
-	};
-	return sel;
+	return (monitor_select_t) {0, 0};
 }
 
 int node_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst)
@@ -1031,7 +1005,12 @@ end:
 bool locate_leaf(bspwm_wid_t win, coordinates_t *loc)
 {
 	if (!loc) return false;
-	
+
+	/* Client leaves are indexed, only receptacles need the scan */
+	if (window_index_get(win, loc)) {
+		return true;
+	}
+
 	for (monitor_t *m = mon_head; m; m = m->next) {
 		for (desktop_t *d = m->desk_head; d; d = d->next) {
 			for (node_t *n = first_extrema(d->root); n; n = next_leaf(n, d->root)) {
@@ -1047,65 +1026,11 @@ bool locate_leaf(bspwm_wid_t win, coordinates_t *loc)
 	return false;
 }
 
-/* Small LRU cache for locate_window: motion/configure/button/property-notify
- * events frequently hit the same window in succession; without this each call
- * walked every monitor/desktop/leaf. Entries are invalidated on remove_node. */
-#define LOCATE_WINDOW_CACHE_SIZE 16
-typedef struct {
-	bspwm_wid_t win;
-	coordinates_t loc;
-	bool valid;
-} locate_window_cache_entry_t;
-static locate_window_cache_entry_t locate_window_cache[LOCATE_WINDOW_CACHE_SIZE];
-
-/* Invalidated on every node unlink/free/transfer and on monitor/desktop
- * removal. Entries store {monitor, desktop, node} by window id; any of those
- * pointers can dangle once the tree mutates, and the on-hit check only
- * re-validates the node, never the monitor/desktop. */
-void locate_window_cache_clear(void)
-{
-	for (size_t i = 0; i < LOCATE_WINDOW_CACHE_SIZE; i++) {
-		locate_window_cache[i].valid = false;
-	}
-}
-
 bool locate_window(bspwm_wid_t win, coordinates_t *loc)
 {
 	if (!loc) return false;
 
-	for (size_t i = 0; i < LOCATE_WINDOW_CACHE_SIZE; i++) {
-		locate_window_cache_entry_t *e = &locate_window_cache[i];
-		if (e->valid && e->win == win) {
-			node_t *n = e->loc.node;
-			if (n && n->client && n->id == win) {
-				*loc = e->loc;
-				return true;
-			}
-			e->valid = false;
-			break;
-		}
-	}
-
-	for (monitor_t *m = mon_head; m; m = m->next) {
-		for (desktop_t *d = m->desk_head; d; d = d->next) {
-			for (node_t *n = first_extrema(d->root); n; n = next_leaf(n, d->root)) {
-				if (!n->client)
-					continue;
-				if (n->id == win) {
-					loc->monitor = m;
-					loc->desktop = d;
-					loc->node = n;
-					static size_t locate_window_cache_next = 0;
-					locate_window_cache[locate_window_cache_next].win = win;
-					locate_window_cache[locate_window_cache_next].loc = *loc;
-					locate_window_cache[locate_window_cache_next].valid = true;
-					locate_window_cache_next = (locate_window_cache_next + 1) % LOCATE_WINDOW_CACHE_SIZE;
-					return true;
-				}
-			}
-		}
-	}
-	return false;
+	return window_index_get(win, loc);
 }
 
 bool locate_desktop(char *name, coordinates_t *loc)
@@ -1227,223 +1152,103 @@ bool monitor_from_index(int idx, coordinates_t *loc)
 	return false;
 }
 
-bool node_matches(coordinates_t *loc, coordinates_t *ref, node_select_t *sel)
+/* Gathers the modifiers that hold for a node. The ones that walk the tree
+ * or compare strings are only evaluated when the selector asks for them. */
+static uint32_t node_modifiers(coordinates_t *loc, coordinates_t *ref, uint32_t mask)
 {
-	if (!loc || !loc->node || !sel)
-		return false;
+	node_t *n = loc->node;
+	uint32_t m = 0;
 
-	if (sel->focused != OPTION_NONE &&
-	    loc->node != (mon && mon->desk ? mon->desk->focus : NULL)
-	    ? sel->focused == OPTION_TRUE
-	    : sel->focused == OPTION_FALSE) {
-		return false;
+	if (n == (mon && mon->desk ? mon->desk->focus : NULL)) {
+		m |= NODE_MOD_FOCUSED;
 	}
-
-	if (sel->active != OPTION_NONE &&
-	    loc->node != (loc->desktop ? loc->desktop->focus : NULL)
-	    ? sel->active == OPTION_TRUE
-	    : sel->active == OPTION_FALSE) {
-		return false;
+	if (n == (loc->desktop ? loc->desktop->focus : NULL)) {
+		m |= NODE_MOD_ACTIVE;
 	}
-
-	if (sel->automatic != OPTION_NONE &&
-	    loc->node->presel
-	    ? sel->automatic == OPTION_FALSE
-	    : sel->automatic == OPTION_TRUE) {
-		return false;
+	if (loc->desktop == (loc->monitor ? loc->monitor->desk : NULL)) {
+		m |= NODE_MOD_ACTIVE_DESKTOP;
 	}
-
-	if (sel->local != OPTION_NONE &&
-	    loc->desktop != (ref ? ref->desktop : NULL)
-	    ? sel->local == OPTION_TRUE
-	    : sel->local == OPTION_FALSE) {
-		return false;
+	if (loc->desktop == (ref ? ref->desktop : NULL)) {
+		m |= NODE_MOD_LOCAL;
 	}
+	m |= (n->presel ? 0 : NODE_MOD_AUTOMATIC) |
+	     (is_leaf(n) ? NODE_MOD_LEAF : 0) |
+	     (n->client ? NODE_MOD_WINDOW : 0) |
+	     (n->hidden ? NODE_MOD_HIDDEN : 0) |
+	     (n->sticky ? NODE_MOD_STICKY : 0) |
+	     (n->private ? NODE_MOD_PRIVATE : 0) |
+	     (n->locked ? NODE_MOD_LOCKED : 0) |
+	     (n->marked ? NODE_MOD_MARKED : 0) |
+	     (n->split_type == TYPE_HORIZONTAL ? NODE_MOD_HORIZONTAL : 0) |
+	     (n->split_type == TYPE_VERTICAL ? NODE_MOD_VERTICAL : 0);
 
-	if (sel->active != OPTION_NONE &&
-	    loc->desktop != (loc->monitor ? loc->monitor->desk : NULL)
-	    ? sel->active == OPTION_TRUE
-	    : sel->active == OPTION_FALSE) {
-		return false;
+	if ((mask & NODE_MOD_DESCENDANT_OF) && is_descendant(n, ref ? ref->node : NULL)) {
+		m |= NODE_MOD_DESCENDANT_OF;
 	}
-
-	if (sel->leaf != OPTION_NONE &&
-	    !is_leaf(loc->node)
-	    ? sel->leaf == OPTION_TRUE
-	    : sel->leaf == OPTION_FALSE) {
-		return false;
+	if ((mask & NODE_MOD_ANCESTOR_OF) && is_descendant(ref ? ref->node : NULL, n)) {
+		m |= NODE_MOD_ANCESTOR_OF;
 	}
 
-	if (sel->window != OPTION_NONE &&
-	    !loc->node->client
-	    ? sel->window == OPTION_TRUE
-	    : sel->window == OPTION_FALSE) {
-		return false;
+	client_t *c = n->client;
+	if (c == NULL) {
+		return m;
 	}
 
-#define NFLAG(p) \
-	if (sel->p != OPTION_NONE && \
-	    !loc->node->p \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
-	}
-	NFLAG(hidden)
-	NFLAG(sticky)
-	NFLAG(private)
-	NFLAG(locked)
-	NFLAG(marked)
-#undef NFLAG
-
-#define NSPLIT(p, e) \
-	if (sel->p != OPTION_NONE && \
-	    loc->node->split_type != e \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
-	}
-	NSPLIT(horizontal, TYPE_HORIZONTAL)
-	NSPLIT(vertical, TYPE_VERTICAL)
-#undef NSPLIT
-
-	if (sel->descendant_of != OPTION_NONE &&
-	    !is_descendant(loc->node, ref ? ref->node : NULL)
-	    ? sel->descendant_of == OPTION_TRUE
-	    : sel->descendant_of == OPTION_FALSE) {
-		return false;
+	if ((mask & NODE_MOD_SAME_CLASS) && ref && ref->node && ref->node->client &&
+	    c->class_name == ref->node->client->class_name) {
+		m |= NODE_MOD_SAME_CLASS;
 	}
-
-	if (sel->ancestor_of != OPTION_NONE &&
-	    !is_descendant(ref ? ref->node : NULL, loc->node)
-	    ? sel->ancestor_of == OPTION_TRUE
-	    : sel->ancestor_of == OPTION_FALSE) {
-		return false;
+	switch (c->state) {
+		case STATE_TILED: m |= NODE_MOD_TILED; break;
+		case STATE_PSEUDO_TILED: m |= NODE_MOD_PSEUDO_TILED; break;
+		case STATE_FLOATING: m |= NODE_MOD_FLOATING; break;
+		case STATE_FULLSCREEN: m |= NODE_MOD_FULLSCREEN; break;
 	}
-
-	if (!loc->node->client) {
-		if (sel->same_class == OPTION_TRUE ||
-		    sel->tiled == OPTION_TRUE ||
-		    sel->pseudo_tiled == OPTION_TRUE ||
-		    sel->floating == OPTION_TRUE ||
-		    sel->fullscreen == OPTION_TRUE ||
-		    sel->below == OPTION_TRUE ||
-		    sel->normal == OPTION_TRUE ||
-		    sel->above == OPTION_TRUE ||
-		    sel->urgent == OPTION_TRUE) {
-			return false;
-		}
-		return true;
+	switch (c->layer) {
+		case LAYER_BELOW: m |= NODE_MOD_BELOW; break;
+		case LAYER_NORMAL: m |= NODE_MOD_NORMAL; break;
+		case LAYER_ABOVE: m |= NODE_MOD_ABOVE; break;
 	}
-
-	if (ref && ref->node && ref->node->client &&
-	    sel->same_class != OPTION_NONE &&
-	    streq(loc->node->client->class_name, ref->node->client->class_name)
-	    ? sel->same_class == OPTION_FALSE
-	    : sel->same_class == OPTION_TRUE) {
-		return false;
+	if (c->urgent) {
+		m |= NODE_MOD_URGENT;
 	}
-
-#define WSTATE(p, e) \
-	if (sel->p != OPTION_NONE && \
-	    loc->node->client->state != e \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
-	}
-	WSTATE(tiled, STATE_TILED)
-	WSTATE(pseudo_tiled, STATE_PSEUDO_TILED)
-	WSTATE(floating, STATE_FLOATING)
-	WSTATE(fullscreen, STATE_FULLSCREEN)
-#undef WSTATE
-
-#define WLAYER(p, e) \
-	if (sel->p != OPTION_NONE && \
-	    loc->node->client->layer != e \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
-	}
-	WLAYER(below, LAYER_BELOW)
-	WLAYER(normal, LAYER_NORMAL)
-	WLAYER(above, LAYER_ABOVE)
-#undef WLAYER
-
-#define WFLAG(p) \
-	if (sel->p != OPTION_NONE && \
-	    !loc->node->client->p \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
-	}
-	WFLAG(urgent)
-#undef WFLAG
-
-	return true;
+	return m;
 }
 
-bool desktop_matches(coordinates_t *loc, coordinates_t *ref, desktop_select_t *sel)
+bool node_matches(coordinates_t *loc, coordinates_t *ref, node_select_t *sel)
 {
-	if (!loc || !loc->desktop || !sel)
-		return false;
-
-	if (sel->occupied != OPTION_NONE &&
-	    !loc->desktop->root
-	    ? sel->occupied == OPTION_TRUE
-	    : sel->occupied == OPTION_FALSE) {
+	if (!loc || !loc->node || !sel)
 		return false;
-	}
 
-	if (sel->focused != OPTION_NONE &&
-	    loc->desktop != (mon ? mon->desk : NULL)
-	    ? sel->focused == OPTION_TRUE
-	    : sel->focused == OPTION_FALSE) {
-		return false;
-	}
+	if (sel->mask == 0)
+		return true;
 
-	if (sel->active != OPTION_NONE &&
-	    loc->desktop != (loc->monitor ? loc->monitor->desk : NULL)
-	    ? sel->active == OPTION_TRUE
-	    : sel->active == OPTION_FALSE) {
-		return false;
-	}
+	return (node_modifiers(loc, ref, sel->mask) & sel->mask) == sel->want;
+}
 
-	if (sel->urgent != OPTION_NONE &&
-	    !is_urgent(loc->desktop)
-	    ? sel->urgent == OPTION_TRUE
-	    : sel->urgent == OPTION_FALSE) {
+bool desktop_matches(coordinates_t *loc, coordinates_t *ref, desktop_select_t *sel)
+{
+	if (!loc || !loc->desktop || !sel)
 		return false;
-	}
 
-	if (sel->local != OPTION_NONE &&
-	    loc->monitor != (ref && ref->monitor ? ref->monitor : NULL)
-	    ? sel->local == OPTION_TRUE
-	    : sel->local == OPTION_FALSE) {
-		return false;
-	}
+	if (sel->mask == 0)
+		return true;
 
-#define DLAYOUT(p, e) \
-	if (sel->p != OPTION_NONE && \
-	    loc->desktop->layout != e \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
-	}
-	DLAYOUT(tiled, LAYOUT_TILED)
-	DLAYOUT(monocle, LAYOUT_MONOCLE)
-#undef DLAYOUT
+	desktop_t *d = loc->desktop;
+	uint32_t m = (d->root ? DESKTOP_MOD_OCCUPIED : 0) |
+	             (d == (mon ? mon->desk : NULL) ? DESKTOP_MOD_FOCUSED : 0) |
+	             (d == (loc->monitor ? loc->monitor->desk : NULL) ? DESKTOP_MOD_ACTIVE : 0) |
+	             (loc->monitor == (ref && ref->monitor ? ref->monitor : NULL) ? DESKTOP_MOD_LOCAL : 0) |
+	             (d->layout == LAYOUT_TILED ? DESKTOP_MOD_TILED : 0) |
+	             (d->layout == LAYOUT_MONOCLE ? DESKTOP_MOD_MONOCLE : 0) |
+	             (d->user_layout == LAYOUT_TILED ? DESKTOP_MOD_USER_TILED : 0) |
+	             (d->user_layout == LAYOUT_MONOCLE ? DESKTOP_MOD_USER_MONOCLE : 0);
 
-#define DUSERLAYOUT(p, e) \
-	if (sel->p != OPTION_NONE && \
-	    loc->desktop->user_layout != e \
-	    ? sel->p == OPTION_TRUE \
-	    : sel->p == OPTION_FALSE) { \
-		return false; \
+	if ((sel->mask & DESKTOP_MOD_URGENT) && is_urgent(d)) {
+		m |= DESKTOP_MOD_URGENT;
 	}
-	DUSERLAYOUT(user_tiled, LAYOUT_TILED)
-	DUSERLAYOUT(user_monocle, LAYOUT_MONOCLE)
-#undef DUSERLAYOUT
 
-	return true;
+	return (m & sel->mask) == sel->want;
 }
 
 bool monitor_matches(coordinates_t *loc, __attribute__((unused)) coordinates_t *ref, monitor_select_t *sel)
@@ -1451,19 +1256,9 @@ bool monitor_matches(coordinates_t *loc, __attribute__((unused)) coordinates_t *
 	if (!loc || !loc->monitor || !sel)
 		return false;
 
-	if (sel->occupied != OPTION_NONE &&
-	    (!loc->monitor->desk || !loc->monitor->desk->root)
-	    ? sel->occupied == OPTION_TRUE
-	    : sel->occupied == OPTION_FALSE) {
-		return false;
-	}
-
-	if (sel->focused != OPTION_NONE &&
-	    loc->monitor != mon
-	    ? sel->focused == OPTION_TRUE
-	    : sel->focused == OPTION_FALSE) {
-		return false;
-	}
+	monitor_t *m = loc->monitor;
+	uint32_t mods = (m->desk && m->desk->root ? MONITOR_MOD_OCCUPIED : 0) |
+	                (m == mon ? MONITOR_MOD_FOCUSED : 0);
 
-	return true;
+	return (mods & sel->mask) == sel->want;
 }
@@ -25,13 +25,16 @@
 #ifndef BSPWM_QUERY_H
 #define BSPWM_QUERY_H
 
+#include "json.h"
+
 #define PTH_TOK  "/"
 
 typedef enum {
 	DOMAIN_TREE,
 	DOMAIN_MONITOR,
 	DOMAIN_DESKTOP,
-	DOMAIN_NODE
+	DOMAIN_NODE,
+	DOMAIN_METRICS
 } domain_t;
 
 enum {
@@ -44,19 +47,19 @@ enum {
 typedef void (*monitor_printer_t)(monitor_t *m, FILE *rsp);
 typedef void (*desktop_printer_t)(desktop_t *m, FILE *rsp);
 
-void query_state(FILE *rsp);
-void query_monitor(monitor_t *m, FILE *rsp);
-void query_desktop(desktop_t *d, FILE *rsp);
-void query_node(node_t *n, FILE *rsp);
-void query_presel(presel_t *p, FILE *rsp);
-void query_client(client_t *c, FILE *rsp);
-void query_rectangle(bspwm_rect_t r, FILE *rsp);
-void query_constraints(constraints_t c, FILE *rsp);
-void query_padding(padding_t p, FILE *rsp);
-void query_history(FILE *rsp);
-void query_coordinates(coordinates_t *loc, FILE *rsp);
-void query_stack(FILE *rsp);
-void query_subscribers(FILE *rsp);
+void query_state(json_writer_t *jw);
+void query_monitor(monitor_t *m, const char *key, json_writer_t *jw);
+void query_desktop(desktop_t *d, const char *key, json_writer_t *jw);
+void query_node(node_t *n, const char *key, json_writer_t *jw);
+void query_presel(presel_t *p, const char *key, json_writer_t *jw);
+void query_client(client_t *c, const char *key, json_writer_t *jw);
+void query_rectangle(bspwm_rect_t r, const char *key, json_writer_t *jw);
+void query_constraints(constraints_t c, const char *key, json_writer_t *jw);
+void query_padding(padding_t p, const char *key, json_writer_t *jw);
+void query_history(const char *key, json_writer_t *jw);
+void query_coordinates(coordinates_t *loc, const char *key, json_writer_t *jw);
+void query_stack(const char *key, json_writer_t *jw);
+void query_subscribers(const char *key, json_writer_t *jw);
 int query_node_ids(coordinates_t *mon_ref, coordinates_t *desk_ref, coordinates_t* ref, coordinates_t *trg, monitor_select_t *mon_sel, desktop_select_t *desk_sel, node_select_t *sel, FILE *rsp);
 int query_node_ids_in(node_t *n, desktop_t *d, monitor_t *m, coordinates_t *ref, coordinates_t *trg, node_select_t *sel, FILE *rsp);
 int query_desktop_ids(coordinates_t* mon_ref, coordinates_t *ref, coordinates_t *trg, monitor_select_t *mon_sel, desktop_select_t *sel, desktop_printer_t printer, FILE *rsp);
@@ -89,7 +92,6 @@ int desktop_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst);
 int monitor_from_desc(char *desc, coordinates_t *ref, coordinates_t *dst);
 __attribute__((warn_unused_result)) bool locate_leaf(bspwm_wid_t win, coordinates_t *loc);
 __attribute__((warn_unused_result)) bool locate_window(bspwm_wid_t win, coordinates_t *loc);
-void locate_window_cache_clear(void);
 __attribute__((warn_unused_result)) bool locate_desktop(char *name, coordinates_t *loc);
 __attribute__((warn_unused_result)) bool locate_monitor(char *name, coordinates_t *loc);
 __attribute__((warn_unused_result)) bool desktop_from_id(uint32_t id, coordinates_t *loc, monitor_t *mm);
@@ -22,6 +22,8 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,6 +43,8 @@
 #include "window.h"
 #include "restore.h"
 #include "parse.h"
+#include "lookup.h"
+#include "snapshot.h"
 
 /* Upper bound for the restore walkers: the token cursor must never be
  * dereferenced at or past this. A zeroed sentinel token sits at *tokens_end
@@ -54,8 +58,83 @@ static inline bool tok_oob(jsmntok_t **t)
 	return *t >= tokens_end;
 }
 
+/* Every key of the state file, whatever the object it belongs to */
+#define RESTORE_KEYS(X) \
+	X(focusedMonitorId) X(primaryMonitorId) X(clientsCount) X(monitors) \
+	X(focusHistory) X(stackingList) X(eventSubscribers) \
+	X(name) X(id) X(randrId) X(wired) X(adaptiveSync) X(directScanout) \
+	X(stickyCount) X(windowGap) X(borderWidth) X(focusedDesktopId) \
+	X(padding) X(rectangle) X(desktops) \
+	X(layout) X(userLayout) X(focusedNodeId) X(root) \
+	X(splitType) X(splitRatio) X(vacant) X(hidden) X(sticky) X(private) \
+	X(locked) X(marked) X(presel) X(constraints) X(firstChild) \
+	X(secondChild) X(client) X(splitDir) \
+	X(className) X(instanceName) X(state) X(lastState) X(layer) \
+	X(lastLayer) X(urgent) X(shown) X(tiledRectangle) X(floatingRectangle) \
+	X(x) X(y) X(width) X(height) X(min_width) X(min_height) \
+	X(top) X(right) X(bottom) X(left) \
+	X(fileDescriptor) X(fifoPath) X(subtype) X(field) X(count) X(json) \
+	X(monitorId) X(desktopId) X(nodeId)
+
+#define KEY_ID(k)  KEY_##k,
+#define KEY_NAME(k)  #k,
+enum {
+	RESTORE_KEYS(KEY_ID)
+};
+static const char *const restore_key_names[] = {RESTORE_KEYS(KEY_NAME)};
+#undef KEY_ID
+#undef KEY_NAME
+
+static name_table_t restore_key_table = NAME_TABLE(restore_key_names);
+
+/* Returns the id of a key token, or -1 for an unknown key. */
+static int restore_key(jsmntok_t *key, char *json)
+{
+	if (key->end < key->start) {
+		return -1;
+	}
+	return name_table_lookup_len(&restore_key_table, json + key->start, key->end - key->start);
+}
+
+static void restore_string(char *dst, size_t size, jsmntok_t *t, char *json)
+{
+	int tlen = (int) (t->end - t->start);
+	if (tlen < 0) { tlen = 0; }
+	if ((size_t) tlen >= size) { tlen = (int) size - 1; }
+	snprintf(dst, size, "%.*s", tlen, json + t->start);
+}
+
+/* The numbers are read within their token: sscanf would measure the
+ * whole rest of the file first, for every value. */
+static bool restore_number(jsmntok_t *t, char *json, long long min, long long max, long long *v)
+{
+	char *end;
+	errno = 0;
+	long long x = strtoll(json + t->start, &end, 10);
+	if (end == json + t->start || end != json + t->end || errno != 0 || x < min || x > max) {
+		return false;
+	}
+	*v = x;
+	return true;
+}
+
+static bool restore_real(jsmntok_t *t, char *json, double *v)
+{
+	char *end;
+	double x = strtod(json + t->start, &end);
+	if (end == json + t->start || end != json + t->end) {
+		return false;
+	}
+	*v = x;
+	return true;
+}
+
 bool restore_state(const char *file_path)
 {
+	if (is_snapshot(file_path)) {
+		return restore_snapshot(file_path);
+	}
+
 	size_t jslen;
 	char *json = read_string(file_path, &jslen);
 
@@ -63,47 +142,24 @@ bool restore_state(const char *file_path)
 		return false;
 	}
 
-	size_t nbtok = 256;
+	/* A first pass without tokens counts them, the second one fills an
+	 * array of exactly that size plus the sentinel slot. */
 	jsmn_parser parser;
-	jsmntok_t *tokens = safe_malloc_array(nbtok, sizeof(jsmntok_t));
-
-	if (tokens == NULL) {
-		perror("Restore tree: malloc");
-		free(json);
-		return false;
-	}
-
-	int ret;
-
-	/* Re-init the parser on every retry: jsmn_parse mutates parser state
-	 * on NOMEM (it has consumed input up to where it ran out of tokens),
-	 * so calling it again with a bigger token buffer but the same advanced
-	 * parser yields JSMN_ERROR_INVAL on the next character. Reset before
-	 * each attempt so the larger buffer parses the file from the start. */
-	for (;;) {
-		jsmn_init(&parser);
-		ret = jsmn_parse(&parser, json, jslen, tokens, (unsigned int)nbtok);
-		if (ret != JSMN_ERROR_NOMEM) {
-			break;
-		}
-		if (!safe_double(&nbtok)) {
-			warn("Restore tree: token count overflow\n");
-			free(tokens);
-			free(json);
-			return false;
-		}
-		jsmntok_t *rtokens = safe_realloc_array(tokens, nbtok, sizeof(jsmntok_t));
-		if (rtokens == NULL) {
-			perror("Restore tree: realloc");
-			free(tokens);
+	jsmntok_t *tokens = NULL;
+	jsmn_init(&parser);
+	int ret = jsmn_parse(&parser, json, jslen, NULL, 0);
+
+	if (ret >= 0) {
+		tokens = safe_malloc_array((size_t) ret + 1, sizeof(jsmntok_t));
+		if (tokens == NULL) {
+			perror("Restore tree: malloc");
 			free(json);
 			return false;
 		}
-		tokens = rtokens;
+		jsmn_init(&parser);
+		ret = jsmn_parse(&parser, json, jslen, tokens, (unsigned int) ret);
 	}
 
-
-
 	if (ret < 0) {
 		warn("Restore tree: jsmn_parse: ");
 		switch (ret) {
@@ -127,19 +183,9 @@ bool restore_state(const char *file_path)
 		return false;
 	}
 
-	/* Reserve a zeroed sentinel slot at tokens[ret] and bound the cursor to
-	 * it, so a crafted state file with inflated container sizes cannot walk
-	 * the token cursor out of bounds. */
-	if ((size_t) ret >= nbtok) {
-		jsmntok_t *rtokens = safe_realloc_array(tokens, (size_t) ret + 1, sizeof(jsmntok_t));
-		if (rtokens == NULL) {
-			perror("Restore tree: realloc");
-			free(tokens);
-			free(json);
-			return false;
-		}
-		tokens = rtokens;
-	}
+	/* A zeroed sentinel token at tokens[ret] bounds the cursor, so a
+	 * crafted state file with inflated container sizes cannot walk it
+	 * out of bounds. */
 	memset(&tokens[ret], 0, sizeof(jsmntok_t));
 	tokens_end = tokens + ret;
 
@@ -160,50 +206,60 @@ bool restore_state(const char *file_path)
 	jsmntok_t *t = tokens + 1;
 	uint32_t focused_monitor_id = 0, primary_monitor_id = 0;
 	jsmntok_t *focus_history_token = NULL, *stacking_list_token = NULL;
+	long long v;
 
 	for (int i = 0; i < num && t < tokens_end; i++) {
-		if (keyeq("focusedMonitorId", t, json)) {
-			t++;
-			if (sscanf(json + t->start, "%u", &focused_monitor_id) != 1) { focused_monitor_id = 0; }
-		} else if (keyeq("primaryMonitorId", t, json)) {
-			t++;
-			if (sscanf(json + t->start, "%u", &primary_monitor_id) != 1) { primary_monitor_id = 0; }
-		} else if (keyeq("clientsCount", t, json)) {
-			t++;
-			if (sscanf(json + t->start, "%u", &clients_count) != 1) { clients_count = 0; }
-		} else if (keyeq("monitors", t, json)) {
-			t++;
-			int s = t->size;
-			t++;
-			for (int j = 0; j < s && t < tokens_end; j++) {
-				monitor_t *m = restore_monitor(&t, json);
-				if (m == NULL) {
-					continue;
-				}
-				if (m->desk == NULL) {
-					add_desktop(m, make_desktop(NULL, BSPWM_WID_NONE));
+		switch (restore_key(t, json)) {
+			case KEY_focusedMonitorId:
+				t++;
+				focused_monitor_id = restore_number(t, json, 0, UINT32_MAX, &v) ? v : 0;
+				break;
+			case KEY_primaryMonitorId:
+				t++;
+				primary_monitor_id = restore_number(t, json, 0, UINT32_MAX, &v) ? v : 0;
+				break;
+			case KEY_clientsCount:
+				t++;
+				clients_count = restore_number(t, json, 0, UINT_MAX, &v) ? v : 0;
+				/* every restored node takes a few tokens, which bounds the hint */
+				reserve_nodes(MIN((size_t) clients_count, (size_t) ret / 4));
+				break;
+			case KEY_monitors: {
+				t++;
+				int s = t->size;
+				t++;
+				for (int j = 0; j < s && t < tokens_end; j++) {
+					monitor_t *m = restore_monitor(&t, json);
+					if (m == NULL) {
+						continue;
+					}
+					if (m->desk == NULL) {
+						add_desktop(m, make_desktop(NULL, BSPWM_WID_NONE));
+					}
+					add_monitor(m);
 				}
-				add_monitor(m);
-			}
-			continue;
-		} else if (keyeq("focusHistory", t, json)) {
-			t++;
-			if (mon == NULL) {
-				focus_history_token = t;
-			}
-			restore_history(&t, json);
-			continue;
-		} else if (keyeq("stackingList", t, json)) {
-			t++;
-			if (mon == NULL) {
-				stacking_list_token = t;
+				continue;
 			}
-			restore_stack(&t, json);
-			continue;
-		} else if (keyeq("eventSubscribers", t, json)) {
-			t++;
-			restore_subscribers(&t, json);
-			continue;
+			case KEY_focusHistory:
+				t++;
+				if (mon == NULL) {
+					focus_history_token = t;
+				}
+				restore_history(&t, json);
+				continue;
+			case KEY_stackingList:
+				t++;
+				if (mon == NULL) {
+					stacking_list_token = t;
+				}
+				restore_stack(&t, json);
+				continue;
+			case KEY_eventSubscribers:
+				t++;
+				restore_subscribers(&t, json);
+				continue;
+			default:
+				break;
 		}
 		t++;
 	}
@@ -230,11 +286,136 @@ bool restore_state(const char *file_path)
 		restore_stack(&stacking_list_token, json);
 	}
 
+	restore_finish();
+
+	free(tokens);
+	free(json);
+
+	return true;
+}
+
+/* Refresh the properties of every restored client, sending the requests
+ * for all of them before collecting the first reply. */
+static void initialize_clients(void)
+{
+	size_t count = 0;
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
-		m->id = ++id_counter;
 		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-			d->id = ++id_counter;
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+				if (n->client != NULL) {
+					count++;
+				}
+			}
+		}
+	}
+
+	bspwm_attrs_cookie_t *cookies = count > 0 ? malloc(count * sizeof(bspwm_attrs_cookie_t)) : NULL;
+	if (cookies == NULL) {
+		for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+			for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+				for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+					initialize_client(n);
+				}
+			}
+		}
+		return;
+	}
+
+	size_t i = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+				if (n->client != NULL) {
+					cookies[i++] = backend_request_window_attributes(n->id, false);
+				}
+			}
+		}
+	}
+
+	i = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			for (node_t *n = first_extrema(d->root); n != NULL; n = next_leaf(n, d->root)) {
+				client_t *c = n->client;
+				if (c == NULL) {
+					continue;
+				}
+				bspwm_window_attrs_t attrs;
+				char class_name[MAXLEN], instance_name[MAXLEN];
+				backend_collect_window_attributes(n->id, cookies[i++], &attrs,
+				                                  class_name, instance_name, NULL, MAXLEN);
+				c->icccm_props = attrs.icccm_props;
+				c->size_hints = attrs.size_hints;
+				if (attrs.has_geometry) {
+					c->geometry = attrs.geometry;
+					c->geometry_known = true;
+				}
+			}
+		}
+	}
+
+	free(cookies);
+}
+
+/* The ID a monitor or desktop had in the state file, and its new one */
+typedef struct {
+	uint32_t old_id;
+	uint32_t new_id;
+} id_change_t;
+
+typedef struct {
+	id_change_t *ids;
+	size_t len;
+	size_t cap;
+	bool failed;
+} id_changes_t;
+
+static uint32_t renumber(id_changes_t *changes, uint32_t old_id)
+{
+	uint32_t new_id = ++id_counter;
+	if (changes->len == changes->cap && !changes->failed) {
+		size_t cap = changes->cap ? changes->cap * 2 : 16;
+		id_change_t *ids = safe_realloc_array(changes->ids, cap, sizeof(id_change_t));
+		if (ids == NULL) {
+			changes->failed = true;
+		} else {
+			changes->ids = ids;
+			changes->cap = cap;
+		}
+	}
+	if (changes->len < changes->cap) {
+		changes->ids[changes->len++] = (id_change_t) {old_id, new_id};
+	}
+	return new_id;
+}
+
+/* Maps an ID of the state file to the one given by restore_finish: IDs
+ * that belonged to no monitor or desktop match nothing anymore. */
+static uint32_t renumbered_id(const id_changes_t *changes, uint32_t old_id)
+{
+	if (old_id == 0) {
+		return 0;
+	}
+	for (size_t i = 0; i < changes->len; i++) {
+		if (changes->ids[i].old_id == old_id) {
+			return changes->ids[i].new_id;
+		}
+	}
+	return UINT32_MAX;
+}
+
+/* Gives fresh IDs to the restored monitors and desktops, and sets up the
+ * restored windows and the EWMH properties. */
+void restore_finish(void)
+{
+	id_changes_t changes = {0};
+
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		m->id = renumber(&changes, m->id);
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			d->id = renumber(&changes, d->id);
 			regenerate_ids_in(d->root);
+			flag_index_add_in(m, d, d->root);
 			refresh_presel_feedbacks(m, d, d->root);
 			restack_presel_feedbacks(d);
 
@@ -242,13 +423,29 @@ bool restore_state(const char *file_path)
 				if (n->client == NULL) {
 					continue;
 				}
-				initialize_client(n);
+				window_index_add(n->id, m, d, n);
 				backend_window_listen_enter(n->id, focus_follows_pointer);
 				window_grab_buttons(n->id);
 			}
 		}
 	}
 
+	/* The event filters of the restored subscribers refer to the old IDs */
+	if (changes.failed) {
+		warn("Restore: out of memory, resetting the subscriber filters.\n");
+	}
+	for (subscriber_list_t *sb = subscribe_head; sb != NULL; sb = sb->next) {
+		if (changes.failed) {
+			sb->monitor_id = sb->desktop_id = 0;
+		} else {
+			sb->monitor_id = renumbered_id(&changes, sb->monitor_id);
+			sb->desktop_id = renumbered_id(&changes, sb->desktop_id);
+		}
+	}
+	free(changes.ids);
+
+	initialize_clients();
+
 	ewmh_update_number_of_desktops();
 	ewmh_update_desktop_names();
 	ewmh_update_desktop_viewport();
@@ -258,39 +455,35 @@ bool restore_state(const char *file_path)
 
 	/* Restore X11 input focus to the focused window */
 	update_input_focus();
-
-	free(tokens);
-	free(json);
-
-	return true;
 }
 
-#define RESTORE_INT(k, p) \
-	} else if (keyeq(#k, *t, json)) { \
-		(*t)++; \
-		if (sscanf(json + (*t)->start, "%i", p) != 1) { *(p) = 0; }
-
-#define RESTORE_UINT(k, p) \
-	} else if (keyeq(#k, *t, json)) { \
+#define RESTORE_NUMBER(k, p, min, max) \
+	case KEY_##k: { \
 		(*t)++; \
-		if (sscanf(json + (*t)->start, "%u", p) != 1) { *(p) = 0; }
+		long long v; \
+		*(p) = restore_number(*t, json, min, max, &v) ? v : 0; \
+		break; \
+	}
 
-#define RESTORE_USINT(k, p) \
-	} else if (keyeq(#k, *t, json)) { \
-		(*t)++; \
-		if (sscanf(json + (*t)->start, "%hu", p) != 1) { *(p) = 0; }
+#define RESTORE_INT(k, p)    RESTORE_NUMBER(k, p, INT_MIN, INT_MAX)
+#define RESTORE_UINT(k, p)   RESTORE_NUMBER(k, p, 0, UINT_MAX)
+#define RESTORE_SINT(k, p)   RESTORE_NUMBER(k, p, SHRT_MIN, SHRT_MAX)
+#define RESTORE_USINT(k, p)  RESTORE_NUMBER(k, p, 0, USHRT_MAX)
 
 #define RESTORE_DOUBLE(k, p) \
-	} else if (keyeq(#k, *t, json)) { \
+	case KEY_##k: \
 		(*t)++; \
-		if (sscanf(json + (*t)->start, "%lf", p) != 1) { *(p) = 0; }
+		if (!restore_real(*t, json, p)) { *(p) = 0; } \
+		break;
 
 #define RESTORE_ANY(k, p, f) \
-	} else if (keyeq(#k, *t, json)) { \
+	case KEY_##k: { \
 		(*t)++; \
-		char *val = copy_string(json + (*t)->start, (*t)->end - (*t)->start); \
+		char val[MAXLEN]; \
+		restore_string(val, sizeof(val), *t, json); \
 		f(val, p); \
-		free(val);
+		break; \
+	}
 
 #define RESTORE_BOOL(k, p)  RESTORE_ANY(k, p, parse_bool)
 
@@ -308,42 +501,48 @@ monitor_t *restore_monitor(jsmntok_t **t, char *json)
 	uint32_t focused_desktop_id = 0;
 
 	for (int i = 0; i < num && !tok_oob(t); i++) {
-		if (keyeq("name", *t, json)) {
-			(*t)++;
-			int tlen = (int) ((*t)->end - (*t)->start);
-			if (tlen < 0) { tlen = 0; }
-			if ((size_t) tlen >= sizeof(m->name)) { tlen = (int) sizeof(m->name) - 1; }
-			snprintf(m->name, sizeof(m->name), "%.*s", tlen, json + (*t)->start);
-		RESTORE_UINT(id, &m->id)
-		RESTORE_UINT(randrId, &m->output_id)
-		RESTORE_BOOL(wired, &m->wired)
-		RESTORE_UINT(stickyCount, &m->sticky_count)
-		RESTORE_INT(windowGap, &m->window_gap)
-		RESTORE_UINT(borderWidth, &m->border_width)
-		RESTORE_UINT(focusedDesktopId, &focused_desktop_id)
-		} else if (keyeq("padding", *t, json)) {
-			(*t)++;
-			restore_padding(&m->padding, t, json);
-			continue;
-		} else if (keyeq("rectangle", *t, json)) {
-			(*t)++;
-			restore_rectangle(&m->rectangle, t, json);
-			update_root(m, &m->rectangle);
-			continue;
-		} else if (keyeq("desktops", *t, json)) {
-			(*t)++;
-			int s = (*t)->size;
-			(*t)++;
-			for (int j = 0; j < s && !tok_oob(t); j++) {
-				desktop_t *d = restore_desktop(t, json);
-				if (d != NULL) {
-					add_desktop(m, d);
+		switch (restore_key(*t, json)) {
+			case KEY_name:
+				(*t)++;
+				restore_string(m->name, sizeof(m->name), *t, json);
+				break;
+			RESTORE_UINT(id, &m->id)
+			RESTORE_UINT(randrId, &m->output_id)
+			RESTORE_BOOL(wired, &m->wired)
+			RESTORE_BOOL(adaptiveSync, &m->adaptive_sync)
+			case KEY_directScanout:
+				/* Observed by the backend, nothing to restore */
+				(*t)++;
+				break;
+			RESTORE_UINT(stickyCount, &m->sticky_count)
+			RESTORE_INT(windowGap, &m->window_gap)
+			RESTORE_UINT(borderWidth, &m->border_width)
+			RESTORE_UINT(focusedDesktopId, &focused_desktop_id)
+			case KEY_padding:
+				(*t)++;
+				restore_padding(&m->padding, t, json);
+				continue;
+			case KEY_rectangle:
+				(*t)++;
+				restore_rectangle(&m->rectangle, t, json);
+				update_root(m, &m->rectangle);
+				continue;
+			case KEY_desktops: {
+				(*t)++;
+				int s = (*t)->size;
+				(*t)++;
+				for (int j = 0; j < s && !tok_oob(t); j++) {
+					desktop_t *d = restore_desktop(t, json);
+					if (d != NULL) {
+						add_desktop(m, d);
+					}
 				}
+				continue;
 			}
-			continue;
-		} else {
-			warn("Restore monitor: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
-			(*t)++;
+			default:
+				warn("Restore monitor: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
+				(*t)++;
+				break;
 		}
 		(*t)++;
 	}
@@ -357,6 +556,10 @@ monitor_t *restore_monitor(jsmntok_t **t, char *json)
 		}
 	}
 
+	if (m->adaptive_sync) {
+		backend_set_adaptive_sync(m->output_id, true);
+	}
+
 	return m;
 }
 
@@ -374,31 +577,36 @@ desktop_t *restore_desktop(jsmntok_t **t, char *json)
 	bspwm_wid_t focusedNodeId = BSPWM_WID_NONE;
 
 	for (int i = 0; i < s && !tok_oob(t); i++) {
-		if (keyeq("name", *t, json)) {
-			(*t)++;
-			int tlen = (int) ((*t)->end - (*t)->start);
-			if (tlen < 0) { tlen = 0; }
-			if ((size_t) tlen >= sizeof(d->name)) { tlen = (int) sizeof(d->name) - 1; }
-			snprintf(d->name, sizeof(d->name), "%.*s", tlen, json + (*t)->start);
-		RESTORE_UINT(id, &d->id)
-		RESTORE_ANY(layout, &d->layout, parse_layout)
-		RESTORE_ANY(userLayout, &d->user_layout, parse_layout)
-		RESTORE_INT(windowGap, &d->window_gap)
-		RESTORE_UINT(borderWidth, &d->border_width)
-		} else if (keyeq("focusedNodeId", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%u", &focusedNodeId) != 1) { focusedNodeId = BSPWM_WID_NONE; }
-		} else if (keyeq("padding", *t, json)) {
-			(*t)++;
-			restore_padding(&d->padding, t, json);
-			continue;
-		} else if (keyeq("root", *t, json)) {
-			(*t)++;
-			d->root = restore_node(t, json);
-			continue;
-		} else {
-			warn("Restore desktop: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
-			(*t)++;
+		switch (restore_key(*t, json)) {
+			case KEY_name:
+				(*t)++;
+				restore_string(d->name, sizeof(d->name), *t, json);
+				break;
+			RESTORE_UINT(id, &d->id)
+			RESTORE_ANY(layout, &d->layout, parse_layout)
+			RESTORE_ANY(userLayout, &d->user_layout, parse_layout)
+			RESTORE_INT(windowGap, &d->window_gap)
+			RESTORE_UINT(borderWidth, &d->border_width)
+			case KEY_focusedNodeId: {
+				(*t)++;
+				long long v;
+				focusedNodeId = restore_number(*t, json, 0, UINT32_MAX, &v) ? v : BSPWM_WID_NONE;
+				break;
+			}
+			case KEY_padding:
+				(*t)++;
+				restore_padding(&d->padding, t, json);
+				continue;
+			case KEY_root:
+				(*t)++;
+				d->root = restore_node(t, json);
+				relink_leaves(d->root);
+				rebuild_counts_from_leaves(d->root);
+				continue;
+			default:
+				warn("Restore desktop: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
+				(*t)++;
+				break;
 		}
 		(*t)++;
 	}
@@ -428,52 +636,59 @@ node_t *restore_node(jsmntok_t **t, char *json)
 		}
 
 		for (int i = 0; i < s && !tok_oob(t); i++) {
-			if (keyeq("id", *t, json)) {
-				(*t)++;
-				if (sscanf(json + (*t)->start, "%u", &n->id) != 1) { n->id = 0; }
-			RESTORE_ANY(splitType, &n->split_type, parse_split_type)
-			RESTORE_DOUBLE(splitRatio, &n->split_ratio)
-			RESTORE_BOOL(vacant, &n->vacant)
-			RESTORE_BOOL(hidden, &n->hidden)
-			RESTORE_BOOL(sticky, &n->sticky)
-			RESTORE_BOOL(private, &n->private)
-			RESTORE_BOOL(locked, &n->locked)
-			RESTORE_BOOL(marked, &n->marked)
-			} else if (keyeq("presel", *t, json)) {
-				(*t)++;
-				n->presel = restore_presel(t, json);
-				continue;
-			} else if (keyeq("rectangle", *t, json)) {
-				(*t)++;
-				restore_rectangle(&n->rectangle, t, json);
-				continue;
-			} else if (keyeq("constraints", *t, json)) {
-				(*t)++;
-				restore_constraints(&n->constraints, t, json);
-				continue;
-			} else if (keyeq("firstChild", *t, json)) {
-				(*t)++;
-				node_t *fc = restore_node(t, json);
-				n->first_child = fc;
-				if (fc != NULL) {
-					fc->parent = n;
+			switch (restore_key(*t, json)) {
+				case KEY_id: {
+					(*t)++;
+					long long id;
+					node_registry_set_id(n, restore_number(*t, json, 0, UINT32_MAX, &id) ? id : 0);
+					break;
 				}
-				continue;
-			} else if (keyeq("secondChild", *t, json)) {
-				(*t)++;
-				node_t *sc = restore_node(t, json);
-				n->second_child = sc;
-				if (sc != NULL) {
-					sc->parent = n;
+				RESTORE_ANY(splitType, &n->split_type, parse_split_type)
+				RESTORE_DOUBLE(splitRatio, &n->split_ratio)
+				RESTORE_BOOL(vacant, &n->vacant)
+				RESTORE_BOOL(hidden, &n->hidden)
+				RESTORE_BOOL(sticky, &n->sticky)
+				RESTORE_BOOL(private, &n->private)
+				RESTORE_BOOL(locked, &n->locked)
+				RESTORE_BOOL(marked, &n->marked)
+				case KEY_presel:
+					(*t)++;
+					n->presel = restore_presel(t, json);
+					continue;
+				case KEY_rectangle:
+					(*t)++;
+					restore_rectangle(&n->rectangle, t, json);
+					continue;
+				case KEY_constraints:
+					(*t)++;
+					restore_constraints(&n->constraints, t, json);
+					continue;
+				case KEY_firstChild: {
+					(*t)++;
+					node_t *fc = restore_node(t, json);
+					n->first_child = fc;
+					if (fc != NULL) {
+						fc->parent = n;
+					}
+					continue;
 				}
-				continue;
-			} else if (keyeq("client", *t, json)) {
-				(*t)++;
-				n->client = restore_client(t, json);
-				continue;
-			} else {
-				warn("Restore node: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
-				(*t)++;
+				case KEY_secondChild: {
+					(*t)++;
+					node_t *sc = restore_node(t, json);
+					n->second_child = sc;
+					if (sc != NULL) {
+						sc->parent = n;
+					}
+					continue;
+				}
+				case KEY_client:
+					(*t)++;
+					n->client = restore_client(t, json);
+					continue;
+				default:
+					warn("Restore node: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
+					(*t)++;
+					break;
 			}
 			(*t)++;
 		}
@@ -499,10 +714,14 @@ presel_t *restore_presel(jsmntok_t **t, char *json)
 		}
 
 		for (int i = 0; i < s && !tok_oob(t); i++) {
-			if (keyeq("splitRatio", *t, json)) {
-				(*t)++;
-				if (sscanf(json + (*t)->start, "%lf", &p->split_ratio) != 1) { p->split_ratio = 0.5; }
-			RESTORE_ANY(splitDir, &p->split_dir, parse_direction)
+			switch (restore_key(*t, json)) {
+				case KEY_splitRatio:
+					(*t)++;
+					if (!restore_real(*t, json, &p->split_ratio)) { p->split_ratio = 0.5; }
+					break;
+				RESTORE_ANY(splitDir, &p->split_dir, parse_direction)
+				default:
+					break;
 			}
 
 			(*t)++;
@@ -528,38 +747,39 @@ client_t *restore_client(jsmntok_t **t, char *json)
 		if (c == NULL) {
 			return NULL;
 		}
+		char name[MAX_CLASS_NAME_LEN];
 
 		for (int i = 0; i < s && !tok_oob(t); i++) {
-			if (keyeq("className", *t, json)) {
-				(*t)++;
-				int tlen = (int) ((*t)->end - (*t)->start);
-				if (tlen < 0) { tlen = 0; }
-				if ((size_t) tlen >= sizeof(c->class_name)) { tlen = (int) sizeof(c->class_name) - 1; }
-				snprintf(c->class_name, sizeof(c->class_name), "%.*s", tlen, json + (*t)->start);
-			} else if (keyeq("instanceName", *t, json)) {
-				(*t)++;
-				int tlen = (int) ((*t)->end - (*t)->start);
-				if (tlen < 0) { tlen = 0; }
-				if ((size_t) tlen >= sizeof(c->instance_name)) { tlen = (int) sizeof(c->instance_name) - 1; }
-				snprintf(c->instance_name, sizeof(c->instance_name), "%.*s", tlen, json + (*t)->start);
-			RESTORE_ANY(state, &c->state, parse_client_state)
-			RESTORE_ANY(lastState, &c->last_state, parse_client_state)
-			RESTORE_ANY(layer, &c->layer, parse_stack_layer)
-			RESTORE_ANY(lastLayer, &c->last_layer, parse_stack_layer)
-			RESTORE_UINT(borderWidth, &c->border_width)
-			RESTORE_BOOL(urgent, &c->urgent)
-			RESTORE_BOOL(shown, &c->shown)
-			} else if (keyeq("tiledRectangle", *t, json)) {
-				(*t)++;
-				restore_rectangle(&c->tiled_rectangle, t, json);
-				continue;
-			} else if (keyeq("floatingRectangle", *t, json)) {
-				(*t)++;
-				restore_rectangle(&c->floating_rectangle, t, json);
-				continue;
-			} else {
-				warn("Restore client: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
-				(*t)++;
+			switch (restore_key(*t, json)) {
+				case KEY_className:
+					(*t)++;
+					restore_string(name, sizeof(name), *t, json);
+					set_client_class(c, name, c->instance_name);
+					break;
+				case KEY_instanceName:
+					(*t)++;
+					restore_string(name, sizeof(name), *t, json);
+					set_client_class(c, c->class_name, name);
+					break;
+				RESTORE_ANY(state, &c->state, parse_client_state)
+				RESTORE_ANY(lastState, &c->last_state, parse_client_state)
+				RESTORE_ANY(layer, &c->layer, parse_stack_layer)
+				RESTORE_ANY(lastLayer, &c->last_layer, parse_stack_layer)
+				RESTORE_UINT(borderWidth, &c->border_width)
+				RESTORE_BOOL(urgent, &c->urgent)
+				RESTORE_BOOL(shown, &c->shown)
+				case KEY_tiledRectangle:
+					(*t)++;
+					restore_rectangle(&c->tiled_rectangle, t, json);
+					continue;
+				case KEY_floatingRectangle:
+					(*t)++;
+					restore_rectangle(&c->floating_rectangle, t, json);
+					continue;
+				default:
+					warn("Restore client: unknown key: '%.*s'.\n", (*t)->end - (*t)->start, json + (*t)->start);
+					(*t)++;
+					break;
 			}
 
 			(*t)++;
@@ -578,18 +798,13 @@ void restore_rectangle(bspwm_rect_t *r, jsmntok_t **t, char *json)
 	(*t)++;
 
 	for (int i = 0; i < s && !tok_oob(t); i++) {
-		if (keyeq("x", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%hi", &r->x) != 1) { r->x = 0; }
-		} else if (keyeq("y", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%hi", &r->y) != 1) { r->y = 0; }
-		} else if (keyeq("width", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%hu", &r->width) != 1) { r->width = 0; }
-		} else if (keyeq("height", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%hu", &r->height) != 1) { r->height = 0; }
+		switch (restore_key(*t, json)) {
+			RESTORE_SINT(x, &r->x)
+			RESTORE_SINT(y, &r->y)
+			RESTORE_USINT(width, &r->width)
+			RESTORE_USINT(height, &r->height)
+			default:
+				break;
 		}
 		(*t)++;
 	}
@@ -604,12 +819,11 @@ void restore_constraints(constraints_t *c, jsmntok_t **t, char *json)
 	(*t)++;
 
 	for (int i = 0; i < s && !tok_oob(t); i++) {
-		if (keyeq("min_width", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%hu", &c->min_width) != 1) { c->min_width = 0; }
-		} else if (keyeq("min_height", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%hu", &c->min_height) != 1) { c->min_height = 0; }
+		switch (restore_key(*t, json)) {
+			RESTORE_USINT(min_width, &c->min_width)
+			RESTORE_USINT(min_height, &c->min_height)
+			default:
+				break;
 		}
 		(*t)++;
 	}
@@ -624,18 +838,13 @@ void restore_padding(padding_t *p, jsmntok_t **t, char *json)
 	(*t)++;
 
 	for (int i = 0; i < s && !tok_oob(t); i++) {
-		if (keyeq("top", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%i", &p->top) != 1) { p->top = 0; }
-		} else if (keyeq("right", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%i", &p->right) != 1) { p->right = 0; }
-		} else if (keyeq("bottom", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%i", &p->bottom) != 1) { p->bottom = 0; }
-		} else if (keyeq("left", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%i", &p->left) != 1) { p->left = 0; }
+		switch (restore_key(*t, json)) {
+			RESTORE_INT(top, &p->top)
+			RESTORE_INT(right, &p->right)
+			RESTORE_INT(bottom, &p->bottom)
+			RESTORE_INT(left, &p->left)
+			default:
+				break;
 		}
 		(*t)++;
 	}
@@ -682,6 +891,26 @@ void restore_subscribers(jsmntok_t **t, char *json)
 	}
 }
 
+/* Reopens an inherited subscriber descriptor after checking it. */
+FILE *restore_subscriber_stream(int fd)
+{
+	long fd_max = sysconf(_SC_OPEN_MAX);
+	if (fd_max <= 0) {
+		fd_max = 1024;
+	}
+	if (fd <= STDERR_FILENO || fd >= (int) fd_max) {
+		warn("Restore subscriber: rejecting out-of-range fd.\n");
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+	    !(S_ISSOCK(st.st_mode) || S_ISFIFO(st.st_mode) || S_ISREG(st.st_mode))) {
+		warn("Restore subscriber: rejecting fd %i (fstat failed or wrong type).\n", fd);
+		return NULL;
+	}
+	return fdopen(fd, "w");
+}
+
 void restore_subscriber(subscriber_list_t *s, jsmntok_t **t, char *json)
 {
 	if (tok_oob(t)) {
@@ -691,31 +920,34 @@ void restore_subscriber(subscriber_list_t *s, jsmntok_t **t, char *json)
 	(*t)++;
 
 	for (int i = 0; i < n && !tok_oob(t); i++) {
-		if (keyeq("fileDescriptor", *t, json)) {
-			(*t)++;
-			int fd = -1;
-			long fd_max = sysconf(_SC_OPEN_MAX);
-			if (fd_max <= 0) {
-				fd_max = 1024;
-			}
-			if (sscanf(json + (*t)->start, "%i", &fd) == 1 &&
-			    fd > STDERR_FILENO && fd < (int) fd_max) {
-				struct stat st;
-				if (fstat(fd, &st) == 0 &&
-				    (S_ISSOCK(st.st_mode) || S_ISFIFO(st.st_mode) || S_ISREG(st.st_mode))) {
-					s->stream = fdopen(fd, "w");
+		switch (restore_key(*t, json)) {
+			case KEY_fileDescriptor: {
+				(*t)++;
+				long long fd;
+				if (restore_number(*t, json, INT_MIN, INT_MAX, &fd)) {
+					s->stream = restore_subscriber_stream(fd);
 				} else {
-					warn("Restore subscriber: rejecting fd %i (fstat failed or wrong type).\n", fd);
+					warn("Restore subscriber: rejecting out-of-range fd.\n");
 				}
-			} else {
-				warn("Restore subscriber: rejecting out-of-range fd.\n");
+				break;
 			}
-		} else if (keyeq("fifoPath", *t, json)) {
-			(*t)++;
-			free(s->fifo_path);
-			s->fifo_path = copy_string(json + (*t)->start, (*t)->end - (*t)->start);
-		RESTORE_INT(field, &s->field)
-		RESTORE_INT(count, &s->count)
+			case KEY_fifoPath:
+				(*t)++;
+				free(s->fifo_path);
+				s->fifo_path = copy_string(json + (*t)->start, (*t)->end - (*t)->start);
+				break;
+			case KEY_subtype:
+				(*t)++;
+				restore_string(s->subtype, sizeof(s->subtype), *t, json);
+				break;
+			RESTORE_INT(field, &s->field)
+			RESTORE_INT(count, &s->count)
+			RESTORE_BOOL(json, &s->json)
+			RESTORE_UINT(monitorId, &s->monitor_id)
+			RESTORE_UINT(desktopId, &s->desktop_id)
+			RESTORE_UINT(nodeId, &s->node_id)
+			default:
+				break;
 		}
 		(*t)++;
 	}
@@ -728,24 +960,30 @@ void restore_coordinates(coordinates_t *loc, jsmntok_t **t, char *json)
 	}
 	int s = (*t)->size;
 	(*t)++;
-	uint32_t id = 0;
+	long long id = 0;
 
 	for (int i = 0; i < s && !tok_oob(t); i++) {
-		if (keyeq("monitorId", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%u", &id) == 1) {
-				loc->monitor = find_monitor(id);
-			}
-		} else if (keyeq("desktopId", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%u", &id) == 1) {
-				loc->desktop = find_desktop_in(id, loc->monitor);
-			}
-		} else if (keyeq("nodeId", *t, json)) {
-			(*t)++;
-			if (sscanf(json + (*t)->start, "%u", &id) == 1) {
-				loc->node = find_by_id_in(loc->desktop != NULL ? loc->desktop->root : NULL, id);
-			}
+		switch (restore_key(*t, json)) {
+			case KEY_monitorId:
+				(*t)++;
+				if (restore_number(*t, json, 0, UINT32_MAX, &id)) {
+					loc->monitor = find_monitor(id);
+				}
+				break;
+			case KEY_desktopId:
+				(*t)++;
+				if (restore_number(*t, json, 0, UINT32_MAX, &id)) {
+					loc->desktop = find_desktop_in(id, loc->monitor);
+				}
+				break;
+			case KEY_nodeId:
+				(*t)++;
+				if (restore_number(*t, json, 0, UINT32_MAX, &id)) {
+					loc->node = find_by_id_in(loc->desktop != NULL ? loc->desktop->root : NULL, id);
+				}
+				break;
+			default:
+				break;
 		}
 		(*t)++;
 	}
@@ -757,26 +995,22 @@ void restore_stack(jsmntok_t **t, char *json)
 	(*t)++;
 
 	for (int i = 0; i < s; i++) {
-		uint32_t id;
-		if (sscanf(json + (*t)->start, "%u", &id) == 1) {
+		long long id;
+		if (restore_number(*t, json, 0, UINT32_MAX, &id)) {
 			coordinates_t loc;
 			if (locate_window(id, &loc)) {
-				stack_insert_after(stack_tail, loc.node);
+				stack_insert(loc.node, true);
 			}
 		}
 		(*t)++;
 	}
 }
 
+#undef RESTORE_NUMBER
 #undef RESTORE_INT
 #undef RESTORE_UINT
+#undef RESTORE_SINT
 #undef RESTORE_USINT
 #undef RESTORE_DOUBLE
 #undef RESTORE_ANY
 #undef RESTORE_BOOL
-
-bool keyeq(char *s, jsmntok_t *key, char *json)
-{
-	size_t n = key->end - key->start;
-	return (strlen(s) == n && strncmp(s, json + key->start, n) == 0);
-}
@@ -28,6 +28,7 @@
 #include "jsmn.h"
 
 bool restore_state(const char *file_path);
+void restore_finish(void);
 monitor_t *restore_monitor(jsmntok_t **t, char *json);
 desktop_t *restore_desktop(jsmntok_t **t, char *json);
 node_t *restore_node(jsmntok_t **t, char *json);
@@ -38,9 +39,9 @@ void restore_constraints(constraints_t *c, jsmntok_t **t, char *json);
 void restore_padding(padding_t *p, jsmntok_t **t, char *json);
 void restore_history(jsmntok_t **t, char *json);
 void restore_subscribers(jsmntok_t **t, char *json);
+FILE *restore_subscriber_stream(int fd);
 void restore_subscriber(subscriber_list_t *s, jsmntok_t **t, char *json);
 void restore_coordinates(coordinates_t *loc, jsmntok_t **t, char *json);
 void restore_stack(jsmntok_t **t, char *json);
-bool keyeq(char *s, jsmntok_t *key, char *json);
 
 #endif
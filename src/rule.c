@@ -29,6 +29,9 @@
 #include <sys/epoll.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include "bspwm.h"
 #ifdef BACKEND_X11
 #include "backend_x11.h"
@@ -38,7 +41,105 @@
 #include "query.h"
 #include "parse.h"
 #include "settings.h"
+#include "events.h"
 #include "rule.h"
+#include "stats.h"
+#include "trace.h"
+#include "intern.h"
+
+/* Rules are bucketed by exact class name, then by exact instance name for
+ * the ones matching any class; the rules matching both are kept apart.
+ * Every bucket is in insertion order. */
+typedef struct {
+	rule_t *head;
+	rule_t *tail;
+} rule_bucket_t;
+
+static rule_bucket_t class_buckets[RULE_BUCKETS];
+static rule_bucket_t instance_buckets[RULE_BUCKETS];
+static rule_bucket_t wildcard_rules;
+static unsigned long rule_seq;
+static unsigned int name_rules_count;  /* rules matching titles */
+
+/* Fields of a rule consequence set by parse_key_value */
+enum {
+	CSQ_MONITOR          = 1 << 0,
+	CSQ_DESKTOP          = 1 << 1,
+	CSQ_NODE             = 1 << 2,
+	CSQ_SPLIT_DIR        = 1 << 3,
+	CSQ_STATE            = 1 << 4,
+	CSQ_LAYER            = 1 << 5,
+	CSQ_SPLIT_RATIO      = 1 << 6,
+	CSQ_RECTANGLE        = 1 << 7,
+	CSQ_HONOR_SIZE_HINTS = 1 << 8,
+	CSQ_HIDDEN           = 1 << 9,
+	CSQ_STICKY           = 1 << 10,
+	CSQ_PRIVATE          = 1 << 11,
+	CSQ_LOCKED           = 1 << 12,
+	CSQ_MARKED           = 1 << 13,
+	CSQ_CENTER           = 1 << 14,
+	CSQ_FOLLOW           = 1 << 15,
+	CSQ_MANAGE           = 1 << 16,
+	CSQ_FOCUS            = 1 << 17,
+	CSQ_BORDER           = 1 << 18,
+};
+
+static uint32_t set_key_value(char *key, char *value, rule_consequence_t *csq);
+
+static uint32_t hash_name(const char *s)
+{
+	uint32_t h = 2166136261u;
+	while (*s != '\0') {
+		h = (h ^ (unsigned char) *s++) * 16777619u;
+	}
+	return h;
+}
+
+static rule_bucket_t *rule_bucket(rule_t *r)
+{
+	if (!streq(r->class_name, MATCH_ANY)) {
+		return &class_buckets[hash_name(r->class_name) % RULE_BUCKETS];
+	} else if (!streq(r->instance_name, MATCH_ANY)) {
+		return &instance_buckets[hash_name(r->instance_name) % RULE_BUCKETS];
+	} else {
+		return &wildcard_rules;
+	}
+}
+
+static void free_rule_effect(rule_t *r)
+{
+	rule_consequence_t *csq = r->effect_csq;
+	if (csq == NULL) {
+		return;
+	}
+	free(csq->split_dir);
+	free(csq->layer);
+	free(csq->state);
+	free(csq->rect);
+	free(csq);
+	r->effect_csq = NULL;
+}
+
+/* Parse the effect once, the same way parse_keys_values would, and
+ * remember which fields it sets. */
+static void compile_rule_effect(rule_t *r)
+{
+	r->effect_mask = 0;
+	r->effect_csq = calloc(1, sizeof(rule_consequence_t));
+	if (r->effect_csq == NULL) {
+		return;
+	}
+	r->effect_csq->honor_size_hints = HONOR_SIZE_HINTS_DEFAULT;
+	char effect[MAXLEN];
+	snprintf(effect, sizeof(effect), "%s", r->effect);
+	char *key = strtok(effect, CSQ_BLK);
+	char *value = strtok(NULL, CSQ_BLK);
+	while (key != NULL && value != NULL) {
+		r->effect_mask |= set_key_value(key, value, r->effect_csq);
+		key = strtok(NULL, CSQ_BLK);
+		value = strtok(NULL, CSQ_BLK);
+	}
+}
 
 rule_t *make_rule(void)
 {
@@ -48,6 +149,9 @@ rule_t *make_rule(void)
 	}
 	r->class_name[0] = r->instance_name[0] = r->name[0] = r->effect[0] = '\0';
 	r->next = r->prev = NULL;
+	r->bucket_next = r->bucket_prev = NULL;
+	r->effect_csq = NULL;
+	r->class_id = r->instance_id = NULL;
 	r->one_shot = false;
 	return r;
 }
@@ -61,6 +165,25 @@ void add_rule(rule_t *r)
 		r->prev = rule_tail;
 		rule_tail = r;
 	}
+	r->seq = rule_seq++;
+	compile_rule_effect(r);
+	if (!streq(r->class_name, MATCH_ANY)) {
+		r->class_id = intern(r->class_name);
+	}
+	if (!streq(r->instance_name, MATCH_ANY)) {
+		r->instance_id = intern(r->instance_name);
+	}
+	if (!streq(r->name, MATCH_ANY)) {
+		name_rules_count++;
+	}
+	rule_bucket_t *b = rule_bucket(r);
+	if (b->head == NULL) {
+		b->head = b->tail = r;
+	} else {
+		b->tail->bucket_next = r;
+		r->bucket_prev = b->tail;
+		b->tail = r;
+	}
 }
 
 void remove_rule(rule_t *r)
@@ -82,9 +205,33 @@ void remove_rule(rule_t *r)
 	if (r == rule_tail) {
 		rule_tail = prev;
 	}
+	rule_bucket_t *b = rule_bucket(r);
+	if (r->bucket_prev != NULL) {
+		r->bucket_prev->bucket_next = r->bucket_next;
+	}
+	if (r->bucket_next != NULL) {
+		r->bucket_next->bucket_prev = r->bucket_prev;
+	}
+	if (r == b->head) {
+		b->head = r->bucket_next;
+	}
+	if (r == b->tail) {
+		b->tail = r->bucket_prev;
+	}
+	if (!streq(r->name, MATCH_ANY)) {
+		name_rules_count--;
+	}
+	free_rule_effect(r);
+	intern_release(r->class_id);
+	intern_release(r->instance_id);
 	free(r);
 }
 
+bool rules_match_names(void)
+{
+	return name_rules_count > 0;
+}
+
 void remove_rule_by_cause(char *cause)
 {
     if (cause == NULL || strlen(cause) >= MAXLEN * 3) {
@@ -171,11 +318,53 @@ pending_rule_t *make_pending_rule(int fd, bspwm_wid_t win, rule_consequence_t *c
 	return pr;
 }
 
+/* Pending rules indexed by the read end of their pipe, the event loop
+ * looks them up once per ready descriptor. */
+static pending_rule_t **pending_rule_by_fd;
+static int pending_rule_by_fd_len;
+
+static void index_pending_rule(pending_rule_t *pr)
+{
+	if (pr->fd < 0) {
+		return;
+	}
+	if (pr->fd >= pending_rule_by_fd_len) {
+		int len = MAX(2 * pending_rule_by_fd_len, pr->fd + 1);
+		pending_rule_t **table = realloc(pending_rule_by_fd, len * sizeof(pending_rule_t *));
+		if (table == NULL) {
+			warn("Couldn't index pending rule.\n");
+			return;
+		}
+		memset(table + pending_rule_by_fd_len, 0, (len - pending_rule_by_fd_len) * sizeof(pending_rule_t *));
+		pending_rule_by_fd = table;
+		pending_rule_by_fd_len = len;
+	}
+	pending_rule_by_fd[pr->fd] = pr;
+}
+
+pending_rule_t *find_pending_rule(int fd)
+{
+	if (pending_rule_head == NULL || fd < 0) {
+		return NULL;
+	}
+	if (fd < pending_rule_by_fd_len && pending_rule_by_fd[fd] != NULL) {
+		return pending_rule_by_fd[fd];
+	}
+	/* Only reached for descriptors the table couldn't grow to hold */
+	for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
+		if (pr->fd == fd) {
+			return pr;
+		}
+	}
+	return NULL;
+}
+
 void add_pending_rule(pending_rule_t *pr)
 {
 	if (pr == NULL) {
 		return;
 	}
+	index_pending_rule(pr);
 	if (pending_rule_head == NULL) {
 		pending_rule_head = pending_rule_tail = pr;
 	} else {
@@ -183,8 +372,10 @@ void add_pending_rule(pending_rule_t *pr)
 		pr->prev = pending_rule_tail;
 		pending_rule_tail = pr;
 	}
-	struct epoll_event ev = { .events = EPOLLIN, .data.fd = pr->fd };
-	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pr->fd, &ev);
+	if (pr->fd >= 0) {
+		struct epoll_event ev = { .events = EPOLLIN, .data.fd = pr->fd };
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pr->fd, &ev);
+	}
 }
 
 void remove_pending_rule(pending_rule_t *pr)
@@ -206,8 +397,18 @@ void remove_pending_rule(pending_rule_t *pr)
 	if (pr == pending_rule_tail) {
 		pending_rule_tail = a;
 	}
-	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, pr->fd, NULL);
-	close(pr->fd);
+	if (pr->fd >= 0 && pr->fd < pending_rule_by_fd_len) {
+		pending_rule_by_fd[pr->fd] = NULL;
+	}
+	if (pending_rule_head == NULL) {
+		free(pending_rule_by_fd);
+		pending_rule_by_fd = NULL;
+		pending_rule_by_fd_len = 0;
+	}
+	if (pr->fd >= 0) {
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, pr->fd, NULL);
+		close(pr->fd);
+	}
 	free(pr->csq);
 	event_queue_t *eq = pr->event_head;
 	while (eq != NULL) {
@@ -218,6 +419,18 @@ void remove_pending_rule(pending_rule_t *pr)
 	free(pr);
 }
 
+/* Manage the window of a pending rule with the consequences gathered so
+ * far, replay the events received meanwhile and drop the rule. */
+void release_pending_rule(pending_rule_t *pr)
+{
+	if (manage_window(pr->win, pr->csq, pr->fd)) {
+		for (event_queue_t *eq = pr->event_head; eq != NULL; eq = eq->next) {
+			handle_event(eq->data);
+		}
+	}
+	remove_pending_rule(pr);
+}
+
 void postpone_event(pending_rule_t *pr, void *evt)
 {
 	event_queue_t *eq = make_event_queue(evt);
@@ -282,10 +495,11 @@ event_queue_t *make_event_queue(void *evt)
 
 void _apply_window_type(bspwm_wid_t win, rule_consequence_t *csq)
 {
-	bspwm_window_type_t type;
-	if (!backend_get_window_type(win, &type))
+	if (!csq->attrs.has_type)
 		return;
 
+	bspwm_window_type_t type = csq->attrs.type;
+
 	switch (type) {
 		case BSP_WINDOW_TYPE_TOOLBAR:
 		case BSP_WINDOW_TYPE_UTILITY:
@@ -309,59 +523,39 @@ void _apply_window_type(bspwm_wid_t win, rule_consequence_t *csq)
 
 void _apply_window_state(bspwm_wid_t win, rule_consequence_t *csq)
 {
-#ifdef BACKEND_X11
-	/* Query _NET_WM_STATE to set initial fullscreen/above/below/sticky */
-	xcb_ewmh_get_atoms_reply_t wm_state;
-	if (xcb_ewmh_get_wm_state_reply(ewmh, xcb_ewmh_get_wm_state(ewmh, win), &wm_state, NULL) == 1) {
-		for (unsigned int i = 0; i < wm_state.atoms_len; i++) {
-			xcb_atom_t a = wm_state.atoms[i];
-			if (a == ewmh->_NET_WM_STATE_FULLSCREEN) {
-				SET_CSQ_STATE(STATE_FULLSCREEN);
-			} else if (a == ewmh->_NET_WM_STATE_BELOW) {
-				SET_CSQ_LAYER(LAYER_BELOW);
-			} else if (a == ewmh->_NET_WM_STATE_ABOVE) {
-				SET_CSQ_LAYER(LAYER_ABOVE);
-			} else if (a == ewmh->_NET_WM_STATE_STICKY) {
-				csq->sticky = true;
-			}
-		}
-		xcb_ewmh_get_atoms_reply_wipe(&wm_state);
-	}
-#else
 	(void)win;
-	(void)csq;
-#endif
+	uint8_t state = csq->attrs.initial_state;
+	if (state & BSP_INITIAL_STATE_FULLSCREEN) {
+		SET_CSQ_STATE(STATE_FULLSCREEN);
+	}
+	if (state & BSP_INITIAL_STATE_BELOW) {
+		SET_CSQ_LAYER(LAYER_BELOW);
+	} else if (state & BSP_INITIAL_STATE_ABOVE) {
+		SET_CSQ_LAYER(LAYER_ABOVE);
+	}
+	if (state & BSP_INITIAL_STATE_STICKY) {
+		csq->sticky = true;
+	}
 }
 
 void _apply_transient(bspwm_wid_t win, rule_consequence_t *csq)
 {
-	bspwm_wid_t transient_for = BSPWM_WID_NONE;
-	if (backend_get_transient_for(win, &transient_for) && transient_for != BSPWM_WID_NONE) {
+	(void)win;
+	if (csq->attrs.transient_for != BSPWM_WID_NONE) {
 		SET_CSQ_STATE(STATE_FLOATING);
 	}
 }
 
 void _apply_hints(bspwm_wid_t win, rule_consequence_t *csq)
 {
-	bspwm_size_hints_t size_hints;
-	if (backend_get_size_hints(win, &size_hints)) {
-		if ((size_hints.flags & (BSP_SIZE_HINT_P_MIN_SIZE | BSP_SIZE_HINT_P_MAX_SIZE)) &&
-		    size_hints.min_width == size_hints.max_width && size_hints.min_height == size_hints.max_height) {
-			SET_CSQ_STATE(STATE_FLOATING);
-		}
+	(void)win;
+	bspwm_size_hints_t *size_hints = &csq->attrs.size_hints;
+	if ((size_hints->flags & (BSP_SIZE_HINT_P_MIN_SIZE | BSP_SIZE_HINT_P_MAX_SIZE)) &&
+	    size_hints->min_width == size_hints->max_width && size_hints->min_height == size_hints->max_height) {
+		SET_CSQ_STATE(STATE_FLOATING);
 	}
 }
 
-void _apply_class(bspwm_wid_t win, rule_consequence_t *csq)
-{
-	backend_get_window_class(win, csq->class_name, csq->instance_name, sizeof(csq->class_name));
-}
-
-void _apply_name(bspwm_wid_t win, rule_consequence_t *csq)
-{
-	backend_get_window_name(win, csq->name, sizeof(csq->name));
-}
-
 void parse_keys_values(char *buf, rule_consequence_t *csq)
 {
     if (buf == NULL)
@@ -371,9 +565,12 @@ void parse_keys_values(char *buf, rule_consequence_t *csq)
     if (len >= BUFSIZ)
         return;
 
-    char *buf_copy = malloc(len + 1);
-    if (buf_copy == NULL)
+    scratch_mark_t mark = scratch_mark();
+    char *buf_copy = scratch_alloc(len + 1);
+    if (buf_copy == NULL) {
+        scratch_release(mark);
         return;
+    }
 
     memcpy(buf_copy, buf, len);
     buf_copy[len] = '\0';
@@ -389,35 +586,319 @@ void parse_keys_values(char *buf, rule_consequence_t *csq)
         value = strtok(NULL, CSQ_BLK);
     }
 
-    free(buf_copy);
+    scratch_release(mark);
+}
+
+
+/* Copy the fields a compiled effect sets into the consequence. */
+static void apply_rule_effect(rule_t *rule, rule_consequence_t *csq)
+{
+	rule_consequence_t *eff = rule->effect_csq;
+	uint32_t mask = rule->effect_mask;
+	if (eff == NULL) {
+		char effect[MAXLEN];
+		snprintf(effect, sizeof(effect), "%s", rule->effect);
+		parse_keys_values(effect, csq);
+		return;
+	}
+	if (mask & CSQ_MONITOR) {
+		snprintf(csq->monitor_desc, sizeof(csq->monitor_desc), "%s", eff->monitor_desc);
+	}
+	if (mask & CSQ_DESKTOP) {
+		snprintf(csq->desktop_desc, sizeof(csq->desktop_desc), "%s", eff->desktop_desc);
+	}
+	if (mask & CSQ_NODE) {
+		snprintf(csq->node_desc, sizeof(csq->node_desc), "%s", eff->node_desc);
+	}
+	if (mask & CSQ_SPLIT_DIR) {
+		SET_CSQ_SPLIT_DIR(*eff->split_dir);
+	}
+	if (mask & CSQ_STATE) {
+		SET_CSQ_STATE(*eff->state);
+	}
+	if (mask & CSQ_LAYER) {
+		SET_CSQ_LAYER(*eff->layer);
+	}
+	if (mask & CSQ_SPLIT_RATIO) {
+		csq->split_ratio = eff->split_ratio;
+	}
+	if (mask & CSQ_RECTANGLE) {
+		if (eff->rect == NULL) {
+			free(csq->rect);
+			csq->rect = NULL;
+		} else {
+			if (csq->rect == NULL) {
+				csq->rect = malloc(sizeof(bspwm_rect_t));
+			}
+			if (csq->rect != NULL) {
+				*csq->rect = *eff->rect;
+			}
+		}
+	}
+	if (mask & CSQ_HONOR_SIZE_HINTS) {
+		csq->honor_size_hints = eff->honor_size_hints;
+	}
+#define COPYCSQ(name, bit) \
+	if (mask & bit) { \
+		csq->name = eff->name; \
+	}
+	COPYCSQ(hidden, CSQ_HIDDEN)
+	COPYCSQ(sticky, CSQ_STICKY)
+	COPYCSQ(private, CSQ_PRIVATE)
+	COPYCSQ(locked, CSQ_LOCKED)
+	COPYCSQ(marked, CSQ_MARKED)
+	COPYCSQ(center, CSQ_CENTER)
+	COPYCSQ(follow, CSQ_FOLLOW)
+	COPYCSQ(manage, CSQ_MANAGE)
+	COPYCSQ(focus, CSQ_FOCUS)
+	COPYCSQ(border, CSQ_BORDER)
+#undef COPYCSQ
 }
 
+/* Interned rule names match by pointer: a window name that isn't
+ * interned matches no rule naming it. */
+static bool rule_name_matches(const char *rule_name, const char *rule_id, const char *name, const char *id)
+{
+	if (rule_id != NULL) {
+		return rule_id == id;
+	}
+	return streq(rule_name, MATCH_ANY) || streq(rule_name, name);
+}
 
 void apply_rules(bspwm_wid_t win, rule_consequence_t *csq)
 {
-	/* Query window properties via backend */
 	_apply_window_type(win, csq);
 	_apply_window_state(win, csq);
 	_apply_transient(win, csq);
 	_apply_hints(win, csq);
-	_apply_class(win, csq);
-	_apply_name(win, csq);
-
-	rule_t *rule = rule_head;
-	while (rule != NULL) {
-		rule_t *next = rule->next;
-		if ((streq(rule->class_name, MATCH_ANY) || streq(rule->class_name, csq->class_name)) &&
-		    (streq(rule->instance_name, MATCH_ANY) || streq(rule->instance_name, csq->instance_name)) &&
+
+	/* Visit the candidate buckets in insertion order, as if walking the
+	 * whole rule list. */
+	const char *class_id = intern_find(csq->class_name);
+	const char *instance_id = intern_find(csq->instance_name);
+	rule_t *cur[] = {
+		class_buckets[hash_name(csq->class_name) % RULE_BUCKETS].head,
+		instance_buckets[hash_name(csq->instance_name) % RULE_BUCKETS].head,
+		wildcard_rules.head,
+	};
+	while (true) {
+		size_t k = LENGTH(cur);
+		for (size_t i = 0; i < LENGTH(cur); i++) {
+			if (cur[i] != NULL && (k == LENGTH(cur) || cur[i]->seq < cur[k]->seq)) {
+				k = i;
+			}
+		}
+		if (k == LENGTH(cur)) {
+			break;
+		}
+		rule_t *rule = cur[k];
+		cur[k] = rule->bucket_next;
+		if (rule_name_matches(rule->class_name, rule->class_id, csq->class_name, class_id) &&
+		    rule_name_matches(rule->instance_name, rule->instance_id, csq->instance_name, instance_id) &&
 		    (streq(rule->name, MATCH_ANY) || streq(rule->name, csq->name))) {
-			char effect[MAXLEN];
-			snprintf(effect, sizeof(effect), "%s", rule->effect);
-			parse_keys_values(effect, csq);
+			apply_rule_effect(rule, csq);
 			if (rule->one_shot) {
 				remove_rule(rule);
 				break;
 			}
 		}
-		rule = next;
+	}
+}
+
+/* The persistent rules command started when external_rules_daemon is set.
+ * Requests are written to its standard input, one per line:
+ * <wid>\t<class>\t<instance>\t<consequences>, and it answers each of
+ * them, in any order, with a <wid> <key=value ...> line. */
+static struct {
+	int in_fd;
+	int out_fd;
+	size_t len;
+	char buf[BUFSIZ];
+} rule_daemon = {.in_fd = -1, .out_fd = -1};
+
+static bool start_rule_daemon(void)
+{
+	int req[2], rsp[2];
+	if (pipe(req) == -1) {
+		return false;
+	}
+	if (pipe(rsp) == -1) {
+		close(req[0]);
+		close(req[1]);
+		return false;
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		int dpy_fd = backend_get_fd();
+		if (dpy_fd >= 0) {
+			close(dpy_fd);
+		}
+		dup2(req[0], 0);
+		dup2(rsp[1], 1);
+		close(req[0]);
+		close(req[1]);
+		close(rsp[0]);
+		close(rsp[1]);
+		setsid();
+		execl(external_rules_command, external_rules_command, NULL);
+		err("Couldn't spawn rule daemon.\n");
+	}
+	close(req[0]);
+	close(rsp[1]);
+	if (pid == -1) {
+		close(req[1]);
+		close(rsp[0]);
+		return false;
+	}
+	rule_daemon.in_fd = req[1];
+	rule_daemon.out_fd = rsp[0];
+	rule_daemon.len = 0;
+	fcntl(rule_daemon.in_fd, F_SETFD, FD_CLOEXEC);
+	fcntl(rule_daemon.out_fd, F_SETFD, FD_CLOEXEC);
+	fcntl(rule_daemon.in_fd, F_SETFL, O_NONBLOCK | fcntl(rule_daemon.in_fd, F_GETFL));
+	fcntl(rule_daemon.out_fd, F_SETFL, O_NONBLOCK | fcntl(rule_daemon.out_fd, F_GETFL));
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = rule_daemon.out_fd };
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, rule_daemon.out_fd, &ev);
+	return true;
+}
+
+/* Closing its standard input tells the daemon to exit, the rules still
+ * waiting for an answer fall back to the built-in consequences when
+ * they time out. */
+void stop_rule_daemon(void)
+{
+	if (rule_daemon.out_fd == -1) {
+		return;
+	}
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, rule_daemon.out_fd, NULL);
+	close(rule_daemon.in_fd);
+	close(rule_daemon.out_fd);
+	rule_daemon.in_fd = rule_daemon.out_fd = -1;
+	rule_daemon.len = 0;
+}
+
+bool is_rule_daemon_fd(int fd)
+{
+	return fd == rule_daemon.out_fd;
+}
+
+/* Copy a field of a request, the separators can't appear in it. */
+static void copy_request_field(char *dst, size_t size, const char *src)
+{
+	snprintf(dst, size, "%s", src);
+	for (char *c = dst; *c != '\0'; c++) {
+		if (*c == '\t' || *c == '\n') {
+			*c = ' ';
+		}
+	}
+}
+
+static bool query_rule_daemon(bspwm_wid_t win, rule_consequence_t *csq)
+{
+	if (rule_daemon.out_fd == -1 && !start_rule_daemon()) {
+		return false;
+	}
+	char class_name[MAXLEN], instance_name[MAXLEN];
+	char *csq_buf = NULL;
+	copy_request_field(class_name, sizeof(class_name), csq->class_name);
+	copy_request_field(instance_name, sizeof(instance_name), csq->instance_name);
+	scratch_mark_t mark = scratch_mark();
+	print_rule_consequence(&csq_buf, csq);
+	if (csq_buf == NULL) {
+		scratch_release(mark);
+		return false;
+	}
+	/* Writes of at most PIPE_BUF bytes are atomic: a request is either
+	 * queued whole or not at all. */
+	char line[PIPE_BUF];
+	int len = snprintf(line, sizeof(line), "%i\t%s\t%s\t%s\n", win, class_name, instance_name, csq_buf);
+	scratch_release(mark);
+	if (len < 0 || (size_t) len >= sizeof(line) || write(rule_daemon.in_fd, line, len) != len) {
+		return false;
+	}
+	pending_rule_t *pr = make_pending_rule(-1, win, csq);
+	if (pr == NULL) {
+		return false;
+	}
+	pr->deadline = get_time_ms() + external_rules_timeout;
+	add_pending_rule(pr);
+	return true;
+}
+
+static void handle_rule_daemon_line(char *line)
+{
+	char *end;
+	bspwm_wid_t win = strtoul(line, &end, 0);
+	if (end == line) {
+		return;
+	}
+	for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
+		if (pr->fd == -1 && pr->win == win) {
+			parse_keys_values(end, pr->csq);
+			release_pending_rule(pr);
+			return;
+		}
+	}
+}
+
+void read_rule_daemon(void)
+{
+	ssize_t n = read(rule_daemon.out_fd, rule_daemon.buf + rule_daemon.len, sizeof(rule_daemon.buf) - 1 - rule_daemon.len);
+	if (n == 0 || (n == -1 && errno != EAGAIN && errno != EINTR)) {
+		warn("The rule daemon exited.\n");
+		stop_rule_daemon();
+		release_expired_rules(true);
+		return;
+	} else if (n == -1) {
+		return;
+	}
+	rule_daemon.len += n;
+	rule_daemon.buf[rule_daemon.len] = '\0';
+	char *line = rule_daemon.buf;
+	char *eol;
+	while ((eol = strchr(line, '\n')) != NULL) {
+		*eol = '\0';
+		handle_rule_daemon_line(line);
+		line = eol + 1;
+	}
+	rule_daemon.len -= line - rule_daemon.buf;
+	if (rule_daemon.len == sizeof(rule_daemon.buf) - 1) {
+		warn("Dropping an overlong rule daemon answer.\n");
+		rule_daemon.len = 0;
+	}
+	memmove(rule_daemon.buf, line, rule_daemon.len);
+}
+
+/* Milliseconds until the first rule waiting on the daemon times out, -1
+ * if there's none. */
+int pending_rules_timeout(void)
+{
+	uint64_t now = get_time_ms();
+	int timeout = -1;
+	for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
+		if (pr->fd != -1) {
+			continue;
+		}
+		int left = pr->deadline > now ? (int) MIN(pr->deadline - now, (uint64_t) INT_MAX) : 0;
+		if (timeout == -1 || left < timeout) {
+			timeout = left;
+		}
+	}
+	return timeout;
+}
+
+/* Manage the windows whose daemon answer is overdue (or still missing if
+ * all is set) with the built-in consequences. */
+void release_expired_rules(bool all)
+{
+	uint64_t now = get_time_ms();
+	pending_rule_t *pr = pending_rule_head;
+	while (pr != NULL) {
+		pending_rule_t *next = pr->next;
+		if (pr->fd == -1 && (all || pr->deadline <= now)) {
+			release_pending_rule(pr);
+		}
+		pr = next;
 	}
 }
 
@@ -427,6 +908,10 @@ bool schedule_rules(bspwm_wid_t win, rule_consequence_t *csq)
 		return false;
 	}
 	resolve_rule_consequence(csq);
+	if (external_rules_daemon) {
+		return query_rule_daemon(win, csq);
+	}
+	uint64_t start = latency_now();
 	int fds[2];
 	if (pipe(fds) == -1) {
 		return false;
@@ -445,12 +930,12 @@ bool schedule_rules(bspwm_wid_t win, rule_consequence_t *csq)
 		snprintf(wid, sizeof(wid), "%i", win);
 		setsid();
 		execl(external_rules_command, external_rules_command, wid, csq->class_name, csq->instance_name, csq_buf, NULL);
-		free(csq_buf);
 		err("Couldn't spawn rule command.\n");
 	} else if (pid > 0) {
 		close(fds[1]);
 		pending_rule_t *pr = make_pending_rule(fds[0], win, csq);
 		add_pending_rule(pr);
+		trace_record(TRACE_RULES, "spawn", start, latency_now(), win);
 	}
 	return (pid != -1);
 }
@@ -479,33 +964,46 @@ void parse_rule_consequence(int fd, rule_consequence_t *csq)
 }
 
 void parse_key_value(char *key, char *value, rule_consequence_t *csq)
+{
+	set_key_value(key, value, csq);
+}
+
+/* Returns the field that was set, if any. */
+static uint32_t set_key_value(char *key, char *value, rule_consequence_t *csq)
 {
 	bool v;
 	if (streq("monitor", key)) {
 		snprintf(csq->monitor_desc, sizeof(csq->monitor_desc), "%s", value);
+		return CSQ_MONITOR;
 	} else if (streq("desktop", key)) {
 		snprintf(csq->desktop_desc, sizeof(csq->desktop_desc), "%s", value);
+		return CSQ_DESKTOP;
 	} else if (streq("node", key)) {
 		snprintf(csq->node_desc, sizeof(csq->node_desc), "%s", value);
+		return CSQ_NODE;
 	} else if (streq("split_dir", key)) {
 		direction_t dir;
 		if (parse_direction(value, &dir)) {
 			SET_CSQ_SPLIT_DIR(dir);
+			return csq->split_dir != NULL ? CSQ_SPLIT_DIR : 0;
 		}
 	} else if (streq("state", key)) {
 		client_state_t cst;
 		if (parse_client_state(value, &cst)) {
 			SET_CSQ_STATE(cst);
+			return csq->state != NULL ? CSQ_STATE : 0;
 		}
 	} else if (streq("layer", key)) {
 		stack_layer_t lyr;
 		if (parse_stack_layer(value, &lyr)) {
 			SET_CSQ_LAYER(lyr);
+			return csq->layer != NULL ? CSQ_LAYER : 0;
 		}
 	} else if (streq("split_ratio", key)) {
 		double rat;
 		if (sscanf(value, "%lf", &rat) == 1 && rat > 0 && rat < 1) {
 			csq->split_ratio = rat;
+			return CSQ_SPLIT_RATIO;
 		}
 	} else if (streq("rectangle", key)) {
 		if (csq->rect == NULL) {
@@ -515,29 +1013,34 @@ void parse_key_value(char *key, char *value, rule_consequence_t *csq)
 			free(csq->rect);
 			csq->rect = NULL;
 		}
+		return CSQ_RECTANGLE;
 	} else if (streq("honor_size_hints", key)) {
 		if (!parse_honor_size_hints_mode(value, &csq->honor_size_hints)) {
 			csq->honor_size_hints = HONOR_SIZE_HINTS_DEFAULT;
 		}
+		return CSQ_HONOR_SIZE_HINTS;
 	} else if (parse_bool(value, &v)) {
 		if (streq("hidden", key)) {
 			csq->hidden = v;
+			return CSQ_HIDDEN;
 		}
-#define SETCSQ(name) \
+#define SETCSQ(name, bit) \
 		else if (streq(#name, key)) { \
 			csq->name = v; \
+			return bit; \
 		}
-		SETCSQ(sticky)
-		SETCSQ(private)
-		SETCSQ(locked)
-		SETCSQ(marked)
-		SETCSQ(center)
-		SETCSQ(follow)
-		SETCSQ(manage)
-		SETCSQ(focus)
-		SETCSQ(border)
+		SETCSQ(sticky, CSQ_STICKY)
+		SETCSQ(private, CSQ_PRIVATE)
+		SETCSQ(locked, CSQ_LOCKED)
+		SETCSQ(marked, CSQ_MARKED)
+		SETCSQ(center, CSQ_CENTER)
+		SETCSQ(follow, CSQ_FOLLOW)
+		SETCSQ(manage, CSQ_MANAGE)
+		SETCSQ(focus, CSQ_FOCUS)
+		SETCSQ(border, CSQ_BORDER)
 #undef SETCSQ
 	}
+	return 0;
 }
 
 #undef SET_CSQ_LAYER
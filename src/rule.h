@@ -28,25 +28,34 @@
 #define MATCH_ANY  "*"
 #define CSQ_BLK    " =,\n"
 
+#define RULE_BUCKETS  64
+
 rule_t *make_rule(void);
 void add_rule(rule_t *r);
 void remove_rule(rule_t *r);
+/* Whether a rule matches window titles, which are fetched for it. */
+bool rules_match_names(void);
 void remove_rule_by_cause(char *cause);
 bool remove_rule_by_index(int idx);
 rule_consequence_t *make_rule_consequence(void);
 pending_rule_t *make_pending_rule(int fd, bspwm_wid_t win, rule_consequence_t *csq);
 void add_pending_rule(pending_rule_t *pr);
+pending_rule_t *find_pending_rule(int fd);
 void remove_pending_rule(pending_rule_t *pr);
+void release_pending_rule(pending_rule_t *pr);
 void postpone_event(pending_rule_t *pr, void *evt);
 event_queue_t *make_event_queue(void *evt);
 void _apply_window_type(bspwm_wid_t win, rule_consequence_t *csq);
 void _apply_window_state(bspwm_wid_t win, rule_consequence_t *csq);
 void _apply_transient(bspwm_wid_t win, rule_consequence_t *csq);
 void _apply_hints(bspwm_wid_t win, rule_consequence_t *csq);
-void _apply_class(bspwm_wid_t win, rule_consequence_t *csq);
-void _apply_name(bspwm_wid_t win, rule_consequence_t *csq);
 void parse_keys_values(char *buf, rule_consequence_t *csq);
 void apply_rules(bspwm_wid_t win, rule_consequence_t *csq);
+void stop_rule_daemon(void);
+bool is_rule_daemon_fd(int fd);
+void read_rule_daemon(void);
+int pending_rules_timeout(void);
+void release_expired_rules(bool all);
 bool schedule_rules(bspwm_wid_t win, rule_consequence_t *csq);
 void parse_rule_consequence(int fd, rule_consequence_t *csq);
 void parse_key_value(char *key, char *value, rule_consequence_t *csq);
@@ -29,7 +29,10 @@
 #include "settings.h"
 
 char external_rules_command[MAXLEN];
+bool external_rules_daemon;
+uint32_t external_rules_timeout;
 char status_prefix[MAXLEN];
+uint32_t history_size;
 
 char normal_border_color[MAXLEN];
 char active_border_color[MAXLEN];
@@ -45,9 +48,11 @@ child_polarity_t initial_polarity;
 automatic_scheme_t automatic_scheme;
 bool removal_adjustment;
 tightness_t directional_focus_tightness;
+subscriber_overflow_t subscriber_overflow;
 
 uint16_t pointer_modifier;
 uint32_t pointer_motion_interval;
+bool pointer_motion_sync;
 pointer_action_t pointer_actions[3];
 int8_t mapping_events_count;
 
@@ -67,9 +72,12 @@ bool ignore_ewmh_struts;
 state_transition_t ignore_ewmh_fullscreen;
 bool center_pseudo_tiled;
 honor_size_hints_mode_t honor_size_hints;
+bool composited_switching;
+int configure_rate_limit;
 bool remove_disabled_monitors;
 bool remove_unplugged_monitors;
 bool merge_overlapping_monitors;
+bool adaptive_sync;
 
 bool tile_limit_enabled;
 int max_tiles_per_desktop;
@@ -98,7 +106,10 @@ void run_config(int run_level)
 void load_settings(void)
 {
 	snprintf(external_rules_command, sizeof(external_rules_command), "%s", EXTERNAL_RULES_COMMAND);
+	external_rules_daemon = EXTERNAL_RULES_DAEMON;
+	external_rules_timeout = EXTERNAL_RULES_TIMEOUT;
 	snprintf(status_prefix, sizeof(status_prefix), "%s", STATUS_PREFIX);
+	history_size = HISTORY_SIZE;
 
 	snprintf(normal_border_color, sizeof(normal_border_color), "%s", NORMAL_BORDER_COLOR);
 	snprintf(active_border_color, sizeof(active_border_color), "%s", ACTIVE_BORDER_COLOR);
@@ -114,9 +125,11 @@ void load_settings(void)
 	automatic_scheme = AUTOMATIC_SCHEME;
 	removal_adjustment = REMOVAL_ADJUSTMENT;
 	directional_focus_tightness = TIGHTNESS_HIGH;
+	subscriber_overflow = SUBSCRIBER_OVERFLOW;
 
 	pointer_modifier = POINTER_MODIFIER;
 	pointer_motion_interval = POINTER_MOTION_INTERVAL;
+	pointer_motion_sync = POINTER_MOTION_SYNC;
 	pointer_actions[0] = ACTION_MOVE;
 	pointer_actions[1] = ACTION_RESIZE_SIDE;
 	pointer_actions[2] = ACTION_RESIZE_CORNER;
@@ -138,9 +151,12 @@ void load_settings(void)
 	ignore_ewmh_struts = IGNORE_EWMH_STRUTS;
 	center_pseudo_tiled = CENTER_PSEUDO_TILED;
 	honor_size_hints = HONOR_SIZE_HINTS;
+	composited_switching = COMPOSITED_SWITCHING;
+	configure_rate_limit = CONFIGURE_RATE_LIMIT;
 	remove_disabled_monitors = REMOVE_DISABLED_MONITORS;
 	remove_unplugged_monitors = REMOVE_UNPLUGGED_MONITORS;
 	merge_overlapping_monitors = MERGE_OVERLAPPING_MONITORS;
+	adaptive_sync = ADAPTIVE_SYNC;
 
 	tile_limit_enabled = TILE_LIMIT_ENABLED;
 	max_tiles_per_desktop = MAX_TILES_PER_DESKTOP;
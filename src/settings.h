@@ -29,8 +29,12 @@
 
 #define POINTER_MODIFIER         BSP_MOD_MASK_4
 #define POINTER_MOTION_INTERVAL  17
+#define POINTER_MOTION_SYNC      false
 #define EXTERNAL_RULES_COMMAND   ""
+#define EXTERNAL_RULES_DAEMON    false
+#define EXTERNAL_RULES_TIMEOUT   500
 #define STATUS_PREFIX            "W"
+#define HISTORY_SIZE             2048
 
 #define NORMAL_BORDER_COLOR           "#30302f"
 #define ACTIVE_BORDER_COLOR           "#474645"
@@ -43,6 +47,7 @@
 #define BORDER_WIDTH         1
 #define SPLIT_RATIO          0.5
 #define AUTOMATIC_SCHEME     SCHEME_LONGEST_SIDE
+#define SUBSCRIBER_OVERFLOW  OVERFLOW_COALESCE
 #define REMOVAL_ADJUSTMENT   true
 
 #define PRESEL_FEEDBACK             true
@@ -63,10 +68,13 @@
 #define CENTER_PSEUDO_TILED         true
 #define HONOR_SIZE_HINTS            HONOR_SIZE_HINTS_NO
 #define MAPPING_EVENTS_COUNT        1
+#define COMPOSITED_SWITCHING        false
+#define CONFIGURE_RATE_LIMIT        120
 
 #define REMOVE_DISABLED_MONITORS    false
 #define REMOVE_UNPLUGGED_MONITORS   false
 #define MERGE_OVERLAPPING_MONITORS  false
+#define ADAPTIVE_SYNC               false
 
 #define TILE_LIMIT_ENABLED          false
 #define MAX_TILES_PER_DESKTOP       8
@@ -78,7 +86,11 @@
 #define CASCADE_OFFSET              20
 
 extern char external_rules_command[MAXLEN];
+extern bool external_rules_daemon;
+extern uint32_t external_rules_timeout;
 extern char status_prefix[MAXLEN];
+extern uint32_t history_size;
+extern subscriber_overflow_t subscriber_overflow;
 
 extern char normal_border_color[MAXLEN];
 extern char active_border_color[MAXLEN];
@@ -97,6 +109,7 @@ extern tightness_t directional_focus_tightness;
 
 extern uint16_t pointer_modifier;
 extern uint32_t pointer_motion_interval;
+extern bool pointer_motion_sync;
 extern pointer_action_t pointer_actions[3];
 extern int8_t mapping_events_count;
 
@@ -117,10 +130,13 @@ extern state_transition_t ignore_ewmh_fullscreen;
 
 extern bool center_pseudo_tiled;
 extern honor_size_hints_mode_t honor_size_hints;
+extern bool composited_switching;
+extern int configure_rate_limit;
 
 extern bool remove_disabled_monitors;
 extern bool remove_unplugged_monitors;
 extern bool merge_overlapping_monitors;
+extern bool adaptive_sync;
 
 extern bool tile_limit_enabled;
 extern int max_tiles_per_desktop;
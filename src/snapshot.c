@@ -0,0 +1,565 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bspwm.h"
+#include "desktop.h"
+#include "history.h"
+#include "lookup.h"
+#include "monitor.h"
+#include "query.h"
+#include "restore.h"
+#include "stack.h"
+#include "subscribe.h"
+#include "tree.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_BYTE_ORDER  0x01020304
+#define MAX_TREE_DEPTH       256
+
+static const uint16_t record_sizes[8] = {
+	sizeof(snapshot_monitor_t),
+	sizeof(snapshot_desktop_t),
+	sizeof(snapshot_node_t),
+	sizeof(snapshot_client_t),
+	sizeof(snapshot_coordinates_t),
+	sizeof(snapshot_subscriber_t),
+	sizeof(uint32_t),
+	0,
+};
+
+typedef struct {
+	uint8_t *data;
+	size_t len;
+	size_t cap;
+	bool failed;
+} snapshot_writer_t;
+
+typedef struct {
+	const uint8_t *pos;
+	const uint8_t *end;
+	bool failed;
+} snapshot_reader_t;
+
+static void put(snapshot_writer_t *w, const void *src, size_t len)
+{
+	if (w->failed) {
+		return;
+	}
+	if (w->len + len > w->cap) {
+		size_t cap = w->cap > 0 ? w->cap : BUFSIZ;
+		while (cap < w->len + len) {
+			if (!safe_double(&cap)) {
+				w->failed = true;
+				return;
+			}
+		}
+		uint8_t *data = realloc(w->data, cap);
+		if (data == NULL) {
+			w->failed = true;
+			return;
+		}
+		w->data = data;
+		w->cap = cap;
+	}
+	memcpy(w->data + w->len, src, len);
+	w->len += len;
+}
+
+static bool get(snapshot_reader_t *r, void *dst, size_t len)
+{
+	if (r->failed || (size_t) (r->end - r->pos) < len) {
+		r->failed = true;
+		return false;
+	}
+	memcpy(dst, r->pos, len);
+	r->pos += len;
+	return true;
+}
+
+static void write_node(snapshot_writer_t *w, node_t *n)
+{
+	snapshot_node_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.id = n->id;
+	rec.split_ratio = n->split_ratio;
+	rec.rectangle = n->rectangle;
+	rec.constraints = n->constraints;
+	rec.split_type = n->split_type;
+	rec.vacant = n->vacant;
+	rec.hidden = n->hidden;
+	rec.sticky = n->sticky;
+	rec.private = n->private;
+	rec.locked = n->locked;
+	rec.marked = n->marked;
+	if (n->presel != NULL) {
+		rec.contents |= SNAPSHOT_PRESEL;
+		rec.presel_dir = n->presel->split_dir;
+		rec.presel_ratio = n->presel->split_ratio;
+	}
+	if (n->first_child != NULL) {
+		rec.contents |= SNAPSHOT_FIRST_CHILD;
+	}
+	if (n->second_child != NULL) {
+		rec.contents |= SNAPSHOT_SECOND_CHILD;
+	}
+	if (n->client != NULL) {
+		rec.contents |= SNAPSHOT_CLIENT;
+	}
+	put(w, &rec, sizeof(rec));
+
+	if (n->client != NULL) {
+		client_t *c = n->client;
+		snapshot_client_t crec;
+		memset(&crec, 0, sizeof(crec));
+		snprintf(crec.class_name, sizeof(crec.class_name), "%s", c->class_name);
+		snprintf(crec.instance_name, sizeof(crec.instance_name), "%s", c->instance_name);
+		crec.border_width = c->border_width;
+		crec.tiled_rectangle = c->tiled_rectangle;
+		crec.floating_rectangle = c->floating_rectangle;
+		crec.state = c->state;
+		crec.last_state = c->last_state;
+		crec.layer = c->layer;
+		crec.last_layer = c->last_layer;
+		crec.urgent = c->urgent;
+		crec.shown = c->shown;
+		put(w, &crec, sizeof(crec));
+	}
+
+	if (n->first_child != NULL) {
+		write_node(w, n->first_child);
+	}
+	if (n->second_child != NULL) {
+		write_node(w, n->second_child);
+	}
+}
+
+bool write_snapshot(const char *file_path)
+{
+	snapshot_writer_t w = {0};
+	snapshot_header_t hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAPSHOT_VERSION;
+	hdr.byte_order = SNAPSHOT_BYTE_ORDER;
+	memcpy(hdr.record_sizes, record_sizes, sizeof(hdr.record_sizes));
+	hdr.focused_monitor_id = mon != NULL ? mon->id : 0;
+	hdr.primary_monitor_id = pri_mon != NULL ? pri_mon->id : 0;
+	put(&w, &hdr, sizeof(hdr));
+
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		snapshot_monitor_t mrec;
+		memset(&mrec, 0, sizeof(mrec));
+		snprintf(mrec.name, sizeof(mrec.name), "%s", m->name);
+		mrec.id = m->id;
+		mrec.output_id = m->output_id;
+		mrec.sticky_count = m->sticky_count;
+		mrec.window_gap = m->window_gap;
+		mrec.border_width = m->border_width;
+		mrec.focused_desktop_id = m->desk != NULL ? m->desk->id : 0;
+		mrec.padding = m->padding;
+		mrec.rectangle = m->rectangle;
+		mrec.wired = m->wired;
+		mrec.adaptive_sync = m->adaptive_sync;
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			mrec.desktops_count++;
+		}
+		put(&w, &mrec, sizeof(mrec));
+		hdr.monitors_count++;
+
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			snapshot_desktop_t drec;
+			memset(&drec, 0, sizeof(drec));
+			snprintf(drec.name, sizeof(drec.name), "%s", d->name);
+			drec.id = d->id;
+			drec.focused_node_id = d->focus != NULL ? d->focus->id : 0;
+			drec.window_gap = d->window_gap;
+			drec.border_width = d->border_width;
+			drec.padding = d->padding;
+			drec.layout = d->layout;
+			drec.user_layout = d->user_layout;
+			drec.has_root = d->root != NULL;
+			put(&w, &drec, sizeof(drec));
+			if (d->root != NULL) {
+				write_node(&w, d->root);
+			}
+		}
+	}
+
+	for (history_t *h = history_head; h != NULL; h = h->next) {
+		snapshot_coordinates_t loc = {
+			h->loc.monitor->id,
+			h->loc.desktop->id,
+			h->loc.node != NULL ? h->loc.node->id : 0,
+		};
+		put(&w, &loc, sizeof(loc));
+		hdr.history_count++;
+	}
+
+	for (stacking_list_t *s = stack_head; s != NULL; s = s->next) {
+		uint32_t id = s->node->id;
+		put(&w, &id, sizeof(id));
+		hdr.stack_count++;
+	}
+
+	for (subscriber_list_t *sb = subscribe_head; sb != NULL; sb = sb->next) {
+		snapshot_subscriber_t srec;
+		memset(&srec, 0, sizeof(srec));
+		srec.fd = sb->stream != NULL ? fileno(sb->stream) : -1;
+		srec.field = sb->field;
+		srec.count = sb->count;
+		srec.fifo_path_len = sb->fifo_path != NULL ? strlen(sb->fifo_path) : 0;
+		srec.monitor_id = sb->monitor_id;
+		srec.desktop_id = sb->desktop_id;
+		srec.node_id = sb->node_id;
+		snprintf(srec.subtype, sizeof(srec.subtype), "%s", sb->subtype);
+		srec.json = sb->json;
+		put(&w, &srec, sizeof(srec));
+		if (srec.fifo_path_len > 0) {
+			put(&w, sb->fifo_path, srec.fifo_path_len);
+		}
+		hdr.subscribers_count++;
+	}
+
+	if (w.failed) {
+		free(w.data);
+		return false;
+	}
+
+	hdr.size = w.len;
+	memcpy(w.data, &hdr, sizeof(hdr));
+
+	int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		perror("Write snapshot: open");
+		free(w.data);
+		return false;
+	}
+	size_t done = 0;
+	while (done < w.len) {
+		ssize_t n = write(fd, w.data + done, w.len - done);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("Write snapshot: write");
+			break;
+		}
+		done += (size_t) n;
+	}
+	close(fd);
+	free(w.data);
+	return done == w.len;
+}
+
+bool is_snapshot(const char *file_path)
+{
+	char magic[sizeof(((snapshot_header_t *) NULL)->magic)];
+	int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	bool ok = read(fd, magic, sizeof(magic)) == (ssize_t) sizeof(magic) &&
+	          memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+	close(fd);
+	return ok;
+}
+
+static node_t *read_node(snapshot_reader_t *r, int depth)
+{
+	snapshot_node_t rec;
+	if (depth > MAX_TREE_DEPTH || !get(r, &rec, sizeof(rec))) {
+		r->failed = true;
+		return NULL;
+	}
+
+	node_t *n;
+	if (rec.contents & SNAPSHOT_CLIENT) {
+		snapshot_client_t crec;
+		if (!get(r, &crec, sizeof(crec)) ||
+		    crec.state > STATE_FULLSCREEN || crec.last_state > STATE_FULLSCREEN ||
+		    crec.layer > LAYER_ABOVE || crec.last_layer > LAYER_ABOVE ||
+		    (n = make_leaf(UINT32_MAX)) == NULL) {
+			r->failed = true;
+			return NULL;
+		}
+		client_t *c = n->client;
+		crec.class_name[sizeof(crec.class_name) - 1] = '\0';
+		crec.instance_name[sizeof(crec.instance_name) - 1] = '\0';
+		set_client_class(c, crec.class_name, crec.instance_name);
+		c->border_width = crec.border_width;
+		c->tiled_rectangle = crec.tiled_rectangle;
+		c->floating_rectangle = crec.floating_rectangle;
+		c->state = crec.state;
+		c->last_state = crec.last_state;
+		c->layer = crec.layer;
+		c->last_layer = crec.last_layer;
+		c->urgent = crec.urgent;
+		c->shown = crec.shown;
+	} else if ((n = make_node(UINT32_MAX)) == NULL) {
+		r->failed = true;
+		return NULL;
+	}
+
+	node_registry_set_id(n, rec.id);
+	n->split_type = rec.split_type == TYPE_HORIZONTAL ? TYPE_HORIZONTAL : TYPE_VERTICAL;
+	n->split_ratio = rec.split_ratio;
+	n->rectangle = rec.rectangle;
+	n->constraints = rec.constraints;
+	n->vacant = rec.vacant;
+	n->hidden = rec.hidden;
+	n->sticky = rec.sticky;
+	n->private = rec.private;
+	n->locked = rec.locked;
+	n->marked = rec.marked;
+
+	if ((rec.contents & SNAPSHOT_PRESEL) && (n->presel = make_presel()) != NULL) {
+		n->presel->split_dir = rec.presel_dir <= DIR_WEST ? rec.presel_dir : DIR_EAST;
+		n->presel->split_ratio = rec.presel_ratio;
+	}
+
+	/* a node either has both children, or none */
+	bool first = rec.contents & SNAPSHOT_FIRST_CHILD;
+	bool second = rec.contents & SNAPSHOT_SECOND_CHILD;
+	if (first != second || (first && n->client != NULL)) {
+		r->failed = true;
+		return n;
+	}
+	if (first) {
+		n->first_child = read_node(r, depth + 1);
+		if (n->first_child != NULL) {
+			n->first_child->parent = n;
+		}
+		if (!r->failed) {
+			n->second_child = read_node(r, depth + 1);
+			if (n->second_child != NULL) {
+				n->second_child->parent = n;
+			}
+		}
+	}
+
+	return n;
+}
+
+static bool read_monitor(snapshot_reader_t *r)
+{
+	snapshot_monitor_t mrec;
+	if (!get(r, &mrec, sizeof(mrec))) {
+		return false;
+	}
+	monitor_t *m = make_monitor(NULL, NULL, UINT32_MAX);
+	if (m == NULL) {
+		r->failed = true;
+		return false;
+	}
+	mrec.name[sizeof(mrec.name) - 1] = '\0';
+	snprintf(m->name, sizeof(m->name), "%s", mrec.name);
+	m->id = mrec.id;
+	m->output_id = mrec.output_id;
+	m->wired = mrec.wired;
+	m->adaptive_sync = mrec.adaptive_sync;
+	if (m->adaptive_sync) {
+		backend_set_adaptive_sync(m->output_id, true);
+	}
+	m->sticky_count = mrec.sticky_count;
+	m->window_gap = mrec.window_gap;
+	m->border_width = mrec.border_width;
+	m->padding = mrec.padding;
+	m->rectangle = mrec.rectangle;
+	update_root(m, &m->rectangle);
+
+	for (uint32_t i = 0; i < mrec.desktops_count && !r->failed; i++) {
+		snapshot_desktop_t drec;
+		if (!get(r, &drec, sizeof(drec))) {
+			break;
+		}
+		desktop_t *d = make_desktop(NULL, UINT32_MAX);
+		if (d == NULL) {
+			r->failed = true;
+			break;
+		}
+		drec.name[sizeof(drec.name) - 1] = '\0';
+		snprintf(d->name, sizeof(d->name), "%s", drec.name);
+		d->id = drec.id;
+		d->layout = drec.layout == LAYOUT_MONOCLE ? LAYOUT_MONOCLE : LAYOUT_TILED;
+		d->user_layout = drec.user_layout == LAYOUT_MONOCLE ? LAYOUT_MONOCLE : LAYOUT_TILED;
+		d->window_gap = drec.window_gap;
+		d->border_width = drec.border_width;
+		d->padding = drec.padding;
+		if (drec.has_root) {
+			d->root = read_node(r, 0);
+			if (r->failed) {
+				/* never keep a torn tree, its windows get adopted again */
+				free_node(d->root);
+				d->root = NULL;
+			}
+			relink_leaves(d->root);
+			rebuild_counts_from_leaves(d->root);
+		}
+		if (drec.focused_node_id != 0) {
+			d->focus = find_by_id_in(d->root, drec.focused_node_id);
+		}
+		add_desktop(m, d);
+		if (d->id == mrec.focused_desktop_id) {
+			m->desk = d;
+		}
+	}
+
+	if (m->desk == NULL) {
+		add_desktop(m, make_desktop(NULL, BSPWM_WID_NONE));
+	}
+	add_monitor(m);
+	return !r->failed;
+}
+
+bool restore_snapshot(const char *file_path)
+{
+	int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		perror("Restore snapshot: open");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(snapshot_header_t)) {
+		warn("Restore snapshot: truncated file.\n");
+		close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror("Restore snapshot: mmap");
+		return false;
+	}
+
+	snapshot_reader_t r = {map, (const uint8_t *) map + st.st_size, false};
+	snapshot_header_t hdr;
+	get(&r, &hdr, sizeof(hdr));
+	if (memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) != 0 ||
+	    hdr.version != SNAPSHOT_VERSION || hdr.byte_order != SNAPSHOT_BYTE_ORDER ||
+	    hdr.size != (uint64_t) st.st_size ||
+	    memcmp(hdr.record_sizes, record_sizes, sizeof(record_sizes)) != 0) {
+		warn("Restore snapshot: incompatible snapshot.\n");
+		munmap(map, (size_t) st.st_size);
+		return false;
+	}
+
+	mon = NULL;
+	while (mon_head != NULL) {
+		remove_monitor(mon_head);
+	}
+
+	for (uint32_t i = 0; i < hdr.monitors_count && !r.failed; i++) {
+		read_monitor(&r);
+	}
+
+	clients_count = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			clients_count += clients_count_in(d->root);
+		}
+	}
+
+	coordinates_t loc;
+	if (hdr.focused_monitor_id != 0 && monitor_from_id(hdr.focused_monitor_id, &loc)) {
+		mon = loc.monitor;
+	}
+	if (hdr.primary_monitor_id != 0 && monitor_from_id(hdr.primary_monitor_id, &loc)) {
+		pri_mon = loc.monitor;
+	}
+
+	for (uint32_t i = 0; i < hdr.history_count && !r.failed; i++) {
+		snapshot_coordinates_t rec;
+		if (!get(&r, &rec, sizeof(rec))) {
+			break;
+		}
+		monitor_t *m = find_monitor(rec.monitor_id);
+		desktop_t *d = find_desktop_in(rec.desktop_id, m);
+		if (m != NULL && d != NULL) {
+			node_t *n = rec.node_id != 0 ? find_by_id_in(d->root, rec.node_id) : NULL;
+			history_add(m, d, n, true);
+		}
+	}
+
+	for (uint32_t i = 0; i < hdr.stack_count && !r.failed; i++) {
+		uint32_t id;
+		if (!get(&r, &id, sizeof(id))) {
+			break;
+		}
+		node_t *n = node_registry_get(id);
+		if (n != NULL && n->client != NULL) {
+			stack_insert(n, true);
+		}
+	}
+
+	for (uint32_t i = 0; i < hdr.subscribers_count && !r.failed; i++) {
+		snapshot_subscriber_t rec;
+		if (!get(&r, &rec, sizeof(rec)) || (size_t) (r.end - r.pos) < rec.fifo_path_len) {
+			r.failed = true;
+			break;
+		}
+		char *fifo_path = NULL;
+		if (rec.fifo_path_len > 0) {
+			fifo_path = copy_string((char *) r.pos, rec.fifo_path_len);
+			r.pos += rec.fifo_path_len;
+		}
+		FILE *stream = restore_subscriber_stream(rec.fd);
+		if (stream == NULL) {
+			free(fifo_path);
+			continue;
+		}
+		subscriber_list_t *sb = make_subscriber(stream, fifo_path, rec.field, rec.count);
+		if (sb == NULL) {
+			fclose(stream);
+			free(fifo_path);
+			continue;
+		}
+		rec.subtype[sizeof(rec.subtype) - 1] = '\0';
+		snprintf(sb->subtype, sizeof(sb->subtype), "%s", rec.subtype);
+		sb->json = rec.json;
+		sb->monitor_id = rec.monitor_id;
+		sb->desktop_id = rec.desktop_id;
+		sb->node_id = rec.node_id;
+		add_subscriber(sb);
+	}
+
+	if (r.failed) {
+		warn("Restore snapshot: truncated or corrupted snapshot.\n");
+	}
+
+	munmap(map, (size_t) st.st_size);
+
+	if (mon == NULL) {
+		mon = mon_head;
+	}
+	restore_finish();
+	return !r.failed;
+}
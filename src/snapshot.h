@@ -0,0 +1,138 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BSPWM_SNAPSHOT_H
+#define BSPWM_SNAPSHOT_H
+
+#include "types.h"
+
+/* Binary state snapshot, written on restart instead of the JSON dump.
+ * Records are fixed layout structures in native byte order: a snapshot
+ * is only meant to be read back by the same build on the same machine,
+ * anything else is rejected by the version and layout checks. */
+#define SNAPSHOT_MAGIC    "BSPWMSNP"
+#define SNAPSHOT_VERSION  3
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t size;
+	uint16_t record_sizes[8];
+	uint32_t focused_monitor_id;
+	uint32_t primary_monitor_id;
+	uint32_t monitors_count;
+	uint32_t history_count;
+	uint32_t stack_count;
+	uint32_t subscribers_count;
+} snapshot_header_t;
+
+typedef struct {
+	char name[SMALEN];
+	uint32_t id;
+	uint32_t output_id;
+	uint32_t sticky_count;
+	int32_t window_gap;
+	uint32_t border_width;
+	uint32_t focused_desktop_id;
+	uint32_t desktops_count;
+	padding_t padding;
+	bspwm_rect_t rectangle;
+	uint8_t wired;
+	uint8_t adaptive_sync;
+} snapshot_monitor_t;
+
+typedef struct {
+	char name[SMALEN];
+	uint32_t id;
+	uint32_t focused_node_id;
+	int32_t window_gap;
+	uint32_t border_width;
+	padding_t padding;
+	uint8_t layout;
+	uint8_t user_layout;
+	uint8_t has_root;
+} snapshot_desktop_t;
+
+/* Nodes are stored in preorder, each one followed by its client, if any. */
+#define SNAPSHOT_FIRST_CHILD   (1 << 0)
+#define SNAPSHOT_SECOND_CHILD  (1 << 1)
+#define SNAPSHOT_CLIENT        (1 << 2)
+#define SNAPSHOT_PRESEL        (1 << 3)
+
+typedef struct {
+	uint32_t id;
+	double split_ratio;
+	double presel_ratio;
+	bspwm_rect_t rectangle;
+	constraints_t constraints;
+	uint8_t split_type;
+	uint8_t presel_dir;
+	uint8_t contents;
+	uint8_t vacant;
+	uint8_t hidden;
+	uint8_t sticky;
+	uint8_t private;
+	uint8_t locked;
+	uint8_t marked;
+} snapshot_node_t;
+
+typedef struct {
+	char class_name[MAX_CLASS_NAME_LEN];
+	char instance_name[MAX_INSTANCE_NAME_LEN];
+	uint32_t border_width;
+	bspwm_rect_t tiled_rectangle;
+	bspwm_rect_t floating_rectangle;
+	uint8_t state;
+	uint8_t last_state;
+	uint8_t layer;
+	uint8_t last_layer;
+	uint8_t urgent;
+	uint8_t shown;
+} snapshot_client_t;
+
+typedef struct {
+	uint32_t monitor_id;
+	uint32_t desktop_id;
+	uint32_t node_id;
+} snapshot_coordinates_t;
+
+/* Followed by the FIFO path, without its terminating null byte. */
+typedef struct {
+	int32_t fd;
+	int32_t field;
+	int32_t count;
+	uint32_t fifo_path_len;
+	uint32_t monitor_id;
+	uint32_t desktop_id;
+	uint32_t node_id;
+	char subtype[SMALEN];
+	uint8_t json;
+} snapshot_subscriber_t;
+
+bool write_snapshot(const char *file_path);
+bool is_snapshot(const char *file_path);
+bool restore_snapshot(const char *file_path);
+
+#endif
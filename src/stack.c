@@ -28,87 +28,94 @@
 #include "ewmh.h"
 #include "tree.h"
 #include "stack.h"
+#include "pool.h"
 
 #define MAX_STACK_DEPTH 1000
 
+static pool_t stack_pool = POOL_INIT("stack", stacking_list_t);
+
+/* First and last entries of each stacking segment: the list is the */
+/* concatenation of the segments, from the lowest level to the highest. */
+static stacking_list_t *segment_head[STACK_LEVELS];
+static stacking_list_t *segment_tail[STACK_LEVELS];
+
+/* Entries moved by the current stack() call, and the matching requests. */
+static struct {
+	stacking_list_t **entries;
+	bspwm_wid_t *wins;
+	bspwm_wid_t *siblings;
+	size_t count;
+	size_t cap;
+} restack_batch;
+
+/* While positive, stack() defers its requests: see hold_stack. */
+static unsigned int stack_hold_depth;
+
+uint64_t restack_requests;
+
 stacking_list_t *make_stack(node_t *n)
 {
 	if (!n)
 		return NULL;
 		
-	stacking_list_t *s = calloc(1, sizeof(stacking_list_t));
+	stacking_list_t *s = pool_alloc(&stack_pool);
 	if (!s)
 		return NULL;
 		
 	s->node = n;
+	s->held = false;
 	s->prev = s->next = NULL;
 	return s;
 }
 
-void stack_insert_after(stacking_list_t *a, node_t *n)
+/* The entry right below where a new entry of the given level is linked. */
+static stacking_list_t *segment_anchor(int level, bool top)
 {
-	if (!n)
-		return;
-		
-	stacking_list_t *s = make_stack(n);
-	if (!s)
-		return;
-		
-	if (!a) {
-		stack_head = stack_tail = s;
-	} else {
-		if (a->node == n) {
-			free(s);
-			return;
-		}
-		remove_stack_node(n);
-		stacking_list_t *b = a->next;
-		if (b)
-			b->prev = s;
-		s->next = b;
-		s->prev = a;
-		a->next = s;
-		if (stack_tail == a)
-			stack_tail = s;
+	if (top && segment_tail[level])
+		return segment_tail[level];
+	if (!top && segment_head[level])
+		return segment_head[level]->prev;
+	for (int l = level - 1; l >= 0; l--) {
+		if (segment_tail[l])
+			return segment_tail[l];
 	}
+	return NULL;
 }
 
-void stack_insert_before(stacking_list_t *a, node_t *n)
+static void stack_link(stacking_list_t *s, int level, bool top)
 {
-	if (!n)
-		return;
-		
-	stacking_list_t *s = make_stack(n);
-	if (!s)
-		return;
-		
-	if (!a) {
-		stack_head = stack_tail = s;
-	} else {
-		if (a->node == n) {
-			free(s);
-			return;
-		}
-		remove_stack_node(n);
-		stacking_list_t *b = a->prev;
-		if (b)
-			b->next = s;
-		s->prev = b;
-		s->next = a;
-		a->prev = s;
-		if (stack_head == a)
-			stack_head = s;
-	}
+	stacking_list_t *a = segment_anchor(level, top);
+	stacking_list_t *b = a ? a->next : stack_head;
+
+	s->level = level;
+	s->prev = a;
+	s->next = b;
+	if (a)
+		a->next = s;
+	else
+		stack_head = s;
+	if (b)
+		b->prev = s;
+	else
+		stack_tail = s;
+
+	if (top || !segment_tail[level])
+		segment_tail[level] = s;
+	if (!top || !segment_head[level])
+		segment_head[level] = s;
 }
 
-void remove_stack(stacking_list_t *s)
+static void stack_unlink(stacking_list_t *s)
 {
-	if (!s)
-		return;
-		
 	stacking_list_t *a = s->prev;
 	stacking_list_t *b = s->next;
-	
+	int l = s->level;
+
+	if (segment_head[l] == s)
+		segment_head[l] = (b && b->level == l) ? b : NULL;
+	if (segment_tail[l] == s)
+		segment_tail[l] = (a && a->level == l) ? a : NULL;
+
 	if (a)
 		a->next = b;
 	if (b)
@@ -117,8 +124,39 @@ void remove_stack(stacking_list_t *s)
 		stack_head = b;
 	if (s == stack_tail)
 		stack_tail = a;
+	s->prev = s->next = NULL;
+}
+
+/* Moves `n` (adding it if needed) to the top or the bottom of its segment. */
+stacking_list_t *stack_insert(node_t *n, bool top)
+{
+	if (!n)
+		return NULL;
+
+	stacking_list_t *s = n->stack_entry;
+	if (s) {
+		stack_unlink(s);
+	} else {
+		s = make_stack(n);
+		if (!s)
+			return NULL;
+		n->stack_entry = s;
+	}
+
+	stack_link(s, stack_level(n->client), top);
+	return s;
+}
+
+void remove_stack(stacking_list_t *s)
+{
+	if (!s)
+		return;
+		
+	stack_unlink(s);
+	if (s->node && s->node->stack_entry == s)
+		s->node->stack_entry = NULL;
 		
-	free(s);
+	pool_free(&stack_pool, s);
 }
 
 void remove_stack_node(node_t *n)
@@ -126,12 +164,9 @@ void remove_stack_node(node_t *n)
 	if (!n)
 		return;
 
-	stacking_list_t *s = stack_head;
-	while (s) {
-		stacking_list_t *next = s->next;
-		if (is_descendant(s->node, n))
-			remove_stack(s);
-		s = next;
+	for (node_t *f = first_extrema(n); f; f = next_leaf(f, n)) {
+		if (f->stack_entry)
+			remove_stack(f->stack_entry);
 	}
 }
 
@@ -158,44 +193,78 @@ int stack_cmp(client_t *c1, client_t *c2)
 	return stack_level(c1) - stack_level(c2);
 }
 
-stacking_list_t *limit_above(node_t *n)
+static bool restack_batch_reserve(size_t count)
 {
-	if (!n || !n->client)
-		return NULL;
-		
-	stacking_list_t *s = stack_head;
-	while (s && s->node && s->node->client && 
-	       stack_cmp(n->client, s->node->client) >= 0) {
-		s = s->next;
+	if (count <= restack_batch.cap)
+		return true;
+
+	size_t cap = restack_batch.cap > 0 ? restack_batch.cap : 64;
+	while (cap < count) {
+		if (!safe_double(&cap))
+			return false;
 	}
-	
-	if (!s)
-		s = stack_tail;
-		
-	if (s && s->node == n)
-		s = s->prev;
-		
-	return s;
+
+	stacking_list_t **entries = safe_realloc_array(restack_batch.entries, cap, sizeof(stacking_list_t *));
+	if (!entries)
+		return false;
+	restack_batch.entries = entries;
+	bspwm_wid_t *wins = safe_realloc_array(restack_batch.wins, cap, sizeof(bspwm_wid_t));
+	if (!wins)
+		return false;
+	restack_batch.wins = wins;
+	bspwm_wid_t *siblings = safe_realloc_array(restack_batch.siblings, cap, sizeof(bspwm_wid_t));
+	if (!siblings)
+		return false;
+	restack_batch.siblings = siblings;
+
+	restack_batch.cap = cap;
+	return true;
 }
 
-stacking_list_t *limit_below(node_t *n)
+/* Sends the stacking requests for the batched entries, which are given in */
+/* list order: each one is put right above its predecessor, except for the */
+/* ones at the bottom of the list, which are put below their successor. */
+static void restack_batch_flush(void)
 {
-	if (!n || !n->client)
-		return NULL;
-		
-	stacking_list_t *s = stack_tail;
-	while (s && s->node && s->node->client && 
-	       stack_cmp(n->client, s->node->client) <= 0) {
-		s = s->prev;
+	stacking_list_t **e = restack_batch.entries;
+	size_t count = restack_batch.count;
+	size_t j = 0;
+
+	while (j < count && e[j] == (j == 0 ? stack_head : e[j - 1]->next))
+		j++;
+
+	uint32_t n = 0;
+	if (j > 0 && e[j - 1]->next) {
+		for (size_t i = j; i > 0; i--) {
+			stacking_list_t *s = e[i - 1];
+			restack_batch.wins[n] = s->node->id;
+			restack_batch.siblings[n] = s->next->node->id;
+			put_status(SBSC_MASK_NODE_STACK, "node_stack 0x%08X below 0x%08X\n",
+			           s->node->id, s->next->node->id);
+			n++;
+		}
+		window_restack(restack_batch.wins, restack_batch.siblings, n, false);
+		restack_requests++;
+		n = 0;
+	} else if (j > 0) {
+		/* everything got moved: the bottom entry is the reference */
+		j = 1;
 	}
-	
-	if (!s)
-		s = stack_head;
-		
-	if (s && s->node == n)
-		s = s->next;
-		
-	return s;
+
+	for (size_t i = j; i < count; i++) {
+		stacking_list_t *s = e[i];
+		restack_batch.wins[n] = s->node->id;
+		restack_batch.siblings[n] = s->prev->node->id;
+		put_status(SBSC_MASK_NODE_STACK, "node_stack 0x%08X above 0x%08X\n",
+		           s->node->id, s->prev->node->id);
+		n++;
+	}
+	if (n > 0) {
+		window_restack(restack_batch.wins, restack_batch.siblings, n, true);
+		restack_requests++;
+	}
+
+	restack_batch.count = 0;
 }
 
 void stack(desktop_t *d, node_t *n, bool focused)
@@ -203,46 +272,94 @@ void stack(desktop_t *d, node_t *n, bool focused)
 	if (!d || !n)
 		return;
 		
+	size_t moved[STACK_LEVELS] = {0};
+	size_t total = 0;
+
 	for (node_t *f = first_extrema(n); f; f = next_leaf(f, n)) {
 		if (!f->client || (IS_FLOATING(f->client) && !auto_raise))
 			continue;
 			
-		if (!stack_head) {
-			stack_insert_after(NULL, f);
-		} else {
-			stacking_list_t *s = focused ? limit_above(f) : limit_below(f);
-			if (!s)
-				continue;
-				
-			if (!s->node || !s->node->client)
+		stacking_list_t *s = stack_insert(f, focused);
+		if (!s)
+			continue;
+		s->held = (stack_hold_depth > 0);
+		moved[s->level]++;
+		total++;
+	}
+
+	if (stack_hold_depth > 0) {
+		ewmh_update_client_list(true);
+		return;
+	}
+
+	/* the moved entries of each segment are contiguous: */
+	/* at its top when focused, at its bottom otherwise */
+	if (total > 0 && restack_batch_reserve(total)) {
+		for (int l = 0; l < STACK_LEVELS; l++) {
+			if (moved[l] == 0)
 				continue;
-				
-			int i = stack_cmp(f->client, s->node->client);
-			if (i < 0 || (i == 0 && !focused)) {
-				stack_insert_before(s, f);
-				window_below(f->id, s->node->id);
-				put_status(SBSC_MASK_NODE_STACK, "node_stack 0x%08X below 0x%08X\n", 
-				          f->id, s->node->id);
-			} else {
-				stack_insert_after(s, f);
-				window_above(f->id, s->node->id);
-				put_status(SBSC_MASK_NODE_STACK, "node_stack 0x%08X above 0x%08X\n", 
-				          f->id, s->node->id);
-			}
+			stacking_list_t *s = focused ? segment_tail[l] : segment_head[l];
+			for (size_t i = 1; focused && i < moved[l]; i++)
+				s = s->prev;
+			for (size_t i = 0; i < moved[l]; i++, s = s->next)
+				restack_batch.entries[restack_batch.count++] = s;
 		}
+		restack_batch_flush();
 	}
 	
 	ewmh_update_client_list(true);
-	restack_presel_feedbacks(d);
+
+	/* The feedbacks of hidden desktops are unmapped, show_desktop
+	 * restacks them. */
+	for (monitor_t *m = mon_head; m; m = m->next) {
+		if (m->desk == d) {
+			restack_presel_feedbacks(d);
+			break;
+		}
+	}
+}
+
+void hold_stack(void)
+{
+	stack_hold_depth++;
+}
+
+/* The held entries are collected in list order, which is the order
+ * restack_batch_flush expects. */
+void release_stack(void)
+{
+	if (stack_hold_depth > 1) {
+		stack_hold_depth--;
+		return;
+	}
+	stack_hold_depth = 0;
+
+	size_t total = 0;
+	for (stacking_list_t *s = stack_head; s; s = s->next)
+		total += s->held;
+	if (total == 0)
+		return;
+
+	bool reserved = restack_batch_reserve(total);
+	for (stacking_list_t *s = stack_head; s; s = s->next) {
+		if (s->held && reserved)
+			restack_batch.entries[restack_batch.count++] = s;
+		s->held = false;
+	}
+	if (reserved)
+		restack_batch_flush();
+
+	for (monitor_t *m = mon_head; m; m = m->next)
+		restack_presel_feedbacks(m->desk);
 }
 
 static void restack_presel_feedbacks_in_depth(node_t *r, node_t *n, int depth);
 
 void restack_presel_feedbacks(desktop_t *d)
 {
-	if (!d)
+	if (!d || presel_feedback_count == 0)
 		return;
-		
+
 	stacking_list_t *s = stack_tail;
 	while (s && s->node && s->node->client && !IS_TILED(s->node->client)) {
 		s = s->prev;
@@ -257,7 +374,7 @@ static void restack_presel_feedbacks_in_depth(node_t *r, node_t *n, int depth)
 	if (!r || !n || depth > MAX_STACK_DEPTH)
 		return;
 		
-	if (r->presel)
+	if (r->presel && r->presel->feedback != BSPWM_WID_NONE)
 		window_above(r->presel->feedback, n->id);
 		
 	restack_presel_feedbacks_in_depth(r->first_child, n, depth + 1);
@@ -25,17 +25,22 @@
 #ifndef BSPWM_STACK_H
 #define BSPWM_STACK_H
 
+#define STACK_LEVELS  9  /* 3 layers times 3 states, see stack_level() */
+
 stacking_list_t *make_stack(node_t *n);
-void stack_insert_after(stacking_list_t *a, node_t *n);
-void stack_insert_before(stacking_list_t *a, node_t *n);
+stacking_list_t *stack_insert(node_t *n, bool top);
 void remove_stack(stacking_list_t *s);
 void remove_stack_node(node_t *n);
 int stack_level(client_t *c);
 int stack_cmp(client_t *c1, client_t *c2);
-stacking_list_t *limit_above(node_t *n);
-stacking_list_t *limit_below(node_t *n);
 void stack(desktop_t *d, node_t *n, bool focused);
+/* Between hold_stack and release_stack, stack only reorders the list:
+ * release_stack sends the requests for the moved entries at once. */
+void hold_stack(void);
+void release_stack(void);
 void restack_presel_feedbacks(desktop_t *d);
+/* Restacking requests sent to the backend, for query --metrics. */
+extern uint64_t restack_requests;
 void restack_presel_feedbacks_in(node_t *r, node_t *n);
 
 #endif
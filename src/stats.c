@@ -0,0 +1,259 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "bspwm.h"
+#include "helpers.h"
+#include "stats.h"
+#include "pool.h"
+#include "backend.h"
+#include "trace.h"
+#include "lookup.h"
+#include "subscribe.h"
+#include "stack.h"
+
+static latency_histogram_t *histogram_head;
+static latency_histogram_t *histogram_tail;
+static uint32_t request_base;  /* backend_request_count at the last reset */
+
+latency_histogram_t *make_latency_histogram(const char *group, const char *name)
+{
+	latency_histogram_t *h = calloc(1, sizeof(latency_histogram_t));
+	if (h == NULL) {
+		return NULL;
+	}
+	h->group = group;
+	h->name = name;
+	h->next = NULL;
+	if (histogram_head == NULL) {
+		histogram_head = histogram_tail = h;
+	} else {
+		histogram_tail->next = h;
+		histogram_tail = h;
+	}
+	return h;
+}
+
+uint64_t latency_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static size_t bucket_index(uint64_t v)
+{
+	if (v < LATENCY_SUB_COUNT) {
+		return v;
+	}
+	int e = 63 - __builtin_clzll(v);
+	if (e > LATENCY_MAX_EXPONENT) {
+		return LATENCY_BUCKETS - 1;
+	}
+	size_t sub = (v >> (e - LATENCY_SUB_BITS)) & (LATENCY_SUB_COUNT - 1);
+	return (size_t) (e - LATENCY_SUB_BITS + 1) * LATENCY_SUB_COUNT + sub;
+}
+
+/* Highest value that falls in the given bucket */
+static uint64_t bucket_value(size_t i)
+{
+	if (i < LATENCY_SUB_COUNT) {
+		return i;
+	}
+	int e = (int) (i / LATENCY_SUB_COUNT) + LATENCY_SUB_BITS - 1;
+	uint64_t sub = i % LATENCY_SUB_COUNT;
+	uint64_t width = UINT64_C(1) << (e - LATENCY_SUB_BITS);
+	return ((LATENCY_SUB_COUNT + sub) << (e - LATENCY_SUB_BITS)) + width - 1;
+}
+
+void latency_record(latency_histogram_t *h, uint64_t start)
+{
+	if (h == NULL) {
+		return;
+	}
+	uint64_t now = latency_now();
+	uint64_t d = now - start;
+	trace_record(h->group, h->name, start, now, 0);
+	h->count++;
+	h->total += d;
+	if (d > h->max) {
+		h->max = d;
+	}
+	h->buckets[bucket_index(d)]++;
+}
+
+void latency_record_scratch(latency_histogram_t *h, size_t bytes)
+{
+	if (h != NULL && bytes > h->scratch_peak) {
+		h->scratch_peak = bytes;
+	}
+}
+
+static uint64_t percentile(latency_histogram_t *h, double q)
+{
+	uint64_t rank = (uint64_t) (q * (double) h->count + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank) {
+			return MIN(bucket_value(i), h->max);
+		}
+	}
+	return h->max;
+}
+
+static void print_group(FILE *rsp, const char *group)
+{
+	bool first = true;
+	fprintf(rsp, "\"%s\":{", group);
+	for (latency_histogram_t *h = histogram_head; h != NULL; h = h->next) {
+		if (!streq(h->group, group) || h->count == 0) {
+			continue;
+		}
+		fprintf(rsp, "%s\"%s\":{\"count\":%" PRIu64 ",\"totalNs\":%" PRIu64 ",\"maxNs\":%" PRIu64
+		        ",\"p50Ns\":%" PRIu64 ",\"p99Ns\":%" PRIu64 ",\"p999Ns\":%" PRIu64
+		        ",\"scratchPeak\":%" PRIu64 "}",
+		        first ? "" : ",", h->name, h->count, h->total, h->max,
+		        percentile(h, 0.5), percentile(h, 0.99), percentile(h, 0.999), h->scratch_peak);
+		first = false;
+	}
+	fprintf(rsp, "}");
+}
+
+void print_latency_stats(FILE *rsp)
+{
+	static const char *groups[] = {LATENCY_COMMANDS, LATENCY_EVENTS, LATENCY_LISTENERS};
+	fprintf(rsp, "{");
+	for (size_t i = 0; i < LENGTH(groups); i++) {
+		if (i > 0) {
+			fprintf(rsp, ",");
+		}
+		print_group(rsp, groups[i]);
+	}
+	fprintf(rsp, ",\"slabs\":");
+	print_pool_stats(rsp);
+	fprintf(rsp, ",\"scratch\":");
+	print_scratch_stats(rsp);
+	fprintf(rsp, ",\"backend\":{\"requests\":%" PRIu32 "}", backend_request_count() - request_base);
+	fprintf(rsp, "}");
+}
+
+void reset_latency_stats(void)
+{
+	for (latency_histogram_t *h = histogram_head; h != NULL; h = h->next) {
+		h->count = h->total = h->max = h->scratch_peak = 0;
+		memset(h->buckets, 0, sizeof(h->buckets));
+	}
+	reset_pool_stats();
+	reset_scratch_stats();
+	request_base = backend_request_count();
+	lookup_stats = (lookup_stats_t) {0};
+	subscriber_dropped_bytes = 0;
+	restack_requests = 0;
+}
+
+static void print_counter_group(FILE *rsp, const char *group, const char *label, const char *help)
+{
+	fprintf(rsp, "# TYPE bspwm_%s counter\n# HELP bspwm_%s %s\n", group, group, help);
+	for (latency_histogram_t *h = histogram_head; h != NULL; h = h->next) {
+		if (streq(h->group, group) && h->count > 0) {
+			fprintf(rsp, "bspwm_%s_total{%s=\"%s\"} %" PRIu64 "\n", group, label, h->name, h->count);
+		}
+	}
+}
+
+static void print_counter_pair(FILE *rsp, const char *name, const char *help, const char *label,
+                               const char *first, uint64_t first_value, const char *second, uint64_t second_value)
+{
+	fprintf(rsp, "# TYPE bspwm_%s counter\n# HELP bspwm_%s %s\n", name, name, help);
+	fprintf(rsp, "bspwm_%s_total{%s=\"%s\"} %" PRIu64 "\n", name, label, first, first_value);
+	fprintf(rsp, "bspwm_%s_total{%s=\"%s\"} %" PRIu64 "\n", name, label, second, second_value);
+}
+
+static void print_gauge(FILE *rsp, const char *name, const char *help, double value)
+{
+	fprintf(rsp, "# TYPE bspwm_%s gauge\n# HELP bspwm_%s %s\n", name, name, help);
+	if (isnan(value)) {
+		fprintf(rsp, "bspwm_%s NaN\n", name);
+	} else {
+		fprintf(rsp, "bspwm_%s %.17g\n", name, value);
+	}
+}
+
+/* NaN until the first lookup, as OpenMetrics allows */
+static double hit_ratio(uint64_t hits, uint64_t misses)
+{
+	return (hits + misses) == 0 ? (double) NAN : (double) hits / (double) (hits + misses);
+}
+
+void print_metrics(FILE *rsp)
+{
+	print_counter_group(rsp, LATENCY_EVENTS, "handler", "Events handled.");
+	print_counter_group(rsp, LATENCY_COMMANDS, "command", "IPC requests handled.");
+	print_counter_group(rsp, LATENCY_LISTENERS, "listener", "Backend listeners run.");
+
+	lookup_stats_t ls = lookup_stats;
+	print_counter_pair(rsp, "configures", "Configure requests sent and suppressed as no-ops.", "result",
+	                   "sent", ls.configures_sent, "suppressed", ls.configures_suppressed);
+	print_counter_pair(rsp, "window_lookups", "Window id lookups.", "result",
+	                   "hit", ls.window_hits, "miss", ls.window_misses);
+	print_gauge(rsp, "window_lookup_hit_ratio", "Share of the window id lookups finding a node.",
+	            hit_ratio(ls.window_hits, ls.window_misses));
+	print_counter_pair(rsp, "geometry_reads", "Window geometry reads.", "result",
+	                   "hit", ls.geometry_hits, "miss", ls.geometry_misses);
+	print_gauge(rsp, "geometry_cache_hit_ratio", "Share of the window geometry reads answered by the cache.",
+	            hit_ratio(ls.geometry_hits, ls.geometry_misses));
+	print_counter_pair(rsp, "parks", "Windows parked out of view and brought back.", "action",
+	                   "park", ls.parks, "unpark", ls.unparks);
+	print_counter_pair(rsp, "maps", "Windows mapped and unmapped.", "action",
+	                   "map", ls.maps, "unmap", ls.unmaps);
+
+	fprintf(rsp, "# TYPE bspwm_restacks counter\n"
+	        "# HELP bspwm_restacks Restacking requests sent, each one moving one or more windows.\n"
+	        "bspwm_restacks_total %" PRIu64 "\n", restack_requests);
+
+	print_gauge(rsp, "subscribers", "Connected subscribers.", subscriber_count());
+	fprintf(rsp, "# TYPE bspwm_subscriber_dropped_bytes counter\n"
+	        "# HELP bspwm_subscriber_dropped_bytes Queued output discarded for slow subscribers.\n"
+	        "bspwm_subscriber_dropped_bytes_total %" PRIu64 "\n", subscriber_dropped_bytes);
+
+	print_gauge(rsp, "clients", "Managed windows.", clients_count);
+	print_gauge(rsp, "nodes", "Live nodes, receptacles and internal nodes included.", node_registry_count());
+
+	const scratch_arena_t *sa = scratch_arena();
+	print_gauge(rsp, "scratch_used_bytes", "Scratch arena bytes in use.", sa->used);
+	print_gauge(rsp, "scratch_peak_bytes", "Highest scratch arena usage since the last stats reset.", sa->max_peak);
+	print_gauge(rsp, "scratch_chunks", "Scratch arena chunks allocated.", sa->chunk_count);
+	fprintf(rsp, "# EOF\n");
+}
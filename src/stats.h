@@ -0,0 +1,71 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BSPWM_STATS_H
+#define BSPWM_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Log-linear histogram of durations in nanoseconds: exact below 16ns, then
+ * 16 buckets per power of two, i.e. under 7% relative error. Durations of
+ * 2^LATENCY_MAX_EXPONENT ns and more share the last bucket. */
+#define LATENCY_SUB_BITS      4
+#define LATENCY_SUB_COUNT     (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_EXPONENT  40
+#define LATENCY_BUCKETS       ((LATENCY_MAX_EXPONENT - LATENCY_SUB_BITS + 2) * LATENCY_SUB_COUNT)
+
+/* Groups of the wm --stats output */
+#define LATENCY_COMMANDS   "commands"
+#define LATENCY_EVENTS     "events"
+#define LATENCY_LISTENERS  "listeners"
+
+typedef struct latency_histogram_t latency_histogram_t;
+struct latency_histogram_t {
+	const char *group;
+	const char *name;
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint64_t scratch_peak;  /* scratch arena bytes, see latency_record_scratch */
+	uint32_t buckets[LATENCY_BUCKETS];
+	latency_histogram_t *next;
+};
+
+/* Histograms live until exit, callers keep the returned pointer. */
+latency_histogram_t *make_latency_histogram(const char *group, const char *name);
+uint64_t latency_now(void);
+void latency_record(latency_histogram_t *h, uint64_t start);
+/* Keeps the highest scratch arena usage of a single call. */
+void latency_record_scratch(latency_histogram_t *h, size_t bytes);
+void print_latency_stats(FILE *rsp);
+void reset_latency_stats(void);
+/* The counters of the histograms, of the lookups and of the subscribers,
+ * and gauges of the tree and the scratch arena, in the OpenMetrics text
+ * format, for query --metrics. */
+void print_metrics(FILE *rsp);
+
+#endif
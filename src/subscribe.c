@@ -24,15 +24,140 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
 #include "bspwm.h"
 #include "desktop.h"
+#include "helpers.h"
 #include "settings.h"
 #include "subscribe.h"
 #include "tree.h"
+#include "stats.h"
+#include "trace.h"
+
+/* The last rendered report, in text and in JSON, valid until the next
+ * put_status(SBSC_MASK_REPORT) */
+typedef struct {
+	char *buf;
+	size_t len;
+	bool valid;
+} report_cache_t;
+
+static report_cache_t report_cache[2];
+
+/* While positive, put_status only queues its output: see hold_status. */
+static unsigned int hold_depth;
+
+/* A report was put while held, flush_status sends it */
+static bool report_held;
+
+uint64_t subscriber_dropped_bytes;
+
+typedef enum {
+	FIELD_VALUE,
+	FIELD_SWITCH,
+	FIELD_MONITOR,
+	FIELD_DESKTOP,
+	FIELD_NODE,
+} event_field_kind_t;
+
+typedef struct {
+	const char *key;
+	event_field_kind_t kind;
+} event_field_t;
+
+#define MAX_EVENT_FIELDS  6
+
+/* The JSON keys of the words following an event name, in order: trailing
+ * ones may be missing. The subtype is the field that `subscribe --subtype`
+ * matches. */
+typedef struct {
+	const char *name;
+	int subtype;
+	event_field_t fields[MAX_EVENT_FIELDS];
+} event_schema_t;
+
+#define F_MON(k)   {k, FIELD_MONITOR}
+#define F_DESK(k)  {k, FIELD_DESKTOP}
+#define F_NODE(k)  {k, FIELD_NODE}
+#define F_VAL(k)   {k, FIELD_VALUE}
+#define F_SW(k)    {k, FIELD_SWITCH}
+#define F_LOC      F_MON("monitorId"), F_DESK("desktopId"), F_NODE("nodeId")
+
+static const event_schema_t event_schemas[] = {
+	{"monitor_add", -1, {F_MON("monitorId"), F_VAL("name"), F_VAL("geometry")}},
+	{"monitor_rename", -1, {F_MON("monitorId"), F_VAL("oldName"), F_VAL("newName")}},
+	{"monitor_remove", -1, {F_MON("monitorId")}},
+	{"monitor_swap", -1, {F_MON("srcMonitorId"), F_MON("dstMonitorId")}},
+	{"monitor_focus", -1, {F_MON("monitorId")}},
+	{"monitor_geometry", -1, {F_MON("monitorId"), F_VAL("geometry")}},
+	{"desktop_add", -1, {F_MON("monitorId"), F_DESK("desktopId"), F_VAL("name")}},
+	{"desktop_rename", -1, {F_MON("monitorId"), F_DESK("desktopId"), F_VAL("oldName"), F_VAL("newName")}},
+	{"desktop_remove", -1, {F_MON("monitorId"), F_DESK("desktopId")}},
+	{"desktop_swap", -1, {F_MON("srcMonitorId"), F_DESK("srcDesktopId"), F_MON("dstMonitorId"), F_DESK("dstDesktopId")}},
+	{"desktop_transfer", -1, {F_MON("srcMonitorId"), F_DESK("srcDesktopId"), F_MON("dstMonitorId")}},
+	{"desktop_focus", -1, {F_MON("monitorId"), F_DESK("desktopId")}},
+	{"desktop_activate", -1, {F_MON("monitorId"), F_DESK("desktopId")}},
+	{"desktop_layout", 2, {F_MON("monitorId"), F_DESK("desktopId"), F_VAL("layout")}},
+	{"node_add", -1, {F_MON("monitorId"), F_DESK("desktopId"), F_NODE("ipId"), F_NODE("nodeId")}},
+	{"node_remove", -1, {F_LOC}},
+	{"node_swap", -1, {F_MON("srcMonitorId"), F_DESK("srcDesktopId"), F_NODE("srcNodeId"), F_MON("dstMonitorId"), F_DESK("dstDesktopId"), F_NODE("dstNodeId")}},
+	{"node_transfer", -1, {F_MON("srcMonitorId"), F_DESK("srcDesktopId"), F_NODE("srcNodeId"), F_MON("dstMonitorId"), F_DESK("dstDesktopId"), F_NODE("dstNodeId")}},
+	{"node_focus", -1, {F_LOC}},
+	{"node_activate", -1, {F_LOC}},
+	{"node_presel", 3, {F_LOC, F_VAL("presel"), F_VAL("value")}},
+	{"node_stack", 1, {F_NODE("nodeId"), F_VAL("relation"), F_NODE("otherNodeId")}},
+	{"node_geometry", -1, {F_LOC, F_VAL("geometry")}},
+	{"node_state", 3, {F_LOC, F_VAL("state"), F_SW("on")}},
+	{"node_flag", 3, {F_LOC, F_VAL("flag"), F_SW("on")}},
+	{"node_layer", 3, {F_LOC, F_VAL("layer")}},
+	{"pointer_action", 3, {F_LOC, F_VAL("action"), F_VAL("stage")}},
+};
+
+#undef F_MON
+#undef F_DESK
+#undef F_NODE
+#undef F_VAL
+#undef F_SW
+#undef F_LOC
+
+typedef struct {
+	enum {
+		VALUE_UINT,
+		VALUE_INT,
+		VALUE_DOUBLE,
+		VALUE_STRING,
+		VALUE_RECT,
+	} type;
+	union {
+		unsigned int u;
+		int i;
+		double f;
+		struct {
+			const char *s;
+			size_t len;
+		};
+		bspwm_rect_t r;
+	};
+} event_value_t;
+
+/* An event taken apart along its format string */
+typedef struct {
+	const char *name;
+	size_t name_len;
+	const event_schema_t *schema;
+	int num_values;
+	event_value_t values[MAX_EVENT_FIELDS];
+} status_event_t;
+
+static bool queue_output(subscriber_list_t *sb, const char *data, size_t len, bool is_report);
+static bool drain_ring(subscriber_list_t *sb);
+static bool cached_report(bool json, const char **buf, size_t *len);
 
 subscriber_list_t *make_subscriber(FILE *stream, char *fifo_path, int field, int count)
 {
@@ -45,6 +170,8 @@ subscriber_list_t *make_subscriber(FILE *stream, char *fifo_path, int field, int
 	sb->fifo_path = fifo_path;
 	sb->field = field;
 	sb->count = count;
+	sb->ring = NULL;
+	sb->ring_start = sb->ring_len = 0;
 	return sb;
 }
 
@@ -67,14 +194,18 @@ void remove_subscriber(subscriber_list_t *sb)
 	if (sb == subscribe_tail) {
 		subscribe_tail = a;
 	}
+	int cli_fd = fileno(sb->stream);
+	if (sb->polling) {
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cli_fd, NULL);
+	}
 	if (restart) {
-		int cli_fd = fileno(sb->stream);
 		/* Keep fd open for restart but mark for cleanup */
 		fcntl(cli_fd, F_SETFD, ~FD_CLOEXEC & fcntl(cli_fd, F_GETFD));
 	} else {
 		fclose(sb->stream);
 		unlink(sb->fifo_path);
 	}
+	free(sb->ring);
 	free(sb->fifo_path);
 	free(sb);
 }
@@ -94,15 +225,235 @@ void add_subscriber(subscriber_list_t *sb)
 	}
 	int cli_fd = fileno(sb->stream);
 	fcntl(cli_fd, F_SETFD, FD_CLOEXEC | fcntl(cli_fd, F_GETFD));
+	fcntl(cli_fd, F_SETFL, O_NONBLOCK | fcntl(cli_fd, F_GETFL));
 	if (sb->field & SBSC_MASK_REPORT) {
-		print_report(sb->stream);
-		if (sb->count-- == 1) {
+		const char *report;
+		size_t len;
+		if (!cached_report(sb->json, &report, &len) || !queue_output(sb, report, len, true)) {
 			remove_subscriber(sb);
+		} else if (sb->count-- == 1) {
+			finish_subscriber(sb);
 		}
 	}
 }
 
-int print_report(FILE *stream)
+unsigned int subscriber_count(void)
+{
+	unsigned int count = 0;
+	for (subscriber_list_t *sb = subscribe_head; sb != NULL; sb = sb->next) {
+		count++;
+	}
+	return count;
+}
+
+subscriber_list_t *find_subscriber(int fd)
+{
+	for (subscriber_list_t *sb = subscribe_head; sb != NULL; sb = sb->next) {
+		if (sb->polling && fileno(sb->stream) == fd) {
+			return sb;
+		}
+	}
+	return NULL;
+}
+
+/* Register for EPOLLOUT while output is pending, the main loop then calls
+ * flush_subscriber whenever the stream can take more. */
+static void set_polling(subscriber_list_t *sb, bool value)
+{
+	if (sb->polling == value) {
+		return;
+	}
+	int fd = fileno(sb->stream);
+	if (value) {
+		struct epoll_event ev = {0};
+		ev.events = EPOLLOUT;
+		ev.data.fd = fd;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			return;
+		}
+	} else {
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	}
+	sb->polling = value;
+}
+
+/* Write as much as possible without blocking. Return the number of bytes
+ * written, or -1 if the subscriber is gone. */
+static ssize_t write_some(int fd, const char *data, size_t len)
+{
+	uint64_t start = latency_now();
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = write(fd, data + done, len - done);
+		if (n > 0) {
+			done += (size_t) n;
+		} else if (n == -1 && errno == EINTR) {
+			continue;
+		} else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			return -1;
+		}
+	}
+	trace_record(TRACE_SUBSCRIBERS, "write", start, latency_now(), (uint32_t) done);
+	return (ssize_t) done;
+}
+
+#define RING_AT(sb, i)  ((sb)->ring[((sb)->ring_start + (i)) % SUBSCRIBER_RING_SIZE])
+
+/* Drop whole lines from the front until len bytes fit. A line that was
+ * partly written already is kept, so the reader never sees a torn line. */
+static bool make_room(subscriber_list_t *sb, size_t len)
+{
+	size_t keep = 0;
+	if (sb->line_started) {
+		while (keep < sb->ring_len && RING_AT(sb, keep) != '\n') {
+			keep++;
+		}
+		keep = MIN(keep + 1, sb->ring_len);
+	}
+	size_t drop = keep;
+	while (drop < sb->ring_len && SUBSCRIBER_RING_SIZE - (sb->ring_len - (drop - keep)) < len) {
+		while (drop < sb->ring_len && RING_AT(sb, drop) != '\n') {
+			drop++;
+		}
+		drop = MIN(drop + 1, sb->ring_len);
+	}
+	size_t dropped = drop - keep;
+	if (SUBSCRIBER_RING_SIZE - (sb->ring_len - dropped) < len) {
+		return false;
+	}
+	/* Shift the kept head over the dropped lines */
+	for (size_t i = keep; i > 0; i--) {
+		RING_AT(sb, dropped + i - 1) = RING_AT(sb, i - 1);
+	}
+	sb->ring_start = (sb->ring_start + dropped) % SUBSCRIBER_RING_SIZE;
+	sb->ring_len -= dropped;
+	subscriber_dropped_bytes += dropped;
+	return true;
+}
+
+static bool queue_output(subscriber_list_t *sb, const char *data, size_t len, bool is_report)
+{
+	bool torn = false;
+	if (hold_depth == 0 && sb->ring_len == 0 && !sb->report_pending) {
+		ssize_t n = write_some(fileno(sb->stream), data, len);
+		if (n == -1) {
+			return false;
+		}
+		if ((size_t) n == len) {
+			return true;
+		}
+		torn = sb->line_started = (n > 0);
+		data += n;
+		len -= (size_t) n;
+	}
+
+	/* Held output is written early rather than dropped */
+	if (SUBSCRIBER_RING_SIZE - sb->ring_len < len && hold_depth > 0 && !sb->polling && !sb->report_pending) {
+		if (!drain_ring(sb)) {
+			return false;
+		}
+	}
+
+	if (SUBSCRIBER_RING_SIZE - sb->ring_len < len) {
+		if (subscriber_overflow == OVERFLOW_DISCONNECT) {
+			return false;
+		} else if (subscriber_overflow == OVERFLOW_COALESCE && is_report && !torn) {
+			/* A fresh report goes out once the stream drains */
+			sb->report_pending = true;
+			set_polling(sb, true);
+			return true;
+		} else if (!make_room(sb, len)) {
+			return false;
+		}
+	}
+
+	if (sb->ring == NULL) {
+		sb->ring = malloc(SUBSCRIBER_RING_SIZE);
+		if (sb->ring == NULL) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		RING_AT(sb, sb->ring_len + i) = data[i];
+	}
+	sb->ring_len += len;
+	if (hold_depth == 0) {
+		set_polling(sb, true);
+	}
+	return true;
+}
+
+/* Write the queued output until the stream would block. Return false if
+ * the subscriber is gone. */
+static bool drain_ring(subscriber_list_t *sb)
+{
+	int fd = fileno(sb->stream);
+	while (sb->ring_len > 0) {
+		size_t chunk = MIN(sb->ring_len, SUBSCRIBER_RING_SIZE - sb->ring_start);
+		ssize_t n = write_some(fd, sb->ring + sb->ring_start, chunk);
+		if (n == -1) {
+			return false;
+		}
+		if (n > 0) {
+			sb->line_started = (sb->ring[sb->ring_start + n - 1] != '\n');
+		}
+		sb->ring_start = (sb->ring_start + (size_t) n) % SUBSCRIBER_RING_SIZE;
+		sb->ring_len -= (size_t) n;
+		if ((size_t) n < chunk) {
+			return true;
+		}
+	}
+	sb->ring_start = 0;
+	return true;
+}
+
+void flush_subscriber(subscriber_list_t *sb)
+{
+	if (!drain_ring(sb)) {
+		remove_subscriber(sb);
+		return;
+	}
+	if (sb->ring_len > 0) {
+		set_polling(sb, true);
+		return;
+	}
+
+	if (sb->report_pending) {
+		sb->report_pending = false;
+		const char *report;
+		size_t len;
+		if (!cached_report(sb->json, &report, &len) || !queue_output(sb, report, len, true)) {
+			remove_subscriber(sb);
+			return;
+		}
+		if (sb->ring_len > 0 || sb->report_pending) {
+			return;
+		}
+	}
+
+	set_polling(sb, false);
+	if (sb->finished) {
+		remove_subscriber(sb);
+	}
+}
+
+#undef RING_AT
+
+/* The subscriber received its last message: remove it once that message
+ * has been written out. */
+void finish_subscriber(subscriber_list_t *sb)
+{
+	if (sb->ring_len == 0 && !sb->report_pending) {
+		remove_subscriber(sb);
+	} else {
+		sb->finished = true;
+	}
+}
+
+static void write_report(FILE *stream)
 {
 	fprintf(stream, "%s", status_prefix);
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
@@ -146,38 +497,425 @@ int print_report(FILE *stream)
 		}
 	}
 	fprintf(stream, "%s", "\n");
+}
+
+static void write_json_string(FILE *stream, const char *s, size_t len)
+{
+	fputc('"', stream);
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\') {
+			fprintf(stream, "\\%c", c);
+		} else if (c == '\n') {
+			fputs("\\n", stream);
+		} else if (c == '\t') {
+			fputs("\\t", stream);
+		} else if (c < 0x20) {
+			fprintf(stream, "\\u%04x", c);
+		} else {
+			fputc(c, stream);
+		}
+	}
+	fputc('"', stream);
+}
+
+/* The report of a JSON subscriber is the text report without its line
+ * feed, as a string member. */
+static bool render_report(bool json, char **buf, size_t *len)
+{
+	const char *text = NULL;
+	size_t text_len = 0;
+	if (json && !cached_report(false, &text, &text_len)) {
+		return false;
+	}
+	FILE *stream = open_memstream(buf, len);
+	if (stream == NULL) {
+		return false;
+	}
+	if (json) {
+		fputs("{\"event\":\"report\",\"status\":", stream);
+		write_json_string(stream, text, text_len > 0 ? text_len - 1 : 0);
+		fputs("}\n", stream);
+	} else {
+		write_report(stream);
+	}
+	if (fclose(stream) != 0) {
+		free(*buf);
+		return false;
+	}
+	return true;
+}
+
+static bool cached_report(bool json, const char **buf, size_t *len)
+{
+	report_cache_t *rc = &report_cache[json];
+	if (!rc->valid) {
+		char *cache = NULL;
+		size_t cache_len = 0;
+		if (!render_report(json, &cache, &cache_len)) {
+			return false;
+		}
+		free(rc->buf);
+		rc->buf = cache;
+		rc->len = cache_len;
+		rc->valid = true;
+	}
+	*buf = rc->buf;
+	*len = rc->len;
+	return true;
+}
+
+void invalidate_report(void)
+{
+	report_cache[false].valid = report_cache[true].valid = false;
+}
+
+int print_report(FILE *stream)
+{
+	const char *report;
+	size_t len;
+	if (cached_report(false, &report, &len)) {
+		fwrite(report, 1, len, stream);
+	} else {
+		write_report(stream);
+	}
 	return fflush(stream);
 }
 
-void put_status(subscriber_mask_t mask, ...)
+#define RECT_FORMAT  "%ux%u+%i+%i"
+
+/* Take the argument of one word of an event format. A word without a
+ * conversion is a value by itself. */
+static bool parse_value(const char *word, size_t len, va_list *args, event_value_t *v)
 {
-	subscriber_list_t *sb = subscribe_head;
-	int ret;
-	while (sb != NULL) {
-		subscriber_list_t *next = sb->next;
-		if (sb->field & mask) {
-			if (sb->count > 0) {
-				sb->count--;
+	if (len == strlen(RECT_FORMAT) && strncmp(word, RECT_FORMAT, len) == 0) {
+		v->type = VALUE_RECT;
+		v->r.width = va_arg(*args, unsigned int);
+		v->r.height = va_arg(*args, unsigned int);
+		v->r.x = va_arg(*args, int);
+		v->r.y = va_arg(*args, int);
+		return true;
+	}
+	const char *end = word + len;
+	const char *c = memchr(word, '%', len);
+	if (c == NULL) {
+		v->type = VALUE_STRING;
+		v->s = word;
+		v->len = len;
+		return true;
+	}
+	c++;
+	while (c < end && strchr("0123456789.#-+l", *c) != NULL) {
+		c++;
+	}
+	if (c == end || memchr(c + 1, '%', end - c - 1) != NULL) {
+		return false;
+	}
+	switch (*c) {
+		case 'X':
+		case 'x':
+		case 'u':
+			v->type = VALUE_UINT;
+			v->u = va_arg(*args, unsigned int);
+			break;
+		case 'i':
+		case 'd':
+			v->type = VALUE_INT;
+			v->i = va_arg(*args, int);
+			break;
+		case 'f':
+		case 'g':
+			v->type = VALUE_DOUBLE;
+			v->f = va_arg(*args, double);
+			break;
+		case 's':
+			v->type = VALUE_STRING;
+			v->s = va_arg(*args, const char *);
+			v->len = strlen(v->s);
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+#undef RECT_FORMAT
+
+/* An event whose words don't all parse, or that has no schema, passes
+ * every filter and has its values listed under "args". */
+static void parse_event(const char *fmt, va_list *args, status_event_t *ev)
+{
+	const char *p = fmt;
+	size_t len = strcspn(p, " \n");
+	ev->name = p;
+	ev->name_len = len;
+	ev->schema = NULL;
+	ev->num_values = 0;
+	bool complete = true;
+	for (p += len; *p == ' '; p += len) {
+		p++;
+		len = strcspn(p, " \n");
+		if (ev->num_values == MAX_EVENT_FIELDS ||
+		    !parse_value(p, len, args, &ev->values[ev->num_values])) {
+			complete = false;
+			break;
+		}
+		ev->num_values++;
+	}
+	if (!complete) {
+		return;
+	}
+	for (size_t i = 0; i < LENGTH(event_schemas); i++) {
+		const event_schema_t *es = &event_schemas[i];
+		if (strlen(es->name) != ev->name_len || strncmp(es->name, ev->name, ev->name_len) != 0) {
+			continue;
+		}
+		int n = 0;
+		while (n < MAX_EVENT_FIELDS && es->fields[n].key != NULL) {
+			n++;
+		}
+		if (ev->num_values <= n) {
+			ev->schema = es;
+		}
+		break;
+	}
+}
+
+static bool has_filter(subscriber_list_t *sb)
+{
+	return sb->monitor_id != 0 || sb->desktop_id != 0 || sb->node_id != 0 || sb->subtype[0] != '\0';
+}
+
+/* An event passes an identifier filter when one of its identifiers of
+ * that kind matches, or when it has none. */
+static bool match_id(const status_event_t *ev, event_field_kind_t kind, uint32_t id)
+{
+	if (id == 0) {
+		return true;
+	}
+	bool seen = false;
+	for (int i = 0; i < ev->num_values; i++) {
+		if (ev->schema->fields[i].kind == kind && ev->values[i].type == VALUE_UINT) {
+			if (ev->values[i].u == id) {
+				return true;
 			}
-			if (mask == SBSC_MASK_REPORT) {
-				ret = print_report(sb->stream);
+			seen = true;
+		}
+	}
+	return !seen;
+}
+
+static bool event_matches(const status_event_t *ev, subscriber_list_t *sb)
+{
+	if (ev->schema == NULL) {
+		return true;
+	}
+	if (sb->subtype[0] != '\0' && ev->schema->subtype >= 0 && ev->schema->subtype < ev->num_values) {
+		const event_value_t *v = &ev->values[ev->schema->subtype];
+		if (v->type != VALUE_STRING || strlen(sb->subtype) != v->len ||
+		    strncmp(sb->subtype, v->s, v->len) != 0) {
+			return false;
+		}
+	}
+	return match_id(ev, FIELD_MONITOR, sb->monitor_id) &&
+	       match_id(ev, FIELD_DESKTOP, sb->desktop_id) &&
+	       match_id(ev, FIELD_NODE, sb->node_id);
+}
+
+static void write_json_value(FILE *stream, const event_value_t *v, event_field_kind_t kind)
+{
+	switch (v->type) {
+		case VALUE_UINT:
+			fprintf(stream, "%u", v->u);
+			break;
+		case VALUE_INT:
+			fprintf(stream, "%i", v->i);
+			break;
+		case VALUE_DOUBLE:
+			fprintf(stream, "%g", v->f);
+			break;
+		case VALUE_STRING:
+			if (kind == FIELD_SWITCH && v->len == 2 && strncmp(v->s, "on", 2) == 0) {
+				fputs("true", stream);
+			} else if (kind == FIELD_SWITCH && v->len == 3 && strncmp(v->s, "off", 3) == 0) {
+				fputs("false", stream);
 			} else {
-				char *fmt;
-				va_list args;
-				va_start(args, mask);
-				fmt = va_arg(args, char *);
-				vfprintf(sb->stream, fmt, args);
-				va_end(args);
-				ret = fflush(sb->stream);
+				write_json_string(stream, v->s, v->len);
 			}
-			if (ret != 0 || sb->count == 0) {
-				remove_subscriber(sb);
+			break;
+		case VALUE_RECT:
+			fprintf(stream, "{\"x\":%i,\"y\":%i,\"width\":%u,\"height\":%u}",
+			        v->r.x, v->r.y, v->r.width, v->r.height);
+			break;
+	}
+}
+
+static bool format_json(const status_event_t *ev, char **buf, size_t *len)
+{
+	FILE *stream = open_memstream(buf, len);
+	if (stream == NULL) {
+		return false;
+	}
+	fputs("{\"event\":", stream);
+	write_json_string(stream, ev->name, ev->name_len);
+	if (ev->schema != NULL) {
+		for (int i = 0; i < ev->num_values; i++) {
+			const event_field_t *f = &ev->schema->fields[i];
+			fprintf(stream, ",\"%s\":", f->key);
+			write_json_value(stream, &ev->values[i], f->kind);
+		}
+	} else if (ev->num_values > 0) {
+		fputs(",\"args\":[", stream);
+		for (int i = 0; i < ev->num_values; i++) {
+			if (i > 0) {
+				fputc(',', stream);
 			}
+			write_json_value(stream, &ev->values[i], FIELD_VALUE);
+		}
+		fputc(']', stream);
+	}
+	fputs("}\n", stream);
+	if (fclose(stream) != 0) {
+		free(*buf);
+		*buf = NULL;
+		return false;
+	}
+	return true;
+}
+
+static bool format_text(const char *fmt, va_list *args, char **buf, size_t *len)
+{
+	FILE *stream = open_memstream(buf, len);
+	if (stream == NULL) {
+		return false;
+	}
+	vfprintf(stream, fmt, *args);
+	if (fclose(stream) != 0) {
+		free(*buf);
+		*buf = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* The message is formatted once per format and queued on each matching
+ * subscriber: a slow reader costs buffer space, never a blocking write.
+ * The event is only taken apart when a subscriber filters it or wants it
+ * as JSON. A report has no format: the cached one is sent. */
+static void send_status(subscriber_mask_t mask, const char *fmt, va_list *args)
+{
+	bool is_report = (mask == SBSC_MASK_REPORT);
+	char *text = NULL, *json = NULL;
+	size_t text_len = 0, json_len = 0;
+	bool parsed = false;
+	status_event_t ev;
+
+	for (subscriber_list_t *sb = subscribe_head, *next; sb != NULL; sb = next) {
+		next = sb->next;
+		if (!(sb->field & mask) || sb->finished) {
+			continue;
+		}
+		if (!is_report && !parsed && (sb->json || has_filter(sb))) {
+			va_list copy;
+			va_copy(copy, *args);
+			parse_event(fmt, &copy, &ev);
+			va_end(copy);
+			parsed = true;
+		}
+		if (parsed && has_filter(sb) && !event_matches(&ev, sb)) {
+			continue;
+		}
+		const char *out;
+		size_t len;
+		if (is_report) {
+			if (!cached_report(sb->json, &out, &len)) {
+				break;
+			}
+		} else if (sb->json) {
+			if (json == NULL && !format_json(&ev, &json, &json_len)) {
+				break;
+			}
+			out = json;
+			len = json_len;
+		} else {
+			if (text == NULL) {
+				va_list copy;
+				va_copy(copy, *args);
+				bool ok = format_text(fmt, &copy, &text, &text_len);
+				va_end(copy);
+				if (!ok) {
+					break;
+				}
+			}
+			out = text;
+			len = text_len;
+		}
+		if (sb->count > 0) {
+			sb->count--;
+		}
+		if (!queue_output(sb, out, len, is_report)) {
+			remove_subscriber(sb);
+		} else if (sb->count == 0) {
+			finish_subscriber(sb);
+		}
+	}
+
+	free(text);
+	free(json);
+}
+
+/* A report means the state it shows changed, the cached one is rendered
+ * anew. While held, the reports of a whole iteration are coalesced into
+ * one, sent after the other events it accounts for. */
+void put_status(subscriber_mask_t mask, ...)
+{
+	if (mask == SBSC_MASK_REPORT) {
+		invalidate_report();
+		if (hold_depth > 0) {
+			report_held = true;
+		} else {
+			send_status(mask, NULL, NULL);
+		}
+		return;
+	}
+	va_list args;
+	va_start(args, mask);
+	const char *fmt = va_arg(args, const char *);
+	send_status(mask, fmt, &args);
+	va_end(args);
+}
+
+void hold_status(void)
+{
+	hold_depth++;
+}
+
+void flush_status(void)
+{
+	if (report_held) {
+		report_held = false;
+		send_status(SBSC_MASK_REPORT, NULL, NULL);
+	}
+	subscriber_list_t *sb = subscribe_head;
+	while (sb != NULL) {
+		subscriber_list_t *next = sb->next;
+		if (sb->ring_len > 0 && !sb->polling) {
+			flush_subscriber(sb);
 		}
 		sb = next;
 	}
 }
 
+void release_status(void)
+{
+	if (hold_depth == 1) {
+		flush_status();
+	}
+	if (hold_depth > 0) {
+		hold_depth--;
+	}
+}
+
 void prune_dead_subscribers(void)
 {
 	subscriber_list_t *sb = subscribe_head;
@@ -27,6 +27,13 @@
 
 #define FIFO_TEMPLATE  "bspwm_fifo.XXXXXX"
 
+/* Output pending for a subscriber that isn't reading. What doesn't fit is
+ * handled according to the subscriber_overflow setting. */
+#define SUBSCRIBER_RING_SIZE  65536
+
+/* Bytes of queued lines discarded to make room, see make_room */
+extern uint64_t subscriber_dropped_bytes;
+
 typedef enum {
 	SBSC_MASK_REPORT = 1 << 0,
 	SBSC_MASK_MONITOR_ADD = 1 << 1,
@@ -65,9 +72,22 @@ typedef enum {
 subscriber_list_t *make_subscriber(FILE *stream, char *fifo_path, int field, int count);
 void remove_subscriber(subscriber_list_t *sb);
 void add_subscriber(subscriber_list_t *sb);
+void finish_subscriber(subscriber_list_t *sb);
+subscriber_list_t *find_subscriber(int fd);
+unsigned int subscriber_count(void);
+void flush_subscriber(subscriber_list_t *sb);
 int print_report(FILE *stream);
+void invalidate_report(void);
 void put_status(subscriber_mask_t mask, ...);
 
+/* Between hold_status and release_status, put_status only queues its
+ * output: the events of a whole main loop iteration reach a subscriber in
+ * one write, followed by a single report. flush_status sends the report
+ * and writes what is held so far. */
+void hold_status(void);
+void release_status(void);
+void flush_status(void);
+
 /* Remove any subscriber for which the stream has been closed and is no longer
  * writable. */
 void prune_dead_subscribers(void);
@@ -0,0 +1,59 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "trace.h"
+
+static trace_span_t spans[TRACE_CAPACITY];
+static uint64_t span_count;
+
+void trace_record(const char *category, const char *name, uint64_t start, uint64_t end, uint32_t arg)
+{
+	trace_span_t *s = &spans[span_count++ & (TRACE_CAPACITY - 1)];
+	s->category = category;
+	s->name = name;
+	s->start = start;
+	s->duration = end - start;
+	s->arg = arg;
+	TRACE_PROBE(category, name, start, s->duration, arg);
+}
+
+/* Chrome trace event format, complete events in microseconds */
+void print_trace(FILE *rsp)
+{
+	uint64_t first = span_count > TRACE_CAPACITY ? span_count - TRACE_CAPACITY : 0;
+	int pid = getpid();
+	fprintf(rsp, "{\"traceEvents\":[");
+	for (uint64_t i = first; i < span_count; i++) {
+		trace_span_t *s = &spans[i & (TRACE_CAPACITY - 1)];
+		fprintf(rsp, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%" PRIu64 ".%03" PRIu64
+		        ",\"dur\":%" PRIu64 ".%03" PRIu64 ",\"pid\":%i,\"tid\":%i,\"args\":{\"arg\":%" PRIu32 "}}",
+		        i > first ? "," : "", s->name, s->category, s->start / 1000, s->start % 1000,
+		        s->duration / 1000, s->duration % 1000, pid, pid, s->arg);
+	}
+	fprintf(rsp, "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%" PRIu64 "}}", first);
+}
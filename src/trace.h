@@ -0,0 +1,60 @@
+/* Copyright (c) 2012, Bastien Dejean
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BSPWM_TRACE_H
+#define BSPWM_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Number of spans kept, oldest overwritten first. A power of two. */
+#define TRACE_CAPACITY  4096
+
+/* Span categories besides the latency groups of stats.h */
+#define TRACE_ARRANGE      "arrange"
+#define TRACE_RULES        "rules"
+#define TRACE_SUBSCRIBERS  "subscribers"
+
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+#define TRACE_PROBE(category, name, start, duration, arg) \
+	DTRACE_PROBE5(bspwm, span, category, name, start, duration, arg)
+#else
+#define TRACE_PROBE(category, name, start, duration, arg)
+#endif
+
+typedef struct {
+	const char *category;
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+	uint32_t arg;
+} trace_span_t;
+
+/* Record a span from start to end, in latency_now() nanoseconds.
+ * category and name must be static strings. */
+void trace_record(const char *category, const char *name, uint64_t start, uint64_t end, uint32_t arg);
+void print_trace(FILE *rsp);
+
+#endif
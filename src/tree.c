@@ -41,11 +41,34 @@
 #include "window.h"
 #include "tree.h"
 #include "rule.h"
+#include "lookup.h"
+#include "pool.h"
+#include "stats.h"
+#include "trace.h"
+#include "intern.h"
 
 #define MAX_TREE_DEPTH 256
 #define SAFE_ADD(a, b, max) ((b) > 0 && (a) > (max) - (b)) ? (max) : (a) + (b)
 #define SAFE_SUB(a, b) ((a) < (b) ? 0 : (a) - (b))
 
+/* A window's node and its client, allocated together. */
+typedef struct {
+	node_t node;
+	client_t client;
+} leaf_chunk_t;
+
+static pool_t node_pool = POOL_INIT("node", node_t);
+static pool_t leaf_pool = POOL_INIT("leaf", leaf_chunk_t);
+static pool_t client_pool = POOL_INIT("client", client_t);
+static pool_t presel_pool = POOL_INIT("presel", presel_t);
+
+/* Feedback windows of cancelled preselections, kept unmapped for reuse:
+ * creating one is several requests to the X server. */
+#define PRESEL_SPARES  8
+static bspwm_wid_t presel_spares[PRESEL_SPARES];
+static unsigned int presel_spare_count;
+unsigned int presel_feedback_count;
+
 /* Secure memset that won't be optimized away */
 void secure_memzero(void *ptr, size_t len)
 {
@@ -55,12 +78,21 @@ void secure_memzero(void *ptr, size_t len)
 	}
 }
 
+/* While positive, arrange is deferred: see hold_arrange. */
+static unsigned int arrange_hold_depth;
+
 void arrange(monitor_t *m, desktop_t *d)
 {
 	if (!m || !d || !d->root) {
 		return;
 	}
 
+	if (arrange_hold_depth > 0) {
+		d->arrange_held = true;
+		return;
+	}
+
+	uint64_t start = latency_now();
 	bspwm_rect_t rect = m->rectangle;
 
 	rect.x = SAFE_ADD(rect.x, SAFE_ADD(m->padding.left, d->padding.left, UINT16_MAX), UINT16_MAX);
@@ -84,81 +116,203 @@ void arrange(monitor_t *m, desktop_t *d)
 		rect.height = SAFE_SUB(rect.height, d->window_gap);
 	}
 
+	/* A lone window's border depends on the monitor count */
+	if (is_leaf(d->root)) {
+		d->root->dirty = true;
+	}
+
 	apply_layout(m, d, d->root, rect, rect);
+	apply_pending_geometry(m, d);
+	trace_record(TRACE_ARRANGE, "arrange", start, latency_now(), d->id);
 }
 
-void apply_layout(monitor_t *m, desktop_t *d, node_t *n, bspwm_rect_t rect, bspwm_rect_t root_rect)
+void hold_arrange(void)
 {
-	if (!n || !m || !d) {
+	arrange_hold_depth++;
+}
+
+void flush_arrange(void)
+{
+	unsigned int depth = arrange_hold_depth;
+	arrange_hold_depth = 0;
+	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+			if (d->arrange_held) {
+				d->arrange_held = false;
+				arrange(m, d);
+			}
+		}
+	}
+	arrange_hold_depth = depth;
+}
+
+void release_arrange(void)
+{
+	if (arrange_hold_depth == 1) {
+		flush_arrange();
+	}
+	if (arrange_hold_depth > 0) {
+		arrange_hold_depth--;
+	}
+}
+
+/* Mark a node whose own layout inputs changed, and the path leading to it. */
+void mark_layout_dirty(node_t *n)
+{
+	for (int depth = 0; n && depth <= MAX_TREE_DEPTH; n = n->parent, depth++) {
+		n->dirty = true;
+	}
+}
+
+static void invalidate_layout_in_bounded(node_t *n, int depth)
+{
+	if (!n || depth > MAX_TREE_DEPTH) {
 		return;
 	}
+	n->dirty = true;
+	invalidate_layout_in_bounded(n->first_child, depth + 1);
+	invalidate_layout_in_bounded(n->second_child, depth + 1);
+}
 
-	n->rectangle = rect;
+/* Force a full layout pass over the subtree, for inputs shared by all its
+ * nodes: layout, gaps, borders, settings. */
+void invalidate_layout_in(node_t *n)
+{
+	invalidate_layout_in_bounded(n, 0);
+	mark_layout_dirty(n);
+}
 
-	if (n->presel) {
-		draw_presel_feedback(m, d, n);
+/* In monocle, a focused tiled window covers the tiled windows of its layer
+ * and those below: they are configured once they can show instead of on
+ * every pass, see apply_pending_geometry. */
+static bool monocle_covers(desktop_t *d)
+{
+	node_t *f = d->focus;
+	return d->layout == LAYOUT_MONOCLE && f && f->client && !f->hidden &&
+	       f->client->state == STATE_TILED;
+}
+
+static bool monocle_defers(desktop_t *d, node_t *n)
+{
+	return n != d->focus && monocle_covers(d) && IS_TILED(n->client) &&
+	       n->client->layer <= d->focus->client->layer;
+}
+
+/* Send the slot computed by apply_layout to the window of a leaf. */
+static void configure_leaf(monitor_t *m, desktop_t *d, node_t *n)
+{
+	unsigned int bw;
+	bool the_only_window = !m->prev && !m->next && d->root && d->root->client;
+
+	if ((borderless_monocle && d->layout == LAYOUT_MONOCLE && IS_TILED(n->client)) ||
+	    (borderless_singleton && the_only_window) ||
+	    n->client->state == STATE_FULLSCREEN) {
+		bw = 0;
+	} else {
+		bw = n->client->border_width;
 	}
 
-	if (is_leaf(n)) {
-		if (!n->client) {
-			return;
-		}
+	bspwm_rect_t rect = n->rectangle;
+	bspwm_rect_t r;
+	client_state_t s = n->client->state;
 
-		unsigned int bw;
-		bool the_only_window = !m->prev && !m->next && d->root && d->root->client;
+	if (s == STATE_TILED || s == STATE_PSEUDO_TILED) {
+		int wg = (gapless_monocle && d->layout == LAYOUT_MONOCLE ? 0 : d->window_gap);
+		r = rect;
 
-		if ((borderless_monocle && d->layout == LAYOUT_MONOCLE && IS_TILED(n->client)) ||
-		    (borderless_singleton && the_only_window) ||
-		    n->client->state == STATE_FULLSCREEN) {
+		if ((int)bw > (INT_MAX - wg) / 2) {
 			bw = 0;
-		} else {
-			bw = n->client->border_width;
 		}
 
-		bspwm_rect_t r;
-		bspwm_rect_t cr = get_window_rectangle(n);
-		client_state_t s = n->client->state;
+		int bleed = wg + 2 * (int)bw;
+		r.width = (bleed < (int)r.width ? r.width - bleed : 1);
+		r.height = (bleed < (int)r.height ? r.height - bleed : 1);
 
-		if (s == STATE_TILED || s == STATE_PSEUDO_TILED) {
-			int wg = (gapless_monocle && d->layout == LAYOUT_MONOCLE ? 0 : d->window_gap);
-			r = rect;
-
-			if ((int)bw > (INT_MAX - wg) / 2) {
-				bw = 0;
+		if (s == STATE_PSEUDO_TILED) {
+			bspwm_rect_t f = n->client->floating_rectangle;
+			r.width = MIN(r.width, f.width);
+			r.height = MIN(r.height, f.height);
+			if (center_pseudo_tiled) {
+				r.x = rect.x - bw + (rect.width - wg - r.width) / 2;
+				r.y = rect.y - bw + (rect.height - wg - r.height) / 2;
 			}
+		}
+		n->client->tiled_rectangle = r;
+	} else if (s == STATE_FLOATING) {
+		r = n->client->floating_rectangle;
+	} else {
+		r = m->rectangle;
+		n->client->tiled_rectangle = r;
+	}
 
-			int bleed = wg + 2 * (int)bw;
-			r.width = (bleed < (int)r.width ? r.width - bleed : 1);
-			r.height = (bleed < (int)r.height ? r.height - bleed : 1);
-
-			if (s == STATE_PSEUDO_TILED) {
-				bspwm_rect_t f = n->client->floating_rectangle;
-				r.width = MIN(r.width, f.width);
-				r.height = MIN(r.height, f.height);
-				if (center_pseudo_tiled) {
-					r.x = rect.x - bw + (rect.width - wg - r.width) / 2;
-					r.y = rect.y - bw + (rect.height - wg - r.height) / 2;
-				}
-			}
-			n->client->tiled_rectangle = r;
-		} else if (s == STATE_FLOATING) {
-			r = n->client->floating_rectangle;
+	apply_size_hints(n->client, &r.width, &r.height);
+
+	if (monocle_defers(d, n)) {
+		n->geometry_pending = true;
+		d->geometry_pending = true;
+		return;
+	}
+	n->geometry_pending = false;
+
+	if (!rect_eq(r, get_window_rectangle(n))) {
+		window_move_resize(n->id, r.x, r.y, r.width, r.height);
+		if (!grabbing) {
+			put_status(SBSC_MASK_NODE_GEOMETRY, "node_geometry 0x%08X 0x%08X 0x%08X %ux%u+%i+%i\n",
+		   m->id, d->id, n->id, r.width, r.height, r.x, r.y);
+		}
+	}
+
+	window_border_width(n->id, bw);
+}
+
+/* Configure the leaves whose slots were held back by monocle_defers and
+ * may show now: the focus and the windows raised above its layer, or all
+ * of them when nothing covers. */
+void apply_pending_geometry(monitor_t *m, desktop_t *d)
+{
+	if (!m || !d || !d->geometry_pending) {
+		return;
+	}
+
+	d->geometry_pending = false;
+	for (node_t *n = first_extrema(d->root); n; n = next_leaf(n, d->root)) {
+		if (!n->geometry_pending || !n->client) {
+			continue;
+		}
+		if (monocle_defers(d, n)) {
+			d->geometry_pending = true;
 		} else {
-			r = m->rectangle;
-			n->client->tiled_rectangle = r;
+			configure_leaf(m, d, n);
 		}
+	}
+}
 
-		apply_size_hints(n->client, &r.width, &r.height);
+void apply_layout(monitor_t *m, desktop_t *d, node_t *n, bspwm_rect_t rect, bspwm_rect_t root_rect)
+{
+	if (!n || !m || !d) {
+		return;
+	}
 
-		if (!rect_eq(r, cr)) {
-			window_move_resize(n->id, r.x, r.y, r.width, r.height);
-			if (!grabbing) {
-				put_status(SBSC_MASK_NODE_GEOMETRY, "node_geometry 0x%08X 0x%08X 0x%08X %ux%u+%i+%i\n",
-			   m->id, d->id, n->id, r.width, r.height, r.x, r.y);
-			}
+	/* Nothing below changed and the slot is the same: the previous pass
+	 * still holds for the whole subtree. */
+	if (!n->dirty && rect_eq(rect, n->rectangle)) {
+		return;
+	}
+
+	n->dirty = false;
+	n->rectangle = rect;
+
+	if (n->presel) {
+		draw_presel_feedback(m, d, n);
+	}
+
+	if (is_leaf(n)) {
+		if (!n->client) {
+			return;
 		}
 
-		window_border_width(n->id, bw);
+		spatial_index_invalidate(d);
+		configure_leaf(m, d, n);
 	} else {
 		if (!n->first_child || !n->second_child) {
 			return;
@@ -213,9 +367,39 @@ void apply_layout(monitor_t *m, desktop_t *d, node_t *n, bspwm_rect_t rect, bspw
 	}
 }
 
+bspwm_wid_t acquire_presel_feedback(void)
+{
+	uint32_t color = backend_get_color_pixel(presel_feedback_color);
+	bspwm_wid_t win;
+	if (presel_spare_count > 0) {
+		win = presel_spares[--presel_spare_count];
+		backend_set_presel_feedback_color(win, color);
+	} else {
+		win = backend_create_presel_feedback(color);
+	}
+	if (win != BSPWM_WID_NONE) {
+		presel_feedback_count++;
+	}
+	return win;
+}
+
+void release_presel_feedback(bspwm_wid_t win)
+{
+	if (win == BSPWM_WID_NONE) {
+		return;
+	}
+	presel_feedback_count--;
+	if (presel_spare_count < PRESEL_SPARES) {
+		window_hide(win);
+		presel_spares[presel_spare_count++] = win;
+	} else {
+		backend_destroy_window(win);
+	}
+}
+
 presel_t *make_presel(void)
 {
-	presel_t *p = calloc(1, sizeof(presel_t));
+	presel_t *p = pool_alloc(&presel_pool);
 	if (!p) {
 		return NULL;
 	}
@@ -232,6 +416,7 @@ bool set_type(node_t *n, split_type_t typ)
 	}
 
 	n->split_type = typ;
+	mark_layout_dirty(n);
 	update_constraints(n);
 	rebuild_constraints_towards_root(n);
 	return true;
@@ -244,6 +429,7 @@ bool set_ratio(node_t *n, double rat)
 	}
 
 	n->split_ratio = rat;
+	mark_layout_dirty(n);
 	return true;
 }
 
@@ -261,6 +447,7 @@ void presel_dir(monitor_t *m, desktop_t *d, node_t *n, direction_t dir)
 	}
 
 	n->presel->split_dir = dir;
+	mark_layout_dirty(n);
 	put_status(SBSC_MASK_NODE_PRESEL, "node_presel 0x%08X 0x%08X 0x%08X dir %s\n",
 	           m->id, d->id, n->id, SPLIT_DIR_STR(dir));
 }
@@ -279,6 +466,7 @@ void presel_ratio(monitor_t *m, desktop_t *d, node_t *n, double ratio)
 	}
 
 	n->presel->split_ratio = ratio;
+	mark_layout_dirty(n);
 	put_status(SBSC_MASK_NODE_PRESEL, "node_presel 0x%08X 0x%08X 0x%08X ratio %lf\n",
 	           m->id, d->id, n->id, ratio);
 }
@@ -289,12 +477,11 @@ void cancel_presel(monitor_t *m, desktop_t *d, node_t *n)
 		return;
 	}
 
-	if (n->presel->feedback != BSPWM_WID_NONE) {
-		backend_destroy_window(n->presel->feedback);
-	}
+	release_presel_feedback(n->presel->feedback);
 
-	free(n->presel);
+	pool_free(&presel_pool, n->presel);
 	n->presel = NULL;
+	mark_layout_dirty(n);
 
 	if (m && d) {
 		put_status(SBSC_MASK_NODE_PRESEL, "node_presel 0x%08X 0x%08X 0x%08X cancel\n",
@@ -370,54 +557,6 @@ bool window_ignores_tile_limits(bspwm_wid_t win)
 	return false;
 }
 
-static void count_tiled_nodes_iterative(node_t *root, int *count)
-{
-	if (!root || !count) {
-		return;
-	}
-
-	node_t *stack[1024];
-	int stack_top = 0;
-
-	stack[stack_top++] = root;
-
-	while (stack_top > 0) {
-		if (stack_top >= 1024) {
-			break;
-		}
-
-		node_t *n = stack[--stack_top];
-		if (!n) {
-			continue;
-		}
-
-		if (n->client && !IS_FLOATING(n->client)) {
-			if (*count >= INT_MAX - 1) {
-				break;
-			}
-			(*count)++;
-		}
-
-		if (n->second_child && stack_top < 1023) {
-			stack[stack_top++] = n->second_child;
-		}
-		if (n->first_child && stack_top < 1023) {
-			stack[stack_top++] = n->first_child;
-		}
-	}
-}
-
-int count_tiled_windows(desktop_t *d)
-{
-	if (!d || !d->root) {
-		return 0;
-	}
-
-	int count = 0;
-	count_tiled_nodes_iterative(d->root, &count);
-	return count;
-}
-
 node_t *insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f)
 {
 	if (!d || !n) {
@@ -432,7 +571,7 @@ node_t *insert_node(monitor_t *m, desktop_t *d, node_t *n, node_t *f)
 		goto insert_node;
 	}
 
-	int current_tiles = count_tiled_windows(d);
+	int current_tiles = d->root ? (int) d->root->counts.tiles : 0;
 	if (current_tiles >= d->max_tiles_per_desktop) {
 		// Force window to be floating when tile limit is reached
 		// This keeps it managed by bspwm instead of becoming unmanaged
@@ -464,7 +603,9 @@ insert_node:
 			d->root = n;
 		}
 		n->parent = p;
-		free(f);
+		flag_index_remove(m, d, f);
+		node_registry_remove(f);
+		pool_free(&node_pool, f);
 		f = NULL;
 	} else {
 		node_t *c = make_node(BSPWM_WID_NONE);
@@ -589,6 +730,11 @@ insert_node:
 		}
 	}
 
+	link_leaves(n);
+	window_index_add_in(m, d, n);
+	flag_index_add_in(m, d, n);
+	mark_layout_dirty(n);
+	update_counts(n);
 	propagate_flags_upward(m, d, n);
 
 	if (!d->focus && is_focusable(n)) {
@@ -662,6 +808,7 @@ bool activate_node(monitor_t *m, desktop_t *d, node_t *n)
 	}
 
 	d->focus = n;
+	apply_pending_geometry(m, d);
 	history_add(m, d, n, false);
 	put_status(SBSC_MASK_REPORT);
 
@@ -766,17 +913,25 @@ bool focus_node(monitor_t *m, desktop_t *d, node_t *n)
 		set_urgent(m, d, n, false);
 	}
 
+	/* The focus borders of hidden desktops are redrawn by show_desktop */
 	if (mon != m) {
 		if (mon) {
 			for (desktop_t *e = mon->desk_head; e; e = e->next) {
-				draw_border(e->focus, true, false);
+				if (e == mon->desk) {
+					draw_border(e->focus, true, false);
+				} else {
+					e->stale_colors = true;
+				}
 			}
 		}
 		for (desktop_t *e = m->desk_head; e; e = e->next) {
 			if (e == d) {
 				continue;
+			} else if (e == m->desk) {
+				draw_border(e->focus, true, true);
+			} else {
+				e->stale_colors = true;
 			}
-			draw_border(e->focus, true, true);
 		}
 	}
 
@@ -817,6 +972,7 @@ bool focus_node(monitor_t *m, desktop_t *d, node_t *n)
 	}
 
 	d->focus = n;
+	apply_pending_geometry(m, d);
 	if (!has_input_focus) {
 		set_input_focus(n);
 	}
@@ -854,15 +1010,17 @@ static void hide_node_bounded(desktop_t *d, node_t *n, int depth)
 		return;
 	}
 
-	if (!n->hidden) {
-		if (n->presel && d->layout != LAYOUT_MONOCLE) {
-			window_hide(n->presel->feedback);
-		}
-		if (n->client) {
-			window_hide(n->id);
-		}
+	if (!n->hidden && n->presel && d->layout != LAYOUT_MONOCLE) {
+		window_hide(n->presel->feedback);
 	}
 	if (n->client) {
+		/* Parked windows stay mapped: switching back doesn't make
+		 * their clients redraw */
+		if (composited_switching) {
+			window_park(n->id, true);
+		} else if (!n->hidden) {
+			window_hide(n->id);
+		}
 		if (n->client->shown) {
 			warn("hide_node: 0x%08X shown=false (was true)\n", n->id);
 		}
@@ -883,20 +1041,20 @@ static void show_node_bounded(desktop_t *d, node_t *n, int depth)
 		return;
 	}
 
-	if (!n->hidden) {
-		if (n->client) {
+	if (n->client) {
+		if (composited_switching) {
+			window_park(n->id, false);
+		} else if (!n->hidden) {
 			window_show(n->id);
 		}
-		if (n->presel && d->layout != LAYOUT_MONOCLE) {
-			window_show(n->presel->feedback);
-		}
-	}
-	if (n->client) {
 		if (!n->client->shown) {
 			warn("show_node: 0x%08X shown=true (was false)\n", n->id);
 		}
 		n->client->shown = true;
 	}
+	if (!n->hidden && n->presel && d->layout != LAYOUT_MONOCLE) {
+		window_show(n->presel->feedback);
+	}
 	show_node_bounded(d, n->first_child, depth + 1);
 	show_node_bounded(d, n->second_child, depth + 1);
 }
@@ -906,38 +1064,52 @@ void show_node(desktop_t *d, node_t *n)
 	show_node_bounded(d, n, 0);
 }
 
-node_t *make_node(uint32_t id)
+/* The first and last leaves of the subtree walked by the last
+ * next_leaf/prev_leaf call, so that the following steps of the walk
+ * don't look them up again. Whatever reshapes a thread or makes a node
+ * forgets them. */
+static struct {
+	node_t *root;
+	node_t *first;
+	node_t *last;
+} leaf_bound;
+
+static void forget_leaf_bound(void)
+{
+	leaf_bound.root = NULL;
+}
+
+static void init_node(node_t *n, uint32_t id)
 {
+	forget_leaf_bound();
 	if (id == BSPWM_WID_NONE) {
 		id = ++id_counter;
 	}
-	node_t *n = calloc(1, sizeof(node_t));
-	if (!n) {
-		return NULL;
-	}
 	n->id = id;
 	n->parent = n->first_child = n->second_child = NULL;
+	n->leaf_prev = n->leaf_next = NULL;
 	n->vacant = n->hidden = n->sticky = n->private = n->locked = n->marked = false;
 	n->split_ratio = split_ratio;
 	n->split_type = TYPE_VERTICAL;
 	n->constraints = (constraints_t){MIN_WIDTH, MIN_HEIGHT};
+	n->counts = (node_counts_t){0};
 	n->presel = NULL;
 	n->client = NULL;
-	return n;
+	n->dirty = true;
+	n->geometry_pending = false;
+	node_registry_add(n);
 }
 
-client_t *make_client(void)
+static bool init_client(client_t *c)
 {
-	client_t *c = calloc(1, sizeof(client_t));
-	if (!c) {
-		return NULL;
+	c->class_name = intern(MISSING_VALUE);
+	if (c->class_name == NULL) {
+		return false;
 	}
+	c->instance_name = intern_ref(c->class_name);
+	c->name = NULL;
 	c->state = c->last_state = STATE_TILED;
 	c->layer = c->last_layer = LAYER_NORMAL;
-	strncpy(c->class_name, MISSING_VALUE, sizeof(c->class_name) - 1);
-	c->class_name[sizeof(c->class_name) - 1] = '\0';
-	strncpy(c->instance_name, MISSING_VALUE, sizeof(c->instance_name) - 1);
-	c->instance_name[sizeof(c->instance_name) - 1] = '\0';
 	c->border_width = border_width;
 	c->urgent = false;
 	c->shown = false;
@@ -947,9 +1119,95 @@ client_t *make_client(void)
 	c->icccm_props.delete_window = false;
 	c->size_hints.flags = 0;
 	c->honor_size_hints = honor_size_hints;
+	c->configure_period = c->configure_applied = 0;
+	c->configure_count = 0;
+	c->configure_deferred = false;
+	return true;
+}
+
+/* Releases what a client holds outside of itself. */
+static void release_client(client_t *c)
+{
+	intern_release(c->class_name);
+	intern_release(c->instance_name);
+	free(c->name);
+}
+
+node_t *make_node(uint32_t id)
+{
+	node_t *n = pool_alloc(&node_pool);
+	if (!n) {
+		return NULL;
+	}
+	init_node(n, id);
+	return n;
+}
+
+/* Makes the node of a window, with its client right after it in memory. */
+node_t *make_leaf(uint32_t id)
+{
+	leaf_chunk_t *l = pool_alloc(&leaf_pool);
+	if (!l) {
+		return NULL;
+	}
+	if (!init_client(&l->client)) {
+		pool_free(&leaf_pool, l);
+		return NULL;
+	}
+	init_node(&l->node, id);
+	l->node.client = &l->client;
+	l->node.embedded_client = true;
+	return &l->node;
+}
+
+/* Sizes the node and client pools for a tree of count windows at once,
+ * ahead of a restore. */
+void reserve_nodes(size_t count)
+{
+	pool_reserve(&node_pool, 2 * count);
+	pool_reserve(&client_pool, count);
+}
+
+client_t *make_client(void)
+{
+	client_t *c = pool_alloc(&client_pool);
+	if (!c) {
+		return NULL;
+	}
+	if (!init_client(c)) {
+		pool_free(&client_pool, c);
+		return NULL;
+	}
 	return c;
 }
 
+/* Interns the class and instance names of a client: clients of the same
+ * program share them and compare them by pointer. */
+void set_client_class(client_t *c, const char *class_name, const char *instance_name)
+{
+	const char *cn = intern(class_name);
+	const char *in = intern(instance_name);
+	if (cn == NULL || in == NULL) {
+		intern_release(cn);
+		intern_release(in);
+		return;
+	}
+	intern_release(c->class_name);
+	intern_release(c->instance_name);
+	c->class_name = cn;
+	c->instance_name = in;
+}
+
+void set_client_name(client_t *c, const char *name)
+{
+	char *copy = NULL;
+	if (name != NULL && (copy = strdup(name)) == NULL) {
+		return;
+	}
+	free(c->name);
+	c->name = copy;
+}
+
 /*
  * Pipelined client initialization - sends all 4 property requests at once.
  * Reduces 4 sequential X11 round-trips to 1 batch (~2000μs → ~500μs).
@@ -995,19 +1253,9 @@ bool is_second_child(node_t *n)
 	return n && n->parent && n->parent->second_child == n;
 }
 
-static unsigned int clients_count_in_bounded(node_t *n, int depth)
-{
-	if (!n || depth > MAX_TREE_DEPTH) {
-		return 0;
-	}
-	return (n->client ? 1 : 0) +
-	       clients_count_in_bounded(n->first_child, depth + 1) +
-	       clients_count_in_bounded(n->second_child, depth + 1);
-}
-
 unsigned int clients_count_in(node_t *n)
 {
-	return clients_count_in_bounded(n, 0);
+	return n ? n->counts.clients : 0;
 }
 
 node_t *brother_tree(node_t *n)
@@ -1080,20 +1328,16 @@ void free_node_list(node_list_t *list)
 	free(list);
 }
 
-static node_t *second_extrema_bounded(node_t *n, int depth)
-{
-	if (!n || depth > MAX_TREE_DEPTH) {
-		return NULL;
-	}
-	if (!n->second_child) {
-		return n;
-	}
-	return second_extrema_bounded(n->second_child, depth + 1);
-}
-
 node_t *second_extrema(node_t *n)
 {
-	return second_extrema_bounded(n, 0);
+	if (!n) return NULL;
+
+	int depth = 0;
+	while (n->second_child && depth < MAX_TREE_DEPTH) {
+		n = n->second_child;
+		depth++;
+	}
+	return n;
 }
 
 node_t *first_focusable_leaf(node_t *n)
@@ -1156,25 +1400,32 @@ node_t *prev_node(node_t *n)
 	return NULL;
 }
 
+static void bound_leaves(node_t *r)
+{
+	if (r != leaf_bound.root) {
+		leaf_bound.root = r;
+		leaf_bound.first = first_extrema(r);
+		leaf_bound.last = second_extrema(r);
+	}
+}
+
+/* The leaves of a tree are threaded in order through leaf_prev and
+ * leaf_next: a walk takes one step per leaf. A walk in a subtree r ends
+ * at its extreme leaves, looked up once per walk. */
 node_t *next_leaf(node_t *n, node_t *r)
 {
 	if (!n) {
 		return NULL;
 	}
 
-	node_t *p = n;
-	while (is_second_child(p) && p != r) {
-		p = p->parent;
-		if (!p) {
+	if (r && r->parent) {
+		bound_leaves(r);
+		if (n == leaf_bound.last) {
 			return NULL;
 		}
 	}
 
-	if (p == r || !p->parent) {
-		return NULL;
-	}
-
-	return first_extrema(p->parent->second_child);
+	return n->leaf_next;
 }
 
 node_t *prev_leaf(node_t *n, node_t *r)
@@ -1183,19 +1434,102 @@ node_t *prev_leaf(node_t *n, node_t *r)
 		return NULL;
 	}
 
-	node_t *p = n;
-	while (is_first_child(p) && p != r) {
-		p = p->parent;
-		if (!p) {
+	if (r && r->parent) {
+		bound_leaves(r);
+		if (n == leaf_bound.first) {
 			return NULL;
 		}
 	}
 
-	if (p == r || !p->parent) {
-		return NULL;
+	return n->leaf_prev;
+}
+
+/* The leaves around the subtree n, found through the tree itself */
+static node_t *leaf_before(node_t *n)
+{
+	while (is_first_child(n)) {
+		n = n->parent;
 	}
+	return (n && n->parent) ? second_extrema(n->parent->first_child) : NULL;
+}
 
-	return second_extrema(p->parent->first_child);
+static node_t *leaf_after(node_t *n)
+{
+	while (is_second_child(n)) {
+		n = n->parent;
+	}
+	return (n && n->parent) ? first_extrema(n->parent->second_child) : NULL;
+}
+
+/* Threads the leaves of n, already threaded among themselves, between
+ * the leaves around n. */
+void link_leaves(node_t *n)
+{
+	forget_leaf_bound();
+	node_t *first = first_extrema(n);
+	node_t *last = second_extrema(n);
+	if (!first || !last) {
+		return;
+	}
+	first->leaf_prev = leaf_before(n);
+	if (first->leaf_prev) {
+		first->leaf_prev->leaf_next = first;
+	}
+	last->leaf_next = leaf_after(n);
+	if (last->leaf_next) {
+		last->leaf_next->leaf_prev = last;
+	}
+}
+
+/* Takes the leaves of n out of the thread of its tree, before n is. */
+void unlink_leaves(node_t *n)
+{
+	forget_leaf_bound();
+	node_t *first = first_extrema(n);
+	node_t *last = second_extrema(n);
+	if (!first || !last) {
+		return;
+	}
+	if (first->leaf_prev) {
+		first->leaf_prev->leaf_next = last->leaf_next;
+	}
+	if (last->leaf_next) {
+		last->leaf_next->leaf_prev = first->leaf_prev;
+	}
+	first->leaf_prev = last->leaf_next = NULL;
+}
+
+/* Rethreads the leaves of n after its shape changed. */
+void relink_leaves(node_t *n)
+{
+	if (!n) {
+		return;
+	}
+
+	forget_leaf_bound();
+
+	node_t *stack[MAX_TREE_DEPTH];
+	int stack_top = 0;
+	node_t *prev = NULL;
+	stack[stack_top++] = n;
+
+	while (stack_top > 0) {
+		node_t *f = stack[--stack_top];
+		if (is_leaf(f)) {
+			f->leaf_prev = prev;
+			if (prev) {
+				prev->leaf_next = f;
+			}
+			prev = f;
+		} else {
+			if (f->second_child && stack_top < MAX_TREE_DEPTH - 1)
+				stack[stack_top++] = f->second_child;
+			if (f->first_child && stack_top < MAX_TREE_DEPTH - 1)
+				stack[stack_top++] = f->first_child;
+		}
+	}
+
+	link_leaves(n);
 }
 
 node_t *next_tiled_leaf(node_t *n, node_t *r)
@@ -1274,12 +1608,57 @@ bool is_descendant(node_t *a, node_t *b)
 	return a == b;
 }
 
+/* Tells whether a comes before b in the preorder of their common tree. */
+bool precedes(node_t *a, node_t *b)
+{
+	int da = 0, db = 0;
+	for (node_t *p = a; p->parent; p = p->parent) {
+		da++;
+	}
+	for (node_t *p = b; p->parent; p = p->parent) {
+		db++;
+	}
+
+	node_t *pa = a, *pb = b;
+	for (; da > db; da--) {
+		pa = pa->parent;
+	}
+	for (; db > da; db--) {
+		pb = pb->parent;
+	}
+	if (pa == pb) {
+		return pa == a && a != b;
+	}
+	while (pa->parent != pb->parent) {
+		pa = pa->parent;
+		pb = pb->parent;
+	}
+	return pa == pa->parent->first_child;
+}
+
 bool find_by_id(uint32_t id, coordinates_t *loc)
 {
+	node_t *n = node_registry_get(id);
+	if (!n) {
+		return false;
+	}
+
+	coordinates_t wloc;
+	if (n->client && window_index_get(id, &wloc) && wloc.node == n) {
+		if (loc) {
+			*loc = wloc;
+		}
+		return true;
+	}
+
+	node_t *r = n;
+	for (int depth = 0; r->parent && depth < MAX_TREE_DEPTH; depth++) {
+		r = r->parent;
+	}
+
 	for (monitor_t *m = mon_head; m; m = m->next) {
 		for (desktop_t *d = m->desk_head; d; d = d->next) {
-			node_t *n = find_by_id_in(d->root, id);
-			if (n) {
+			if (d->root == r) {
 				if (loc) {
 					loc->monitor = m;
 					loc->desktop = d;
@@ -1292,31 +1671,42 @@ bool find_by_id(uint32_t id, coordinates_t *loc)
 	return false;
 }
 
-static node_t *find_by_id_in_bounded(node_t *r, uint32_t id, int depth)
-{
-	if (!r || depth > MAX_TREE_DEPTH) {
-		return NULL;
-	}
-	if (r->id == id) {
-		return r;
-	}
-	node_t *f = find_by_id_in_bounded(r->first_child, id, depth + 1);
-	if (f) {
-		return f;
-	}
-	return find_by_id_in_bounded(r->second_child, id, depth + 1);
-}
-
 node_t *find_by_id_in(node_t *r, uint32_t id)
 {
-	return find_by_id_in_bounded(r, id, 0);
+	node_t *n = node_registry_get(id);
+	return is_descendant(n, r) ? n : NULL;
 }
 
+/* When the selector requires flags, only the desktops having all of them
+ * are searched, through the list of the rarest one. */
 void find_any_node(coordinates_t *ref, coordinates_t *dst, node_select_t *sel)
 {
+	uint8_t flags = sel ? NODE_FLAGS_OF_MODIFIERS(sel->mask & sel->want) : 0;
+	node_flag_t f;
+
 	for (monitor_t *m = mon_head; m; m = m->next) {
+		if (flags && !flag_index_rarest(m->flag_count, flags, &f)) {
+			continue;
+		}
 		for (desktop_t *d = m->desk_head; d; d = d->next) {
-			if (find_any_node_in(m, d, d->root, ref, dst, sel)) {
+			if (!flags) {
+				if (find_any_node_in(m, d, d->root, ref, dst, sel)) {
+					return;
+				}
+				continue;
+			}
+			if (!flag_index_rarest(d->flag_count, flags, &f)) {
+				continue;
+			}
+			node_t *first = NULL;
+			for (node_t *n = d->flag_head[f]; n; n = n->flag_next[f]) {
+				coordinates_t loc = {m, d, n};
+				if ((!first || precedes(n, first)) && node_matches(&loc, ref, sel)) {
+					first = n;
+				}
+			}
+			if (first) {
+				*dst = (coordinates_t) {m, d, first};
 				return;
 			}
 		}
@@ -1365,39 +1755,118 @@ void find_first_ancestor(coordinates_t *ref, coordinates_t *dst, node_select_t *
 	}
 }
 
-void find_nearest_neighbor(coordinates_t *ref, coordinates_t *dst, direction_t dir, node_select_t *sel)
+typedef struct {
+	coordinates_t *ref;
+	node_select_t *sel;
+	bspwm_rect_t rect;
+	direction_t dir;
+	coordinates_t *dst;
+	uint32_t distance;
+	uint64_t rank;
+	uint32_t order;  /* leaf order of dst in its desktop */
+} neighbor_search_t;
+
+/* Ties on distance go to the most recently focused window, then to the
+ * first one in monitor and leaf order. */
+static void consider_neighbor(neighbor_search_t *ns, monitor_t *m, desktop_t *d, node_t *f, uint32_t order)
 {
-	if (!ref || !ref->monitor || !ref->desktop || !ref->node) {
+	coordinates_t loc = {m, d, f};
+	bspwm_rect_t r = get_rectangle(m, d, f);
+
+	if (f == ns->ref->node || !f->client || f->hidden ||
+	    is_descendant(f, ns->ref->node) || !node_matches(&loc, ns->ref, ns->sel) ||
+	    !on_dir_side(ns->rect, r, ns->dir)) {
 		return;
 	}
 
-	bspwm_rect_t rect = get_rectangle(ref->monitor, ref->desktop, ref->node);
-	uint32_t md = UINT32_MAX, mr = UINT32_MAX;
+	uint32_t fd = boundary_distance(ns->rect, r, ns->dir);
+	uint64_t fr = history_rank(f);
 
-	for (monitor_t *m = mon_head; m; m = m->next) {
-		desktop_t *d = m->desk;
-		if (!d) {
-			continue;
-		}
+	if (fd < ns->distance || (fd == ns->distance &&
+	    (fr < ns->rank || (fr == ns->rank && order < ns->order)))) {
+		ns->distance = fd;
+		ns->rank = fr;
+		ns->order = order;
+		*ns->dst = loc;
+	}
+}
 
-		for (node_t *f = first_extrema(d->root); f; f = next_leaf(f, d->root)) {
-			coordinates_t loc = {m, d, f};
-			bspwm_rect_t r = get_rectangle(m, d, f);
+/* The non-floating leaves are visited by increasing distance of their
+ * facing edge to the reference rectangle, until it exceeds the best
+ * distance found. */
+static void nearest_in_desktop(neighbor_search_t *ns, monitor_t *m, desktop_t *d)
+{
+	/* Windows of later desktops lose ties */
+	ns->order = 0;
 
-			if (f == ref->node || !f->client || f->hidden ||
-			    is_descendant(f, ref->node) || !node_matches(&loc, ref, sel) ||
-			    !on_dir_side(rect, r, dir)) {
-				continue;
+	spatial_index_t *s = spatial_index_get(d);
+	if (s == NULL) {
+		uint32_t order = 0;
+		for (node_t *f = first_extrema(d->root); f; f = next_leaf(f, d->root)) {
+			if (f->client) {
+				consider_neighbor(ns, m, d, f, order++);
 			}
+		}
+		return;
+	}
 
-			uint32_t fd = boundary_distance(rect, r, dir);
-			uint32_t fr = history_rank(f);
+	bspwm_point_t r_max = {ns->rect.x + ns->rect.width - 1, ns->rect.y + ns->rect.height - 1};
+	int32_t target;
+	switch (ns->dir) {
+		case DIR_NORTH: target = ns->rect.y; break;
+		case DIR_WEST: target = ns->rect.x; break;
+		case DIR_SOUTH: target = r_max.y; break;
+		default: target = r_max.x; break;
+	}
 
-			if (fd < md || (fd == md && fr < mr)) {
-				md = fd;
-				mr = fr;
-				*dst = loc;
-			}
+	spatial_key_t *keys = s->keys[ns->dir];
+	uint32_t lo = 0, hi = s->tiled_count;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (keys[mid].key < target) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	/* keys[below - 1] and keys[hi] are the nearest unvisited keys on each side */
+	uint32_t below = lo;
+	while (below > 0 || hi < s->tiled_count) {
+		uint32_t db = below > 0 ? (uint32_t) (target - keys[below - 1].key) : UINT32_MAX;
+		uint32_t da = hi < s->tiled_count ? (uint32_t) (keys[hi].key - target) : UINT32_MAX;
+		spatial_key_t *k = db <= da ? &keys[--below] : &keys[hi++];
+		if (MIN(db, da) > ns->distance) {
+			break;
+		}
+		spatial_entry_t *e = &s->entries[k->entry];
+		consider_neighbor(ns, m, d, e->node, e->order);
+	}
+
+	for (uint32_t i = s->tiled_count; i < s->tiled_count + s->floating_count; i++) {
+		consider_neighbor(ns, m, d, s->entries[i].node, s->entries[i].order);
+	}
+}
+
+void find_nearest_neighbor(coordinates_t *ref, coordinates_t *dst, direction_t dir, node_select_t *sel)
+{
+	if (!ref || !ref->monitor || !ref->desktop || !ref->node) {
+		return;
+	}
+
+	neighbor_search_t ns = {
+		.ref = ref,
+		.sel = sel,
+		.rect = get_rectangle(ref->monitor, ref->desktop, ref->node),
+		.dir = dir,
+		.dst = dst,
+		.distance = UINT32_MAX,
+		.rank = UINT64_MAX,
+	};
+
+	for (monitor_t *m = mon_head; m; m = m->next) {
+		if (m->desk) {
+			nearest_in_desktop(&ns, m, m->desk);
 		}
 	}
 }
@@ -1415,15 +1884,7 @@ int tiled_count(node_t *n, bool include_receptacles)
 	if (!n) {
 		return 0;
 	}
-
-	int cnt = 0;
-	for (node_t *f = first_extrema(n); f; f = next_leaf(f, n)) {
-		if (!f->hidden && ((include_receptacles && !f->client) ||
-		                   (f->client && IS_TILED(f->client)))) {
-			cnt++;
-		}
-	}
-	return cnt;
+	return (int) (n->counts.tiled + (include_receptacles ? n->counts.receptacles : 0));
 }
 
 void find_by_area(area_peak_t ap, coordinates_t *ref, coordinates_t *dst, node_select_t *sel)
@@ -1452,6 +1913,8 @@ void find_by_area(area_peak_t ap, coordinates_t *ref, coordinates_t *dst, node_s
 void rotate_tree(node_t *n, int deg)
 {
 	rotate_tree_rec(n, deg);
+	relink_leaves(n);
+	invalidate_layout_in(n);
 	rebuild_constraints_from_leaves(n);
 	rebuild_constraints_towards_root(n);
 }
@@ -1513,6 +1976,8 @@ static void flip_tree_bounded(node_t *n, flip_t flp, int depth)
 void flip_tree(node_t *n, flip_t flp)
 {
 	flip_tree_bounded(n, flp, 0);
+	relink_leaves(n);
+	invalidate_layout_in(n);
 }
 
 static void equalize_tree_bounded(node_t *n, int depth)
@@ -1529,6 +1994,7 @@ static void equalize_tree_bounded(node_t *n, int depth)
 void equalize_tree(node_t *n)
 {
 	equalize_tree_bounded(n, 0);
+	invalidate_layout_in(n);
 }
 
 static int balance_tree_bounded(node_t *n, int depth)
@@ -1554,7 +2020,9 @@ static int balance_tree_bounded(node_t *n, int depth)
 
 int balance_tree(node_t *n)
 {
-	return balance_tree_bounded(n, 0);
+	int b = balance_tree_bounded(n, 0);
+	invalidate_layout_in(n);
+	return b;
 }
 
 static void adjust_ratios_bounded(node_t *n, bspwm_rect_t rect, int depth)
@@ -1613,6 +2081,7 @@ static void adjust_ratios_bounded(node_t *n, bspwm_rect_t rect, int depth)
 void adjust_ratios(node_t *n, bspwm_rect_t rect)
 {
 	adjust_ratios_bounded(n, rect, 0);
+	invalidate_layout_in(n);
 }
 
 void unlink_node(monitor_t *m, desktop_t *d, node_t *n)
@@ -1621,11 +2090,11 @@ void unlink_node(monitor_t *m, desktop_t *d, node_t *n)
 		return;
 	}
 
-	/* Any node about to be unlinked, freed, or moved to another desktop
-	 * (transfer_node) may be cached in locate_window with now-stale
-	 * coordinates. Invalidate here so every structural change is covered,
-	 * not just remove_node. */
-	locate_window_cache_clear();
+	/* The windows of a node about to be freed or moved to another desktop
+	 * (transfer_node) leave the indexes here, insert_node adds them back. */
+	window_index_remove_in(n);
+	flag_index_remove_in(m, d, n);
+	unlink_leaves(n);
 
 	node_t *p = n->parent;
 
@@ -1680,10 +2149,13 @@ void unlink_node(monitor_t *m, desktop_t *d, node_t *n)
 			}
 		}
 
-		free(p);
+		flag_index_remove(m, d, p);
+		node_registry_remove(p);
+		pool_free(&node_pool, p);
 		n->parent = NULL;
 
 		if (b) {
+			mark_layout_dirty(b);
 			propagate_flags_upward(m, d, b);
 		}
 	}
@@ -1737,8 +2209,6 @@ void remove_node(monitor_t *m, desktop_t *d, node_t *n)
 		return;
 	}
 
-	locate_window_cache_clear();
-
 	unlink_node(m, d, n);
 	history_remove(d, n, true);
 	remove_stack_node(n);
@@ -1760,7 +2230,7 @@ void remove_node(monitor_t *m, desktop_t *d, node_t *n)
 		set_layout(m, d, LAYOUT_MONOCLE, false);
 	}
 
-	ewmh_update_client_lists();
+	ewmh_update_client_list(true);
 
 	if (mon && !d->focus) {
 		if (d == mon->desk) {
@@ -1785,19 +2255,27 @@ static void free_node_bounded(node_t *n, int depth)
 	n->parent = NULL;
 
 	if (n->client) {
+		window_index_remove(n->id);
+		ewmh_client_list_remove(n->id);
+		release_client(n->client);
 		secure_memzero(n->client, sizeof(client_t));
-		free(n->client);
+		if (!n->embedded_client) {
+			pool_free(&client_pool, n->client);
+		}
 		n->client = NULL;
 	}
 
 	if (n->presel) {
+		release_presel_feedback(n->presel->feedback);
 		secure_memzero(n->presel, sizeof(presel_t));
-		free(n->presel);
+		pool_free(&presel_pool, n->presel);
 		n->presel = NULL;
 	}
 
+	node_registry_remove(n);
+	bool embedded = n->embedded_client;
 	secure_memzero(n, sizeof(node_t));
-	free(n);
+	pool_free(embedded ? &leaf_pool : &node_pool, n);
 
 	free_node_bounded(first_child, depth + 1);
 	free_node_bounded(second_child, depth + 1);
@@ -1852,12 +2330,12 @@ bool swap_nodes(monitor_t *m1, desktop_t *d1, node_t *n1, monitor_t *m2, desktop
 	uint32_t last_d1_focus_id = last_d1_focus ? last_d1_focus->id : 0;
 	uint32_t last_d2_focus_id = last_d2_focus ? last_d2_focus->id : 0;
 
-	if (n1->presel && n1->presel->feedback != BSPWM_WID_NONE) {
-		backend_destroy_window(n1->presel->feedback);
+	if (n1->presel) {
+		release_presel_feedback(n1->presel->feedback);
 		n1->presel->feedback = BSPWM_WID_NONE;
 	}
-	if (n2->presel && n2->presel->feedback != BSPWM_WID_NONE) {
-		backend_destroy_window(n2->presel->feedback);
+	if (n2->presel) {
+		release_presel_feedback(n2->presel->feedback);
 		n2->presel->feedback = BSPWM_WID_NONE;
 	}
 
@@ -1879,6 +2357,11 @@ bool swap_nodes(monitor_t *m1, desktop_t *d1, node_t *n1, monitor_t *m2, desktop
 
 	n1->parent = pn2;
 	n2->parent = pn1;
+	link_leaves(n1);
+	link_leaves(n2);
+
+	mark_layout_dirty(n1);
+	mark_layout_dirty(n2);
 
 	propagate_flags_upward(m2, d2, n1);
 	propagate_flags_upward(m1, d1, n2);
@@ -1891,6 +2374,13 @@ bool swap_nodes(monitor_t *m1, desktop_t *d1, node_t *n1, monitor_t *m2, desktop
 			d2->root = n1;
 		}
 
+		window_index_add_in(m1, d1, n2);
+		window_index_add_in(m2, d2, n1);
+		flag_index_remove_in(m1, d1, n1);
+		flag_index_remove_in(m2, d2, n2);
+		flag_index_add_in(m1, d1, n2);
+		flag_index_add_in(m2, d2, n1);
+
 		if (n1_held_focus) {
 			if (n2_held_focus && last_d2_focus_id != 0) {
 				coordinates_t loc;
@@ -2243,6 +2733,7 @@ void set_vacant_local(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->vacant = value;
+	mark_layout_dirty(n);
 
 	if (value) {
 		cancel_presel(m, d, n);
@@ -2317,6 +2808,7 @@ bool set_layer(monitor_t *m, desktop_t *d, node_t *n, stack_layer_t l)
 
 	if (d) {
 		stack(d, n, (d->focus == n));
+		apply_pending_geometry(m, d);
 	}
 
 	return true;
@@ -2333,6 +2825,9 @@ bool set_state(monitor_t *m, desktop_t *d, node_t *n, client_state_t s)
 
 	c->last_state = c->state;
 	c->state = s;
+	rebuild_counts_towards_root(n);
+	mark_layout_dirty(n);
+	spatial_index_invalidate(d);
 
 	switch (c->last_state) {
 		case STATE_TILED:
@@ -2487,6 +2982,54 @@ void rebuild_constraints_towards_root(node_t *n)
 	rebuild_constraints_towards_root_bounded(n, 0);
 }
 
+static void rebuild_counts_from_leaves_bounded(node_t *n, int depth)
+{
+	if (!n || depth > MAX_TREE_DEPTH) {
+		return;
+	}
+	rebuild_counts_from_leaves_bounded(n->first_child, depth + 1);
+	rebuild_counts_from_leaves_bounded(n->second_child, depth + 1);
+	update_counts(n);
+}
+
+void rebuild_counts_from_leaves(node_t *n)
+{
+	rebuild_counts_from_leaves_bounded(n, 0);
+}
+
+void rebuild_counts_towards_root(node_t *n)
+{
+	for (node_t *p = n; p; p = p->parent) {
+		update_counts(p);
+	}
+}
+
+/* Derives the counts of n from its children, or from its client if n is a
+ * leaf. The children have to be up to date. */
+void update_counts(node_t *n)
+{
+	if (!n) {
+		return;
+	}
+
+	if (is_leaf(n)) {
+		client_t *c = n->client;
+		n->counts.clients = c ? 1 : 0;
+		n->counts.tiled = (c && !n->hidden && IS_TILED(c)) ? 1 : 0;
+		n->counts.receptacles = (!c && !n->hidden) ? 1 : 0;
+		n->counts.tiles = (c && !IS_FLOATING(c)) ? 1 : 0;
+		return;
+	}
+
+	node_counts_t z = {0};
+	node_counts_t *a = n->first_child ? &n->first_child->counts : &z;
+	node_counts_t *b = n->second_child ? &n->second_child->counts : &z;
+	n->counts.clients = a->clients + b->clients;
+	n->counts.tiled = a->tiled + b->tiled;
+	n->counts.receptacles = a->receptacles + b->receptacles;
+	n->counts.tiles = a->tiles + b->tiles;
+}
+
 void update_constraints(node_t *n)
 {
 	if (!n || is_leaf(n) || !n->first_child || !n->second_child) {
@@ -2523,6 +3066,7 @@ static void propagate_flags_upward_bounded(monitor_t *m, desktop_t *d, node_t *n
 		set_vacant_local(m, d, p, (p->first_child->vacant && p->second_child->vacant));
 		set_hidden_local(m, d, p, (p->first_child->hidden && p->second_child->hidden));
 		update_constraints(p);
+		update_counts(p);
 	}
 
 	propagate_flags_upward_bounded(m, d, p, depth + 1);
@@ -2582,9 +3126,10 @@ void set_hidden_local(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->hidden = value;
+	flag_index_update(m, d, n);
 
 	if (n->client) {
-		if (n->client->shown) {
+		if (n->client->shown || composited_switching) {
 			window_set_visibility(n->id, !value);
 		}
 
@@ -2611,6 +3156,7 @@ static void propagate_hidden_downward_bounded(monitor_t *m, desktop_t *d, node_t
 	set_hidden_local(m, d, n, value);
 	propagate_hidden_downward_bounded(m, d, n->first_child, value, depth + 1);
 	propagate_hidden_downward_bounded(m, d, n->second_child, value, depth + 1);
+	update_counts(n);
 }
 
 void propagate_hidden_downward(monitor_t *m, desktop_t *d, node_t *n, bool value)
@@ -2628,6 +3174,7 @@ static void propagate_hidden_upward_bounded(monitor_t *m, desktop_t *d, node_t *
 
 	if (p && p->first_child && p->second_child) {
 		set_hidden_local(m, d, p, p->first_child->hidden && p->second_child->hidden);
+		update_counts(p);
 	}
 
 	propagate_hidden_upward_bounded(m, d, p, depth + 1);
@@ -2649,6 +3196,7 @@ void set_sticky(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->sticky = value;
+	flag_index_update(m, m->desk, n);
 
 	if (value) {
 		m->sticky_count++;
@@ -2680,6 +3228,7 @@ void set_private(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->private = value;
+	flag_index_update(m, d, n);
 
 	if (m && d) {
 		put_status(SBSC_MASK_NODE_FLAG, "node_flag 0x%08X 0x%08X 0x%08X private %s\n",
@@ -2698,6 +3247,7 @@ void set_locked(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->locked = value;
+	flag_index_update(m, d, n);
 
 	if (m && d) {
 		put_status(SBSC_MASK_NODE_FLAG, "node_flag 0x%08X 0x%08X 0x%08X locked %s\n",
@@ -2716,6 +3266,7 @@ void set_marked(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->marked = value;
+	flag_index_update(m, d, n);
 
 	if (m && d) {
 		put_status(SBSC_MASK_NODE_FLAG, "node_flag 0x%08X 0x%08X 0x%08X marked %s\n",
@@ -2742,14 +3293,7 @@ void set_urgent(monitor_t *m, desktop_t *d, node_t *n, bool value)
 	}
 
 	n->client->urgent = value;
-
-	if (d) {
-		if (value) {
-			d->urgent_count++;
-		} else {
-			d->urgent_count = SAFE_SUB(d->urgent_count, 1);
-		}
-	}
+	flag_index_update(m, d, n);
 
 	if (value) {
 		n->client->wm_flags |= WM_FLAG_DEMANDS_ATTENTION;
@@ -2807,7 +3351,7 @@ static void regenerate_ids_in_bounded(node_t *n, int depth)
 	if (!n || n->client || depth > MAX_TREE_DEPTH) {
 		return;
 	}
-	n->id = ++id_counter;
+	node_registry_set_id(n, ++id_counter);
 	regenerate_ids_in_bounded(n->first_child, depth + 1);
 	regenerate_ids_in_bounded(n->second_child, depth + 1);
 }
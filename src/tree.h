@@ -29,7 +29,21 @@
 #define MIN_HEIGHT  32
 
 void arrange(monitor_t *m, desktop_t *d);
+/* Between hold_arrange and release_arrange, arrange only marks the
+ * desktop: release_arrange, and flush_arrange before that, arrange each
+ * marked desktop once. */
+void hold_arrange(void);
+void release_arrange(void);
+void flush_arrange(void);
+void mark_layout_dirty(node_t *n);
+void invalidate_layout_in(node_t *n);
 void apply_layout(monitor_t *m, desktop_t *d, node_t *n, bspwm_rect_t rect, bspwm_rect_t root_rect);
+void apply_pending_geometry(monitor_t *m, desktop_t *d);
+/* Feedback windows come unmapped from a small pool of spares, where
+ * release_presel_feedback puts them back. */
+extern unsigned int presel_feedback_count;
+bspwm_wid_t acquire_presel_feedback(void);
+void release_presel_feedback(bspwm_wid_t win);
 presel_t *make_presel(void);
 bool set_type(node_t *n, split_type_t typ);
 bool set_ratio(node_t *n, double rat);
@@ -46,7 +60,11 @@ bool focus_node(monitor_t *m, desktop_t *d, node_t *n);
 void hide_node(desktop_t *d, node_t *n);
 void show_node(desktop_t *d, node_t *n);
 node_t *make_node(uint32_t id);
+node_t *make_leaf(uint32_t id);
 client_t *make_client(void);
+void set_client_class(client_t *c, const char *class_name, const char *instance_name);
+void set_client_name(client_t *c, const char *name);
+void reserve_nodes(size_t count);
 void initialize_client(node_t *n);
 bool is_focusable(node_t *n);
 bool is_leaf(node_t *n);
@@ -61,6 +79,9 @@ node_t *next_node(node_t *n);
 node_t *prev_node(node_t *n);
 node_t *next_leaf(node_t *n, node_t *r);
 node_t *prev_leaf(node_t *n, node_t *r);
+void link_leaves(node_t *n);
+void unlink_leaves(node_t *n);
+void relink_leaves(node_t *n);
 
 typedef struct {
 	node_t **nodes;
@@ -76,6 +97,7 @@ bool is_adjacent(node_t *a, node_t *b, direction_t dir);
 node_t *find_fence(node_t *n, direction_t dir);
 bool is_child(node_t *a, node_t *b);
 bool is_descendant(node_t *a, node_t *b);
+bool precedes(node_t *a, node_t *b);
 bool find_by_id(uint32_t id, coordinates_t *loc);
 node_t *find_by_id_in(node_t *r, uint32_t id);
 void find_any_node(coordinates_t *ref, coordinates_t *dst, node_select_t *sel);
@@ -111,6 +133,9 @@ void set_fullscreen(monitor_t *m, desktop_t *d, node_t *n, bool value);
 void neutralize_occluding_windows(monitor_t *m, desktop_t *d, node_t *n);
 void rebuild_constraints_from_leaves(node_t *n);
 void rebuild_constraints_towards_root(node_t *n);
+void rebuild_counts_from_leaves(node_t *n);
+void rebuild_counts_towards_root(node_t *n);
+void update_counts(node_t *n);
 void update_constraints(node_t *n);
 void propagate_flags_upward(monitor_t *m, desktop_t *d, node_t *n);
 void set_hidden(monitor_t *m, desktop_t *d, node_t *n, bool value);
@@ -51,6 +51,12 @@ typedef enum automatic_scheme : unsigned char {
 	SCHEME_SPIRAL
 } automatic_scheme_t;
 
+typedef enum subscriber_overflow : unsigned char {
+	OVERFLOW_DROP_OLDEST,
+	OVERFLOW_COALESCE,
+	OVERFLOW_DISCONNECT
+} subscriber_overflow_t;
+
 typedef enum honor_size_hints_mode : unsigned char {
 	HONOR_SIZE_HINTS_NO = 0,
 	HONOR_SIZE_HINTS_YES,
@@ -87,12 +93,6 @@ typedef enum stack_layer : unsigned char {
 	LAYER_ABOVE
 } stack_layer_t;
 
-typedef enum option_bool : unsigned char {
-	OPTION_NONE,
-	OPTION_TRUE,
-	OPTION_FALSE
-} option_bool_t;
-
 typedef enum alter_state : unsigned char {
 	ALTER_TOGGLE,
 	ALTER_SET
@@ -183,48 +183,81 @@ typedef enum state_transition : unsigned char {
 	STATE_TRANSITION_EXIT = 0b10,
 } state_transition_t;
 
+/* Selector modifiers, one bit each. A selector holds in 'mask' the
+ * modifiers it constrains and in 'want' the value they must have. */
+typedef enum node_modifier : uint32_t {
+	NODE_MOD_AUTOMATIC = 1u << 0,
+	NODE_MOD_FOCUSED = 1u << 1,
+	NODE_MOD_ACTIVE = 1u << 2,
+	NODE_MOD_LOCAL = 1u << 3,
+	NODE_MOD_LEAF = 1u << 4,
+	NODE_MOD_WINDOW = 1u << 5,
+	NODE_MOD_TILED = 1u << 6,
+	NODE_MOD_PSEUDO_TILED = 1u << 7,
+	NODE_MOD_FLOATING = 1u << 8,
+	NODE_MOD_FULLSCREEN = 1u << 9,
+	NODE_MOD_HIDDEN = 1u << 10,
+	NODE_MOD_STICKY = 1u << 11,
+	NODE_MOD_PRIVATE = 1u << 12,
+	NODE_MOD_LOCKED = 1u << 13,
+	NODE_MOD_MARKED = 1u << 14,
+	NODE_MOD_URGENT = 1u << 15,
+	NODE_MOD_SAME_CLASS = 1u << 16,
+	NODE_MOD_DESCENDANT_OF = 1u << 17,
+	NODE_MOD_ANCESTOR_OF = 1u << 18,
+	NODE_MOD_BELOW = 1u << 19,
+	NODE_MOD_NORMAL = 1u << 20,
+	NODE_MOD_ABOVE = 1u << 21,
+	NODE_MOD_HORIZONTAL = 1u << 22,
+	NODE_MOD_VERTICAL = 1u << 23,
+	/* Set along with NODE_MOD_ACTIVE by the active modifier. */
+	NODE_MOD_ACTIVE_DESKTOP = 1u << 24,
+} node_modifier_t;
+
+/* Node flags with a per-desktop index, in the order of their modifiers
+ * from NODE_MOD_HIDDEN on. */
+typedef enum node_flag : unsigned char {
+	NODE_FLAG_HIDDEN,
+	NODE_FLAG_STICKY,
+	NODE_FLAG_PRIVATE,
+	NODE_FLAG_LOCKED,
+	NODE_FLAG_MARKED,
+	NODE_FLAG_URGENT,
+	NODE_FLAGS_COUNT
+} node_flag_t;
+
+#define NODE_FLAGS_OF_MODIFIERS(m)  (((m) / NODE_MOD_HIDDEN) & ((1u << NODE_FLAGS_COUNT) - 1))
+
+typedef enum desktop_modifier : uint32_t {
+	DESKTOP_MOD_OCCUPIED = 1u << 0,
+	DESKTOP_MOD_FOCUSED = 1u << 1,
+	DESKTOP_MOD_ACTIVE = 1u << 2,
+	DESKTOP_MOD_URGENT = 1u << 3,
+	DESKTOP_MOD_LOCAL = 1u << 4,
+	DESKTOP_MOD_TILED = 1u << 5,
+	DESKTOP_MOD_MONOCLE = 1u << 6,
+	DESKTOP_MOD_USER_TILED = 1u << 7,
+	DESKTOP_MOD_USER_MONOCLE = 1u << 8,
+} desktop_modifier_t;
+
+typedef enum monitor_modifier : uint32_t {
+	MONITOR_MOD_OCCUPIED = 1u << 0,
+	MONITOR_MOD_FOCUSED = 1u << 1,
+} monitor_modifier_t;
+
 typedef struct {
-	option_bool_t automatic;
-	option_bool_t focused;
-	option_bool_t active;
-	option_bool_t local;
-	option_bool_t leaf;
-	option_bool_t window;
-	option_bool_t tiled;
-	option_bool_t pseudo_tiled;
-	option_bool_t floating;
-	option_bool_t fullscreen;
-	option_bool_t hidden;
-	option_bool_t sticky;
-	option_bool_t private;
-	option_bool_t locked;
-	option_bool_t marked;
-	option_bool_t urgent;
-	option_bool_t same_class;
-	option_bool_t descendant_of;
-	option_bool_t ancestor_of;
-	option_bool_t below;
-	option_bool_t normal;
-	option_bool_t above;
-	option_bool_t horizontal;
-	option_bool_t vertical;
+	uint32_t mask;
+	uint32_t want;
 } node_select_t;
 
 typedef struct {
-	option_bool_t occupied;
-	option_bool_t focused;
-	option_bool_t active;
-	option_bool_t urgent;
-	option_bool_t local;
-	option_bool_t tiled;
-	option_bool_t monocle;
-	option_bool_t user_tiled;
-	option_bool_t user_monocle;
+	uint32_t mask;
+	uint32_t want;
 } desktop_select_t;
 
 typedef struct {
-	option_bool_t occupied;
-	option_bool_t focused;
+	uint32_t mask;
+	uint32_t want;
 } monitor_select_t;
 
 /* icccm_props_t is now an alias for the backend-portable type */
@@ -249,23 +282,22 @@ typedef struct {
 
 	/* WARM fields - size hints used during resize */
 	bspwm_size_hints_t size_hints;
+	bspwm_rect_t geometry;             /* of the window, see client_geometry_sent() */
+	uint32_t geometry_serial;          /* of our last configure request */
+	bool geometry_known;
+
+	/* Configure requests of a floating window, see throttle_configure() */
+	uint64_t configure_period;         /* ms, second configure_count covers */
+	uint64_t configure_applied;        /* ms, when one was last applied */
+	uint16_t configure_count;
+	bool configure_deferred;           /* the last one waits for a frame */
 
 	/* COLD fields - only accessed during window creation/rule matching */
-	char class_name[MAX_CLASS_NAME_LEN];
-	char instance_name[MAX_INSTANCE_NAME_LEN];
-	char name[MAXLEN];
+	const char *class_name;            /* interned, see set_client_class() */
+	const char *instance_name;         /* interned */
+	char *name;                        /* out of line, NULL when unknown */
 } client_t;
 
-#define GEOMETRY_CACHE_SIZE 32
-#define GEOMETRY_CACHE_TTL_MS 100
-
-typedef struct {
-	bspwm_wid_t win;
-	bspwm_rect_t geometry;
-	uint64_t timestamp;
-	bool valid;
-} geometry_cache_entry_t;
-
 typedef struct presel_t presel_t;
 struct presel_t {
 	double split_ratio;
@@ -279,6 +311,18 @@ struct constraints_t {
 	uint16_t min_height;
 };
 
+/* Leaf counts of a subtree, see update_counts */
+typedef struct node_counts_t node_counts_t;
+struct node_counts_t {
+	uint32_t clients;
+	uint32_t tiled;        /* shown tiled and pseudo-tiled clients */
+	uint32_t receptacles;  /* shown receptacles */
+	uint32_t tiles;        /* non-floating clients, hidden ones included */
+};
+
+typedef struct history_t history_t;
+typedef struct stacking_list_t stacking_list_t;
+
 typedef struct node_t node_t;
 struct node_t {
 	node_t *parent;
@@ -291,12 +335,23 @@ struct node_t {
 	presel_t *presel;
 	bspwm_rect_t rectangle;
 	constraints_t constraints;
+	node_counts_t counts;
 	bool vacant;
 	bool hidden;
 	bool sticky;
 	bool private;
 	bool locked;
 	bool marked;
+	bool dirty;       /* the subtree needs a layout pass */
+	bool geometry_pending;  /* slot not sent to the window yet, see monocle_defers */
+	bool embedded_client;  /* allocated along with its client by make_leaf() */
+	uint8_t indexed_flags;  /* flags under which the node is linked, see lookup.h */
+	node_t *flag_prev[NODE_FLAGS_COUNT];
+	node_t *flag_next[NODE_FLAGS_COUNT];
+	node_t *leaf_prev;  /* neighbor leaves of a leaf in its tree, see next_leaf */
+	node_t *leaf_next;
+	history_t *history;  /* newest history entry of this node */
+	stacking_list_t *stack_entry;
 };
 
 typedef struct padding_t padding_t;
@@ -307,6 +362,29 @@ struct padding_t {
 	int left;
 };
 
+/* The client leaves of a desktop, in leaf order, non-floating ones first.
+ * keys[dir] sorts the non-floating ones by their edge facing a window
+ * searched from in direction dir, see spatial_index_get. */
+typedef struct {
+	node_t *node;
+	bspwm_rect_t rect;
+	uint32_t order;
+} spatial_entry_t;
+
+typedef struct {
+	int32_t key;
+	uint32_t entry;
+} spatial_key_t;
+
+typedef struct {
+	spatial_entry_t *entries;
+	spatial_key_t *keys[4];
+	uint32_t tiled_count;
+	uint32_t floating_count;
+	uint32_t capacity;
+	bool valid;
+} spatial_index_t;
+
 typedef struct desktop_t desktop_t;
 struct desktop_t {
 	char name[SMALEN];
@@ -320,10 +398,16 @@ struct desktop_t {
 	padding_t padding;
 	int window_gap;
 	unsigned int border_width;
-	unsigned int urgent_count;
+	node_t *flag_head[NODE_FLAGS_COUNT];  /* nodes having each flag */
+	unsigned int flag_count[NODE_FLAGS_COUNT];
 	bool tile_limit_enabled;
 	int max_tiles_per_desktop;
 	unsigned int cascade_index;
+	history_t *history;  /* newest history entry on this desktop */
+	spatial_index_t spatial;
+	bool stale_colors;  /* borders to redraw when shown */
+	bool arrange_held;  /* arranged by release_arrange */
+	bool geometry_pending;  /* leaves may hold a geometry_pending slot */
 };
 
 typedef struct monitor_t monitor_t;
@@ -335,9 +419,12 @@ struct monitor_t {
 	bool wired;
 	padding_t padding;
 	unsigned int sticky_count;
+	unsigned int flag_count[NODE_FLAGS_COUNT];  /* sums over the desktops */
 	int window_gap;
 	unsigned int border_width;
 	bspwm_rect_t rectangle;
+	uint32_t refresh;  /* mHz, 0 when unknown */
+	bool adaptive_sync;
 	desktop_t *desk;
 	desktop_t *desk_head;
 	desktop_t *desk_tail;
@@ -351,17 +438,22 @@ typedef struct {
 	node_t *node;
 } coordinates_t;
 
-typedef struct history_t history_t;
 struct history_t {
 	coordinates_t loc;
 	bool latest;
+	uint64_t order;      /* increases from the head to the tail */
 	history_t *prev;
 	history_t *next;
+	history_t *node_newer;  /* entries of the same node */
+	history_t *node_older;
+	history_t *desk_newer;  /* entries on the same desktop */
+	history_t *desk_older;
 };
 
-typedef struct stacking_list_t stacking_list_t;
 struct stacking_list_t {
 	node_t *node;
+	int level;           /* stacking segment, see stack_level() */
+	bool held;           /* moved while the stacking is held */
 	stacking_list_t *prev;
 	stacking_list_t *next;
 };
@@ -382,21 +474,22 @@ struct subscriber_list_t {
 	char* fifo_path;
 	int field;
 	int count;
+	char *ring;          /* pending output, allocated on first use */
+	size_t ring_start;
+	size_t ring_len;
+	bool line_started;   /* the first pending line was partly written */
+	bool report_pending; /* a report was coalesced away, send a fresh one */
+	bool polling;        /* waiting for EPOLLOUT */
+	bool finished;       /* count exhausted, remove once drained */
+	bool json;           /* one JSON object per event */
+	uint32_t monitor_id; /* only events about this monitor, 0 for any */
+	uint32_t desktop_id; /* only events about this desktop, 0 for any */
+	uint32_t node_id;    /* only events about this node, 0 for any */
+	char subtype[SMALEN]; /* only events of this subtype, empty for any */
 	subscriber_list_t *prev;
 	subscriber_list_t *next;
 };
 
-typedef struct rule_t rule_t;
-struct rule_t {
-	char class_name[MAXLEN];
-	char instance_name[MAXLEN];
-	char name[MAXLEN];
-	char effect[MAXLEN];
-	bool one_shot;
-	rule_t *prev;
-	rule_t *next;
-};
-
 typedef struct {
 	char class_name[MAXLEN];
 	char instance_name[MAXLEN];
@@ -420,11 +513,31 @@ typedef struct {
 	bool focus;
 	bool border;
 	bspwm_rect_t *rect;
+	bspwm_window_attrs_t attrs; /* what the window itself asked for */
 } rule_consequence_t;
 
+typedef struct rule_t rule_t;
+struct rule_t {
+	char class_name[MAXLEN];
+	char instance_name[MAXLEN];
+	char name[MAXLEN];
+	char effect[MAXLEN];
+	bool one_shot;
+	unsigned long seq;               /* insertion order, merges the buckets */
+	uint32_t effect_mask;            /* fields of effect_csq set by effect */
+	rule_consequence_t *effect_csq;  /* effect parsed by add_rule */
+	const char *class_id;            /* class_name interned by add_rule, NULL for MATCH_ANY */
+	const char *instance_id;
+	rule_t *prev;
+	rule_t *next;
+	rule_t *bucket_prev;
+	rule_t *bucket_next;
+};
+
 typedef struct pending_rule_t pending_rule_t;
 struct pending_rule_t {
-	int fd;
+	int fd;                /* -1 when waiting on the rule daemon */
+	uint64_t deadline;     /* monotonic ms, rule daemon only */
 	bspwm_wid_t win;
 	rule_consequence_t *csq;
 	event_queue_t *event_head;
@@ -433,4 +546,22 @@ struct pending_rule_t {
 	pending_rule_t *next;
 };
 
+typedef struct ipc_client_t ipc_client_t;
+struct ipc_client_t {
+	int fd;
+	bool framed;        /* sent FRAMED_HELLO */
+	bool closing;       /* removed once the output is sent */
+	uint32_t events;    /* registered with epoll */
+	char *buf;          /* received, not yet served */
+	size_t len;
+	size_t cap;
+	char *out;          /* to send, from out_pos */
+	size_t out_pos;
+	size_t out_len;
+	size_t out_cap;
+	uint64_t deadline;  /* monotonic ms, 0 when nothing is half done */
+	ipc_client_t *prev;
+	ipc_client_t *next;
+};
+
 #endif
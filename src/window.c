@@ -36,45 +36,43 @@
 #include "query.h"
 #include "rule.h"
 #include "settings.h"
-
-uint64_t get_time_ms(void)
-{
-	struct timespec ts;
-	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
-		return 0;
-	}
-	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
-}
 #include "geometry.h"
 #include "pointer.h"
 #include "stack.h"
 #include "tree.h"
 #include "parse.h"
+#include "lookup.h"
 #include "window.h"
 
-void schedule_window(bspwm_wid_t win)
+/* Set while adopt_orphans manages a batch of windows: each desktop is
+ * arranged once at the end instead of once per window. */
+static bool adopting = false;
+
+static bool is_schedulable(bspwm_wid_t win)
 {
 	coordinates_t loc;
-	uint8_t override_redirect = 0;
-	xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(dpy, xcb_get_window_attributes(dpy, win), NULL);
-
-	if (wa != NULL) {
-		override_redirect = wa->override_redirect;
-		free(wa);
-	}
-
-	if (override_redirect || locate_window(win, &loc)) {
-		return;
+	if (locate_window(win, &loc)) {
+		return false;
 	}
 
 	/* ignore pending windows */
 	for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
 		if (pr->win == win) {
-			return;
+			return false;
 		}
 	}
 
-	rule_consequence_t *csq = make_rule_consequence();
+	return true;
+}
+
+/* Takes ownership of csq, whose attributes have been collected. */
+static void schedule_consequence(bspwm_wid_t win, rule_consequence_t *csq)
+{
+	if (csq->attrs.override_redirect) {
+		free(csq);
+		return;
+	}
+
 	apply_rules(win, csq);
 	if (!schedule_rules(win, csq)) {
 		manage_window(win, csq, -1);
@@ -82,6 +80,23 @@ void schedule_window(bspwm_wid_t win)
 	}
 }
 
+void schedule_window(bspwm_wid_t win)
+{
+	if (!is_schedulable(win)) {
+		return;
+	}
+
+	rule_consequence_t *csq = make_rule_consequence();
+	if (csq == NULL) {
+		return;
+	}
+
+	/* Titles are only fetched for the rules that match them */
+	backend_fetch_window_attributes(win, &csq->attrs, csq->class_name, csq->instance_name,
+	                                rules_match_names() ? csq->name : NULL, sizeof(csq->class_name));
+	schedule_consequence(win, csq);
+}
+
 /* Free and NULL every heap field of a rule consequence. Safe on any exit
  * path: each field is freed at most once and nulled, so neither a second
  * call nor the caller's free(csq) can double-free. */
@@ -172,29 +187,29 @@ bool manage_window(bspwm_wid_t win, rule_consequence_t *csq, int fd)
 		presel_ratio(m, d, f, csq->split_ratio);
 	}
 
-	node_t *n = make_node(win);
+	node_t *n = make_leaf(win);
 	if (n == NULL) {
-		perror("manage_window: make_node");
-		clear_consequence_payload(csq);
-		return false;
-	}
-	client_t *c = make_client();
-	if (c == NULL) {
-		perror("manage_window: make_client");
-		free_node(n);
+		perror("manage_window: make_leaf");
 		clear_consequence_payload(csq);
 		return false;
 	}
+	client_t *c = n->client;
 	c->border_width = csq->border ? d->border_width : 0;
-	n->client = c;
-	initialize_client(n);
+	c->icccm_props = csq->attrs.icccm_props;
+	c->size_hints = csq->attrs.size_hints;
+	if (csq->attrs.has_geometry) {
+		c->geometry = csq->attrs.geometry;
+		c->geometry_known = true;
+	}
 
 	if (csq->rect != NULL) {
 		c->floating_rectangle = *csq->rect;
 		free(csq->rect);
 		csq->rect = NULL;
 	} else {
-		initialize_floating_rectangle(n);
+		if (c->geometry_known) {
+			c->floating_rectangle = c->geometry;
+		}
 		if (c->floating_rectangle.x == 0 && c->floating_rectangle.y == 0) {
 			csq->center = true;
 		}
@@ -218,10 +233,10 @@ bool manage_window(bspwm_wid_t win, rule_consequence_t *csq, int fd)
 		}
 	}
 
-	strncpy(c->class_name, csq->class_name, sizeof(c->class_name) - 1);
-	c->class_name[sizeof(c->class_name) - 1] = '\0';
-	strncpy(c->instance_name, csq->instance_name, sizeof(c->instance_name) - 1);
-	c->instance_name[sizeof(c->instance_name) - 1] = '\0';
+	set_client_class(c, csq->class_name, csq->instance_name);
+	if (csq->name[0] != '\0') {
+		set_client_name(c, csq->name);
+	}
 
 	if ((csq->state != NULL && (*(csq->state) == STATE_FLOATING || *(csq->state) == STATE_FULLSCREEN)) || csq->hidden) {
 		n->vacant = true;
@@ -259,7 +274,9 @@ bool manage_window(bspwm_wid_t win, rule_consequence_t *csq, int fd)
 	set_locked(m, d, n, csq->locked);
 	set_marked(m, d, n, csq->marked);
 
-	arrange(m, d);
+	if (!adopting) {
+		arrange(m, d);
+	}
 
 	uint32_t values[] = {CLIENT_EVENT_MASK | (focus_follows_pointer ? XCB_EVENT_MASK_ENTER_WINDOW : 0)};
 	xcb_change_window_attributes(dpy, win, XCB_CW_EVENT_MASK, values);
@@ -271,8 +288,12 @@ bool manage_window(bspwm_wid_t win, rule_consequence_t *csq, int fd)
 	} else {
 		hide_node(d, n);
 	}
+	/* Windows of hidden desktops stay mapped, parked */
+	if (composited_switching && !n->hidden) {
+		window_show(win);
+	}
 
-	ewmh_update_client_list(false);
+	ewmh_client_list_add(win);
 	ewmh_set_wm_desktop(n, d);
 
 	if (!csq->hidden && csq->focus) {
@@ -299,7 +320,7 @@ void set_window_state(bspwm_wid_t win, bspwm_wm_state_t state)
 
 void unmanage_window(bspwm_wid_t win)
 {
-	invalidate_geometry_cache(win);
+	backend_forget_window(win);
 	coordinates_t loc;
 	if (locate_window(win, &loc)) {
 		put_status(SBSC_MASK_NODE_REMOVE, "node_remove 0x%08X 0x%08X 0x%08X\n", loc.monitor->id, loc.desktop->id, win);
@@ -334,15 +355,10 @@ void initialize_presel_feedback(node_t *n)
 		return;
 	}
 
-	bspwm_wid_t win = xcb_generate_id(dpy);
-	uint32_t mask = XCB_CW_BACK_PIXEL | XCB_CW_SAVE_UNDER;
-	uint32_t values[] = {backend_get_color_pixel(presel_feedback_color), 1};
-	xcb_create_window(dpy, XCB_COPY_FROM_PARENT, win, root, 0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
-			          XCB_COPY_FROM_PARENT, mask, values);
-
-	xcb_icccm_set_wm_class(dpy, win, sizeof(PRESEL_FEEDBACK_IC), PRESEL_FEEDBACK_IC);
-	/* Make presel window's input shape NULL to pass any input to window below */
-	xcb_shape_rectangles(dpy, XCB_SHAPE_SO_SET, XCB_SHAPE_SK_INPUT, XCB_CLIP_ORDERING_UNSORTED, win, 0, 0, 0, NULL);
+	bspwm_wid_t win = acquire_presel_feedback();
+	if (win == BSPWM_WID_NONE) {
+		return;
+	}
 	stacking_list_t *s = stack_tail;
 	while (s != NULL && !IS_TILED(s->node->client)) {
 		s = s->prev;
@@ -362,6 +378,9 @@ void draw_presel_feedback(monitor_t *m, desktop_t *d, node_t *n)
 	bool exists = (n->presel->feedback != BSPWM_WID_NONE);
 	if (!exists) {
 		initialize_presel_feedback(n);
+		if (n->presel->feedback == BSPWM_WID_NONE) {
+			return;
+		}
 	}
 
 	int gap = gapless_monocle && d->layout == LAYOUT_MONOCLE ? 0 : d->window_gap;
@@ -436,11 +455,16 @@ void hide_presel_feedbacks(monitor_t *m, desktop_t *d, node_t *n)
 	}
 }
 
+/* Hidden desktops are redrawn by show_desktop */
 void update_colors(void)
 {
 	for (monitor_t *m = mon_head; m != NULL; m = m->next) {
 		for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
-			update_colors_in(d->root, d, m);
+			if (d == m->desk) {
+				update_colors_in(d->root, d, m);
+			} else {
+				d->stale_colors = true;
+			}
 		}
 	}
 }
@@ -450,7 +474,7 @@ void update_colors_in(node_t *n, desktop_t *d, monitor_t *m)
 	if (n == NULL) {
 		return;
 	} else {
-		if (n->presel != NULL) {
+		if (n->presel != NULL && n->presel->feedback != BSPWM_WID_NONE) {
 			uint32_t pxl = backend_get_color_pixel(presel_feedback_color);
 			xcb_change_window_attributes(dpy, n->presel->feedback, XCB_CW_BACK_PIXEL, &pxl);
 			if (d == m->desk) {
@@ -486,9 +510,12 @@ void draw_border(node_t *n, bool focused_node, bool focused_monitor)
 
 void window_draw_border(bspwm_wid_t win, uint32_t border_color_pxl)
 {
-	xcb_change_window_attributes(dpy, win, XCB_CW_BORDER_PIXEL, &border_color_pxl);
+	backend_window_set_border_color(win, border_color_pxl);
 }
 
+/* Adopt the windows a previous window manager left on a desktop. Every
+ * request is sent for the whole batch before the first reply is awaited:
+ * one round trip for the desktops, one for the attributes. */
 void adopt_orphans(void)
 {
 	xcb_query_tree_reply_t *qtr = xcb_query_tree_reply(dpy, xcb_query_tree(dpy, root), NULL);
@@ -498,15 +525,66 @@ void adopt_orphans(void)
 
 	int len = xcb_query_tree_children_length(qtr);
 	bspwm_wid_t *wins = xcb_query_tree_children(qtr);
+	if (len <= 0) {
+		free(qtr);
+		return;
+	}
+
+	xcb_get_property_cookie_t *desktop_cookies = malloc(len * sizeof(xcb_get_property_cookie_t));
+	bspwm_attrs_cookie_t *attrs_cookies = malloc(len * sizeof(bspwm_attrs_cookie_t));
+	rule_consequence_t **csqs = calloc(len, sizeof(rule_consequence_t *));
+
+	if (desktop_cookies == NULL || attrs_cookies == NULL || csqs == NULL) {
+		perror("adopt_orphans: malloc");
+		free(desktop_cookies);
+		free(attrs_cookies);
+		free(csqs);
+		free(qtr);
+		return;
+	}
+
+	for (int i = 0; i < len; i++) {
+		desktop_cookies[i] = xcb_ewmh_get_wm_desktop(ewmh, wins[i]);
+	}
 
 	for (int i = 0; i < len; i++) {
 		uint32_t idx;
-		bspwm_wid_t win = wins[i];
-		if (xcb_ewmh_get_wm_desktop_reply(ewmh, xcb_ewmh_get_wm_desktop(ewmh, win), &idx, NULL) == 1) {
-			schedule_window(win);
+		if (xcb_ewmh_get_wm_desktop_reply(ewmh, desktop_cookies[i], &idx, NULL) == 1 && is_schedulable(wins[i])) {
+			csqs[i] = make_rule_consequence();
+		}
+	}
+
+	for (int i = 0; i < len; i++) {
+		if (csqs[i] != NULL) {
+			attrs_cookies[i] = backend_request_window_attributes(wins[i], rules_match_names());
+		}
+	}
+
+	unsigned int adopted = 0;
+	adopting = true;
+	for (int i = 0; i < len; i++) {
+		rule_consequence_t *csq = csqs[i];
+		if (csq == NULL) {
+			continue;
+		}
+		backend_collect_window_attributes(wins[i], attrs_cookies[i], &csq->attrs,
+		                                  csq->class_name, csq->instance_name, csq->name, sizeof(csq->class_name));
+		schedule_consequence(wins[i], csq);
+		adopted++;
+	}
+	adopting = false;
+
+	if (adopted > 0) {
+		for (monitor_t *m = mon_head; m != NULL; m = m->next) {
+			for (desktop_t *d = m->desk_head; d != NULL; d = d->next) {
+				arrange(m, d);
+			}
 		}
 	}
 
+	free(desktop_cookies);
+	free(attrs_cookies);
+	free(csqs);
 	free(qtr);
 }
 
@@ -521,35 +599,21 @@ uint32_t get_border_color(bool focused_node, bool focused_monitor)
 	}
 }
 
-void initialize_floating_rectangle(node_t *n)
-{
-	client_t *c = n->client;
-
-	xcb_get_geometry_reply_t *geo = xcb_get_geometry_reply(dpy, xcb_get_geometry(dpy, n->id), NULL);
-
-	if (geo != NULL) {
-		c->floating_rectangle = (bspwm_rect_t) {geo->x, geo->y, geo->width, geo->height};
-	}
-
-	free(geo);
-}
-
 bspwm_rect_t get_window_rectangle(node_t *n)
 {
 	client_t *c = n->client;
 	if (c != NULL) {
-		/* Check cache first to avoid X11 round-trip */
-		bspwm_rect_t cached;
-		if (get_cached_geometry(n->id, &cached)) {
-			return cached;
+		/* Only windows that were never configured take a round trip. */
+		if (c->geometry_known) {
+			lookup_stats.geometry_hits++;
+		} else {
+			lookup_stats.geometry_misses++;
+			if (backend_window_get_geometry(n->id, &c->geometry)) {
+				c->geometry_known = true;
+			}
 		}
-		/* Cache miss - do X11 call and cache result */
-		xcb_get_geometry_reply_t *g = xcb_get_geometry_reply(dpy, xcb_get_geometry(dpy, n->id), NULL);
-		if (g != NULL) {
-			bspwm_rect_t rect = (bspwm_rect_t) {g->x, g->y, g->width, g->height};
-			free(g);
-			cache_geometry(n->id, rect);
-			return rect;
+		if (c->geometry_known) {
+			return c->geometry;
 		}
 	}
 	return (bspwm_rect_t) {0, 0, screen_width, screen_height};
@@ -692,6 +756,7 @@ bool resize_client(coordinates_t *loc, resize_handle_t rh, int dx, int dy, bool
 			y += rect.height - height;
 		}
 		n->client->floating_rectangle = (bspwm_rect_t) {x, y, width, height};
+		mark_layout_dirty(n);
 		if (n->client->state == STATE_FLOATING) {
 			window_move_resize(n->id, x, y, width, height);
 
@@ -909,29 +974,25 @@ void disable_motion_recorder(void)
 
 void window_border_width(bspwm_wid_t win, uint32_t bw)
 {
-	uint32_t values[] = {bw};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_BORDER_WIDTH, values);
+	backend_window_set_border_width(win, bw);
 }
 
 void window_move(bspwm_wid_t win, int16_t x, int16_t y)
 {
-	uint32_t values[] = {x, y};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X_Y, values);
-	invalidate_geometry_cache(win);
+	backend_window_move(win, x, y);
+	client_geometry_sent(win, (bspwm_rect_t) {x, y, 0, 0}, GEOMETRY_POSITION);
 }
 
 void window_resize(bspwm_wid_t win, uint16_t w, uint16_t h)
 {
-	uint32_t values[] = {w, h};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_WIDTH_HEIGHT, values);
-	invalidate_geometry_cache(win);
+	backend_window_resize(win, w, h);
+	client_geometry_sent(win, (bspwm_rect_t) {0, 0, w, h}, GEOMETRY_SIZE);
 }
 
 void window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t w, uint16_t h)
 {
-	uint32_t values[] = {x, y, w, h};
-	xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_X_Y_WIDTH_HEIGHT, values);
-	invalidate_geometry_cache(win);
+	backend_window_move_resize(win, x, y, w, h);
+	client_geometry_sent(win, (bspwm_rect_t) {x, y, w, h}, GEOMETRY_POSITION | GEOMETRY_SIZE);
 }
 
 void window_center(monitor_t *m, client_t *c)
@@ -974,6 +1035,15 @@ void window_below(bspwm_wid_t w1, bspwm_wid_t w2)
 	window_stack(w1, w2, XCB_STACK_MODE_BELOW);
 }
 
+/* Stack each wins[i] right above (or below) siblings[i], in order */
+void window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings, uint32_t count, bool above)
+{
+	uint32_t mode = above ? XCB_STACK_MODE_ABOVE : XCB_STACK_MODE_BELOW;
+	for (uint32_t i = 0; i < count; i++) {
+		window_stack(wins[i], siblings[i], mode);
+	}
+}
+
 void window_lower(bspwm_wid_t win)
 {
 	uint32_t values[] = {XCB_STACK_MODE_BELOW};
@@ -986,9 +1056,11 @@ void window_set_visibility(bspwm_wid_t win, bool visible)
 	uint32_t values_on[] = {ROOT_EVENT_MASK};
 	xcb_change_window_attributes(dpy, root, XCB_CW_EVENT_MASK, values_off);
 	if (visible) {
+		lookup_stats.maps++;
 		set_window_state(win, BSP_WM_STATE_NORMAL);
 		xcb_map_window(dpy, win);
 	} else {
+		lookup_stats.unmaps++;
 		xcb_unmap_window(dpy, win);
 		set_window_state(win, BSP_WM_STATE_ICONIC);
 	}
@@ -1005,6 +1077,20 @@ void window_show(bspwm_wid_t win)
 	window_set_visibility(win, true);
 }
 
+void window_park(bspwm_wid_t win, bool parked)
+{
+	if (parked) {
+		lookup_stats.parks++;
+	} else {
+		lookup_stats.unparks++;
+	}
+	backend_window_park(win, parked);
+	if (!parked) {
+		/* The geometry reports of the parked window are stale */
+		client_geometry_sent(win, (bspwm_rect_t) {0, 0, 0, 0}, 0);
+	}
+}
+
 void update_input_focus(void)
 {
 	set_input_focus(mon->desk->focus);
@@ -1082,59 +1168,3 @@ bool window_exists(bspwm_wid_t win)
 
 	return true;
 }
-
-static geometry_cache_entry_t geometry_cache[GEOMETRY_CACHE_SIZE] = {0};
-
-bool get_cached_geometry(bspwm_wid_t win, bspwm_rect_t *geometry)
-{
-	uint64_t current_time = get_time_ms();
-
-	for (int i = 0; i < GEOMETRY_CACHE_SIZE; i++) {
-		geometry_cache_entry_t *entry = &geometry_cache[i];
-		if (entry->valid && entry->win == win) {
-			if (current_time - entry->timestamp <= GEOMETRY_CACHE_TTL_MS) {
-				*geometry = entry->geometry;
-				return true;
-			} else {
-				entry->valid = false;
-			}
-		}
-	}
-	return false;
-}
-
-void cache_geometry(bspwm_wid_t win, bspwm_rect_t geometry)
-{
-	uint64_t current_time = get_time_ms();
-	int slot = -1;
-
-	uint64_t oldest_time = UINT64_MAX;
-	for (int i = 0; i < GEOMETRY_CACHE_SIZE; i++) {
-		if (geometry_cache[i].win == win) {
-			slot = i;
-			break;
-		}
-		if (!geometry_cache[i].valid || geometry_cache[i].timestamp < oldest_time) {
-			oldest_time = geometry_cache[i].timestamp;
-			slot = i;
-		}
-	}
-
-	if (slot >= 0) {
-		geometry_cache[slot] = (geometry_cache_entry_t){
-			.win = win,
-			.geometry = geometry,
-			.timestamp = current_time,
-			.valid = true
-		};
-	}
-}
-
-void invalidate_geometry_cache(bspwm_wid_t win)
-{
-	for (int i = 0; i < GEOMETRY_CACHE_SIZE; i++) {
-		if (geometry_cache[i].win == win) {
-			geometry_cache[i].valid = false;
-		}
-	}
-}
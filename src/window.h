@@ -44,7 +44,6 @@ void draw_border(node_t *n, bool focused_node, bool focused_monitor);
 void window_draw_border(bspwm_wid_t win, uint32_t border_color_pxl);
 void adopt_orphans(void);
 uint32_t get_border_color(bool focused_node, bool focused_monitor);
-void initialize_floating_rectangle(node_t *n);
 bspwm_rect_t get_window_rectangle(node_t *n);
 bool move_client(coordinates_t *loc, int dx, int dy);
 bool resize_client(coordinates_t *loc, resize_handle_t rh, int dx, int dy, bool relative);
@@ -61,18 +60,16 @@ void window_center(monitor_t *m, client_t *c);
 void window_stack(bspwm_wid_t w1, bspwm_wid_t w2, uint32_t mode);
 void window_above(bspwm_wid_t w1, bspwm_wid_t w2);
 void window_below(bspwm_wid_t w1, bspwm_wid_t w2);
+void window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings, uint32_t count, bool above);
 void window_lower(bspwm_wid_t win);
 void window_set_visibility(bspwm_wid_t win, bool visible);
 void window_hide(bspwm_wid_t win);
 void window_show(bspwm_wid_t win);
+void window_park(bspwm_wid_t win, bool parked);
 void update_input_focus(void);
 void set_input_focus(node_t *n);
 void clear_input_focus(void);
 void center_pointer(bspwm_rect_t r);
 bool window_exists(bspwm_wid_t win);
 
-bool get_cached_geometry(bspwm_wid_t win, bspwm_rect_t *geometry);
-void cache_geometry(bspwm_wid_t win, bspwm_rect_t geometry);
-void invalidate_geometry_cache(bspwm_wid_t win);
-
 #endif
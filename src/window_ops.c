@@ -23,6 +23,7 @@
 #include "stack.h"
 #include "tree.h"
 #include "subscribe.h"
+#include "lookup.h"
 #include "window.h"
 
 /* ---- Globals that window.c normally defines ---- */
@@ -37,34 +38,53 @@ uint16_t scroll_lock = 0;
 void window_move(bspwm_wid_t win, int16_t x, int16_t y)
 {
 	backend_window_move(win, x, y);
+	client_geometry_sent(win, (bspwm_rect_t) {x, y, 0, 0}, GEOMETRY_POSITION);
 }
 
 void window_resize(bspwm_wid_t win, uint16_t w, uint16_t h)
 {
 	backend_window_resize(win, w, h);
+	client_geometry_sent(win, (bspwm_rect_t) {0, 0, w, h}, GEOMETRY_SIZE);
 }
 
 void window_move_resize(bspwm_wid_t win, int16_t x, int16_t y, uint16_t w, uint16_t h)
 {
 	backend_window_move_resize(win, x, y, w, h);
+	client_geometry_sent(win, (bspwm_rect_t) {x, y, w, h}, GEOMETRY_POSITION | GEOMETRY_SIZE);
 }
 
 void window_show(bspwm_wid_t win)
 {
+	lookup_stats.maps++;
 	backend_window_show(win);
 }
 
 void window_hide(bspwm_wid_t win)
 {
+	lookup_stats.unmaps++;
 	backend_window_hide(win);
 }
 
+void window_park(bspwm_wid_t win, bool parked)
+{
+	if (parked) {
+		lookup_stats.parks++;
+	} else {
+		lookup_stats.unparks++;
+	}
+	backend_window_park(win, parked);
+	if (!parked) {
+		/* The geometry reports of the parked window are stale */
+		client_geometry_sent(win, (bspwm_rect_t) {0, 0, 0, 0}, 0);
+	}
+}
+
 void window_set_visibility(bspwm_wid_t win, bool visible)
 {
 	if (visible)
-		backend_window_show(win);
+		window_show(win);
 	else
-		backend_window_hide(win);
+		window_hide(win);
 }
 
 void window_border_width(bspwm_wid_t win, uint32_t bw)
@@ -87,6 +107,11 @@ void window_below(bspwm_wid_t w1, bspwm_wid_t w2)
 	backend_window_stack_below(w1, w2);
 }
 
+void window_restack(const bspwm_wid_t *wins, const bspwm_wid_t *siblings, uint32_t count, bool above)
+{
+	backend_window_restack(wins, siblings, count, above);
+}
+
 void window_lower(bspwm_wid_t win)
 {
 	backend_window_lower(win);
@@ -166,10 +191,15 @@ void ewmh_update_number_of_desktops(void) {}
 void ewmh_update_current_desktop(void) {}
 void ewmh_update_desktop_names(void) {}
 void ewmh_update_desktop_viewport(void) {}
+void hold_ewmh(void) {}
+void release_ewmh(void) {}
 void ewmh_set_wm_desktop(node_t *n, desktop_t *d) { (void)n; (void)d; }
 void ewmh_update_wm_desktops(void) {}
 void ewmh_update_client_list(bool stacking) { (void)stacking; }
 void ewmh_update_client_lists(void) {}
+void ewmh_client_list_add(bspwm_wid_t win) { (void)win; }
+void ewmh_client_list_remove(bspwm_wid_t win) { (void)win; }
+void ewmh_flush_client_lists(void) {}
 void ewmh_wm_state_update(node_t *n) { (void)n; }
 void ewmh_set_supporting(bspwm_wid_t win) { (void)win; }
 bool ewmh_handle_struts(bspwm_wid_t win) { (void)win; return false; }
@@ -217,20 +247,16 @@ void hide_presel_feedbacks(monitor_t *m, desktop_t *d, node_t *n) { (void)m; (vo
 bspwm_rect_t get_window_rectangle(node_t *n)
 {
 	if (!n || !n->client) return (bspwm_rect_t){0, 0, 0, 0};
+	if (n->client->geometry_known) {
+		lookup_stats.geometry_hits++;
+		return n->client->geometry;
+	}
+	lookup_stats.geometry_misses++;
 	if (IS_FLOATING(n->client))
 		return n->client->floating_rectangle;
 	return n->client->tiled_rectangle;
 }
 
-void initialize_floating_rectangle(node_t *n)
-{
-	if (!n || !n->client) return;
-	bspwm_rect_t geo;
-	if (backend_window_get_geometry(n->id, &geo)) {
-		n->client->floating_rectangle = geo;
-	}
-}
-
 /* ---- Size hints ---- */
 
 void apply_size_hints(client_t *c, uint16_t *width, uint16_t *height)
@@ -253,7 +279,7 @@ void apply_size_hints(client_t *c, uint16_t *width, uint16_t *height)
 void schedule_window(bspwm_wid_t win)
 {
 	coordinates_t loc;
-	if (backend_is_override_redirect(win) || locate_window(win, &loc))
+	if (locate_window(win, &loc))
 		return;
 
 	for (pending_rule_t *pr = pending_rule_head; pr != NULL; pr = pr->next) {
@@ -262,6 +288,14 @@ void schedule_window(bspwm_wid_t win)
 	}
 
 	rule_consequence_t *csq = make_rule_consequence();
+	if (!csq) return;
+
+	backend_fetch_window_attributes(win, &csq->attrs, csq->class_name, csq->instance_name, csq->name, sizeof(csq->class_name));
+	if (csq->attrs.override_redirect) {
+		free(csq);
+		return;
+	}
+
 	apply_rules(win, csq);
 	if (!schedule_rules(win, csq)) {
 		manage_window(win, csq, -1);
@@ -312,22 +346,32 @@ bool manage_window(bspwm_wid_t win, rule_consequence_t *csq, int fd)
 		return false;
 	}
 
-	node_t *n = make_node(win);
-	client_t *c = make_client();
-	n->client = c;
+	node_t *n = make_leaf(win);
+	if (n == NULL) {
+		free(csq->rect);
+		free(csq->layer);
+		free(csq->state);
+		free(csq->split_dir);
+		return false;
+	}
+	client_t *c = n->client;
 
 	/* Copy rule consequence data */
-	snprintf(c->class_name, sizeof(c->class_name), "%s", csq->class_name);
-	snprintf(c->instance_name, sizeof(c->instance_name), "%s", csq->instance_name);
-	snprintf(c->name, sizeof(c->name), "%s", csq->name);
+	set_client_class(c, csq->class_name, csq->instance_name);
+	set_client_name(c, csq->name);
 
 	if (csq->state)
 		c->state = c->last_state = *csq->state;
 	if (csq->layer)
 		c->layer = c->last_layer = *csq->layer;
 
-	initialize_client(n);
-	initialize_floating_rectangle(n);
+	c->icccm_props = csq->attrs.icccm_props;
+	c->size_hints = csq->attrs.size_hints;
+	if (csq->attrs.has_geometry) {
+		c->geometry = csq->attrs.geometry;
+		c->geometry_known = true;
+		c->floating_rectangle = c->geometry;
+	}
 
 	if (csq->rect) {
 		c->floating_rectangle = *csq->rect;
@@ -352,8 +396,15 @@ bool manage_window(bspwm_wid_t win, rule_consequence_t *csq, int fd)
 	uint32_t bcolor = get_border_color(d->focus == n, mon == m);
 	backend_window_set_border_color(win, bcolor);
 
-	backend_window_show(win);
-	c->shown = true;
+	if (d == m->desk) {
+		show_node(d, n);
+	} else {
+		hide_node(d, n);
+	}
+	/* Windows of hidden desktops stay mapped, parked */
+	if (composited_switching && !n->hidden) {
+		window_show(win);
+	}
 
 	if (csq->focus && d == m->desk) {
 		focus_node(m, d, n);
@@ -379,6 +430,7 @@ void set_window_state(bspwm_wid_t win, bspwm_wm_state_t state)
 
 void unmanage_window(bspwm_wid_t win)
 {
+	backend_forget_window(win);
 	coordinates_t loc;
 	if (locate_window(win, &loc)) {
 		put_status(SBSC_MASK_NODE_REMOVE, "node_remove 0x%08X 0x%08X 0x%08X\n",
@@ -416,11 +468,16 @@ bool resize_client(coordinates_t *loc, resize_handle_t rh, int dx, int dy, bool
 	return true;
 }
 
+/* Hidden desktops are redrawn by show_desktop */
 void update_colors(void)
 {
 	for (monitor_t *m = mon_head; m; m = m->next) {
 		for (desktop_t *d = m->desk_head; d; d = d->next) {
-			update_colors_in(d->root, d, m);
+			if (d == m->desk) {
+				update_colors_in(d->root, d, m);
+			} else {
+				d->stale_colors = true;
+			}
 		}
 	}
 }
@@ -435,8 +492,7 @@ void initialize_presel_feedback(node_t *n)
 {
 	if (!n || !n->presel) return;
 	if (n->presel->feedback == BSPWM_WID_NONE) {
-		n->presel->feedback = backend_create_presel_feedback(
-			backend_get_color_pixel(presel_feedback_color));
+		n->presel->feedback = acquire_presel_feedback();
 	}
 }
 
@@ -447,24 +503,8 @@ void handle_event(void *evt) { (void)evt; }
 /* Keybind grabs — no-op on Wayland (handled in compositor keyboard handler) */
 void backend_grab_keys(void) { }
 void backend_ungrab_keys(void) { }
-
-/* ---- Geometry cache stubs ---- */
-
-bool get_cached_geometry(bspwm_wid_t win, bspwm_rect_t *geometry)
-{
-	(void)win; (void)geometry;
-	return false;
-}
-
-void cache_geometry(bspwm_wid_t win, bspwm_rect_t geometry)
-{
-	(void)win; (void)geometry;
-}
-
-void invalidate_geometry_cache(bspwm_wid_t win)
-{
-	(void)win;
-}
+void backend_grab_keyboard(void) { }
+void backend_ungrab_keyboard(void) { }
 
 /* ---- Pointer tracking stubs ---- */
 
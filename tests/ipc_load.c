@@ -0,0 +1,121 @@
+/* Paced bspc load for run_perf.
+ * Sends one command per connection at a fixed rate, like bspc does, and
+ * prints the latency percentiles and the achieved rate as tab separated
+ * `<prefix>_<metric> value` lines.
+ *
+ * Usage: ipc_load PREFIX RATE SECONDS COMMAND [ARGS...] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+static int send_command(const char *path, const char *msg, size_t len)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    send(fd, msg, len, 0) != (ssize_t)len) {
+		close(fd);
+		return -1;
+	}
+	char buf[BUFSIZ];
+	int status = 0;
+	ssize_t n;
+	bool first = true;
+	while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+		/* A leading 0x07 marks a failure, see bspc.c */
+		if (first && buf[0] == 7) {
+			status = 1;
+		}
+		first = false;
+	}
+	close(fd);
+	return status;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 5) {
+		fprintf(stderr, "Usage: %s PREFIX RATE SECONDS COMMAND [ARGS...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const char *prefix = argv[1];
+	int rate = atoi(argv[2]);
+	int seconds = atoi(argv[3]);
+	const char *path = getenv("BSPWM_SOCKET");
+	if (rate < 1 || seconds < 1 || path == NULL) {
+		fprintf(stderr, "%s: need a positive RATE and SECONDS and BSPWM_SOCKET.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* Arguments are sent null separated */
+	char msg[BUFSIZ];
+	size_t len = 0;
+	for (int i = 4; i < argc; i++) {
+		size_t n = strlen(argv[i]) + 1;
+		if (len + n > sizeof(msg)) {
+			fprintf(stderr, "%s: command too long.\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+		memcpy(msg + len, argv[i], n);
+		len += n;
+	}
+
+	int total = rate * seconds;
+	long long *lat = malloc(total * sizeof(long long));
+	if (lat == NULL) {
+		return EXIT_FAILURE;
+	}
+	long long period = 1000000000LL / rate;
+	long long start = now_ns();
+	int failures = 0;
+
+	for (int i = 0; i < total; i++) {
+		long long due = start + i * period;
+		long long t = now_ns();
+		if (t < due) {
+			struct timespec ts = {(due - t) / 1000000000LL, (due - t) % 1000000000LL};
+			nanosleep(&ts, NULL);
+		}
+		long long t0 = now_ns();
+		if (send_command(path, msg, len) != 0) {
+			failures++;
+		}
+		lat[i] = now_ns() - t0;
+	}
+
+	double elapsed = (now_ns() - start) / 1e9;
+	qsort(lat, total, sizeof(long long), cmp_ll);
+	printf("%s_p50_us\t%lld\n", prefix, lat[total / 2] / 1000);
+	printf("%s_p99_us\t%lld\n", prefix, lat[(total * 99) / 100] / 1000);
+	printf("%s_max_us\t%lld\n", prefix, lat[total - 1] / 1000);
+	printf("%s_rate\t%.0f\n", prefix, total / elapsed);
+	printf("%s_failures\t%d\n", prefix, failures);
+
+	free(lat);
+	return EXIT_SUCCESS;
+}
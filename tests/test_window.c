@@ -2,10 +2,23 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <xcb/xcb_event.h>
 #include <xcb/xcb_icccm.h>
 
 #define TEST_WINDOW_IC  "test\0Test"
+/* When set, print the microseconds between MapWindow and MapNotify */
+#define LATENCY_ENV_VAR "TEST_WINDOW_LATENCY"
+/* When set to N, grow the window with N configure requests once it is
+ * managed, then print the geometry it ended up with */
+#define BURST_ENV_VAR "TEST_WINDOW_BURST"
+
+static long elapsed_us(struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
 
 bool get_atom(xcb_connection_t *dpy, char *name, xcb_atom_t *atom)
 {
@@ -56,6 +69,28 @@ void render_text(xcb_connection_t *dpy, xcb_window_t win, int16_t x, int16_t y)
 	xcb_free_gc(dpy, gc);
 }
 
+static void sleep_ms(long ms)
+{
+	struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+	nanosleep(&ts, NULL);
+}
+
+void send_burst(xcb_connection_t *dpy, xcb_window_t win, int count)
+{
+	sleep_ms(1000);
+	for (int i = 1; i <= count; i++) {
+		uint32_t values[] = {320 + i, 240 + i};
+		xcb_configure_window(dpy, win, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+	}
+	xcb_flush(dpy);
+	sleep_ms(500);
+	xcb_get_geometry_reply_t *geo = xcb_get_geometry_reply(dpy, xcb_get_geometry(dpy, win), NULL);
+	if (geo != NULL) {
+		printf("%ux%u\n", geo->width, geo->height);
+		fflush(stdout);
+	}
+	free(geo);
+}
 
 int main(int argc, char **argv)
 {
@@ -96,14 +131,21 @@ int main(int argc, char **argv)
 		xcb_disconnect(dpy);
 		return EXIT_FAILURE;
 	}
+	bool report_latency = getenv(LATENCY_ENV_VAR) != NULL;
 	xcb_window_t win = xcb_generate_id(dpy);
 	uint32_t mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
-	uint32_t values[] = {0xff111111, XCB_EVENT_MASK_EXPOSURE};
+	uint32_t values[] = {0xff111111, XCB_EVENT_MASK_EXPOSURE | (report_latency ? XCB_EVENT_MASK_STRUCTURE_NOTIFY : 0)};
 	xcb_create_window(dpy, XCB_COPY_FROM_PARENT, win, screen->root, 0, 0, 320, 240, 2,
 	                  XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, mask, values);
 	xcb_icccm_set_wm_class(dpy, win, wm_class_len, wm_class);
+	struct timespec map_start;
+	clock_gettime(CLOCK_MONOTONIC, &map_start);
 	xcb_map_window(dpy, win);
 	xcb_flush(dpy);
+	char *burst = getenv(BURST_ENV_VAR);
+	if (burst != NULL) {
+		send_burst(dpy, win, atoi(burst));
+	}
 	xcb_generic_event_t *evt;
 	bool running = true;
 	while (running && (evt = xcb_wait_for_event(dpy)) != NULL) {
@@ -115,6 +157,10 @@ int main(int argc, char **argv)
 			}
 		} else if (rt == XCB_EXPOSE) {
 			render_text(dpy, win, 12, 24);
+		} else if (rt == XCB_MAP_NOTIFY && report_latency) {
+			printf("%ld\n", elapsed_us(&map_start));
+			fflush(stdout);
+			report_latency = false;
 		}
 		free(evt);
 	}
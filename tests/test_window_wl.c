@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <wayland-client.h>
 
@@ -17,6 +18,18 @@ static struct xdg_wm_base *xdg_wm_base;
 static struct wl_shm *shm;
 static bool running = true;
 static bool configured = false;
+/* When TEST_WINDOW_LATENCY is set, print the microseconds between the
+ * commit that maps the surface and the compositor's next configure */
+static bool report_latency = false;
+static bool mapped = false;
+static struct timespec map_start;
+
+static long elapsed_us(struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
 
 static void xdg_wm_base_ping(void *data, struct xdg_wm_base *base, uint32_t serial)
 {
@@ -64,6 +77,11 @@ static void xdg_surface_configure(void *data, struct xdg_surface *surface, uint3
 	(void)data;
 	xdg_surface_ack_configure(surface, serial);
 	configured = true;
+	if (mapped && report_latency) {
+		printf("%ld\n", elapsed_us(&map_start));
+		fflush(stdout);
+		report_latency = false;
+	}
 }
 
 static const struct xdg_surface_listener xdg_surface_listener = {
@@ -98,6 +116,7 @@ int main(int argc, char **argv)
 {
 	const char *app_id = "test";
 	if (argc > 1) app_id = argv[1];
+	report_latency = getenv("TEST_WINDOW_LATENCY") != NULL;
 
 	display = wl_display_connect(NULL);
 	if (!display) {
@@ -148,6 +167,8 @@ int main(int argc, char **argv)
 			wl_shm_pool_destroy(pool);
 			close(fd);
 			wl_surface_attach(surface, buffer, 0, 0);
+			clock_gettime(CLOCK_MONOTONIC, &map_start);
+			mapped = true;
 			wl_surface_commit(surface);
 		}
 	}